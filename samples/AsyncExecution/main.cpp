@@ -0,0 +1,285 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../Utils/async_queue.h"
+#include "../Utils/cmd_parser.h"
+
+const int QueueCount = 3;
+
+struct Readback
+{
+    rif_image_desc desc;
+    std::vector<rif_uchar> pixels;
+};
+
+Readback ReadbackImage(rif_image image)
+{
+    Readback result;
+    size_t retSize;
+    rifImageGetInfo(image, RIF_IMAGE_DESC, sizeof(result.desc), &result.desc, &retSize);
+
+    size_t size = 0;
+    rifImageGetInfo(image, RIF_IMAGE_DATA_SIZEBYTE, sizeof(size), &size, &retSize);
+
+    void* data = nullptr;
+    if (rifImageMap(image, RIF_IMAGE_MAP_READ, &data) == RIF_SUCCESS && data)
+    {
+        result.pixels.assign(static_cast<rif_uchar*>(data), static_cast<rif_uchar*>(data) + size);
+        rifImageUnmap(image, data);
+    }
+    return result;
+}
+
+#if defined(__cpp_impl_coroutine)
+utils::AsyncTask AwaitQueue(utils::AsyncQueue& asyncQueue, rif_command_queue queue, rif_int& status, rif_command_queue& value)
+{
+    auto executed = co_await asyncQueue.Execute(queue);
+    // the future is gone by now, the result holds its own copy of the value
+    status = executed.status;
+    value = executed.value;
+}
+#endif
+
+// Completes the submitted queues in reverse order from a worker thread, the way a
+// device finishing short jobs first would. Continuations still run on the thread
+// pumping the executor, in the order the completions arrived. A queue that cannot
+// be launched fails its future, whether chained or awaited.
+int RunSimulation()
+{
+    struct Submission
+    {
+        rif_command_queue queue;
+        rif_exec_command_queue_callback* callback;
+        void* data;
+    };
+
+    utils::ManualExecutor executor;
+    std::vector<Submission> submitted;
+
+    utils::AsyncQueue asyncQueue([&submitted](rif_command_queue queue, rif_exec_command_queue_callback* callback, void* data)
+    {
+        if (!queue)
+        {
+            return RIF_ERROR_INVALID_OBJECT;
+        }
+        submitted.push_back({ queue, callback, data });
+        return RIF_SUCCESS;
+    }, executor);
+
+    std::vector<std::string> log;
+    int finished = 0;
+    for (intptr_t i = 0; i < QueueCount; ++i)
+    {
+        auto queue = reinterpret_cast<rif_command_queue>(i + 1);
+        asyncQueue.Execute(queue)
+            .Then([&log](rif_command_queue& q)
+            {
+                log.push_back("readback " + std::to_string(reinterpret_cast<intptr_t>(q)));
+                return reinterpret_cast<intptr_t>(q);
+            })
+            .Then([&log, &finished](intptr_t& id)
+            {
+                log.push_back("encode " + std::to_string(id));
+                ++finished;
+            });
+    }
+
+    std::thread device([&submitted]()
+    {
+        for (auto it = submitted.rbegin(); it != submitted.rend(); ++it)
+        {
+            it->callback(it->data);
+        }
+    });
+
+    executor.RunUntil([&finished]() { return finished == QueueCount; });
+    device.join();
+
+    bool skipped = true;
+    auto chain = asyncQueue.Execute(nullptr).Then([&skipped](rif_command_queue&) { skipped = false; });
+    executor.RunAll();
+    rif_int chained = chain.Status();
+    log.push_back("failed launch, chained: status " + std::to_string(chained));
+    bool failed = chained != RIF_ERROR_INVALID_OBJECT || !skipped;
+#if defined(__cpp_impl_coroutine)
+    rif_int awaited = RIF_SUCCESS;
+    rif_command_queue value = nullptr;
+    AwaitQueue(asyncQueue, nullptr, awaited, value);
+    executor.RunAll();
+    log.push_back("failed launch, awaited: status " + std::to_string(awaited));
+    failed |= awaited != RIF_ERROR_INVALID_OBJECT;
+
+    // completed after the coroutine suspended, so the value comes through the executor
+    const auto queue = reinterpret_cast<rif_command_queue>(QueueCount + 1);
+    submitted.clear();
+    AwaitQueue(asyncQueue, queue, awaited, value);
+    submitted.front().callback(submitted.front().data);
+    executor.RunAll();
+    log.push_back("awaited: status " + std::to_string(awaited) + ", queue " + std::to_string(reinterpret_cast<intptr_t>(value)));
+    failed |= awaited != RIF_SUCCESS || value != queue;
+#endif
+
+    for (const auto& entry : log)
+    {
+        std::cout << entry << std::endl;
+    }
+    return failed ? ERRCODE : 0;
+}
+
+#if defined(__cpp_impl_coroutine)
+utils::AsyncTask ProcessCoroutine(utils::AsyncQueue& asyncQueue, rif_command_queue queue, rif_image image,
+    std::string path, int& finished)
+{
+    auto executed = co_await asyncQueue.Execute(queue);
+    if (executed.status != RIF_SUCCESS)
+    {
+        std::cout << path << " failed" << std::endl;
+        ++finished;
+        co_return;
+    }
+    Readback result = ReadbackImage(image);
+    ImageTools::SaveImageData(result.pixels.data(), path.c_str(), result.desc.image_width,
+        result.desc.image_height, result.desc.num_components, result.desc.type);
+    ++finished;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-simulate"))
+    {
+        return RunSimulation();
+    }
+
+    rif_int status = RIF_SUCCESS;
+    rif_context context = nullptr;
+
+    int deviceCount = 0;
+    status = rifGetDeviceCount(BACKEND_TYPE, &deviceCount);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    if (deviceCount > 0 || status)
+    {
+        status = rifCreateContext(RIF_API_VERSION, BACKEND_TYPE, DEVICE, nullptr, &context);
+        if (status != RIF_SUCCESS || !context)
+        {
+            return ERRCODE;
+        }
+    }
+
+    rif_image inputImage = ImageTools::LoadImage("images/color.jpg", context);
+    if (!inputImage)
+    {
+        return ERRCODE;
+    }
+    rif_image_desc desc;
+    size_t retSize;
+    rifImageGetInfo(inputImage, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+    desc.type = RIF_COMPONENT_TYPE_UINT8;
+
+    // one queue per blur radius, all of them in flight at once
+    rif_command_queue queues[QueueCount] = {};
+    rif_image_filter filters[QueueCount] = {};
+    rif_image outputs[QueueCount] = {};
+    for (int i = 0; i < QueueCount; ++i)
+    {
+        status = rifContextCreateCommandQueue(context, &queues[i]);
+        if (status == RIF_SUCCESS)
+            status = rifContextCreateImageFilter(context, RIF_IMAGE_FILTER_GAUSSIAN_BLUR, &filters[i]);
+        if (status == RIF_SUCCESS)
+            status = rifContextCreateImage(context, &desc, nullptr, &outputs[i]);
+        if (status == RIF_SUCCESS)
+            status = rifImageFilterSetParameter1u(filters[i], "radius", 2 + 3 * i);
+        if (status == RIF_SUCCESS)
+            status = rifCommandQueueAttachImageFilter(queues[i], filters[i], inputImage, outputs[i]);
+        if (status != RIF_SUCCESS)
+        {
+            return ERRCODE;
+        }
+    }
+
+    utils::ManualExecutor executor;
+    utils::AsyncQueue asyncQueue(context, executor);
+
+    int finished = 0;
+    for (int i = 0; i < QueueCount; ++i)
+    {
+        std::string path = "out_" + std::to_string(i) + ".png";
+#if defined(__cpp_impl_coroutine)
+        ProcessCoroutine(asyncQueue, queues[i], outputs[i], path, finished);
+#else
+        rif_image image = outputs[i];
+        asyncQueue.Execute(queues[i])
+            .Then([image](rif_command_queue&)
+            {
+                return ReadbackImage(image);
+            })
+            .Then([path](Readback& result)
+            {
+                return ImageTools::SaveImageData(result.pixels.data(), path.c_str(), result.desc.image_width,
+                    result.desc.image_height, result.desc.num_components, result.desc.type);
+            })
+            .Then([&finished, path](rif_int& saveStatus)
+            {
+                std::cout << path << (saveStatus == RIF_SUCCESS ? " written" : " failed") << std::endl;
+                ++finished;
+            });
+#endif
+    }
+
+    // sleeps until completions arrive, no polling of the queues
+    executor.RunUntil([&finished]() { return finished == QueueCount; });
+
+    //Free resources
+    for (int i = 0; i < QueueCount; ++i)
+    {
+        rifCommandQueueDetachImageFilter(queues[i], filters[i]);
+        rifObjectDelete(outputs[i]);
+        rifObjectDelete(filters[i]);
+        rifObjectDelete(queues[i]);
+    }
+    rifObjectDelete(inputImage);
+    rifObjectDelete(context);
+    return 0;
+}
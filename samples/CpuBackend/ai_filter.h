@@ -0,0 +1,649 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// RIF_IMAGE_FILTER_AI_DENOISE and RIF_IMAGE_FILTER_AI_UPSCALE on the host: the models
+// of 'modelPath' run through neural_network.h. The denoiser takes the LDR colour
+// model; the HDR and feature-image models are not shipped, so "useHDR" is refused and
+// the normals, depth and albedo images are accepted but unused. The upscaler picks its
+// model by "mode" and needs an output twice the input size. Colour is clamped to
+// [0, 1] on the way in; alpha passes through, nearest sampled when upscaling.
+//
+// A model is loaded when the filter first runs and again when its file changes,
+// through the process-wide cache of neural_model_cache.h; "cachePath" (host only,
+// empty by default) names a directory for its packed files.
+//
+// Runs keep their workspace (NeuralWorkspace plus the network's input tensor) for the
+// last NeuralModel::MaxBuckets input sizes, so a run at a size seen just before
+// allocates and plans nothing. "shapeBucket" (host only, 0 by default) rounds the
+// sizes workspaces are made for up to its multiples, so that sizes changing a little
+// share one; runs still compute the input's pixels only, and the results do not
+// depend on the bucket. BucketStatistics counts the hits and misses.
+//
+// The images of the "inputs" array (host only) go to the matching images of "outputs"
+// in the same run as the input and output, all of one size: a batched inference whose
+// operations each cover every image before the next starts. "batchSize" (host only, 0
+// by default for all of them) bounds the images per inference, and so the memory.
+//
+// "useTemporal" (host only) denoises a sequence, one frame per run. "motionImg" holds
+// in red and green the motion in pixels of each pixel since the previous frame, which
+// had it at (x - red, y - green); without it nothing moves. Every "temporalKeyInterval"
+// frames the whole network runs; the frames between take the input of its last
+// upsampling from the previous frame, warped by the motion, and run only the first
+// convolution and the full resolution decoder, about a third of the work. The result
+// is then blended with the warped previous output by "temporalBlend", that output
+// first clamped to the range of the new result's 3x3 neighbourhood so that moving
+// edges do not smear. Another size, model or compute type starts a new sequence, and
+// so does ResetHistory.
+// With RIF_COMPUTE_TYPE_INT8 the convolutions run quantized with the ranges of the
+// model's calibration file (see NeuralCalibrationPath), which the CpuCalibration
+// sample writes; without one the filter fails with RIF_ERROR_IO_ERROR.
+
+#include "filter.h"
+#include "neural_model_cache.h"
+#include "neural_network.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CpuBackend
+{
+    // the workspace of batches of input sizes that round up to width x height
+    struct NeuralBucket
+    {
+        size_t width = 0;
+        size_t height = 0;
+        std::vector<NeuralTensor> inputs;
+        NeuralWorkspace workspace;
+    };
+
+    // what a temporal denoise keeps from one frame for the next
+    struct NeuralHistory
+    {
+        size_t frames = 0;              // since the last key frame, 0 before the first
+        NeuralTensor input;
+        NeuralWorkspace workspace;
+        NeuralTensor features;          // the feedback tensor of the last frame
+        NeuralTensor warped;
+        NeuralTensor output;            // the last frame's blended result
+        NeuralTensor warpedOutput;
+        std::vector<float> motion;      // x and y per pixel
+    };
+
+    struct NeuralBucketStatistics
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t buckets = 0;         // held now
+    };
+
+    // the network of 'path', acquired again only when the path, the precision or the
+    // bytes of the model's files (see NeuralNetworkKey) differ from the last load, and
+    // its workspaces
+    class NeuralModel
+    {
+    public:
+        // workspaces of full resolution images take hundreds of MB each
+        static const size_t MaxBuckets = 2;
+
+        rif_int Load(const std::string& path, bool quantized, const std::string& cacheDirectory)
+        {
+            // only stats the files while they stay the same
+            uint64_t key = 0;
+            rif_int status = NeuralNetworkKey(path, quantized, key);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            if (path == m_path && quantized == m_quantized && key == m_key && m_network)
+            {
+                return RIF_SUCCESS;
+            }
+            m_path = path;
+            m_quantized = quantized;
+            m_key = key;
+            m_buckets.clear();
+            m_history = NeuralHistory();
+            m_network.reset();
+            return AcquireNeuralNetwork(path, quantized, cacheDirectory, m_network);
+        }
+
+        const NeuralNetwork& Network() const
+        {
+            return *m_network;
+        }
+
+        // the bucket of 'batch' width x height inputs, the size rounded up to multiples
+        // of 'bucket' (0 or 1: the exact size); the least recently used one makes room
+        // for a new size or a larger batch
+        NeuralBucket& Bucket(size_t width, size_t height, size_t batch, size_t bucket)
+        {
+            bucket = std::max<size_t>(bucket, 1);
+            width = (width + bucket - 1) / bucket * bucket;
+            height = (height + bucket - 1) / bucket * bucket;
+            auto found = std::find_if(m_buckets.begin(), m_buckets.end(), [&](const NeuralBucket& b)
+                { return b.width == width && b.height == height && b.inputs.size() >= batch; });
+            if (found != m_buckets.end())
+            {
+                ++m_statistics.hits;
+                m_buckets.splice(m_buckets.begin(), m_buckets, found);
+                return m_buckets.front();
+            }
+
+            ++m_statistics.misses;
+            if (m_buckets.size() >= MaxBuckets)
+            {
+                m_buckets.pop_back();
+            }
+            m_buckets.emplace_front();
+            NeuralBucket& created = m_buckets.front();
+            created.width = width;
+            created.height = height;
+            created.inputs.resize(batch);
+            for (NeuralTensor& input : created.inputs)
+            {
+                input.Resize(width, height, m_network->inputChannels);
+            }
+            return created;
+        }
+
+        NeuralHistory& History()
+        {
+            return m_history;
+        }
+
+        NeuralBucketStatistics Statistics() const
+        {
+            NeuralBucketStatistics statistics = m_statistics;
+            statistics.buckets = m_buckets.size();
+            return statistics;
+        }
+
+    private:
+        std::string m_path;
+        bool m_quantized = false;
+        uint64_t m_key = 0;
+        std::shared_ptr<const NeuralNetwork> m_network;
+        std::list<NeuralBucket> m_buckets;     // the most recently used first
+        NeuralBucketStatistics m_statistics;
+        NeuralHistory m_history;
+    };
+
+    namespace detail
+    {
+        inline std::string ModelFile(const std::string& directory, const char* name)
+        {
+            if (directory.empty())
+            {
+                return name;
+            }
+            const char last = directory.back();
+            return last == '/' || last == '\\' ? directory + name : directory + "/" + name;
+        }
+
+        // runs the network of 'model' on the RGB of each input, all of one size, and
+        // writes the RGB result to the matching output, whose size must be the network's
+        // for the input; alpha comes from the input pixel under each output pixel.
+        // Batches of up to 'batchSize' images (0: all) share one inference.
+        inline rif_int RunImageNetwork(ThreadPool& pool, NeuralModel& model, size_t bucketSize, size_t batchSize,
+            const std::vector<const Image*>& inputs, const std::vector<Image*>& outputs)
+        {
+            const NeuralNetwork& network = model.Network();
+            if (network.inputChannels != 3 || network.outputChannels != 3)
+            {
+                return RIF_ERROR_UNSUPPORTED;
+            }
+
+            const size_t width = inputs[0]->Width();
+            const size_t height = inputs[0]->Height();
+            const size_t outWidth = outputs[0]->Width();
+            const size_t outHeight = outputs[0]->Height();
+            for (size_t i = 0; i < inputs.size(); ++i)
+            {
+                if (inputs[i]->Width() != width || inputs[i]->Height() != height ||
+                    outputs[i]->Width() != outWidth || outputs[i]->Height() != outHeight)
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+            }
+
+            const size_t batch = batchSize ? std::min<size_t>(batchSize, inputs.size()) : inputs.size();
+            for (size_t begin = 0; begin < inputs.size(); begin += batch)
+            {
+                const size_t count = std::min(batch, inputs.size() - begin);
+                NeuralBucket& bucket = model.Bucket(width, height, batch, bucketSize);
+                std::vector<const NeuralTensor*> sources;
+                for (size_t item = 0; item < count; ++item)
+                {
+                    bucket.inputs[item].Reshape(width, height);
+                    sources.push_back(&bucket.inputs[item]);
+                }
+                pool.ParallelForRows(count * height, [&](size_t first, size_t last)
+                {
+                    std::vector<float> row(width * 4);
+                    for (size_t index = first; index < last; ++index)
+                    {
+                        const size_t y = index % height;
+                        NeuralTensor& source = bucket.inputs[index / height];
+                        inputs[begin + index / height]->LoadRow(y, 0, width, row.data(), 4);
+                        for (size_t x = 0; x < width; ++x)
+                        {
+                            float* pixel = source.Pixel(long(x), long(y));
+                            for (size_t c = 0; c < 3; ++c)
+                            {
+                                pixel[c] = std::min(std::max(row[x * 4 + c], 0.0f), 1.0f);
+                            }
+                        }
+                    }
+                });
+
+                const rif_int status = RunNeuralNetwork(pool, network, sources.data(), count, bucket.workspace);
+                if (status != RIF_SUCCESS)
+                {
+                    return status;
+                }
+                if (bucket.workspace.Output().Width() != outWidth || bucket.workspace.Output().Height() != outHeight)
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+
+                pool.ParallelForRows(count * outHeight, [&](size_t first, size_t last)
+                {
+                    std::vector<float> alpha(width * 4);
+                    std::vector<float> row(outWidth * 4);
+                    for (size_t index = first; index < last; ++index)
+                    {
+                        const size_t item = index / outHeight;
+                        const size_t y = index % outHeight;
+                        const NeuralTensor& result = bucket.workspace.Output(item);
+                        inputs[begin + item]->LoadRow(y * height / outHeight, 0, width, alpha.data(), 4);
+                        for (size_t x = 0; x < outWidth; ++x)
+                        {
+                            const float* pixel = result.Pixel(long(x), long(y));
+                            row[x * 4 + 0] = pixel[0];
+                            row[x * 4 + 1] = pixel[1];
+                            row[x * 4 + 2] = pixel[2];
+                            row[x * 4 + 3] = alpha[x * width / outWidth * 4 + 3];
+                        }
+                        outputs[begin + item]->StoreRow(y, 0, outWidth, row.data(), 4);
+                    }
+                });
+            }
+            return RIF_SUCCESS;
+        }
+
+        // the first 'channels' channels of 'source' at (x, y), bilinear with the edge
+        // pixels repeated outwards
+        inline void SampleBilinear(const NeuralTensor& source, float x, float y, size_t channels, float* out)
+        {
+            const float maxX = float(source.Width() - 1);
+            const float maxY = float(source.Height() - 1);
+            x = std::min(std::max(x, 0.0f), maxX);
+            y = std::min(std::max(y, 0.0f), maxY);
+            const long x0 = long(x);
+            const long y0 = long(y);
+            const long x1 = std::min(x0 + 1, long(maxX));
+            const long y1 = std::min(y0 + 1, long(maxY));
+            const float fx = x - float(x0);
+            const float fy = y - float(y0);
+            const float* p00 = source.Pixel(x0, y0);
+            const float* p10 = source.Pixel(x1, y0);
+            const float* p01 = source.Pixel(x0, y1);
+            const float* p11 = source.Pixel(x1, y1);
+            for (size_t c = 0; c < channels; ++c)
+            {
+                const float top = p00[c] + (p10[c] - p00[c]) * fx;
+                const float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                out[c] = top + (bottom - top) * fy;
+            }
+        }
+
+        // 'source' of the previous frame moved to where 'motion' (x and y per pixel of a
+        // width x height frame) takes it; 'source' may have a lower resolution
+        inline void WarpTensor(ThreadPool& pool, const NeuralTensor& source, const std::vector<float>& motion, size_t width, size_t height,
+            NeuralTensor& target)
+        {
+            if (!target.SameShape(source.Width(), source.Height(), source.Channels()))
+            {
+                target.Resize(source.Width(), source.Height(), source.Channels());
+            }
+            const float scaleX = float(source.Width()) / float(width);
+            const float scaleY = float(source.Height()) / float(height);
+            pool.ParallelForRows(source.Height(), [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const size_t my = std::min(height - 1, size_t(float(y) / scaleY));
+                    for (size_t x = 0; x < source.Width(); ++x)
+                    {
+                        const float* m = &motion[(my * width + std::min(width - 1, size_t(float(x) / scaleX))) * 2];
+                        SampleBilinear(source, float(x) - m[0] * scaleX, float(y) - m[1] * scaleY, source.Stride(),
+                            target.Pixel(long(x), long(y)));
+                    }
+                }
+            });
+        }
+
+        // one frame of the temporal denoise of 'network' on 'input' into 'output', with
+        // the motion of 'motion' when given
+        inline rif_int RunTemporalNetwork(ThreadPool& pool, const NeuralNetwork& network, NeuralHistory& history, const Image& input,
+            const Image* motion, Image& output, size_t keyInterval, float blend)
+        {
+            const NeuralFeedback keep = { NeuralFeedbackTensor(network, 1), nullptr };
+            if (network.inputChannels != 3 || network.outputChannels != 3 || keep.tensor < 0)
+            {
+                return RIF_ERROR_UNSUPPORTED;
+            }
+
+            const size_t width = input.Width();
+            const size_t height = input.Height();
+            if (!history.input.SameShape(width, height, 3))
+            {
+                history = NeuralHistory();
+                history.input.Resize(width, height, 3);
+            }
+            history.motion.resize(width * height * 2);
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(width * 4);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(y, 0, width, row.data(), 4);
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        float* pixel = history.input.Pixel(long(x), long(y));
+                        for (size_t c = 0; c < 3; ++c)
+                        {
+                            pixel[c] = std::min(std::max(row[x * 4 + c], 0.0f), 1.0f);
+                        }
+                    }
+                    if (motion)
+                    {
+                        motion->LoadRow(y, 0, width, row.data(), 4);
+                    }
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        history.motion[(y * width + x) * 2 + 0] = motion ? row[x * 4 + 0] : 0.0f;
+                        history.motion[(y * width + x) * 2 + 1] = motion ? row[x * 4 + 1] : 0.0f;
+                    }
+                }
+            });
+
+            // a key frame computes the feedback tensor, the others take it warped
+            const bool key = history.frames == 0 || history.frames >= std::max<size_t>(keyInterval, 1);
+            if (!key)
+            {
+                WarpTensor(pool, history.features, history.motion, width, height, history.warped);
+            }
+            const NeuralFeedback feedback = { keep.tensor, key ? nullptr : &history.warped };
+            const rif_int status = RunNeuralNetwork(pool, network, history.input, feedback, history.workspace);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            NeuralTensor& computed = key ? history.workspace.Tensor(keep.tensor) : history.warped;
+            if (history.features.SameShape(computed.Width(), computed.Height(), computed.Channels()))
+            {
+                std::swap(history.features, computed);
+            }
+            else
+            {
+                history.features = computed;
+            }
+            history.frames = key ? 1 : history.frames + 1;
+
+            const NeuralTensor& result = history.workspace.Output();
+            const bool blending = blend > 0.0f && history.output.SameShape(width, height, 3);
+            if (blending)
+            {
+                WarpTensor(pool, history.output, history.motion, width, height, history.warpedOutput);
+            }
+            else if (!history.output.SameShape(width, height, 3))
+            {
+                history.output.Resize(width, height, 3);
+            }
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(width * 4);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(y, 0, width, row.data(), 4);
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        const float* current = result.Pixel(long(x), long(y));
+                        float* blended = history.output.Pixel(long(x), long(y));
+                        const float* m = &history.motion[(y * width + x) * 2];
+                        const float px = float(x) - m[0];
+                        const float py = float(y) - m[1];
+                        const bool seen = px > -0.5f && py > -0.5f && px < float(width) - 0.5f && py < float(height) - 0.5f;
+                        for (size_t c = 0; c < 3; ++c)
+                        {
+                            float value = current[c];
+                            if (blending && seen)
+                            {
+                                float low = value;
+                                float high = value;
+                                for (long dy = -1; dy <= 1; ++dy)
+                                {
+                                    const long ny = std::min(std::max(long(y) + dy, 0L), long(height) - 1);
+                                    for (long dx = -1; dx <= 1; ++dx)
+                                    {
+                                        const long nx = std::min(std::max(long(x) + dx, 0L), long(width) - 1);
+                                        low = std::min(low, result.Pixel(nx, ny)[c]);
+                                        high = std::max(high, result.Pixel(nx, ny)[c]);
+                                    }
+                                }
+                                const float previous = std::min(std::max(history.warpedOutput.Pixel(long(x), long(y))[c], low), high);
+                                value += (previous - value) * blend;
+                            }
+                            blended[c] = value;
+                            row[x * 4 + c] = value;
+                        }
+                    }
+                    output.StoreRow(y, 0, width, row.data(), 4);
+                }
+            });
+            return RIF_SUCCESS;
+        }
+
+        // 'input' and 'output' followed by the images of the "inputs" and "outputs" arrays
+        inline rif_int GatherBatch(const std::vector<Image*>& moreInputs, const std::vector<Image*>& moreOutputs,
+            const Image& input, Image& output, std::vector<const Image*>& inputs, std::vector<Image*>& outputs)
+        {
+            if (moreInputs.size() != moreOutputs.size())
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            inputs.assign(1, &input);
+            outputs.assign(1, &output);
+            for (size_t i = 0; i < moreInputs.size(); ++i)
+            {
+                if (!moreInputs[i] || !moreOutputs[i])
+                {
+                    return RIF_ERROR_INVALID_PARAMETER;
+                }
+                inputs.push_back(moreInputs[i]);
+                outputs.push_back(moreOutputs[i]);
+            }
+            return RIF_SUCCESS;
+        }
+    }
+
+    class AiDenoiseFilter : public Filter
+    {
+    public:
+        AiDenoiseFilter()
+            : Filter(RIF_IMAGE_FILTER_AI_DENOISE)
+        {
+            DeclareString("modelPath", "./models");
+            DeclareString("cachePath", "");
+            DeclareUint("shapeBucket", 0);
+            DeclareImageArray("inputs");
+            DeclareImageArray("outputs");
+            DeclareUint("batchSize", 0);
+            DeclareUint("useHDR", 0);
+            DeclareUint("useTemporal", 0);
+            DeclareImage("motionImg");
+            DeclareUint("temporalKeyInterval", 8);
+            DeclareFloat("temporalBlend", 0.8f);
+            DeclareImage("colorImg");
+            DeclareImage("normalsImg");
+            DeclareImage("depthImg");
+            DeclareImage("albedoImg");
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (GetUint("useHDR") != 0)
+            {
+                return RIF_ERROR_UNSUPPORTED;
+            }
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            const rif_int status = m_model.Load(detail::ModelFile(GetString("modelPath"), "denoise_c3_ldr_float16.onnx"),
+                ComputeType() == RIF_COMPUTE_TYPE_INT8, GetString("cachePath"));
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+
+            // "colorImg" is the noisy colour when given, as on the devices
+            const Image* color = GetImage("colorImg");
+            if (color && (color->Width() != input.Width() || color->Height() != input.Height()))
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            if (GetUint("useTemporal") != 0)
+            {
+                const Image* motion = GetImage("motionImg");
+                if (motion && (motion->Width() != input.Width() || motion->Height() != input.Height()))
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+                if (!GetImageArray("inputs").empty())
+                {
+                    return RIF_ERROR_UNSUPPORTED;
+                }
+                return detail::RunTemporalNetwork(pool, m_model.Network(), m_model.History(), color ? *color : input, motion, output,
+                    GetUint("temporalKeyInterval"), GetFloat("temporalBlend"));
+            }
+
+            std::vector<const Image*> inputs;
+            std::vector<Image*> outputs;
+            const rif_int gathered = detail::GatherBatch(GetImageArray("inputs"), GetImageArray("outputs"), color ? *color : input, output,
+                inputs, outputs);
+            return gathered != RIF_SUCCESS ? gathered :
+                detail::RunImageNetwork(pool, m_model, GetUint("shapeBucket"), GetUint("batchSize"), inputs, outputs);
+        }
+
+        NeuralBucketStatistics BucketStatistics() const
+        {
+            return m_model.Statistics();
+        }
+
+        // the next temporal run starts a sequence
+        void ResetHistory()
+        {
+            m_model.History() = NeuralHistory();
+        }
+
+    protected:
+        bool SupportsComputeType(rif_compute_type type) const override
+        {
+            return type == RIF_COMPUTE_TYPE_INT8 || Filter::SupportsComputeType(type);
+        }
+
+    private:
+        NeuralModel m_model;
+    };
+
+    class AiUpscaleFilter : public Filter
+    {
+    public:
+        AiUpscaleFilter()
+            : Filter(RIF_IMAGE_FILTER_AI_UPSCALE)
+        {
+            DeclareString("modelPath", "./models");
+            DeclareString("cachePath", "");
+            DeclareUint("shapeBucket", 0);
+            DeclareImageArray("inputs");
+            DeclareImageArray("outputs");
+            DeclareUint("batchSize", 0);
+            DeclareUint("mode", RIF_AI_UPSCALE_MODE_GOOD_2X);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            const char* file = nullptr;
+            switch (GetUint("mode"))
+            {
+            case RIF_AI_UPSCALE_MODE_GOOD_2X:
+                file = "upscale2x_c3_rt_f16.onnx";
+                break;
+            case RIF_AI_UPSCALE_MODE_BEST_2X:
+                file = "esrgan-03x2x32-273866.pb";
+                break;
+            case RIF_AI_UPSCALE_MODE_FAST_2X:
+                file = "upscale2x_fast.pb";
+                break;
+            default:
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            if (output.Width() != 2 * input.Width() || output.Height() != 2 * input.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            const rif_int status = m_model.Load(detail::ModelFile(GetString("modelPath"), file), ComputeType() == RIF_COMPUTE_TYPE_INT8,
+                GetString("cachePath"));
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            std::vector<const Image*> inputs;
+            std::vector<Image*> outputs;
+            const rif_int gathered = detail::GatherBatch(GetImageArray("inputs"), GetImageArray("outputs"), input, output, inputs, outputs);
+            return gathered != RIF_SUCCESS ? gathered :
+                detail::RunImageNetwork(pool, m_model, GetUint("shapeBucket"), GetUint("batchSize"), inputs, outputs);
+        }
+
+        NeuralBucketStatistics BucketStatistics() const
+        {
+            return m_model.Statistics();
+        }
+
+    protected:
+        bool SupportsComputeType(rif_compute_type type) const override
+        {
+            return type == RIF_COMPUTE_TYPE_INT8 || Filter::SupportsComputeType(type);
+        }
+
+    private:
+        NeuralModel m_model;
+    };
+}
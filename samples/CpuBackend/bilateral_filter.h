@@ -0,0 +1,445 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Cross bilateral denoise on the host.
+//
+// The exact method visits the whole (2 * radius + 1)^2 window of every pixel and
+// weights it by a spatial Gaussian (sigma = radius / 3, as for GAUSSIAN_BLUR) times a
+// range Gaussian per guide image, so its cost grows with the square of the radius.
+//
+// The grid method (Chen, Paris and Durand) splats the image into a coarse 3D grid
+// over x, y and the luminance of the first guide, blurs the grid with the separable
+// FIR of gaussian_blur.h and reads every pixel back by trilinear interpolation. Grid
+// cells are about one sigma wide in every dimension, so the work is linear in the
+// pixel count and does not grow with the spatial sigma. Smaller cells ("gridSpatial",
+// "gridRange") get closer to the exact result for more memory and time. Only the first
+// guide takes part in the range weight of the grid.
+
+#include "filter.h"
+#include "float_image.h"
+#include "gaussian_blur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace CpuBackend
+{
+    enum class BilateralMethod
+    {
+        Auto,
+        Exact,
+        Grid,
+    };
+
+    struct BilateralSettings
+    {
+        int radius = 10;
+        std::vector<float> sigmas;      // range sigma of every guide, missing ones use the last
+        BilateralMethod method = BilateralMethod::Auto;
+        float gridSpatial = 0.0f;       // grid cell size in pixels, 0 uses the spatial sigma
+        float gridRange = 1.0f;         // grid cell size in range sigmas
+        int maxRangeCells = 32;         // cells are widened when the luminance range needs more
+    };
+
+    inline float BilateralSpatialSigma(int radius)
+    {
+        return std::max(radius / 3.0f, 0.5f);
+    }
+
+    inline float Luminance(const float* rgb)
+    {
+        return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+    }
+
+    namespace detail
+    {
+        inline float GuideSigma(const BilateralSettings& settings, size_t guide)
+        {
+            if (settings.sigmas.empty())
+            {
+                return 0.1f;
+            }
+            return std::max(settings.sigmas[std::min(guide, settings.sigmas.size() - 1)], 1e-4f);
+        }
+
+        inline void ExactBilateral(ThreadPool& pool, const FloatImage& src, const std::vector<const FloatImage*>& guides,
+            FloatImage& dst, const BilateralSettings& settings)
+        {
+            const long width = static_cast<long>(src.Width());
+            const long height = static_cast<long>(src.Height());
+            const long radius = settings.radius;
+            const long side = 2 * radius + 1;
+            const float sigma = BilateralSpatialSigma(settings.radius);
+
+            std::vector<float> spatial(side * side);
+            for (long dy = -radius; dy <= radius; ++dy)
+            {
+                for (long dx = -radius; dx <= radius; ++dx)
+                {
+                    spatial[(dy + radius) * side + dx + radius] = std::exp(-0.5f * (dx * dx + dy * dy) / (sigma * sigma));
+                }
+            }
+            // the colour distance of a guide is averaged over its three channels
+            std::vector<float> rangeScale(guides.size());
+            for (size_t g = 0; g < guides.size(); ++g)
+            {
+                const float s = GuideSigma(settings, g);
+                rangeScale[g] = -0.5f / (3.0f * s * s);
+            }
+
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (long y = long(begin); y < long(end); ++y)
+                {
+                    float* out = dst.Row(y);
+                    for (long x = 0; x < width; ++x)
+                    {
+                        float acc[3] = { 0.0f, 0.0f, 0.0f };
+                        float total = 0.0f;
+                        for (long qy = std::max(0L, y - radius); qy <= std::min(height - 1, y + radius); ++qy)
+                        {
+                            const float* spatialRow = &spatial[(qy - y + radius) * side + radius];
+                            const float* color = src.Row(qy);
+                            for (long qx = std::max(0L, x - radius); qx <= std::min(width - 1, x + radius); ++qx)
+                            {
+                                float exponent = 0.0f;
+                                for (size_t g = 0; g < guides.size(); ++g)
+                                {
+                                    const float* p = guides[g]->Row(y) + 4 * x;
+                                    const float* q = guides[g]->Row(qy) + 4 * qx;
+                                    const float d0 = p[0] - q[0];
+                                    const float d1 = p[1] - q[1];
+                                    const float d2 = p[2] - q[2];
+                                    exponent += (d0 * d0 + d1 * d1 + d2 * d2) * rangeScale[g];
+                                }
+                                const float w = spatialRow[qx - x] * std::exp(exponent);
+                                acc[0] += w * color[4 * qx];
+                                acc[1] += w * color[4 * qx + 1];
+                                acc[2] += w * color[4 * qx + 2];
+                                total += w;
+                            }
+                        }
+                        out[4 * x] = acc[0] / total;
+                        out[4 * x + 1] = acc[1] / total;
+                        out[4 * x + 2] = acc[2] / total;
+                        out[4 * x + 3] = src.Row(y)[4 * x + 3];
+                    }
+                }
+            });
+        }
+
+        // Cells hold premultiplied RGB and the weight. Columns of cells along the range
+        // axis are contiguous with 'pad' empty cells at both ends, so the x and y blurs
+        // run the vertical FIR over whole columns and the range blur the horizontal one.
+        class BilateralGrid
+        {
+        public:
+            BilateralGrid(long nx, long ny, long nz, long pad)
+                : m_nx(nx), m_ny(ny), m_nz(nz), m_pad(pad)
+            {
+                m_stride = ((nz + 2 * pad) * 4 + FloatImage::RowAlignment - 1) / FloatImage::RowAlignment * FloatImage::RowAlignment;
+                m_data.assign(m_stride * nx * ny + FloatImage::RowAlignment, 0.0f);
+            }
+
+            long Nx() const { return m_nx; }
+            long Ny() const { return m_ny; }
+            long Nz() const { return m_nz; }
+            long Pad() const { return m_pad; }
+            size_t Stride() const { return m_stride; }
+
+            // column of cells at (x, y), pointing at range cell 0
+            float* Column(long x, long y)
+            {
+                return m_data.data() + (y * m_nx + x) * m_stride + m_pad * 4;
+            }
+
+            const float* Column(long x, long y) const
+            {
+                return m_data.data() + (y * m_nx + x) * m_stride + m_pad * 4;
+            }
+
+        private:
+            long m_nx, m_ny, m_nz, m_pad;
+            size_t m_stride;
+            std::vector<float> m_data;
+        };
+
+        inline void GridBilateral(ThreadPool& pool, const FloatImage& src, const FloatImage& guide, FloatImage& dst,
+            const BilateralSettings& settings, const GaussianBlurKernels& kernels)
+        {
+            const long width = static_cast<long>(src.Width());
+            const long height = static_cast<long>(src.Height());
+            const float spatialSigma = BilateralSpatialSigma(settings.radius);
+            const float rangeSigma = GuideSigma(settings, 0);
+
+            std::vector<float> luminance(width * height);
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    for (long x = 0; x < width; ++x)
+                    {
+                        luminance[y * width + x] = Luminance(guide.Row(y) + 4 * x);
+                    }
+                }
+            });
+            const auto bounds = std::minmax_element(luminance.begin(), luminance.end());
+            const float low = *bounds.first;
+            const float span = *bounds.second - low;
+
+            const float cell = settings.gridSpatial > 0.0f ? settings.gridSpatial : spatialSigma;
+            const float rangeCell = std::max(std::max(settings.gridRange, 0.05f) * rangeSigma, span / std::max(settings.maxRangeCells, 1));
+
+            // one more cell than the last sample position so interpolation never leaves the grid
+            const long nx = long((width - 1) / cell) + 2;
+            const long ny = long((height - 1) / cell) + 2;
+            const long nz = long(span / rangeCell) + 2;
+            const float blurXY = spatialSigma / cell;
+            const float blurZ = rangeSigma / rangeCell;
+            const int radiusXY = std::max(1, int(std::ceil(2.0f * blurXY)));
+            const int radiusZ = std::max(1, int(std::ceil(2.0f * blurZ)));
+            BilateralGrid grid(nx, ny, nz, radiusZ);
+
+            // splat: trilinear weights; each band of cell rows is filled by one task from
+            // the pixel rows next to it, so tasks never write the same cell
+            pool.ParallelFor(ny, std::max<size_t>(1, ny / (pool.ThreadCount() * 4)), [&](size_t begin, size_t end)
+            {
+                const long firstRow = std::max(0L, long(std::floor((long(begin) - 1) * cell)));
+                const long lastRow = std::min(height - 1, long(std::ceil(long(end) * cell)));
+                for (long y = firstRow; y <= lastRow; ++y)
+                {
+                    const float fy = y / cell;
+                    const long j = long(fy);
+                    const float ty = fy - j;
+                    for (long x = 0; x < width; ++x)
+                    {
+                        const float* color = src.Row(y) + 4 * x;
+                        const float fx = x / cell;
+                        const float fz = (luminance[y * width + x] - low) / rangeCell;
+                        const long i = long(fx);
+                        const long k = long(fz);
+                        const float tx = fx - i;
+                        const float tz = fz - k;
+                        for (int cy = 0; cy < 2; ++cy)
+                        {
+                            if (j + cy < long(begin) || j + cy >= long(end))
+                            {
+                                continue;
+                            }
+                            const float wy = cy ? ty : 1.0f - ty;
+                            for (int cx = 0; cx < 2; ++cx)
+                            {
+                                float* column = grid.Column(i + cx, j + cy);
+                                const float wxy = wy * (cx ? tx : 1.0f - tx);
+                                for (int cz = 0; cz < 2; ++cz)
+                                {
+                                    const float w = wxy * (cz ? tz : 1.0f - tz);
+                                    float* c = column + 4 * (k + cz);
+                                    c[0] += w * color[0];
+                                    c[1] += w * color[1];
+                                    c[2] += w * color[2];
+                                    c[3] += w;
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+
+            // blur x then y into a copy and back, whole columns at a time
+            const std::vector<float> weightsXY = GaussianWeights(blurXY, radiusXY);
+            const std::vector<float> zeros(grid.Stride() + FloatImage::RowAlignment, 0.0f);
+            BilateralGrid blurred(nx, ny, nz, radiusZ);
+            const size_t count = grid.Stride();
+            auto blurAxis = [&](BilateralGrid& from, BilateralGrid& to, bool alongX)
+            {
+                pool.ParallelFor(ny, 1, [&](size_t begin, size_t end)
+                {
+                    std::vector<const float*> rows(2 * radiusXY + 1);
+                    for (long y = long(begin); y < long(end); ++y)
+                    {
+                        for (long x = 0; x < nx; ++x)
+                        {
+                            for (int k = -radiusXY; k <= radiusXY; ++k)
+                            {
+                                const long sx = alongX ? x + k : x;
+                                const long sy = alongX ? y : y + k;
+                                const bool inside = sx >= 0 && sx < nx && sy >= 0 && sy < ny;
+                                rows[k + radiusXY] = inside ? from.Column(sx, sy) - from.Pad() * 4 : zeros.data();
+                            }
+                            kernels.firColumns(rows.data(), to.Column(x, y) - to.Pad() * 4, 0, count, weightsXY.data(), radiusXY);
+                        }
+                    }
+                });
+            };
+            blurAxis(grid, blurred, true);
+            blurAxis(blurred, grid, false);
+
+            // blur along the range axis in place through a scratch column
+            const std::vector<float> weightsZ = GaussianWeights(blurZ, radiusZ);
+            const size_t countZ = (nz * 4 + kernels.width - 1) / kernels.width * kernels.width;
+            pool.ParallelFor(ny, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> scratch(countZ);
+                for (long y = long(begin); y < long(end); ++y)
+                {
+                    for (long x = 0; x < nx; ++x)
+                    {
+                        float* column = grid.Column(x, y);
+                        kernels.firRow(column, scratch.data(), countZ, weightsZ.data(), radiusZ);
+                        std::copy(scratch.begin(), scratch.begin() + nz * 4, column);
+                    }
+                }
+            });
+
+            // slice
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (long y = long(begin); y < long(end); ++y)
+                {
+                    const float fy = y / cell;
+                    const long j = long(fy);
+                    const float ty = fy - j;
+                    float* out = dst.Row(y);
+                    for (long x = 0; x < width; ++x)
+                    {
+                        const float fx = x / cell;
+                        const float fz = (luminance[y * width + x] - low) / rangeCell;
+                        const long i = long(fx);
+                        const long k = long(fz);
+                        const float tx = fx - i;
+                        const float tz = fz - k;
+                        float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                        for (int cy = 0; cy < 2; ++cy)
+                        {
+                            for (int cx = 0; cx < 2; ++cx)
+                            {
+                                const float* column = grid.Column(i + cx, j + cy) + 4 * k;
+                                const float wxy = (cy ? ty : 1.0f - ty) * (cx ? tx : 1.0f - tx);
+                                for (int c = 0; c < 4; ++c)
+                                {
+                                    acc[c] += wxy * ((1.0f - tz) * column[c] + tz * column[4 + c]);
+                                }
+                            }
+                        }
+                        const float* color = src.Row(y) + 4 * x;
+                        const float inverse = acc[3] > 0.0f ? 1.0f / acc[3] : 0.0f;
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            out[4 * x + c] = acc[3] > 0.0f ? acc[c] * inverse : color[c];
+                        }
+                        out[4 * x + 3] = color[3];
+                    }
+                }
+            });
+        }
+    }
+
+    // 'guides' - images the range weights are computed from, usually including 'src'
+    inline void BilateralDenoise(ThreadPool& pool, const FloatImage& src, const std::vector<const FloatImage*>& guides,
+        FloatImage& dst, const BilateralSettings& settings, simd::Level level = simd::CurrentLevel())
+    {
+        dst.Resize(src.Width(), src.Height());
+        std::vector<const FloatImage*> used = guides;
+        if (used.empty())
+        {
+            used.push_back(&src);
+        }
+
+        BilateralMethod method = settings.method;
+        if (method == BilateralMethod::Auto)
+        {
+            // past this radius the window costs more than building the grid
+            const int exactMaxRadius = 4;
+            method = settings.radius > exactMaxRadius ? BilateralMethod::Grid : BilateralMethod::Exact;
+        }
+
+        if (method == BilateralMethod::Grid)
+        {
+            detail::GridBilateral(pool, src, *used[0], dst, settings, detail::SelectGaussianBlurKernels(level));
+        }
+        else
+        {
+            detail::ExactBilateral(pool, src, used, dst, settings);
+        }
+    }
+
+    // RIF_IMAGE_FILTER_BILATERAL_DENOISE
+    // "inputs" - guide images, "inputsNum" - how many of them to use, "sigmas" - range
+    // sigma per guide, "radius" - window half size, "bilateralMode" - 0 auto, 1 exact,
+    // 2 grid, "gridSpatial" - grid cell in pixels (0: radius / 3), "gridRange" - grid
+    // cell in range sigmas
+    class BilateralDenoiseFilter : public Filter
+    {
+    public:
+        BilateralDenoiseFilter()
+            : Filter(RIF_IMAGE_FILTER_BILATERAL_DENOISE)
+        {
+            DeclareImageArray("inputs");
+            DeclareFloatArray("sigmas");
+            DeclareUint("inputsNum", 0);
+            DeclareUint("radius", 1);
+            DeclareUint("bilateralMode", 0);
+            DeclareFloat("gridSpatial", 0.0f);
+            DeclareFloat("gridRange", 1.0f);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            const std::vector<Image*>& inputs = GetImageArray("inputs");
+            const size_t count = std::min<size_t>(GetUint("inputsNum") ? GetUint("inputsNum") : inputs.size(), inputs.size());
+            std::vector<FloatImage> guides(count);
+            std::vector<const FloatImage*> guidePointers;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (!inputs[i] || inputs[i]->Width() != input.Width() || inputs[i]->Height() != input.Height())
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+                guides[i].Load(pool, *inputs[i]);
+                guidePointers.push_back(&guides[i]);
+            }
+
+            BilateralSettings settings;
+            settings.radius = static_cast<int>(GetUint("radius"));
+            settings.sigmas = GetFloatArray("sigmas");
+            settings.method = static_cast<BilateralMethod>(std::min(GetUint("bilateralMode"), 2u));
+            settings.gridSpatial = GetFloat("gridSpatial");
+            settings.gridRange = GetFloat("gridRange");
+
+            FloatImage src;
+            FloatImage dst;
+            src.Load(pool, input);
+            BilateralDenoise(pool, src, guidePointers, dst, settings);
+            dst.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+    };
+}
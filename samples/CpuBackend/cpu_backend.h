@@ -0,0 +1,484 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Host implementation of the standard filters for machines without a GPU. The entry
+// points mirror the rif* API: the device queries accept any backend type and forward
+// everything but RIF_BACKEND_API_CPU to the library, so a sample can probe the GPU
+// first and fall back to the host with the same calls.
+
+#include "RadeonImageFilters.h"
+#include "image.h"
+#include "filter.h"
+#include "ai_filter.h"
+#include "bilateral_filter.h"
+#include "eaw_filter.h"
+#include "expression_filter.h"
+#include "gaussian_blur.h"
+#include "image_statistics.h"
+#include "lwr_filter.h"
+#include "median_filter.h"
+#include "mlaa_filter.h"
+#include "morphology_filter.h"
+#include "orientation.h"
+#include "pixel_filters.h"
+#include "resample_filter.h"
+#include "thread_pool.h"
+#include "tonemap_filter.h"
+#include "user_kernel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <intrin.h>
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+#endif
+
+// The prebuilt library does not know this value; it is only understood by the
+// CpuBackend entry points below.
+#ifndef RIF_BACKEND_API_CPU
+#define RIF_BACKEND_API_CPU 3u
+#endif
+
+// rif_device_info extension: number of threads the CPU device runs on (rif_uint)
+#ifndef RIF_DEVICE_THREAD_COUNT
+#define RIF_DEVICE_THREAD_COUNT 0x100u
+#endif
+
+namespace CpuBackend
+{
+    namespace detail
+    {
+        inline std::string Trim(const std::string& value)
+        {
+            size_t first = value.find_first_not_of(" \t");
+            size_t last = value.find_last_not_of(" \t\r\n");
+            return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+        }
+
+        // value of the first "key : value" line of /proc/cpuinfo
+        inline std::string CpuInfoField(const char* key)
+        {
+            std::string result;
+#if !defined(WIN32) && !defined(_WIN32)
+            FILE* file = fopen("/proc/cpuinfo", "r");
+            if (!file)
+            {
+                return result;
+            }
+            char line[512];
+            const size_t keyLength = strlen(key);
+            while (fgets(line, sizeof(line), file))
+            {
+                if (strncmp(line, key, keyLength) == 0)
+                {
+                    const char* colon = strchr(line, ':');
+                    if (colon)
+                    {
+                        result = Trim(colon + 1);
+                        break;
+                    }
+                }
+            }
+            fclose(file);
+#else
+            (void)key;
+#endif
+            return result;
+        }
+
+        inline void CpuId(unsigned leaf, unsigned regs[4])
+        {
+            regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#if defined(WIN32) || defined(_WIN32)
+            int values[4];
+            __cpuid(values, static_cast<int>(leaf));
+            for (int i = 0; i < 4; ++i)
+            {
+                regs[i] = static_cast<unsigned>(values[i]);
+            }
+#elif defined(__x86_64__) || defined(__i386__)
+            __get_cpuid(leaf, &regs[0], &regs[1], &regs[2], &regs[3]);
+#else
+            (void)leaf;
+#endif
+        }
+
+        inline std::string CpuName()
+        {
+#if defined(WIN32) || defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+            unsigned regs[4];
+            CpuId(0x80000000u, regs);
+            if (regs[0] >= 0x80000004u)
+            {
+                char brand[49] = {};
+                for (unsigned leaf = 0; leaf < 3; ++leaf)
+                {
+                    CpuId(0x80000002u + leaf, regs);
+                    memcpy(brand + leaf * 16, regs, 16);
+                }
+                return Trim(brand);
+            }
+#elif defined(__APPLE__)
+            char brand[256] = {};
+            size_t size = sizeof(brand);
+            if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0)
+            {
+                return brand;
+            }
+#endif
+            std::string name = CpuInfoField("model name");
+            return name.empty() ? "Host CPU" : name;
+        }
+
+        inline std::string CpuVendor()
+        {
+#if defined(WIN32) || defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+            unsigned regs[4];
+            CpuId(0, regs);
+            char vendor[13] = {};
+            memcpy(vendor + 0, &regs[1], 4);
+            memcpy(vendor + 4, &regs[3], 4);
+            memcpy(vendor + 8, &regs[2], 4);
+            return vendor;
+#elif defined(__APPLE__)
+            return "Apple";
+#else
+            std::string vendor = CpuInfoField("CPU implementer");
+            return vendor.empty() ? "Unknown" : "ARM implementer " + vendor;
+#endif
+        }
+
+        inline rif_uint64 PhysicalMemory()
+        {
+#if defined(WIN32) || defined(_WIN32)
+            MEMORYSTATUSEX status;
+            status.dwLength = sizeof(status);
+            return GlobalMemoryStatusEx(&status) ? status.ullTotalPhys : 0;
+#else
+            long pages = sysconf(_SC_PHYS_PAGES);
+            long pageSize = sysconf(_SC_PAGE_SIZE);
+            return pages > 0 && pageSize > 0 ? rif_uint64(pages) * rif_uint64(pageSize) : 0;
+#endif
+        }
+
+        inline rif_int CopyInfo(const void* value, size_t valueSize, size_t size, void* data, size_t* sizeRet)
+        {
+            if (sizeRet)
+            {
+                *sizeRet = valueSize;
+            }
+            if (data)
+            {
+                if (size < valueSize)
+                {
+                    return RIF_ERROR_INVALID_PARAMETER;
+                }
+                memcpy(data, value, valueSize);
+            }
+            return RIF_SUCCESS;
+        }
+    }
+
+    // Attached filters run in attach order; every filter is parallelized over the pool.
+    class CommandQueue : public Object
+    {
+    public:
+        struct Entry
+        {
+            Filter* filter;
+            const Image* input;
+            Image* output;
+        };
+
+        rif_int AttachImageFilter(Filter* filter, const Image* input, Image* output)
+        {
+            if (!filter || !input || !output)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            m_entries.push_back(Entry{ filter, input, output });
+            return RIF_SUCCESS;
+        }
+
+        rif_int DetachImageFilter(Filter* filter)
+        {
+            for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                if (it->filter == filter)
+                {
+                    m_entries.erase(it);
+                    return RIF_SUCCESS;
+                }
+            }
+            return RIF_ERROR_INVALID_FILTER;
+        }
+
+        const std::vector<Entry>& Entries() const
+        {
+            return m_entries;
+        }
+
+    private:
+        std::vector<Entry> m_entries;
+    };
+
+    // returns nullptr for filter types the host backend does not implement
+    inline Filter* CreateFilter(rif_image_filter_type type)
+    {
+        switch (type)
+        {
+        case RIF_IMAGE_FILTER_GAMMA_CORRECTION:
+            return new GammaCorrectionFilter();
+        case RIF_IMAGE_FILTER_ADD:
+        case RIF_IMAGE_FILTER_SUB:
+        case RIF_IMAGE_FILTER_MUL:
+        case RIF_IMAGE_FILTER_DIV:
+        case RIF_IMAGE_FILTER_MAX:
+        case RIF_IMAGE_FILTER_MIN:
+            return new ArithmeticFilter(type);
+        case RIF_IMAGE_FILTER_CONVERT:
+            return new ConvertFilter();
+        case RIF_IMAGE_FILTER_BGRA_TO_RGBA:
+            return new BgraToRgbaFilter();
+        case RIF_IMAGE_FILTER_FLIP_VERT:
+        case RIF_IMAGE_FILTER_FLIP_HOR:
+            return new FlipFilter(type);
+        case RIF_IMAGE_FILTER_ROTATE:
+            return new RotateFilter();
+        case RIF_IMAGE_FILTER_RESAMPLE:
+            return new ResampleFilter();
+        case RIF_IMAGE_FILTER_GAUSSIAN_BLUR:
+            return new GaussianBlurFilter();
+        case RIF_IMAGE_FILTER_MEDIAN_DENOISE:
+            return new MedianDenoiseFilter();
+        case RIF_IMAGE_FILTER_DILATE_ERODE:
+            return new DilateErodeFilter();
+        case RIF_IMAGE_FILTER_BILATERAL_DENOISE:
+            return new BilateralDenoiseFilter();
+        case RIF_IMAGE_FILTER_EAW_DENOISE:
+            return new EawDenoiseFilter();
+        case RIF_IMAGE_FILTER_LWR_DENOISE:
+            return new LwrDenoiseFilter();
+        case RIF_IMAGE_FILTER_MLAA:
+            return new MlaaFilter();
+        case RIF_IMAGE_FILTER_LINEAR_TONEMAP:
+        case RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP:
+        case RIF_IMAGE_FILTER_REINHARD02_TONEMAP:
+        case RIF_IMAGE_FILTER_DRAGO_TONEMAP:
+        case RIF_IMAGE_FILTER_FILMIC_TONEMAP:
+        case RIF_IMAGE_FILTER_ACES_TONEMAP:
+        case RIF_IMAGE_FILTER_MAXWHITE_TONEMAP:
+        case RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP:
+        case RIF_IMAGE_FILTER_PHOTO_TONEMAP:
+        case RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP:
+        case RIF_IMAGE_FILTER_AUTOLINEAR_TONEMAP:
+            return new ToneMapFilter(type);
+        case RIF_IMAGE_FILTER_NORMALIZATION:
+            return new NormalizationFilter();
+        case RIF_IMAGE_FILTER_IMAGE_STATISTICS:
+            return new ImageStatisticsFilter();
+        case RIF_IMAGE_FILTER_EXPRESSION:
+            return new ExpressionFilter();
+        case RIF_IMAGE_FILTER_USER_DEFINED:
+            return new UserDefinedFilter();
+        case RIF_IMAGE_FILTER_AI_DENOISE:
+            return new AiDenoiseFilter();
+        case RIF_IMAGE_FILTER_AI_UPSCALE:
+            return new AiUpscaleFilter();
+        default:
+            return nullptr;
+        }
+    }
+
+    class Context : public Object
+    {
+    public:
+        // 'threadCount' - 0 uses every hardware thread
+        explicit Context(unsigned threadCount)
+            : m_pool(threadCount)
+        {   }
+
+        ThreadPool& Pool()
+        {
+            return m_pool;
+        }
+
+        rif_int CreateImage(const rif_image_desc* desc, const void* data, Image** image)
+        {
+            if (!desc || !image || desc->image_width == 0 || desc->image_height == 0 ||
+                desc->num_components == 0 || desc->num_components > 4 || ComponentSize(desc->type) == 0)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            *image = new Image(*desc, data);
+            return RIF_SUCCESS;
+        }
+
+        rif_int CreateImageFilter(rif_image_filter_type type, Filter** filter)
+        {
+            if (!filter)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            *filter = CreateFilter(type);
+            return *filter ? RIF_SUCCESS : RIF_ERROR_UNSUPPORTED;
+        }
+
+        rif_int CreateCommandQueue(CommandQueue** queue)
+        {
+            if (!queue)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            *queue = new CommandQueue();
+            return RIF_SUCCESS;
+        }
+
+        // runs the queue to completion on the calling thread and the pool; 'callback' is
+        // invoked before returning, 'statistics->execution_time' is in nanoseconds
+        rif_int ExecuteCommandQueue(CommandQueue* queue, rif_exec_command_queue_callback callback = nullptr,
+            void* data = nullptr, rif_performance_statistic* statistics = nullptr)
+        {
+            if (!queue)
+            {
+                return RIF_ERROR_INVALID_QUEUE;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (const auto& entry : queue->Entries())
+            {
+                rif_int status = entry.filter->Execute(m_pool, *entry.input, *entry.output);
+                if (status != RIF_SUCCESS)
+                {
+                    return status;
+                }
+            }
+
+            if (statistics && statistics->measure_execution_time)
+            {
+                statistics->execution_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            }
+            if (callback)
+            {
+                callback(data);
+            }
+            return RIF_SUCCESS;
+        }
+
+    private:
+        ThreadPool m_pool;
+    };
+
+    inline rif_int GetDeviceCount(rif_backend_api_type backendType, rif_int* deviceCount)
+    {
+        if (backendType != RIF_BACKEND_API_CPU)
+        {
+            return rifGetDeviceCount(backendType, deviceCount);
+        }
+        if (!deviceCount)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        *deviceCount = 1;
+        return RIF_SUCCESS;
+    }
+
+    // RIF_DEVICE_NAME and RIF_DEVICE_VENDOR are strings, RIF_DEVICE_MEMORY_SIZE is a
+    // rif_uint64 holding the physical memory, RIF_DEVICE_THREAD_COUNT a rif_uint
+    inline rif_int GetDeviceInfo(rif_backend_api_type backendType, rif_int deviceId, rif_device_info info,
+        size_t size, void* data, size_t* sizeRet, unsigned threadCount = 0)
+    {
+        if (backendType != RIF_BACKEND_API_CPU)
+        {
+            return rifGetDeviceInfo(backendType, deviceId, info, size, data, sizeRet);
+        }
+        if (deviceId != 0)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        switch (info)
+        {
+        case RIF_DEVICE_NAME:
+        {
+            std::string name = detail::CpuName();
+            return detail::CopyInfo(name.c_str(), name.size() + 1, size, data, sizeRet);
+        }
+        case RIF_DEVICE_VENDOR:
+        {
+            std::string vendor = detail::CpuVendor();
+            return detail::CopyInfo(vendor.c_str(), vendor.size() + 1, size, data, sizeRet);
+        }
+        case RIF_DEVICE_MEMORY_SIZE:
+        {
+            rif_uint64 memory = detail::PhysicalMemory();
+            return detail::CopyInfo(&memory, sizeof(memory), size, data, sizeRet);
+        }
+        case RIF_DEVICE_THREAD_COUNT:
+        {
+            rif_uint threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+            return detail::CopyInfo(&threads, sizeof(threads), size, data, sizeRet);
+        }
+        default:
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    // 'threadCount' - 0 uses every hardware thread
+    inline rif_int CreateContext(rif_backend_api_type backendType, rif_int deviceId, unsigned threadCount, Context** context)
+    {
+        if (!context)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        if (backendType != RIF_BACKEND_API_CPU || deviceId != 0)
+        {
+            return RIF_ERROR_UNSUPPORTED;
+        }
+        *context = new Context(threadCount);
+        return RIF_SUCCESS;
+    }
+
+    inline rif_int ObjectDelete(Object* object)
+    {
+        delete object;
+        return RIF_SUCCESS;
+    }
+}
@@ -0,0 +1,462 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Edge-avoiding a-trous wavelet denoise (Dammertz et al.) on the host.
+//
+// Every iteration applies the 5x5 B3-spline kernel with holes 2^i pixels apart,
+// weighted by the colour distance relative to the colour variance, the normal angle,
+// the depth difference and the transition (object) difference of the two pixels.
+//
+// The image is cut into square tiles processed in parallel. A tile keeps its pixels
+// and a halo of 2^iterations pixels in one buffer where every row holds all the planes
+// (colour, variance, normal, depth, transition, validity) one after the other, so a
+// pass streams the tile once and each SIMD lane filters one pixel with plain loads.
+// After a pass every tile pulls the new colours of its halo from its neighbours'
+// results; the guide planes never change and are filled once.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <chrono>
+#include <vector>
+
+namespace CpuBackend
+{
+    enum EawPlane
+    {
+        EawRed,
+        EawGreen,
+        EawBlue,
+        EawVariance,
+        EawNormalX,
+        EawNormalY,
+        EawNormalZ,
+        EawDepth,
+        EawTransR,
+        EawTransG,
+        EawTransB,
+        EawValid,
+        EawPlaneCount,
+    };
+
+    // multipliers of the edge-stopping terms for one iteration
+    struct EawPassConstants
+    {
+        float color;
+        float normal;
+        float depth;
+        float trans;
+        int step;
+    };
+
+    namespace EawScalar
+    {
+        using simd::Scalar::Float;
+#include "eaw_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace EawSse
+    {
+        using simd::Sse::Float;
+#include "eaw_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace EawAvx2
+    {
+        using simd::Avx2::Float;
+#include "eaw_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace EawNeon
+    {
+        using simd::Neon::Float;
+#include "eaw_kernels.inl"
+    }
+#endif
+
+    struct EawSettings
+    {
+        int iterations = 4;
+        float colorSigma = 1.0f;        // in standard deviations of the colour, halved every iteration
+        float normalSharpness = 64.0f;  // weight exp(-sharpness * (1 - n.n'))
+        float depthSigma = 1.0f;        // per pixel of distance
+        float transSigma = 0.1f;
+        size_t tileSize = 0;            // 0 picks it from the halo
+    };
+
+    // optional guides; a missing one does not affect the weights
+    struct EawGuides
+    {
+        const FloatImage* variance = nullptr;
+        const FloatImage* normals = nullptr;
+        const FloatImage* depth = nullptr;
+        const FloatImage* trans = nullptr;
+    };
+
+    struct EawStatistics
+    {
+        std::vector<double> filterMs;       // per iteration
+        std::vector<double> exchangeMs;     // halo exchange after each iteration but the last
+    };
+
+    inline EawPassConstants EawPass(const EawSettings& settings, int iteration)
+    {
+        EawPassConstants c;
+        c.step = 1 << iteration;
+        const float sigma = std::max(settings.colorSigma, 1e-4f) / float(1 << iteration);
+        c.color = 1.0f / (sigma * sigma);
+        c.normal = settings.normalSharpness;
+        c.depth = 1.0f / (std::max(settings.depthSigma, 1e-6f) * c.step);
+        c.trans = 1.0f / std::max(settings.transSigma * settings.transSigma, 1e-12f);
+        return c;
+    }
+
+    namespace detail
+    {
+        typedef void (*EawRowFunction)(const float* const*, size_t, size_t, size_t, const EawPassConstants&, float* const*);
+
+        inline EawRowFunction SelectEawRow(simd::Level level, int* width)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+            case simd::Level::Avx2:
+                *width = EawAvx2::Float::Width;
+                return EawAvx2::EawRow;
+            case simd::Level::Sse:
+                *width = EawSse::Float::Width;
+                return EawSse::EawRow;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                *width = EawNeon::Float::Width;
+                return EawNeon::EawRow;
+#endif
+            default:
+                *width = EawScalar::Float::Width;
+                return EawScalar::EawRow;
+            }
+        }
+
+        class EawTile
+        {
+        public:
+            EawTile(long x0, long y0, long size, long halo)
+                : m_x0(x0), m_y0(y0), m_size(size), m_halo(halo)
+            {
+                m_pitch = (size + 2 * halo + FloatImage::RowAlignment - 1) / FloatImage::RowAlignment * FloatImage::RowAlignment;
+                m_data.assign(m_pitch * EawPlaneCount * (size + 2 * halo), 0.0f);
+                m_result.assign(3 * size * size, 0.0f);
+            }
+
+            long X0() const { return m_x0; }
+            long Y0() const { return m_y0; }
+            long Size() const { return m_size; }
+            long Halo() const { return m_halo; }
+            size_t Pitch() const { return m_pitch; }
+
+            // buffer row 'ry', halo included; plane k starts k * Pitch() floats further
+            float* Row(long ry)
+            {
+                return m_data.data() + ry * m_pitch * EawPlaneCount;
+            }
+
+            // plane 0..2 of the filtered colours, Size() x Size()
+            float* Result(int plane)
+            {
+                return m_result.data() + plane * m_size * m_size;
+            }
+
+            const float* Result(int plane) const
+            {
+                return m_result.data() + plane * m_size * m_size;
+            }
+
+        private:
+            long m_x0, m_y0, m_size, m_halo;
+            size_t m_pitch;
+            std::vector<float> m_data;
+            std::vector<float> m_result;
+        };
+    }
+
+    inline void EawDenoise(ThreadPool& pool, const FloatImage& color, const EawGuides& guides, FloatImage& dst,
+        const EawSettings& settings, EawStatistics* statistics = nullptr, simd::Level level = simd::CurrentLevel())
+    {
+        const long width = static_cast<long>(color.Width());
+        const long height = static_cast<long>(color.Height());
+        const int iterations = std::max(1, std::min(settings.iterations, 10));
+        dst.Resize(width, height);
+
+        // the last pass reaches 2 * 2^(iterations - 1) pixels out
+        const long halo = 1L << iterations;
+        long size = settings.tileSize ? long(settings.tileSize) : std::max(64L, 2 * halo);
+        size = (size + FloatImage::RowAlignment - 1) / FloatImage::RowAlignment * FloatImage::RowAlignment;
+        const long tilesX = (width + size - 1) / size;
+        const long tilesY = (height + size - 1) / size;
+
+        std::vector<detail::EawTile> tiles;
+        tiles.reserve(tilesX * tilesY);
+        for (long ty = 0; ty < tilesY; ++ty)
+        {
+            for (long tx = 0; tx < tilesX; ++tx)
+            {
+                tiles.emplace_back(tx * size, ty * size, size, halo);
+            }
+        }
+
+        // guide planes, once
+        pool.ParallelFor(tiles.size(), 1, [&](size_t begin, size_t end)
+        {
+            for (size_t t = begin; t < end; ++t)
+            {
+                detail::EawTile& tile = tiles[t];
+                const size_t pitch = tile.Pitch();
+                for (long ry = 0; ry < size + 2 * halo; ++ry)
+                {
+                    const long y = tile.Y0() - halo + ry;
+                    float* row = tile.Row(ry);
+                    if (y < 0 || y >= height)
+                    {
+                        continue;
+                    }
+                    for (long rx = 0; rx < size + 2 * halo; ++rx)
+                    {
+                        const long x = tile.X0() - halo + rx;
+                        if (x < 0 || x >= width)
+                        {
+                            continue;
+                        }
+                        const float* c = color.Row(y) + 4 * x;
+                        row[EawRed * pitch + rx] = c[0];
+                        row[EawGreen * pitch + rx] = c[1];
+                        row[EawBlue * pitch + rx] = c[2];
+                        if (guides.variance)
+                        {
+                            const float* v = guides.variance->Row(y) + 4 * x;
+                            row[EawVariance * pitch + rx] = (v[0] + v[1] + v[2]) * (1.0f / 3.0f);
+                        }
+                        else
+                        {
+                            row[EawVariance * pitch + rx] = 1.0f;
+                        }
+                        if (guides.normals)
+                        {
+                            const float* n = guides.normals->Row(y) + 4 * x;
+                            row[EawNormalX * pitch + rx] = n[0];
+                            row[EawNormalY * pitch + rx] = n[1];
+                            row[EawNormalZ * pitch + rx] = n[2];
+                        }
+                        if (guides.depth)
+                        {
+                            row[EawDepth * pitch + rx] = guides.depth->Row(y)[4 * x];
+                        }
+                        if (guides.trans)
+                        {
+                            const float* tr = guides.trans->Row(y) + 4 * x;
+                            row[EawTransR * pitch + rx] = tr[0];
+                            row[EawTransG * pitch + rx] = tr[1];
+                            row[EawTransB * pitch + rx] = tr[2];
+                        }
+                        row[EawValid * pitch + rx] = 1.0f;
+                    }
+                }
+            }
+        });
+
+        int vectorWidth = 0;
+        const detail::EawRowFunction eawRow = detail::SelectEawRow(level, &vectorWidth);
+        if (statistics)
+        {
+            statistics->filterMs.clear();
+            statistics->exchangeMs.clear();
+        }
+
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            const EawPassConstants constants = EawPass(settings, iteration);
+            auto start = std::chrono::high_resolution_clock::now();
+            pool.ParallelFor(tiles.size(), 1, [&](size_t begin, size_t end)
+            {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    detail::EawTile& tile = tiles[t];
+                    const long rowsUsed = std::min(size, height - tile.Y0());
+                    const size_t count = (std::min(size, width - tile.X0()) + vectorWidth - 1) / vectorWidth * vectorWidth;
+                    const float* rows[5];
+                    for (long y = 0; y < rowsUsed; ++y)
+                    {
+                        for (int k = 0; k < 5; ++k)
+                        {
+                            rows[k] = tile.Row(halo + y + (k - 2) * constants.step);
+                        }
+                        float* out[3] = { tile.Result(0) + y * size, tile.Result(1) + y * size, tile.Result(2) + y * size };
+                        eawRow(rows, tile.Pitch(), halo, count, constants, out);
+                    }
+                }
+            });
+            if (statistics)
+            {
+                statistics->filterMs.push_back(detail::MsSince(start));
+            }
+
+            if (iteration + 1 == iterations)
+            {
+                break;
+            }
+
+            // halo exchange: every tile pulls the colours of its window, its own included,
+            // from the results of the tiles that own them
+            start = std::chrono::high_resolution_clock::now();
+            pool.ParallelFor(tiles.size(), 1, [&](size_t begin, size_t end)
+            {
+                for (size_t t = begin; t < end; ++t)
+                {
+                    detail::EawTile& tile = tiles[t];
+                    const long xBegin = std::max(0L, tile.X0() - halo);
+                    const long xEnd = std::min(width, tile.X0() + size + halo);
+                    for (long ry = 0; ry < size + 2 * halo; ++ry)
+                    {
+                        const long y = tile.Y0() - halo + ry;
+                        if (y < 0 || y >= height)
+                        {
+                            continue;
+                        }
+                        float* row = tile.Row(ry);
+                        for (long x = xBegin; x < xEnd;)
+                        {
+                            const detail::EawTile& owner = tiles[(y / size) * tilesX + x / size];
+                            const long segmentEnd = std::min(xEnd, owner.X0() + size);
+                            const long offset = (y - owner.Y0()) * size + x - owner.X0();
+                            const long rx = x - tile.X0() + halo;
+                            for (int c = 0; c < 3; ++c)
+                            {
+                                std::copy(owner.Result(c) + offset, owner.Result(c) + offset + (segmentEnd - x),
+                                    row + c * tile.Pitch() + rx);
+                            }
+                            x = segmentEnd;
+                        }
+                    }
+                }
+            });
+            if (statistics)
+            {
+                statistics->exchangeMs.push_back(detail::MsSince(start));
+            }
+        }
+
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            for (long y = long(begin); y < long(end); ++y)
+            {
+                float* out = dst.Row(y);
+                const float* in = color.Row(y);
+                for (long x = 0; x < width; ++x)
+                {
+                    const detail::EawTile& tile = tiles[(y / size) * tilesX + x / size];
+                    const long offset = (y - tile.Y0()) * size + x - tile.X0();
+                    out[4 * x] = tile.Result(0)[offset];
+                    out[4 * x + 1] = tile.Result(1)[offset];
+                    out[4 * x + 2] = tile.Result(2)[offset];
+                    out[4 * x + 3] = in[4 * x + 3];
+                }
+            }
+        });
+    }
+
+    // RIF_IMAGE_FILTER_EAW_DENOISE
+    // "normalsImg", "depthImg", "transImg", "colorVar" - guides, "iterations" - a-trous
+    // passes, "colorSigma", "normalSharpness", "depthSigma", "transSigma" - weight scales
+    class EawDenoiseFilter : public Filter
+    {
+    public:
+        EawDenoiseFilter()
+            : Filter(RIF_IMAGE_FILTER_EAW_DENOISE)
+        {
+            const EawSettings defaults;
+            DeclareImage("normalsImg");
+            DeclareImage("depthImg");
+            DeclareImage("transImg");
+            DeclareImage("colorVar");
+            DeclareUint("iterations", defaults.iterations);
+            DeclareFloat("colorSigma", defaults.colorSigma);
+            DeclareFloat("normalSharpness", defaults.normalSharpness);
+            DeclareFloat("depthSigma", defaults.depthSigma);
+            DeclareFloat("transSigma", defaults.transSigma);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            const char* names[] = { "colorVar", "normalsImg", "depthImg", "transImg" };
+            FloatImage images[4];
+            const FloatImage* loaded[4] = {};
+            for (int i = 0; i < 4; ++i)
+            {
+                const Image* guide = GetImage(names[i]);
+                if (!guide)
+                {
+                    continue;
+                }
+                if (guide->Width() != input.Width() || guide->Height() != input.Height())
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+                images[i].Load(pool, *guide);
+                loaded[i] = &images[i];
+            }
+
+            EawGuides guides;
+            guides.variance = loaded[0];
+            guides.normals = loaded[1];
+            guides.depth = loaded[2];
+            guides.trans = loaded[3];
+
+            EawSettings settings;
+            settings.iterations = static_cast<int>(GetUint("iterations"));
+            settings.colorSigma = GetFloat("colorSigma");
+            settings.normalSharpness = GetFloat("normalSharpness");
+            settings.depthSigma = GetFloat("depthSigma");
+            settings.transSigma = GetFloat("transSigma");
+
+            FloatImage src;
+            FloatImage dst;
+            src.Load(pool, input);
+            EawDenoise(pool, src, guides, dst, settings);
+            dst.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+    };
+}
@@ -0,0 +1,95 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// A-trous pass of the EAW denoise, included by eaw_filter.h once per instruction set
+// with 'Float' naming that set's vector type. Each lane filters one pixel.
+
+// Filters 'count' pixels (whole vectors) of one tile row. rows[k] is the tile row at
+// vertical offset (k - 2) * step and holds the EawPlane planes 'pitch' floats apart;
+// the first output is pixel 'first' of rows[2]. Results go to out[0..2] + i.
+inline void EawRow(const float* const* rows, size_t pitch, size_t first, size_t count, const EawPassConstants& c,
+    float* const* out)
+{
+    static const float h[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+    const Float zero = Float::Zero();
+    const Float one = Float::Set1(1.0f);
+    const Float normalScale = Float::Set1(c.normal);
+    const Float depthScale = Float::Set1(c.depth);
+    const Float transScale = Float::Set1(c.trans);
+
+    for (size_t i = 0; i < count; i += Float::Width)
+    {
+        const float* p = rows[2] + first + i;
+        const Float pr = Float::Load(p + EawRed * pitch);
+        const Float pg = Float::Load(p + EawGreen * pitch);
+        const Float pb = Float::Load(p + EawBlue * pitch);
+        const Float colorScale = Float::Set1(c.color) / (Float::Load(p + EawVariance * pitch) + Float::Set1(1e-4f));
+        const Float pnx = Float::Load(p + EawNormalX * pitch);
+        const Float pny = Float::Load(p + EawNormalY * pitch);
+        const Float pnz = Float::Load(p + EawNormalZ * pitch);
+        const Float pz = Float::Load(p + EawDepth * pitch);
+        const Float ptr = Float::Load(p + EawTransR * pitch);
+        const Float ptg = Float::Load(p + EawTransG * pitch);
+        const Float ptb = Float::Load(p + EawTransB * pitch);
+
+        Float ar = zero, ag = zero, ab = zero, aw = zero;
+        for (int ky = 0; ky < 5; ++ky)
+        {
+            const float* row = rows[ky] + first + i;
+            for (int kx = 0; kx < 5; ++kx)
+            {
+                const float* q = row + (kx - 2) * c.step;
+                const Float qr = Float::Load(q + EawRed * pitch);
+                const Float qg = Float::Load(q + EawGreen * pitch);
+                const Float qb = Float::Load(q + EawBlue * pitch);
+
+                const Float dr = pr - qr;
+                const Float dg = pg - qg;
+                const Float db = pb - qb;
+                Float e = MulAdd(dr, dr, MulAdd(dg, dg, db * db)) * colorScale;
+
+                const Float dot = MulAdd(pnx, Float::Load(q + EawNormalX * pitch),
+                    MulAdd(pny, Float::Load(q + EawNormalY * pitch), pnz * Float::Load(q + EawNormalZ * pitch)));
+                e = MulAdd(Max(zero, one - dot), normalScale, e);
+                e = MulAdd(Abs(pz - Float::Load(q + EawDepth * pitch)), depthScale, e);
+
+                const Float tr = ptr - Float::Load(q + EawTransR * pitch);
+                const Float tg = ptg - Float::Load(q + EawTransG * pitch);
+                const Float tb = ptb - Float::Load(q + EawTransB * pitch);
+                e = MulAdd(MulAdd(tr, tr, MulAdd(tg, tg, tb * tb)), transScale, e);
+
+                // pixels outside the image have validity 0
+                const Float w = Float::Set1(h[ky] * h[kx]) * Float::Load(q + EawValid * pitch) * Exp(zero - e);
+                ar = MulAdd(w, qr, ar);
+                ag = MulAdd(w, qg, ag);
+                ab = MulAdd(w, qb, ab);
+                aw = aw + w;
+            }
+        }
+
+        // the centre tap always has a positive weight
+        const Float inverse = one / aw;
+        (ar * inverse).Store(out[0] + i);
+        (ag * inverse).Store(out[1] + i);
+        (ab * inverse).Store(out[2] + i);
+    }
+}
@@ -0,0 +1,546 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Per-pixel arithmetic expressions over several images on the host, standing in for
+// chains of RIF_IMAGE_FILTER_ADD/SUB/MUL/DIV/MIN/MAX that each take a round trip of a
+// whole image through memory.
+//
+// An expression such as "a * k0 + max(b, c) / d" is compiled once into register code.
+// Images are single letters, 'a' being the filter input and 'b' onwards the "inputs"
+// array; k0, k1, ... are the "scalars" array and numbers are literals. The operators
+// are + - * / and unary minus, with min, max, abs, sqrt and clamp(x, lo, hi).
+// Channels are independent and division by zero gives zero, as RIF_IMAGE_FILTER_DIV.
+//
+// Rows are run in blocks of ExpressionBlockPixels pixels: every referenced image is
+// converted into its register block once, the instructions sweep the blocks one at a
+// time, which keeps the dispatch off the per-pixel cost and the blocks in L1, and the
+// result is converted into the output. Each image is read once and the output written
+// once whatever the length of the expression.
+
+#include "filter.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// rif_image_filter_type extension only understood by the host backend
+#ifndef RIF_IMAGE_FILTER_EXPRESSION
+#define RIF_IMAGE_FILTER_EXPRESSION 0x1001u
+#endif
+
+namespace CpuBackend
+{
+    const size_t ExpressionMaxImages = 8;
+    const size_t ExpressionBlockPixels = 64;
+
+    enum class ExpressionOp : uint8_t
+    {
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Min,
+        Max,
+        Neg,
+        Abs,
+        Sqrt,
+        Clamp,
+    };
+
+    struct ExpressionInstruction
+    {
+        ExpressionOp op;
+        uint16_t out;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+    };
+
+    // Registers [0, ExpressionMaxImages) are the images, then come the constants, then
+    // the temporaries, which are reused once their value has been read.
+    struct ExpressionProgram
+    {
+        std::vector<ExpressionInstruction> code;
+        std::vector<float> literals;        // value of every constant
+        std::vector<int> scalars;           // "scalars" index of every constant, -1 for literals
+        size_t images = 0;                  // highest image letter used + 1
+        size_t registers = ExpressionMaxImages;
+        uint16_t result = 0;
+    };
+
+    namespace ExpressionScalar
+    {
+        using simd::Scalar::Float;
+#include "expression_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace ExpressionSse
+    {
+        using simd::Sse::Float;
+#include "expression_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace ExpressionAvx2
+    {
+        using simd::Avx2::Float;
+#include "expression_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace ExpressionAvx512
+    {
+        using simd::Avx512::Float;
+#include "expression_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace ExpressionNeon
+    {
+        using simd::Neon::Float;
+#include "expression_kernels.inl"
+    }
+#endif
+
+    namespace detail
+    {
+        typedef void (*ExpressionKernel)(const ExpressionInstruction*, size_t, float* const*, size_t);
+
+        inline ExpressionKernel SelectExpressionKernel(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return ExpressionAvx512::ExpressionRun;
+            case simd::Level::Avx2:
+                return ExpressionAvx2::ExpressionRun;
+            case simd::Level::Sse:
+                return ExpressionSse::ExpressionRun;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return ExpressionNeon::ExpressionRun;
+#endif
+            default:
+                return ExpressionScalar::ExpressionRun;
+            }
+        }
+
+        // the scalar meaning of every instruction, for folding literals
+        inline float ExpressionEvaluate(ExpressionOp op, float a, float b, float c)
+        {
+            switch (op)
+            {
+            case ExpressionOp::Add: return a + b;
+            case ExpressionOp::Sub: return a - b;
+            case ExpressionOp::Mul: return a * b;
+            case ExpressionOp::Div: return b != 0.0f ? a / b : 0.0f;
+            case ExpressionOp::Min: return std::min(a, b);
+            case ExpressionOp::Max: return std::max(a, b);
+            case ExpressionOp::Neg: return -a;
+            case ExpressionOp::Abs: return std::fabs(a);
+            case ExpressionOp::Sqrt: return std::sqrt(std::max(a, 0.0f));
+            case ExpressionOp::Clamp: return std::min(std::max(a, b), c);
+            }
+            return 0.0f;
+        }
+
+        // recursive descent straight to register code
+        class ExpressionCompiler
+        {
+        public:
+            ExpressionCompiler(const std::string& text, ExpressionProgram& program)
+                : m_text(text)
+                , m_program(program)
+            {   }
+
+            bool Compile()
+            {
+                m_program = ExpressionProgram();
+                const int result = Sum();
+                Skip();
+                if (result < 0 || m_position != m_text.size())
+                {
+                    return false;
+                }
+
+                // the temporaries go after the constants, whose count is only known now
+                const size_t base = ExpressionMaxImages + m_program.literals.size();
+                auto place = [&](int r) { return uint16_t(r >= TemporaryBase ? base + (r - TemporaryBase) : r); };
+                for (ExpressionInstruction& instruction : m_program.code)
+                {
+                    instruction.out = place(instruction.out);
+                    instruction.a = place(instruction.a);
+                    instruction.b = place(instruction.b);
+                    instruction.c = place(instruction.c);
+                }
+                m_program.result = place(result);
+                m_program.registers = base + m_temporaries;
+                return m_program.registers <= 0xffff;
+            }
+
+        private:
+            // temporaries are numbered from here while compiling
+            static const int TemporaryBase = 0x8000;
+
+            void Skip()
+            {
+                while (m_position < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_position])))
+                {
+                    ++m_position;
+                }
+            }
+
+            bool Accept(char c)
+            {
+                Skip();
+                if (m_position < m_text.size() && m_text[m_position] == c)
+                {
+                    ++m_position;
+                    return true;
+                }
+                return false;
+            }
+
+            bool IsLiteral(int r) const
+            {
+                return r >= int(ExpressionMaxImages) && r < TemporaryBase && m_program.scalars[r - ExpressionMaxImages] < 0;
+            }
+
+            int Constant(float value, int scalar)
+            {
+                for (size_t i = 0; i < m_program.literals.size(); ++i)
+                {
+                    if (m_program.scalars[i] == scalar && (scalar >= 0 || m_program.literals[i] == value))
+                    {
+                        return int(ExpressionMaxImages + i);
+                    }
+                }
+                m_program.literals.push_back(value);
+                m_program.scalars.push_back(scalar);
+                return int(ExpressionMaxImages + m_program.literals.size() - 1);
+            }
+
+            int Emit(ExpressionOp op, int a, int b = 0, int c = 0)
+            {
+                if (a < 0 || b < 0 || c < 0)
+                {
+                    return -1;
+                }
+                const int arity = op == ExpressionOp::Clamp ? 3 : op == ExpressionOp::Neg || op == ExpressionOp::Abs || op == ExpressionOp::Sqrt ? 1 : 2;
+                if (IsLiteral(a) && (arity < 2 || IsLiteral(b)) && (arity < 3 || IsLiteral(c)))
+                {
+                    const float* literals = m_program.literals.data() - ExpressionMaxImages;
+                    return Constant(ExpressionEvaluate(op, literals[a], arity > 1 ? literals[b] : 0.0f, arity > 2 ? literals[c] : 0.0f), -1);
+                }
+
+                // every temporary has one reader, so the operands are free once read
+                const int operands[] = { a, b, c };
+                for (int i = 0; i < arity; ++i)
+                {
+                    if (operands[i] >= TemporaryBase)
+                    {
+                        m_free.push_back(operands[i]);
+                    }
+                }
+                int out;
+                if (!m_free.empty())
+                {
+                    out = m_free.back();
+                    m_free.pop_back();
+                }
+                else
+                {
+                    out = TemporaryBase + int(m_temporaries++);
+                }
+                m_program.code.push_back({ op, uint16_t(out), uint16_t(a), uint16_t(b), uint16_t(c) });
+                return out;
+            }
+
+            int Sum()
+            {
+                int left = Product();
+                for (;;)
+                {
+                    if (Accept('+'))
+                    {
+                        const int right = Product();
+                        left = Emit(ExpressionOp::Add, left, right);
+                    }
+                    else if (Accept('-'))
+                    {
+                        const int right = Product();
+                        left = Emit(ExpressionOp::Sub, left, right);
+                    }
+                    else
+                    {
+                        return left;
+                    }
+                }
+            }
+
+            int Product()
+            {
+                int left = Unary();
+                for (;;)
+                {
+                    if (Accept('*'))
+                    {
+                        const int right = Unary();
+                        left = Emit(ExpressionOp::Mul, left, right);
+                    }
+                    else if (Accept('/'))
+                    {
+                        const int right = Unary();
+                        left = Emit(ExpressionOp::Div, left, right);
+                    }
+                    else
+                    {
+                        return left;
+                    }
+                }
+            }
+
+            int Unary()
+            {
+                if (Accept('-'))
+                {
+                    return Emit(ExpressionOp::Neg, Unary());
+                }
+                return Primary();
+            }
+
+            int Primary()
+            {
+                Skip();
+                if (m_position >= m_text.size())
+                {
+                    return -1;
+                }
+                if (Accept('('))
+                {
+                    const int value = Sum();
+                    return Accept(')') ? value : -1;
+                }
+
+                const char* begin = m_text.c_str() + m_position;
+                if (std::isdigit(static_cast<unsigned char>(*begin)) || *begin == '.')
+                {
+                    char* end = nullptr;
+                    const float value = std::strtof(begin, &end);
+                    m_position += end - begin;
+                    return end != begin ? Constant(value, -1) : -1;
+                }
+
+                std::string name;
+                while (m_position < m_text.size() && std::isalnum(static_cast<unsigned char>(m_text[m_position])))
+                {
+                    name += m_text[m_position++];
+                }
+                if (name.size() == 1 && name[0] >= 'a' && name[0] < char('a' + ExpressionMaxImages))
+                {
+                    const size_t image = size_t(name[0] - 'a');
+                    m_program.images = std::max(m_program.images, image + 1);
+                    return int(image);
+                }
+                if (name.size() > 1 && name[0] == 'k' && name.find_first_not_of("0123456789", 1) == std::string::npos)
+                {
+                    return Constant(0.0f, std::atoi(name.c_str() + 1));
+                }
+
+                const struct
+                {
+                    const char* name;
+                    ExpressionOp op;
+                    int arity;
+                } functions[] =
+                {
+                    { "min", ExpressionOp::Min, 2 },
+                    { "max", ExpressionOp::Max, 2 },
+                    { "abs", ExpressionOp::Abs, 1 },
+                    { "sqrt", ExpressionOp::Sqrt, 1 },
+                    { "clamp", ExpressionOp::Clamp, 3 },
+                };
+                for (const auto& function : functions)
+                {
+                    if (name != function.name)
+                    {
+                        continue;
+                    }
+                    int arguments[3] = {};
+                    if (!Accept('('))
+                    {
+                        return -1;
+                    }
+                    for (int i = 0; i < function.arity; ++i)
+                    {
+                        if (i > 0 && !Accept(','))
+                        {
+                            return -1;
+                        }
+                        arguments[i] = Sum();
+                    }
+                    if (!Accept(')'))
+                    {
+                        return -1;
+                    }
+                    return Emit(function.op, arguments[0], arguments[1], arguments[2]);
+                }
+                return -1;
+            }
+
+            const std::string& m_text;
+            ExpressionProgram& m_program;
+            size_t m_position = 0;
+            size_t m_temporaries = 0;
+            std::vector<int> m_free;
+        };
+    }
+
+    // compiles 'text'; false when it does not parse
+    inline bool CompileExpression(const std::string& text, ExpressionProgram& program)
+    {
+        detail::ExpressionCompiler compiler(text, program);
+        return compiler.Compile();
+    }
+
+    // output = 'program' over images[0..] ('a', 'b', ...) and 'scalars' (k0, k1, ...)
+    inline rif_int EvaluateExpression(ThreadPool& pool, const ExpressionProgram& program, const Image* const* images,
+        size_t imageCount, const std::vector<float>& scalars, Image& output, simd::Level level = simd::CurrentLevel())
+    {
+        if (program.images > imageCount)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        for (size_t i = 0; i < program.images; ++i)
+        {
+            if (!images[i])
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            if (images[i]->Width() != output.Width() || images[i]->Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+        }
+        for (int scalar : program.scalars)
+        {
+            if (scalar >= int(scalars.size()))
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+        }
+
+        const detail::ExpressionKernel kernel = detail::SelectExpressionKernel(level);
+        const size_t width = output.Width();
+        const size_t block = 4 * ExpressionBlockPixels;
+        pool.ParallelForRows(output.Height(), [&](size_t begin, size_t end)
+        {
+            std::vector<float> storage(program.registers * block);
+            std::vector<float*> registers(program.registers);
+            for (size_t r = 0; r < program.registers; ++r)
+            {
+                registers[r] = &storage[r * block];
+            }
+            for (size_t i = 0; i < program.literals.size(); ++i)
+            {
+                const float value = program.scalars[i] < 0 ? program.literals[i] : scalars[program.scalars[i]];
+                std::fill(registers[ExpressionMaxImages + i], registers[ExpressionMaxImages + i] + block, value);
+            }
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                for (size_t x0 = 0; x0 < width; x0 += ExpressionBlockPixels)
+                {
+                    const size_t count = std::min(ExpressionBlockPixels, width - x0);
+                    for (size_t i = 0; i < program.images; ++i)
+                    {
+                        images[i]->LoadRow(y, x0, count, registers[i], 4);
+                    }
+                    // whole vectors; the tail of a short block is computed and dropped
+                    kernel(program.code.data(), program.code.size(), registers.data(), (4 * count + 15) / 16 * 16);
+                    output.StoreRow(y, x0, count, registers[program.result], 4);
+                }
+            }
+        });
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_EXPRESSION
+    // "expression" - the per-pixel expression, "inputs" - images 'b', 'c', ... ('a' is
+    // the filter input), "scalars" - k0, k1, ...
+    class ExpressionFilter : public Filter
+    {
+    public:
+        ExpressionFilter()
+            : Filter(RIF_IMAGE_FILTER_EXPRESSION)
+        {
+            DeclareString("expression", "a");
+            DeclareImageArray("inputs");
+            DeclareFloatArray("scalars");
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            // compiled again only when the text changes
+            const std::string& text = GetString("expression");
+            if (!m_compiled || text != m_text)
+            {
+                m_text = text;
+                m_compiled = CompileExpression(text, m_program);
+                if (!m_compiled)
+                {
+                    return RIF_ERROR_INVALID_PARAMETER;
+                }
+            }
+
+            std::vector<const Image*> images(1, &input);
+            for (Image* image : GetImageArray("inputs"))
+            {
+                images.push_back(image);
+            }
+            return EvaluateExpression(pool, m_program, images.data(), images.size(), GetFloatArray("scalars"), output);
+        }
+
+    private:
+        std::string m_text;
+        bool m_compiled = false;
+        ExpressionProgram m_program;
+    };
+}
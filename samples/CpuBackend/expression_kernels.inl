@@ -0,0 +1,80 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Expression interpreter loop, included by expression_filter.h once per instruction
+// set with 'Float' naming that set's vector type. No includes here on purpose.
+
+// Runs 'program' over 'count' floats (whole vectors) of every register block; each
+// instruction sweeps its whole block before the next one is decoded.
+inline void ExpressionRun(const ExpressionInstruction* program, size_t instructions, float* const* registers, size_t count)
+{
+    const Float zero = Float::Zero();
+    for (size_t n = 0; n < instructions; ++n)
+    {
+        const ExpressionInstruction& instruction = program[n];
+        const float* a = registers[instruction.a];
+        const float* b = registers[instruction.b];
+        const float* c = registers[instruction.c];
+        float* out = registers[instruction.out];
+        switch (instruction.op)
+        {
+        case ExpressionOp::Add:
+            for (size_t i = 0; i < count; i += Float::Width) (Float::Load(a + i) + Float::Load(b + i)).Store(out + i);
+            break;
+        case ExpressionOp::Sub:
+            for (size_t i = 0; i < count; i += Float::Width) (Float::Load(a + i) - Float::Load(b + i)).Store(out + i);
+            break;
+        case ExpressionOp::Mul:
+            for (size_t i = 0; i < count; i += Float::Width) (Float::Load(a + i) * Float::Load(b + i)).Store(out + i);
+            break;
+        case ExpressionOp::Div:
+            // zero where the divisor is, like RIF_IMAGE_FILTER_DIV
+            for (size_t i = 0; i < count; i += Float::Width)
+            {
+                const Float divisor = Float::Load(b + i);
+                IfGreater(Abs(divisor), zero, Float::Load(a + i) / divisor, zero).Store(out + i);
+            }
+            break;
+        case ExpressionOp::Min:
+            for (size_t i = 0; i < count; i += Float::Width) Min(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case ExpressionOp::Max:
+            for (size_t i = 0; i < count; i += Float::Width) Max(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case ExpressionOp::Neg:
+            for (size_t i = 0; i < count; i += Float::Width) (zero - Float::Load(a + i)).Store(out + i);
+            break;
+        case ExpressionOp::Abs:
+            for (size_t i = 0; i < count; i += Float::Width) Abs(Float::Load(a + i)).Store(out + i);
+            break;
+        case ExpressionOp::Sqrt:
+            for (size_t i = 0; i < count; i += Float::Width) Sqrt(Max(Float::Load(a + i), zero)).Store(out + i);
+            break;
+        case ExpressionOp::Clamp:
+            for (size_t i = 0; i < count; i += Float::Width)
+            {
+                Min(Max(Float::Load(a + i), Float::Load(b + i)), Float::Load(c + i)).Store(out + i);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,355 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "image.h"
+#include "thread_pool.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace CpuBackend
+{
+    enum class ParameterType
+    {
+        Float,
+        Uint,
+        Image,
+        String,
+        FloatArray,
+        ImageArray,
+    };
+
+    struct Parameter
+    {
+        ParameterType type = ParameterType::Float;
+        float values[16] = {};
+        rif_uint count = 0;         // number of floats or uints used
+        rif_uint uintValue = 0;
+        Image* image = nullptr;     // not owned
+        std::string string;
+        std::vector<float> floatArray;
+        std::vector<Image*> imageArray;     // not owned
+    };
+
+    // Base of the host filters. A filter declares its parameters with their defaults in
+    // its constructor; the setters mirror rifImageFilterSetParameter* and reject names
+    // that were not declared, the same way the device filters do.
+    class Filter : public Object
+    {
+    public:
+        explicit Filter(rif_image_filter_type type)
+            : m_type(type)
+        {   }
+
+        rif_image_filter_type Type() const
+        {
+            return m_type;
+        }
+
+        rif_int SetParameter1f(const std::string& name, float value)
+        {
+            return SetFloats(name, &value, 1);
+        }
+
+        rif_int SetParameter2f(const std::string& name, float x, float y)
+        {
+            const float values[] = { x, y };
+            return SetFloats(name, values, 2);
+        }
+
+        rif_int SetParameter4f(const std::string& name, float x, float y, float z, float w)
+        {
+            const float values[] = { x, y, z, w };
+            return SetFloats(name, values, 4);
+        }
+
+        rif_int SetParameter16f(const std::string& name, const float* values)
+        {
+            return SetFloats(name, values, 16);
+        }
+
+        rif_int SetParameter1u(const std::string& name, rif_uint value)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type == ParameterType::Float)
+            {
+                // like the device filters, an integer may feed a float parameter
+                parameter->values[0] = static_cast<float>(value);
+                return RIF_SUCCESS;
+            }
+            if (parameter->type != ParameterType::Uint)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            parameter->uintValue = value;
+            return RIF_SUCCESS;
+        }
+
+        rif_int SetParameterImage(const std::string& name, Image* image)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type != ParameterType::Image)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            parameter->image = image;
+            return RIF_SUCCESS;
+        }
+
+        rif_int SetParameterString(const std::string& name, const std::string& value)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type != ParameterType::String)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            parameter->string = value;
+            return RIF_SUCCESS;
+        }
+
+        rif_int SetParameterFloatArray(const std::string& name, const float* values, rif_uint count)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type != ParameterType::FloatArray)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            parameter->floatArray.assign(values, values + count);
+            return RIF_SUCCESS;
+        }
+
+        rif_int SetParameterImageArray(const std::string& name, Image* const* images, rif_uint count)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type != ParameterType::ImageArray)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            parameter->imageArray.assign(images, images + count);
+            return RIF_SUCCESS;
+        }
+
+        // RIF_COMPUTE_TYPE_*; filters compute in float unless they accept another type
+        rif_int SetComputeType(rif_compute_type type)
+        {
+            if (!SupportsComputeType(type))
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            m_computeType = type;
+            return RIF_SUCCESS;
+        }
+
+        rif_compute_type ComputeType() const
+        {
+            return m_computeType;
+        }
+
+        // runs the filter over the whole of 'output'
+        virtual rif_int Execute(ThreadPool& pool, const Image& input, Image& output) = 0;
+
+    protected:
+        // half precision is accepted everywhere and computed in float
+        virtual bool SupportsComputeType(rif_compute_type type) const
+        {
+            return type == RIF_COMPUTE_TYPE_FLOAT || type == RIF_COMPUTE_TYPE_HALF;
+        }
+
+        void DeclareFloat(const std::string& name, float x, float y = 0.0f, float z = 0.0f, float w = 0.0f)
+        {
+            Parameter& parameter = m_parameters[name];
+            parameter.type = ParameterType::Float;
+            parameter.values[0] = x;
+            parameter.values[1] = y;
+            parameter.values[2] = z;
+            parameter.values[3] = w;
+            parameter.count = 4;
+        }
+
+        void DeclareUint(const std::string& name, rif_uint value)
+        {
+            Parameter& parameter = m_parameters[name];
+            parameter.type = ParameterType::Uint;
+            parameter.uintValue = value;
+        }
+
+        void DeclareImage(const std::string& name)
+        {
+            m_parameters[name].type = ParameterType::Image;
+        }
+
+        void DeclareFloatArray(const std::string& name)
+        {
+            m_parameters[name].type = ParameterType::FloatArray;
+        }
+
+        void DeclareImageArray(const std::string& name)
+        {
+            m_parameters[name].type = ParameterType::ImageArray;
+        }
+
+        void DeclareString(const std::string& name, const std::string& value)
+        {
+            Parameter& parameter = m_parameters[name];
+            parameter.type = ParameterType::String;
+            parameter.string = value;
+        }
+
+        float GetFloat(const std::string& name, int index = 0) const
+        {
+            return m_parameters.at(name).values[index];
+        }
+
+        const float* GetFloats(const std::string& name) const
+        {
+            return m_parameters.at(name).values;
+        }
+
+        rif_uint GetUint(const std::string& name) const
+        {
+            return m_parameters.at(name).uintValue;
+        }
+
+        Image* GetImage(const std::string& name) const
+        {
+            return m_parameters.at(name).image;
+        }
+
+        const std::string& GetString(const std::string& name) const
+        {
+            return m_parameters.at(name).string;
+        }
+
+        const std::vector<float>& GetFloatArray(const std::string& name) const
+        {
+            return m_parameters.at(name).floatArray;
+        }
+
+        const std::vector<Image*>& GetImageArray(const std::string& name) const
+        {
+            return m_parameters.at(name).imageArray;
+        }
+
+    private:
+        Parameter* Find(const std::string& name)
+        {
+            auto it = m_parameters.find(name);
+            return it == m_parameters.end() ? nullptr : &it->second;
+        }
+
+        rif_int SetFloats(const std::string& name, const float* values, rif_uint count)
+        {
+            Parameter* parameter = Find(name);
+            if (!parameter)
+            {
+                return RIF_ERROR_INVALID_FILTER_ARGUMENT_NAME;
+            }
+            if (parameter->type == ParameterType::Uint && count == 1)
+            {
+                parameter->uintValue = static_cast<rif_uint>(values[0]);
+                return RIF_SUCCESS;
+            }
+            if (parameter->type != ParameterType::Float)
+            {
+                return RIF_ERROR_INVALID_PARAMETER_TYPE;
+            }
+            std::copy(values, values + count, parameter->values);
+            return RIF_SUCCESS;
+        }
+
+        rif_image_filter_type m_type;
+        rif_compute_type m_computeType = RIF_COMPUTE_TYPE_FLOAT;
+        std::map<std::string, Parameter> m_parameters;
+    };
+
+    // Filter computing each output pixel from the input pixel at the same position only.
+    // Rows are converted to float RGBA, passed to ProcessRow and converted back, so the
+    // derived class sees one layout whatever the image formats are.
+    class PixelFilter : public Filter
+    {
+    public:
+        explicit PixelFilter(rif_image_filter_type type)
+            : Filter(type)
+        {   }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            rif_int status = Prepare(input, output);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+
+            const size_t width = output.Width();
+            pool.ParallelForRows(output.Height(), [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(width * 4);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(y, 0, width, row.data(), 4);
+                    ProcessRow(y, row.data(), width);
+                    output.StoreRow(y, 0, width, row.data(), 4);
+                }
+            });
+            return RIF_SUCCESS;
+        }
+
+    protected:
+        // validates the parameters once before the rows are dispatched
+        virtual rif_int Prepare(const Image& input, const Image& output)
+        {
+            (void)input;
+            (void)output;
+            return RIF_SUCCESS;
+        }
+
+        // 'rgba' - 'width' pixels of row 'y', processed in place
+        virtual void ProcessRow(size_t y, float* rgba, size_t width) const = 0;
+    };
+}
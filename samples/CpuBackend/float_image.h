@@ -0,0 +1,141 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "image.h"
+#include "thread_pool.h"
+
+#include <vector>
+
+namespace CpuBackend
+{
+    // maps 'i' into [0, n) following a RIF_READ_MODE_*; DEFAULT behaves as CLAMP
+    inline long BorderIndex(long i, long n, rif_uint mode)
+    {
+        if (i >= 0 && i < n)
+        {
+            return i;
+        }
+        switch (mode)
+        {
+        case RIF_READ_MODE_WRAP:
+            i %= n;
+            return i < 0 ? i + n : i;
+        case RIF_READ_MODE_MIRROR:
+        {
+            // reflect without repeating the edge sample: -1 -> 1, n -> n - 2
+            if (n == 1)
+            {
+                return 0;
+            }
+            const long period = 2 * (n - 1);
+            i %= period;
+            if (i < 0)
+            {
+                i += period;
+            }
+            return i < n ? i : period - i;
+        }
+        default:
+            return i < 0 ? 0 : n - 1;
+        }
+    }
+
+    // Working image of float RGBA pixels. Rows hold 4 * width floats rounded up to 16 so
+    // kernels can run whole vectors to the end of a row; the slack is never read back.
+    class FloatImage
+    {
+    public:
+        static const size_t RowAlignment = 16;
+
+        FloatImage() = default;
+
+        FloatImage(size_t width, size_t height)
+        {
+            Resize(width, height);
+        }
+
+        void Resize(size_t width, size_t height)
+        {
+            m_width = width;
+            m_height = height;
+            m_pitch = (width * 4 + RowAlignment - 1) / RowAlignment * RowAlignment;
+            m_data.assign(m_pitch * height + RowAlignment, 0.0f);
+        }
+
+        size_t Width() const
+        {
+            return m_width;
+        }
+
+        size_t Height() const
+        {
+            return m_height;
+        }
+
+        // floats between rows
+        size_t Pitch() const
+        {
+            return m_pitch;
+        }
+
+        float* Row(size_t y)
+        {
+            return m_data.data() + y * m_pitch;
+        }
+
+        const float* Row(size_t y) const
+        {
+            return m_data.data() + y * m_pitch;
+        }
+
+        void Load(ThreadPool& pool, const Image& image)
+        {
+            Resize(image.Width(), image.Height());
+            pool.ParallelForRows(m_height, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    image.LoadRow(y, 0, m_width, Row(y), 4);
+                }
+            });
+        }
+
+        void Store(ThreadPool& pool, Image& image) const
+        {
+            pool.ParallelForRows(m_height, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    image.StoreRow(y, 0, m_width, Row(y), 4);
+                }
+            });
+        }
+
+    private:
+        size_t m_width = 0;
+        size_t m_height = 0;
+        size_t m_pitch = 0;
+        std::vector<float> m_data;
+    };
+}
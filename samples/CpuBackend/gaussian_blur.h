@@ -0,0 +1,404 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Separable Gaussian blur on the host.
+//
+// Small kernels use a direct FIR: a horizontal pass per row over a border-extended
+// copy of the row, then a vertical pass in column blocks narrow enough for all the
+// 2 * radius + 1 source rows of a block to stay in L1. Both passes vectorize along the
+// row since RGBA pixels are contiguous.
+//
+// Large kernels use the third-order recursive filter of Young and van Vliet, whose
+// cost does not depend on sigma. Recursions run along rows with the vector lanes
+// spread across neighbouring rows (horizontal pass) or neighbouring columns
+// (vertical pass). CLAMP borders are exact through Triggs-Sdika end conditions;
+// MIRROR and WRAP extend every line by 4 sigma first, so their cost grows slightly
+// with sigma when it is large compared to the image.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <cmath>
+#include <vector>
+
+namespace CpuBackend
+{
+    struct IirCoefficients
+    {
+        float b;
+        float a1, a2, a3;
+        float m[9];     // row-major Triggs-Sdika end condition matrix
+    };
+
+    // Young / van Vliet coefficients for 'sigma', y[n] = b x[n] + a1 y[n-1] + a2 y[n-2] + a3 y[n-3]
+    inline IirCoefficients ComputeIirCoefficients(double sigma)
+    {
+        const double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+        const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+        const double b1 = 2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q;
+        const double b2 = -(1.4281 * q * q + 1.26661 * q * q * q);
+        const double b3 = 0.422205 * q * q * q;
+
+        const double a1 = b1 / b0;
+        const double a2 = b2 / b0;
+        const double a3 = b3 / b0;
+        const double b = 1.0 - (a1 + a2 + a3);
+
+        IirCoefficients c;
+        c.b = static_cast<float>(b);
+        c.a1 = static_cast<float>(a1);
+        c.a2 = static_cast<float>(a2);
+        c.a3 = static_cast<float>(a3);
+
+        // Columns of the end condition matrix: the anti-causal outputs at n = N-1, N, N+1
+        // produced by a unit deviation of one causal state once the input stays at its
+        // edge value. The responses decay geometrically, so running them out for a few
+        // dozen time constants gives the matrix to double precision.
+        const size_t length = static_cast<size_t>(40.0 * q) + 64;
+        std::vector<double> w(length + 3);
+        for (int j = 0; j < 3; ++j)
+        {
+            // w[0..2] are the causal outputs at N-1, N-2, N-3
+            double s1 = j == 0 ? 1.0 : 0.0;
+            double s2 = j == 1 ? 1.0 : 0.0;
+            double s3 = j == 2 ? 1.0 : 0.0;
+            w[0] = s1;
+            for (size_t n = 1; n < length; ++n)
+            {
+                double value = a1 * s1 + a2 * s2 + a3 * s3;
+                s3 = s2;
+                s2 = s1;
+                s1 = value;
+                w[n] = value;
+            }
+
+            double y1 = 0.0, y2 = 0.0, y3 = 0.0;
+            double out[3] = {};
+            for (size_t n = length; n-- > 0;)
+            {
+                double y = b * w[n] + a1 * y1 + a2 * y2 + a3 * y3;
+                y3 = y2;
+                y2 = y1;
+                y1 = y;
+                if (n < 3)
+                {
+                    out[n] = y;
+                }
+            }
+            for (int i = 0; i < 3; ++i)
+            {
+                c.m[i * 3 + j] = static_cast<float>(out[i]);
+            }
+        }
+        return c;
+    }
+
+    namespace GaussianBlurScalar
+    {
+        using simd::Scalar::Float;
+#include "gaussian_blur_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace GaussianBlurSse
+    {
+        using simd::Sse::Float;
+#include "gaussian_blur_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace GaussianBlurAvx2
+    {
+        using simd::Avx2::Float;
+#include "gaussian_blur_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace GaussianBlurNeon
+    {
+        using simd::Neon::Float;
+#include "gaussian_blur_kernels.inl"
+    }
+#endif
+
+    enum class GaussianBlurMethod
+    {
+        Auto,
+        Fir,
+        Iir,
+    };
+
+    struct GaussianBlurSettings
+    {
+        float sigma = 1.0f;
+        int radius = 3;                             // FIR half size
+        rif_uint readMode = RIF_READ_MODE_CLAMP;
+        GaussianBlurMethod method = GaussianBlurMethod::Auto;
+    };
+
+    namespace detail
+    {
+        struct GaussianBlurKernels
+        {
+            int width;
+            void (*firRow)(const float*, float*, size_t, const float*, int);
+            void (*firColumns)(const float* const*, float*, size_t, size_t, const float*, int);
+            void (*iirLines)(float*, size_t, const IirCoefficients&);
+        };
+
+        inline GaussianBlurKernels SelectGaussianBlurKernels(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+            case simd::Level::Avx2:
+                return { GaussianBlurAvx2::Float::Width, GaussianBlurAvx2::FirRow, GaussianBlurAvx2::FirColumns, GaussianBlurAvx2::IirLines };
+            case simd::Level::Sse:
+                return { GaussianBlurSse::Float::Width, GaussianBlurSse::FirRow, GaussianBlurSse::FirColumns, GaussianBlurSse::IirLines };
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return { GaussianBlurNeon::Float::Width, GaussianBlurNeon::FirRow, GaussianBlurNeon::FirColumns, GaussianBlurNeon::IirLines };
+#endif
+            default:
+                return { GaussianBlurScalar::Float::Width, GaussianBlurScalar::FirRow, GaussianBlurScalar::FirColumns, GaussianBlurScalar::IirLines };
+            }
+        }
+
+        // weights[0..radius] of a normalized Gaussian truncated at 'radius'
+        inline std::vector<float> GaussianWeights(float sigma, int radius)
+        {
+            std::vector<double> weights(radius + 1);
+            double sum = 0.0;
+            for (int k = 0; k <= radius; ++k)
+            {
+                weights[k] = std::exp(-0.5 * k * k / (double(sigma) * sigma));
+                sum += k == 0 ? weights[k] : 2.0 * weights[k];
+            }
+            std::vector<float> result(radius + 1);
+            for (int k = 0; k <= radius; ++k)
+            {
+                result[k] = static_cast<float>(weights[k] / sum);
+            }
+            return result;
+        }
+
+        inline void FirBlur(ThreadPool& pool, const FloatImage& src, FloatImage& dst, const GaussianBlurSettings& settings,
+            const GaussianBlurKernels& kernels)
+        {
+            const long width = static_cast<long>(src.Width());
+            const long height = static_cast<long>(src.Height());
+            const int radius = settings.radius;
+            const std::vector<float> weights = GaussianWeights(settings.sigma, radius);
+            const size_t count = (width * 4 + kernels.width - 1) / kernels.width * kernels.width;
+
+            FloatImage horizontal(width, height);
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                std::vector<float> padded((width + 2 * radius) * 4 + 2 * kernels.width);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const float* row = src.Row(y);
+                    for (long x = -radius; x < width + radius; ++x)
+                    {
+                        const float* pixel = row + 4 * BorderIndex(x, width, settings.readMode);
+                        std::copy(pixel, pixel + 4, &padded[(x + radius) * 4]);
+                    }
+                    kernels.firRow(&padded[radius * 4], horizontal.Row(y), count, weights.data(), radius);
+                }
+            });
+
+            // column blocks keep the 2 * radius + 1 rows of a block in L1 while the
+            // output rows of a band are produced
+            const size_t block = 256;
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                std::vector<const float*> rows(2 * radius + 1);
+                for (size_t x0 = 0; x0 < count; x0 += block)
+                {
+                    const size_t x1 = std::min(count, x0 + block);
+                    for (size_t y = begin; y < end; ++y)
+                    {
+                        for (int k = -radius; k <= radius; ++k)
+                        {
+                            rows[k + radius] = horizontal.Row(BorderIndex(long(y) + k, height, settings.readMode));
+                        }
+                        kernels.firColumns(rows.data(), dst.Row(y), x0, x1, weights.data(), radius);
+                    }
+                }
+            });
+        }
+
+        inline void IirBlur(ThreadPool& pool, const FloatImage& src, FloatImage& dst, const GaussianBlurSettings& settings,
+            const GaussianBlurKernels& kernels)
+        {
+            const long width = static_cast<long>(src.Width());
+            const long height = static_cast<long>(src.Height());
+            const IirCoefficients coefficients = ComputeIirCoefficients(settings.sigma);
+
+            // CLAMP is handled exactly by the end conditions; the other modes need the
+            // extension materialized, and every line needs a few samples for the start-up
+            auto extension = [&](long length)
+            {
+                long pad = settings.readMode == RIF_READ_MODE_MIRROR || settings.readMode == RIF_READ_MODE_WRAP ?
+                    static_cast<long>(std::ceil(4.0f * settings.sigma)) : 0;
+                return std::max(pad, 4 - length);
+            };
+
+            const size_t step = size_t(GaussianBlurScalar::IirLanes) * kernels.width;
+
+            // horizontal: one vector lane group per row, step / 4 rows per line group
+            FloatImage horizontal(width, height);
+            const long padX = extension(width);
+            const size_t rowsPerGroup = step / 4;
+            const size_t groups = (height + rowsPerGroup - 1) / rowsPerGroup;
+            pool.ParallelFor(groups, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> line((width + 2 * padX) * step);
+                for (size_t g = begin; g < end; ++g)
+                {
+                    const size_t y0 = g * rowsPerGroup;
+                    for (long x = -padX; x < width + padX; ++x)
+                    {
+                        const long sx = BorderIndex(x, width, settings.readMode);
+                        float* sample = &line[(x + padX) * step];
+                        for (size_t r = 0; r < rowsPerGroup; ++r)
+                        {
+                            const float* pixel = src.Row(std::min<size_t>(y0 + r, height - 1)) + 4 * sx;
+                            std::copy(pixel, pixel + 4, sample + r * 4);
+                        }
+                    }
+
+                    kernels.iirLines(line.data(), width + 2 * padX, coefficients);
+
+                    for (size_t r = 0; r < rowsPerGroup && y0 + r < size_t(height); ++r)
+                    {
+                        float* row = horizontal.Row(y0 + r);
+                        for (long x = 0; x < width; ++x)
+                        {
+                            const float* sample = &line[(x + padX) * step + r * 4];
+                            std::copy(sample, sample + 4, row + 4 * x);
+                        }
+                    }
+                }
+            });
+
+            // vertical: lanes across neighbouring columns, one column block per line
+            const long padY = extension(height);
+            const size_t floats = width * 4;
+            const size_t blocks = (floats + step - 1) / step;
+            pool.ParallelFor(blocks, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> line((height + 2 * padY) * step);
+                for (size_t b = begin; b < end; ++b)
+                {
+                    const size_t x0 = b * step;
+                    const size_t used = std::min(step, floats - x0);
+                    for (long y = -padY; y < height + padY; ++y)
+                    {
+                        const float* src = horizontal.Row(BorderIndex(y, height, settings.readMode)) + x0;
+                        std::copy(src, src + used, &line[(y + padY) * step]);
+                    }
+
+                    kernels.iirLines(line.data(), height + 2 * padY, coefficients);
+
+                    for (long y = 0; y < height; ++y)
+                    {
+                        const float* sample = &line[(y + padY) * step];
+                        std::copy(sample, sample + used, dst.Row(y) + x0);
+                    }
+                }
+            });
+        }
+    }
+
+    // blurs 'src' into 'dst' (resized to match), channels independently
+    inline void GaussianBlur(ThreadPool& pool, const FloatImage& src, FloatImage& dst, GaussianBlurSettings settings,
+        simd::Level level = simd::CurrentLevel())
+    {
+        dst.Resize(src.Width(), src.Height());
+        settings.sigma = std::max(settings.sigma, 0.1f);
+        settings.radius = std::max(settings.radius, 0);
+
+        if (settings.method == GaussianBlurMethod::Auto)
+        {
+            // past this radius the FIR costs more than the recursion; only switch when the
+            // requested kernel is wide enough that its truncation does not show
+            const int firMaxRadius = 12;
+            const bool untruncated = settings.radius >= 3.0f * settings.sigma;
+            settings.method = settings.radius > firMaxRadius && untruncated ? GaussianBlurMethod::Iir : GaussianBlurMethod::Fir;
+        }
+
+        const detail::GaussianBlurKernels kernels = detail::SelectGaussianBlurKernels(level);
+        if (settings.method == GaussianBlurMethod::Iir)
+        {
+            detail::IirBlur(pool, src, dst, settings, kernels);
+        }
+        else
+        {
+            detail::FirBlur(pool, src, dst, settings, kernels);
+        }
+    }
+
+    // RIF_IMAGE_FILTER_GAUSSIAN_BLUR
+    // "radius" - kernel half size, "sigma" - standard deviation (radius / 3 when 0),
+    // "readMode" - RIF_READ_MODE_* at the borders, "blurMode" - 0 auto, 1 FIR, 2 recursive
+    class GaussianBlurFilter : public Filter
+    {
+    public:
+        GaussianBlurFilter()
+            : Filter(RIF_IMAGE_FILTER_GAUSSIAN_BLUR)
+        {
+            DeclareUint("radius", 1);
+            DeclareFloat("sigma", 0.0f);
+            DeclareUint("readMode", RIF_READ_MODE_CLAMP);
+            DeclareUint("blurMode", 0);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            GaussianBlurSettings settings;
+            settings.radius = static_cast<int>(GetUint("radius"));
+            settings.sigma = GetFloat("sigma") > 0.0f ? GetFloat("sigma") : std::max(settings.radius / 3.0f, 0.1f);
+            settings.readMode = GetUint("readMode");
+            settings.method = static_cast<GaussianBlurMethod>(std::min(GetUint("blurMode"), 2u));
+
+            FloatImage src;
+            FloatImage dst;
+            src.Load(pool, input);
+            GaussianBlur(pool, src, dst, settings);
+            dst.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+    };
+}
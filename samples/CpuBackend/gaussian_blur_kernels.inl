@@ -0,0 +1,129 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Gaussian blur inner loops, included by gaussian_blur.h once per instruction set
+// with 'Float' naming that set's vector type. No includes here on purpose.
+
+// Horizontal FIR over one row of RGBA floats. 'in' points at pixel 0 of a row that is
+// valid for 'radius' pixels on both sides; 'count' floats are written, rounded up to
+// whole vectors.
+inline void FirRow(const float* in, float* out, size_t count, const float* weights, int radius)
+{
+    const Float w0 = Float::Set1(weights[0]);
+    for (size_t i = 0; i < count; i += Float::Width)
+    {
+        Float acc = Float::Load(in + i) * w0;
+        for (int k = 1; k <= radius; ++k)
+        {
+            // symmetric taps share one multiply
+            Float pair = Float::Load(in + i + 4 * k) + Float::Load(in + i - 4 * k);
+            acc = MulAdd(pair, Float::Set1(weights[k]), acc);
+        }
+        acc.Store(out + i);
+    }
+}
+
+// Vertical FIR for floats [begin, end) of one output row; rows[radius + k] is the input
+// row at offset k.
+inline void FirColumns(const float* const* rows, float* out, size_t begin, size_t end, const float* weights, int radius)
+{
+    const Float w0 = Float::Set1(weights[0]);
+    for (size_t i = begin; i < end; i += Float::Width)
+    {
+        Float acc = Float::Load(rows[radius] + i) * w0;
+        for (int k = 1; k <= radius; ++k)
+        {
+            Float pair = Float::Load(rows[radius + k] + i) + Float::Load(rows[radius - k] + i);
+            acc = MulAdd(pair, Float::Set1(weights[k]), acc);
+        }
+        acc.Store(out + i);
+    }
+}
+
+// Causal plus anti-causal third-order recursion, in place, over 'count' samples of
+// IirLanes vectors each (samples are IirLanes * Float::Width floats apart). The ends
+// are initialized as if the signal continued with its edge value, which is exact for
+// clamped borders (Triggs and Sdika).
+const int IirLanes = 4;
+
+inline void IirLines(float* data, size_t count, const IirCoefficients& c)
+{
+    const size_t step = IirLanes * Float::Width;
+    const Float b = Float::Set1(c.b);
+    const Float a1 = Float::Set1(c.a1);
+    const Float a2 = Float::Set1(c.a2);
+    const Float a3 = Float::Set1(c.a3);
+
+    Float edge[IirLanes];
+    Float w1[IirLanes], w2[IirLanes], w3[IirLanes];
+    for (int l = 0; l < IirLanes; ++l)
+    {
+        edge[l] = Float::Load(data + (count - 1) * step + l * Float::Width);
+        w1[l] = w2[l] = w3[l] = Float::Load(data + l * Float::Width);
+    }
+
+    // the lanes are independent, interleaving them hides the latency of the recursion
+    float* p = data;
+    for (size_t n = 0; n < count; ++n, p += step)
+    {
+        for (int l = 0; l < IirLanes; ++l)
+        {
+            Float x = Float::Load(p + l * Float::Width);
+            Float w = MulAdd(b, x, MulAdd(a1, w1[l], MulAdd(a2, w2[l], a3 * w3[l])));
+            w.Store(p + l * Float::Width);
+            w3[l] = w2[l];
+            w2[l] = w1[l];
+            w1[l] = w;
+        }
+    }
+
+    Float y1[IirLanes], y2[IirLanes], y3[IirLanes];
+    for (int l = 0; l < IirLanes; ++l)
+    {
+        // w1..w3 hold the last three causal outputs
+        Float d0 = w1[l] - edge[l];
+        Float d1 = w2[l] - edge[l];
+        Float d2 = w3[l] - edge[l];
+        Float last = MulAdd(Float::Set1(c.m[0]), d0, MulAdd(Float::Set1(c.m[1]), d1, MulAdd(Float::Set1(c.m[2]), d2, edge[l])));
+        Float next = MulAdd(Float::Set1(c.m[3]), d0, MulAdd(Float::Set1(c.m[4]), d1, MulAdd(Float::Set1(c.m[5]), d2, edge[l])));
+        Float next2 = MulAdd(Float::Set1(c.m[6]), d0, MulAdd(Float::Set1(c.m[7]), d1, MulAdd(Float::Set1(c.m[8]), d2, edge[l])));
+        last.Store(data + (count - 1) * step + l * Float::Width);
+        y1[l] = last;
+        y2[l] = next;
+        y3[l] = next2;
+    }
+
+    p = data + (count - 1) * step;
+    for (size_t n = count - 1; n-- > 0;)
+    {
+        p -= step;
+        for (int l = 0; l < IirLanes; ++l)
+        {
+            Float w = Float::Load(p + l * Float::Width);
+            Float y = MulAdd(b, w, MulAdd(a1, y1[l], MulAdd(a2, y2[l], a3 * y3[l])));
+            y.Store(p + l * Float::Width);
+            y3[l] = y2[l];
+            y2[l] = y1[l];
+            y1[l] = y;
+        }
+    }
+}
@@ -0,0 +1,285 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+#include "Half/half.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace CpuBackend
+{
+    // common base of everything ObjectDelete accepts
+    class Object
+    {
+    public:
+        virtual ~Object() = default;
+    };
+
+    inline size_t ComponentSize(rif_component_type type)
+    {
+        switch (type)
+        {
+        case RIF_COMPONENT_TYPE_UINT8:
+            return 1;
+        case RIF_COMPONENT_TYPE_FLOAT16:
+            return 2;
+        case RIF_COMPONENT_TYPE_FLOAT32:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    // Host image. Rows are padded to 64 bytes so every row starts on a cache line and
+    // vector loads never straddle rows; Map returns the storage itself, no copy.
+    class Image : public Object
+    {
+    public:
+        static const size_t Alignment = 64;
+
+        // 'data' - optional initial pixels, tightly packed unless desc.image_row_pitch is set
+        Image(const rif_image_desc& desc, const void* data)
+            : m_desc(desc)
+        {
+            const size_t pixelSize = PixelSize();
+            const size_t packedPitch = size_t(m_desc.image_width) * pixelSize;
+            m_pitch = (packedPitch + Alignment - 1) / Alignment * Alignment;
+
+            const size_t sourcePitch = m_desc.image_row_pitch ? m_desc.image_row_pitch : packedPitch;
+            m_desc.image_row_pitch = static_cast<rif_uint>(m_pitch);
+            m_desc.image_slice_pitch = static_cast<rif_uint>(m_pitch * m_desc.image_height);
+
+            m_storage.resize(m_pitch * m_desc.image_height + Alignment);
+            m_data = AlignedBase();
+
+            if (data)
+            {
+                for (rif_uint y = 0; y < m_desc.image_height; ++y)
+                {
+                    memcpy(Row(y), static_cast<const rif_uchar*>(data) + y * sourcePitch, packedPitch);
+                }
+            }
+        }
+
+        const rif_image_desc& Desc() const
+        {
+            return m_desc;
+        }
+
+        rif_uint Width() const
+        {
+            return m_desc.image_width;
+        }
+
+        rif_uint Height() const
+        {
+            return m_desc.image_height;
+        }
+
+        rif_uint Components() const
+        {
+            return m_desc.num_components;
+        }
+
+        rif_component_type Type() const
+        {
+            return m_desc.type;
+        }
+
+        size_t PixelSize() const
+        {
+            return ComponentSize(m_desc.type) * m_desc.num_components;
+        }
+
+        // bytes between rows
+        size_t Pitch() const
+        {
+            return m_pitch;
+        }
+
+        size_t SizeInBytes() const
+        {
+            return m_pitch * m_desc.image_height;
+        }
+
+        rif_uchar* Row(size_t y)
+        {
+            return m_data + y * m_pitch;
+        }
+
+        const rif_uchar* Row(size_t y) const
+        {
+            return m_data + y * m_pitch;
+        }
+
+        template <typename T> T* RowAs(size_t y)
+        {
+            return reinterpret_cast<T*>(Row(y));
+        }
+
+        template <typename T> const T* RowAs(size_t y) const
+        {
+            return reinterpret_cast<const T*>(Row(y));
+        }
+
+        // zero-copy: both directions hand out the image storage
+        rif_int Map(rif_image_map_type, void** data)
+        {
+            if (!data)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            *data = m_data;
+            return RIF_SUCCESS;
+        }
+
+        rif_int Unmap(void* data)
+        {
+            return data == m_data ? RIF_SUCCESS : RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        // converts 'count' pixels of row 'y' starting at 'x' to float, 'components' values per pixel;
+        // missing source channels read as 0 (alpha as 1)
+        void LoadRow(size_t y, size_t x, size_t count, float* dst, rif_uint components) const
+        {
+            const size_t first = x * m_desc.num_components;
+            switch (m_desc.type)
+            {
+            case RIF_COMPONENT_TYPE_UINT8:
+                ConvertIn(Row(y) + first, count, dst, components, 1.0f / 255.0f);
+                break;
+            case RIF_COMPONENT_TYPE_FLOAT16:
+                ConvertIn(RowAs<half_float::half>(y) + first, count, dst, components, 1.0f);
+                break;
+            default:
+                ConvertIn(RowAs<float>(y) + first, count, dst, components, 1.0f);
+                break;
+            }
+        }
+
+        // inverse of LoadRow; uint8 output is clamped and rounded
+        void StoreRow(size_t y, size_t x, size_t count, const float* src, rif_uint components)
+        {
+            const size_t first = x * m_desc.num_components;
+            switch (m_desc.type)
+            {
+            case RIF_COMPONENT_TYPE_UINT8:
+                ConvertOut(src, count, components, Row(y) + first);
+                break;
+            case RIF_COMPONENT_TYPE_FLOAT16:
+                ConvertOut(src, count, components, RowAs<half_float::half>(y) + first);
+                break;
+            default:
+                ConvertOut(src, count, components, RowAs<float>(y) + first);
+                break;
+            }
+        }
+
+    private:
+        // float rows with matching components are copied as they are; the overload keeps
+        // the memcpy out of the uchar and half instantiations
+        void ConvertIn(const float* src, size_t count, float* dst, rif_uint components, float scale) const
+        {
+            if (components == m_desc.num_components)
+            {
+                memcpy(dst, src, count * components * sizeof(float));
+                return;
+            }
+            ConvertIn<float>(src, count, dst, components, scale);
+        }
+
+        template <typename T>
+        void ConvertIn(const T* src, size_t count, float* dst, rif_uint components, float scale) const
+        {
+            const rif_uint srcComponents = m_desc.num_components;
+            const rif_uint common = std::min(components, srcComponents);
+            for (size_t i = 0; i < count; ++i, src += srcComponents, dst += components)
+            {
+                rif_uint c = 0;
+                for (; c < common; ++c)
+                {
+                    dst[c] = static_cast<float>(src[c]) * scale;
+                }
+                for (; c < components; ++c)
+                {
+                    dst[c] = c == 3 ? 1.0f : 0.0f;
+                }
+            }
+        }
+
+        static float ToStored(float value, rif_uchar*)
+        {
+            return std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f;
+        }
+
+        static float ToStored(float value, void*)
+        {
+            return value;
+        }
+
+        void ConvertOut(const float* src, size_t count, rif_uint components, float* dst)
+        {
+            if (components == m_desc.num_components)
+            {
+                memcpy(dst, src, count * components * sizeof(float));
+                return;
+            }
+            ConvertOut<float>(src, count, components, dst);
+        }
+
+        template <typename T>
+        void ConvertOut(const float* src, size_t count, rif_uint components, T* dst)
+        {
+            const rif_uint dstComponents = m_desc.num_components;
+            const rif_uint common = std::min(components, dstComponents);
+            for (size_t i = 0; i < count; ++i, src += components, dst += dstComponents)
+            {
+                rif_uint c = 0;
+                for (; c < common; ++c)
+                {
+                    dst[c] = static_cast<T>(ToStored(src[c], dst));
+                }
+                for (; c < dstComponents; ++c)
+                {
+                    dst[c] = static_cast<T>(ToStored(c == 3 ? 1.0f : 0.0f, dst));
+                }
+            }
+        }
+
+        rif_uchar* AlignedBase()
+        {
+            uintptr_t base = reinterpret_cast<uintptr_t>(m_storage.data());
+            return m_storage.data() + ((Alignment - base % Alignment) % Alignment);
+        }
+
+        rif_image_desc m_desc;
+        size_t m_pitch = 0;
+        std::vector<rif_uchar> m_storage;
+        rif_uchar* m_data = nullptr;
+    };
+}
@@ -0,0 +1,134 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// File I/O for host images with the same format rules as ImageTools::LoadImage:
+// jpg and hdr/exr load as float, everything else stb understands as uint8.
+// Like ImageTools.h, include it from the translation unit that defines the stb
+// implementation macros.
+
+#include "cpu_backend.h"
+#include "../ImageTools/ImageTools.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace CpuBackend
+{
+    inline rif_int LoadImage(Context* context, const std::string& path, Image** image)
+    {
+        if (!context || !image)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        std::string ext = path.substr(path.find_last_of(".") + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+        rif_image_desc desc;
+        memset(&desc, 0, sizeof(desc));
+        int width = 0;
+        int height = 0;
+        int num = 0;
+        rif_int status = RIF_SUCCESS;
+
+        if (ext == "exr")
+        {
+            float* data = nullptr;
+            const char* err = nullptr;
+            if (ImageTools::LoadEXRLikeTiny(&data, &width, &height, path.c_str(), &err) != TINYEXR_SUCCESS)
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.num_components = 4;
+            desc.type = RIF_COMPONENT_TYPE_FLOAT32;
+            status = context->CreateImage(&desc, data, image);
+            free(data);
+        }
+        else if (ext == "hdr")
+        {
+            float* data = stbi_loadf(path.c_str(), &width, &height, &num, 0);
+            if (!data)
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.num_components = num;
+            desc.type = RIF_COMPONENT_TYPE_FLOAT32;
+            status = context->CreateImage(&desc, data, image);
+            stbi_image_free(data);
+        }
+        else if (ext == "jpg")
+        {
+            rif_uchar* data = stbi_load(path.c_str(), &width, &height, &num, 3);
+            if (!data)
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+            std::vector<float> pixels(size_t(width) * height * 3);
+            for (size_t i = 0; i < pixels.size(); ++i)
+            {
+                pixels[i] = data[i] / 255.0f;
+            }
+            stbi_image_free(data);
+
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.num_components = 3;
+            desc.type = RIF_COMPONENT_TYPE_FLOAT32;
+            status = context->CreateImage(&desc, pixels.data(), image);
+        }
+        else
+        {
+            rif_uchar* data = stbi_load(path.c_str(), &width, &height, &num, 0);
+            if (!data)
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.num_components = num;
+            desc.type = RIF_COMPONENT_TYPE_UINT8;
+            status = context->CreateImage(&desc, data, image);
+            stbi_image_free(data);
+        }
+        return status;
+    }
+
+    // writes 'image' with ImageTools::SaveImageData, which expects packed rows
+    inline rif_int SaveImage(const Image& image, const std::string& path)
+    {
+        const size_t packedPitch = image.Width() * image.PixelSize();
+        std::vector<rif_uchar> packed(packedPitch * image.Height());
+        for (rif_uint y = 0; y < image.Height(); ++y)
+        {
+            memcpy(&packed[y * packedPitch], image.Row(y), packedPitch);
+        }
+        return ImageTools::SaveImageData(packed.data(), path.c_str(), image.Width(), image.Height(),
+            image.Components(), image.Type());
+    }
+}
@@ -0,0 +1,144 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Full-reference quality of a result against a reference, both float RGBA with colour
+// in [0, 1]: PSNR over the colour channels and SSIM (Wang et al. 2004, 11x11 Gaussian
+// window with sigma 1.5, K1 = 0.01, K2 = 0.03) of the Rec. 709 luminance. Windows are
+// clamped at the image border so any size has a score.
+
+#include "float_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace CpuBackend
+{
+    // infinity for identical images
+    inline double ImagePsnr(const FloatImage& result, const FloatImage& reference)
+    {
+        double sum = 0.0;
+        for (size_t y = 0; y < reference.Height(); ++y)
+        {
+            for (size_t x = 0; x < reference.Width(); ++x)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const double d = double(result.Row(y)[x * 4 + c]) - reference.Row(y)[x * 4 + c];
+                    sum += d * d;
+                }
+            }
+        }
+        const double mse = sum / (3.0 * reference.Width() * reference.Height());
+        return mse > 0.0 ? -10.0 * std::log10(mse) : std::numeric_limits<double>::infinity();
+    }
+
+    namespace detail
+    {
+        // 'plane' blurred by the SSIM window, in place
+        inline void SsimWindow(std::vector<double>& plane, long width, long height)
+        {
+            const int radius = 5;
+            double weights[2 * radius + 1];
+            double total = 0.0;
+            for (int k = -radius; k <= radius; ++k)
+            {
+                weights[k + radius] = std::exp(-0.5 * k * k / (1.5 * 1.5));
+                total += weights[k + radius];
+            }
+
+            std::vector<double> line(std::max(width, height));
+            for (long y = 0; y < height; ++y)
+            {
+                for (long x = 0; x < width; ++x)
+                {
+                    double sum = 0.0;
+                    for (int k = -radius; k <= radius; ++k)
+                    {
+                        sum += weights[k + radius] * plane[y * width + std::min(std::max(x + k, 0L), width - 1)];
+                    }
+                    line[x] = sum / total;
+                }
+                std::copy(line.begin(), line.begin() + width, plane.begin() + y * width);
+            }
+            for (long x = 0; x < width; ++x)
+            {
+                for (long y = 0; y < height; ++y)
+                {
+                    double sum = 0.0;
+                    for (int k = -radius; k <= radius; ++k)
+                    {
+                        sum += weights[k + radius] * plane[std::min(std::max(y + k, 0L), height - 1) * width + x];
+                    }
+                    line[y] = sum / total;
+                }
+                for (long y = 0; y < height; ++y)
+                {
+                    plane[y * width + x] = line[y];
+                }
+            }
+        }
+    }
+
+    // 1 for identical images
+    inline double ImageSsim(const FloatImage& result, const FloatImage& reference)
+    {
+        const long width = long(reference.Width());
+        const long height = long(reference.Height());
+        const size_t size = size_t(width * height);
+        std::vector<double> a(size), b(size), aa(size), bb(size), ab(size);
+        for (long y = 0; y < height; ++y)
+        {
+            for (long x = 0; x < width; ++x)
+            {
+                const float* p = result.Row(y) + x * 4;
+                const float* q = reference.Row(y) + x * 4;
+                const size_t i = size_t(y * width + x);
+                a[i] = 0.2126 * p[0] + 0.7152 * p[1] + 0.0722 * p[2];
+                b[i] = 0.2126 * q[0] + 0.7152 * q[1] + 0.0722 * q[2];
+                aa[i] = a[i] * a[i];
+                bb[i] = b[i] * b[i];
+                ab[i] = a[i] * b[i];
+            }
+        }
+        for (std::vector<double>* plane : { &a, &b, &aa, &bb, &ab })
+        {
+            detail::SsimWindow(*plane, width, height);
+        }
+
+        const double c1 = 0.01 * 0.01;
+        const double c2 = 0.03 * 0.03;
+        double sum = 0.0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double varianceA = aa[i] - a[i] * a[i];
+            const double varianceB = bb[i] - b[i] * b[i];
+            const double covariance = ab[i] - a[i] * b[i];
+            sum += (2.0 * a[i] * b[i] + c1) * (2.0 * covariance + c2) /
+                ((a[i] * a[i] + b[i] * b[i] + c1) * (varianceA + varianceB + c2));
+        }
+        return sum / double(size);
+    }
+}
@@ -0,0 +1,375 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Whole-image statistics on the host: per channel minimum, maximum and mean, the
+// same for the luminance, its log average and a luminance histogram.
+//
+// The reduction is hierarchical. A row is reduced in chunks of StatisticsChunk pixels
+// held in float vectors, chunk sums are added in double to the partial of a band of
+// StatisticsBandRows rows, bands are reduced in parallel and their partials are merged
+// pairwise in a tree. The band split does not depend on the thread count, so the
+// results are the same however many threads run.
+//
+// ImageStatisticsFilter returns the statistics in a small image, so consumers such as
+// auto-exposure only read back a few pixels instead of the whole frame.
+
+#include "filter.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// rif_image_filter_type extension only understood by the host backend
+#ifndef RIF_IMAGE_FILTER_IMAGE_STATISTICS
+#define RIF_IMAGE_FILTER_IMAGE_STATISTICS 0x1000u
+#endif
+
+namespace CpuBackend
+{
+    const size_t StatisticsChunk = 64;
+    const size_t StatisticsBandRows = 16;
+
+    struct StatisticsConstants
+    {
+        float logDelta;
+        bool logHistogram;
+        float histogramMin;
+        float histogramScale;   // bins per unit
+        int bins;
+    };
+
+    // channels 0-3 and the luminance (4); sum[5] holds the log luminance
+    struct StatisticsPartial
+    {
+        float min[5];
+        float max[5];
+        double sum[6];
+        uint64_t count;
+
+        StatisticsPartial()
+            : count(0)
+        {
+            std::fill(min, min + 5, std::numeric_limits<float>::max());
+            std::fill(max, max + 5, -std::numeric_limits<float>::max());
+            std::fill(sum, sum + 6, 0.0);
+        }
+
+        void Merge(const StatisticsPartial& other)
+        {
+            for (int k = 0; k < 5; ++k)
+            {
+                min[k] = std::min(min[k], other.min[k]);
+                max[k] = std::max(max[k], other.max[k]);
+            }
+            for (int k = 0; k < 6; ++k)
+            {
+                sum[k] += other.sum[k];
+            }
+            count += other.count;
+        }
+    };
+
+    namespace StatisticsScalar
+    {
+        using simd::Scalar::Float;
+#include "statistics_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace StatisticsSse
+    {
+        using simd::Sse::Float;
+#include "statistics_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace StatisticsAvx2
+    {
+        using simd::Avx2::Float;
+#include "statistics_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace StatisticsAvx512
+    {
+        using simd::Avx512::Float;
+#include "statistics_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace StatisticsNeon
+    {
+        using simd::Neon::Float;
+#include "statistics_kernels.inl"
+    }
+#endif
+
+    struct StatisticsSettings
+    {
+        int bins = 64;
+        bool logHistogram = true;       // bins over log2(luminance + logDelta), else over the luminance
+        float histogramMin = -16.0f;
+        float histogramMax = 16.0f;
+        float logDelta = 1e-4f;         // keeps the log of black pixels finite
+    };
+
+    struct ImageStatistics
+    {
+        float min[4] = {};
+        float max[4] = {};
+        float mean[4] = {};
+        float minLuminance = 0.0f;
+        float maxLuminance = 0.0f;
+        float meanLuminance = 0.0f;
+        float logAverageLuminance = 0.0f;   // exp(mean(ln(luminance + logDelta)))
+        std::vector<uint32_t> histogram;    // values outside the range fall in the end bins
+    };
+
+    namespace detail
+    {
+        typedef void (*StatisticsRowFunction)(const float* rgba, size_t pixels, const StatisticsConstants& c,
+            StatisticsPartial& partial, uint32_t* histogram);
+
+        inline StatisticsRowFunction SelectStatisticsRow(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return StatisticsAvx512::StatisticsRow;
+            case simd::Level::Avx2:
+                return StatisticsAvx2::StatisticsRow;
+            case simd::Level::Sse:
+                return StatisticsSse::StatisticsRow;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return StatisticsNeon::StatisticsRow;
+#endif
+            default:
+                return StatisticsScalar::StatisticsRow;
+            }
+        }
+    }
+
+    inline ImageStatistics ComputeImageStatistics(ThreadPool& pool, const Image& image, const StatisticsSettings& settings = StatisticsSettings(),
+        simd::Level level = simd::CurrentLevel())
+    {
+        const size_t width = image.Width();
+        const size_t height = image.Height();
+        const int bins = std::max(1, settings.bins);
+        const float range = settings.histogramMax - settings.histogramMin;
+
+        StatisticsConstants constants;
+        constants.logDelta = settings.logDelta;
+        constants.logHistogram = settings.logHistogram;
+        constants.histogramMin = settings.histogramMin;
+        constants.histogramScale = range > 0.0f ? bins / range : 0.0f;
+        constants.bins = bins;
+
+        const detail::StatisticsRowFunction reduceRow = detail::SelectStatisticsRow(level);
+        const bool direct = image.Type() == RIF_COMPONENT_TYPE_FLOAT32 && image.Components() == 4;
+        const size_t bands = std::max<size_t>(1, (height + StatisticsBandRows - 1) / StatisticsBandRows);
+        std::vector<StatisticsPartial> partials(bands);
+        std::vector<uint32_t> histograms(bands * bins, 0);
+
+        pool.ParallelFor(bands, 1, [&](size_t begin, size_t end)
+        {
+            std::vector<float> row(direct ? 0 : width * 4);
+            for (size_t band = begin; band < end; ++band)
+            {
+                for (size_t y = band * StatisticsBandRows; y < std::min(height, (band + 1) * StatisticsBandRows); ++y)
+                {
+                    const float* src = image.RowAs<float>(y);
+                    if (!direct)
+                    {
+                        image.LoadRow(y, 0, width, row.data(), 4);
+                        src = row.data();
+                    }
+                    reduceRow(src, width, constants, partials[band], &histograms[band * bins]);
+                }
+            }
+        });
+
+        // pairwise tree over the bands, each level merged in parallel
+        for (size_t step = 1; step < bands; step *= 2)
+        {
+            const size_t pairs = (bands + 2 * step - 1) / (2 * step);
+            pool.ParallelFor(pairs, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t pair = begin; pair < end; ++pair)
+                {
+                    const size_t target = pair * 2 * step;
+                    const size_t source = target + step;
+                    if (source >= bands)
+                    {
+                        continue;
+                    }
+                    partials[target].Merge(partials[source]);
+                    for (int b = 0; b < bins; ++b)
+                    {
+                        histograms[target * bins + b] += histograms[source * bins + b];
+                    }
+                }
+            });
+        }
+
+        const StatisticsPartial& total = partials[0];
+        ImageStatistics result;
+        if (total.count == 0)
+        {
+            result.histogram.assign(bins, 0);
+            return result;
+        }
+        const double count = static_cast<double>(total.count);
+        for (int k = 0; k < 4; ++k)
+        {
+            result.min[k] = total.min[k];
+            result.max[k] = total.max[k];
+            result.mean[k] = static_cast<float>(total.sum[k] / count);
+        }
+        result.minLuminance = total.min[4];
+        result.maxLuminance = total.max[4];
+        result.meanLuminance = static_cast<float>(total.sum[4] / count);
+        result.logAverageLuminance = static_cast<float>(std::exp(total.sum[5] / count));
+        result.histogram.assign(histograms.begin(), histograms.begin() + bins);
+        return result;
+    }
+
+    // RIF_IMAGE_FILTER_IMAGE_STATISTICS
+    // The output is a float32 RGBA image at least 4 x 2 pixels. Row 0 holds the minimum,
+    // maximum and mean of every channel in pixels 0-2 and the luminance minimum, maximum,
+    // mean and log average in pixel 3. Row 1 holds one histogram bin per pixel, as many as
+    // the output is wide: the count, the fraction of pixels and the cumulative fraction.
+    // "logHistogram" - bins over log2 luminance (1) or luminance (0), "histogramMin",
+    // "histogramMax" - range of the bins
+    class ImageStatisticsFilter : public Filter
+    {
+    public:
+        ImageStatisticsFilter()
+            : Filter(RIF_IMAGE_FILTER_IMAGE_STATISTICS)
+        {
+            const StatisticsSettings defaults;
+            DeclareUint("logHistogram", defaults.logHistogram ? 1 : 0);
+            DeclareFloat("histogramMin", defaults.histogramMin);
+            DeclareFloat("histogramMax", defaults.histogramMax);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (output.Type() != RIF_COMPONENT_TYPE_FLOAT32 || output.Components() != 4 || output.Width() < 4 || output.Height() < 2)
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            StatisticsSettings settings;
+            settings.bins = static_cast<int>(output.Width());
+            settings.logHistogram = GetUint("logHistogram") != 0;
+            settings.histogramMin = GetFloat("histogramMin");
+            settings.histogramMax = GetFloat("histogramMax");
+            const ImageStatistics statistics = ComputeImageStatistics(pool, input, settings);
+
+            for (size_t y = 0; y < output.Height(); ++y)
+            {
+                memset(output.Row(y), 0, output.Width() * output.PixelSize());
+            }
+            float* summary = output.RowAs<float>(0);
+            std::copy(statistics.min, statistics.min + 4, summary);
+            std::copy(statistics.max, statistics.max + 4, summary + 4);
+            std::copy(statistics.mean, statistics.mean + 4, summary + 8);
+            summary[12] = statistics.minLuminance;
+            summary[13] = statistics.maxLuminance;
+            summary[14] = statistics.meanLuminance;
+            summary[15] = statistics.logAverageLuminance;
+
+            float* bins = output.RowAs<float>(1);
+            const double pixels = std::max<double>(1.0, double(input.Width()) * input.Height());
+            double cumulative = 0.0;
+            for (size_t b = 0; b < statistics.histogram.size(); ++b)
+            {
+                cumulative += statistics.histogram[b];
+                bins[4 * b] = static_cast<float>(statistics.histogram[b]);
+                bins[4 * b + 1] = static_cast<float>(statistics.histogram[b] / pixels);
+                bins[4 * b + 2] = static_cast<float>(cumulative / pixels);
+            }
+            return RIF_SUCCESS;
+        }
+    };
+
+    // RIF_IMAGE_FILTER_NORMALIZATION: every colour channel remapped from its range over
+    // the image to [0, 1]; alpha is kept
+    class NormalizationFilter : public Filter
+    {
+    public:
+        NormalizationFilter()
+            : Filter(RIF_IMAGE_FILTER_NORMALIZATION)
+        {   }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            StatisticsSettings settings;
+            settings.bins = 1;
+            const ImageStatistics statistics = ComputeImageStatistics(pool, input, settings);
+            float offset[3];
+            float scale[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                const float range = statistics.max[c] - statistics.min[c];
+                offset[c] = statistics.min[c];
+                scale[c] = range > 0.0f ? 1.0f / range : 0.0f;
+            }
+
+            const size_t width = input.Width();
+            pool.ParallelForRows(input.Height(), [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(width * 4);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(y, 0, width, row.data(), 4);
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            row[4 * x + c] = (row[4 * x + c] - offset[c]) * scale[c];
+                        }
+                    }
+                    output.StoreRow(y, 0, width, row.data(), 4);
+                }
+            });
+            return RIF_SUCCESS;
+        }
+    };
+}
@@ -0,0 +1,459 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Local weighted regression denoise on the host.
+//
+// Every pixel fits its colour as a linear function of the features normal (3),
+// depth (1) and transition (3) over the square window around it and evaluates the
+// fit at its own features. Samples are weighted by the inverse of their colour
+// variance, and the regression is ridge-regularized by the feature variances, so
+// noisy features are trusted less.
+//
+// The weights do not depend on the centre pixel, which makes the normal equations of
+// a window a plain sum of per-pixel moments (the 8x8 matrix, the three right-hand
+// sides and the noise terms). Tiles keep running column sums of these moments in
+// double precision and slide them along the rows, so building a system costs the
+// same whatever the radius. The systems of a row are then solved Float::Width at a
+// time with a lane-per-pixel Cholesky factorization.
+//
+// Features are centred and scaled over the image first, which keeps the float
+// factorization well conditioned whatever the scene units are.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <cmath>
+#include <vector>
+
+namespace CpuBackend
+{
+    const int LwrFeatures = 8;                                  // intercept, normal, depth, transition
+    const int LwrColorMoment = LwrFeatures * (LwrFeatures + 1) / 2;
+    const int LwrRidgeMoment = LwrColorMoment + 3 * LwrFeatures;
+    const int LwrMoments = 64;                                  // LwrRidgeMoment + 3, padded
+
+    // packed upper triangle, r <= c
+    inline int LwrMatrixIndex(int r, int c)
+    {
+        return r * LwrFeatures - r * (r - 1) / 2 + c - r;
+    }
+
+    // 0 normal, 1 depth, 2 transition
+    inline int LwrFeatureGroup(int feature)
+    {
+        return feature <= 3 ? 0 : (feature == 4 ? 1 : 2);
+    }
+
+    namespace LwrScalar
+    {
+        using simd::Scalar::Float;
+#include "lwr_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace LwrSse
+    {
+        using simd::Sse::Float;
+#include "lwr_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace LwrAvx2
+    {
+        using simd::Avx2::Float;
+#include "lwr_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace LwrNeon
+    {
+        using simd::Neon::Float;
+#include "lwr_kernels.inl"
+    }
+#endif
+
+    // missing images leave their features at zero, or the weights at one
+    struct LwrGuides
+    {
+        const FloatImage* colorVariance = nullptr;
+        const FloatImage* normals = nullptr;
+        const FloatImage* normalsVariance = nullptr;
+        const FloatImage* depth = nullptr;
+        const FloatImage* depthVariance = nullptr;
+        const FloatImage* trans = nullptr;
+        const FloatImage* transVariance = nullptr;
+    };
+
+    struct LwrSettings
+    {
+        int radius = 6;
+        float ridge = 1e-3f;        // added to the diagonal, relative to the total weight
+        long tileSize = 128;
+    };
+
+    // one regression sample: standardized features, weight and feature noise per group
+    struct LwrSample
+    {
+        float x[LwrFeatures];
+        float weight;
+        float noise[3];
+    };
+
+    class LwrFeatureMap
+    {
+    public:
+        LwrFeatureMap(const LwrGuides& guides, long width, long height)
+            : m_guides(guides)
+        {
+            double sum[LwrFeatures] = {};
+            double squares[LwrFeatures] = {};
+            for (long y = 0; y < height; ++y)
+            {
+                for (long x = 0; x < width; ++x)
+                {
+                    float raw[LwrFeatures];
+                    Raw(x, y, raw);
+                    for (int k = 1; k < LwrFeatures; ++k)
+                    {
+                        sum[k] += raw[k];
+                        squares[k] += double(raw[k]) * raw[k];
+                    }
+                }
+            }
+
+            const double count = std::max(1.0, double(width) * height);
+            double groupVariance[3] = {};
+            int groupSize[3] = {};
+            for (int k = 1; k < LwrFeatures; ++k)
+            {
+                m_mean[k] = static_cast<float>(sum[k] / count);
+                groupVariance[LwrFeatureGroup(k)] += std::max(0.0, squares[k] / count - m_mean[k] * double(m_mean[k]));
+                ++groupSize[LwrFeatureGroup(k)];
+            }
+            // one scale per group keeps the normal and transition components comparable
+            for (int g = 0; g < 3; ++g)
+            {
+                const double variance = groupVariance[g] / groupSize[g];
+                m_inverseScale[g] = variance > 1e-12 ? static_cast<float>(1.0 / std::sqrt(variance)) : 1.0f;
+            }
+            m_mean[0] = 0.0f;
+        }
+
+        void Sample(long x, long y, LwrSample& sample) const
+        {
+            Raw(x, y, sample.x);
+            sample.x[0] = 1.0f;
+            for (int k = 1; k < LwrFeatures; ++k)
+            {
+                sample.x[k] = (sample.x[k] - m_mean[k]) * m_inverseScale[LwrFeatureGroup(k)];
+            }
+
+            sample.weight = 1.0f;
+            if (m_guides.colorVariance)
+            {
+                const float* v = m_guides.colorVariance->Row(y) + 4 * x;
+                sample.weight = 1.0f / ((v[0] + v[1] + v[2]) * (1.0f / 3.0f) + 1e-4f);
+            }
+
+            const FloatImage* variances[3] = { m_guides.normalsVariance, m_guides.depthVariance, m_guides.transVariance };
+            for (int g = 0; g < 3; ++g)
+            {
+                sample.noise[g] = 0.0f;
+                if (variances[g])
+                {
+                    const float* v = variances[g]->Row(y) + 4 * x;
+                    const float variance = g == 1 ? v[0] : (v[0] + v[1] + v[2]) * (1.0f / 3.0f);
+                    sample.noise[g] = variance * m_inverseScale[g] * m_inverseScale[g];
+                }
+            }
+        }
+
+    private:
+        void Raw(long x, long y, float* raw) const
+        {
+            std::fill(raw, raw + LwrFeatures, 0.0f);
+            if (m_guides.normals)
+            {
+                const float* n = m_guides.normals->Row(y) + 4 * x;
+                std::copy(n, n + 3, raw + 1);
+            }
+            if (m_guides.depth)
+            {
+                raw[4] = m_guides.depth->Row(y)[4 * x];
+            }
+            if (m_guides.trans)
+            {
+                const float* t = m_guides.trans->Row(y) + 4 * x;
+                std::copy(t, t + 3, raw + 5);
+            }
+        }
+
+        LwrGuides m_guides;
+        float m_mean[LwrFeatures] = {};
+        float m_inverseScale[3] = {};
+    };
+
+    namespace detail
+    {
+        typedef void (*LwrSolveFunction)(const float*, const float*, size_t, float, size_t, float* const*);
+
+        inline LwrSolveFunction SelectLwrSolve(simd::Level level, int* width)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+            case simd::Level::Avx2:
+                *width = LwrAvx2::Float::Width;
+                return LwrAvx2::LwrSolve;
+            case simd::Level::Sse:
+                *width = LwrSse::Float::Width;
+                return LwrSse::LwrSolve;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                *width = LwrNeon::Float::Width;
+                return LwrNeon::LwrSolve;
+#endif
+            default:
+                *width = LwrScalar::Float::Width;
+                return LwrScalar::LwrSolve;
+            }
+        }
+
+        // adds sign * the moments of pixel (x, y) to 'sums'
+        inline void AddLwrMoments(const LwrFeatureMap& map, const FloatImage& color, long x, long y, double sign, double* sums)
+        {
+            LwrSample sample;
+            map.Sample(x, y, sample);
+            const float w = static_cast<float>(sign) * sample.weight;
+            float wx[LwrFeatures];
+            for (int k = 0; k < LwrFeatures; ++k)
+            {
+                wx[k] = w * sample.x[k];
+            }
+            for (int r = 0; r < LwrFeatures; ++r)
+            {
+                for (int c = r; c < LwrFeatures; ++c)
+                {
+                    sums[LwrMatrixIndex(r, c)] += wx[r] * sample.x[c];
+                }
+            }
+            const float* rgb = color.Row(y) + 4 * x;
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                for (int k = 0; k < LwrFeatures; ++k)
+                {
+                    sums[LwrColorMoment + channel * LwrFeatures + k] += wx[k] * rgb[channel];
+                }
+            }
+            for (int g = 0; g < 3; ++g)
+            {
+                sums[LwrRidgeMoment + g] += w * sample.noise[g];
+            }
+        }
+    }
+
+    inline void LwrDenoise(ThreadPool& pool, const FloatImage& color, const LwrGuides& guides, FloatImage& dst,
+        const LwrSettings& settings, simd::Level level = simd::CurrentLevel())
+    {
+        const long width = static_cast<long>(color.Width());
+        const long height = static_cast<long>(color.Height());
+        const long radius = std::max(1, settings.radius);
+        const long size = std::max(16L, settings.tileSize);
+        dst.Resize(width, height);
+
+        const LwrFeatureMap map(guides, width, height);
+        int vectorWidth = 0;
+        const detail::LwrSolveFunction solve = detail::SelectLwrSolve(level, &vectorWidth);
+
+        const long tilesX = (width + size - 1) / size;
+        const long tilesY = (height + size - 1) / size;
+        pool.ParallelFor(tilesX * tilesY, 1, [&](size_t begin, size_t end)
+        {
+            const long columns = size + 2 * radius;
+            const size_t stride = (size + FloatImage::RowAlignment - 1) / FloatImage::RowAlignment * FloatImage::RowAlignment;
+            std::vector<double> columnSums(columns * LwrMoments);
+            std::vector<float> rowMoments(stride * LwrMoments);
+            std::vector<float> rowFeatures(stride * LwrFeatures);
+            std::vector<float> results(stride * 3);
+            float* out[3] = { results.data(), results.data() + stride, results.data() + 2 * stride };
+
+            for (size_t t = begin; t < end; ++t)
+            {
+                const long x0 = (long(t) % tilesX) * size;
+                const long y0 = (long(t) / tilesX) * size;
+                const long x1 = std::min(width, x0 + size);
+                const long y1 = std::min(height, y0 + size);
+                const long left = x0 - radius;
+
+                // column sums over the rows of the window, kept in double so that
+                // sliding them does not accumulate rounding
+                auto addRow = [&](long y, double sign)
+                {
+                    if (y < 0 || y >= height)
+                    {
+                        return;
+                    }
+                    for (long x = std::max(0L, left); x < std::min(width, x1 + radius); ++x)
+                    {
+                        detail::AddLwrMoments(map, color, x, y, sign, &columnSums[(x - left) * LwrMoments]);
+                    }
+                };
+                std::fill(columnSums.begin(), columnSums.end(), 0.0);
+                for (long y = y0 - radius; y < y0 + radius; ++y)
+                {
+                    addRow(y, 1.0);
+                }
+
+                for (long y = y0; y < y1; ++y)
+                {
+                    addRow(y + radius, 1.0);
+                    if (y > y0)
+                    {
+                        addRow(y - radius - 1, -1.0);
+                    }
+
+                    double window[LwrMoments] = {};
+                    for (long c = 0; c < 2 * radius; ++c)
+                    {
+                        for (int m = 0; m < LwrMoments; ++m)
+                        {
+                            window[m] += columnSums[c * LwrMoments + m];
+                        }
+                    }
+                    for (long x = x0; x < x1; ++x)
+                    {
+                        const double* entering = &columnSums[(x + radius - left) * LwrMoments];
+                        for (int m = 0; m < LwrMoments; ++m)
+                        {
+                            window[m] += entering[m];
+                            rowMoments[m * stride + (x - x0)] = static_cast<float>(window[m]);
+                        }
+                        const double* leaving = &columnSums[(x - radius - left) * LwrMoments];
+                        for (int m = 0; m < LwrMoments; ++m)
+                        {
+                            window[m] -= leaving[m];
+                        }
+
+                        LwrSample sample;
+                        map.Sample(x, y, sample);
+                        for (int k = 0; k < LwrFeatures; ++k)
+                        {
+                            rowFeatures[k * stride + (x - x0)] = sample.x[k];
+                        }
+                    }
+
+                    // lanes past the end of the tile solve whatever is there; it is not used
+                    const size_t count = (x1 - x0 + vectorWidth - 1) / vectorWidth * vectorWidth;
+                    solve(rowMoments.data(), rowFeatures.data(), stride, settings.ridge, count, out);
+
+                    float* row = dst.Row(y);
+                    for (long x = x0; x < x1; ++x)
+                    {
+                        row[4 * x] = out[0][x - x0];
+                        row[4 * x + 1] = out[1][x - x0];
+                        row[4 * x + 2] = out[2][x - x0];
+                        row[4 * x + 3] = color.Row(y)[4 * x + 3];
+                    }
+                }
+            }
+        });
+    }
+
+    // RIF_IMAGE_FILTER_LWR_DENOISE
+    // "vColorImg", "normalsImg", "vNormalsImg", "depthImg", "vDepthImg", "transImg",
+    // "vTransImg" - guides and their variances, "radius" - window half size, "ridge" -
+    // diagonal regularization relative to the total weight
+    class LwrDenoiseFilter : public Filter
+    {
+    public:
+        LwrDenoiseFilter()
+            : Filter(RIF_IMAGE_FILTER_LWR_DENOISE)
+        {
+            const LwrSettings defaults;
+            for (const char* name : Names())
+            {
+                DeclareImage(name);
+            }
+            DeclareUint("radius", defaults.radius);
+            DeclareFloat("ridge", defaults.ridge);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            const std::vector<const char*> names = Names();
+            std::vector<FloatImage> images(names.size());
+            std::vector<const FloatImage*> loaded(names.size(), nullptr);
+            for (size_t i = 0; i < names.size(); ++i)
+            {
+                const Image* guide = GetImage(names[i]);
+                if (!guide)
+                {
+                    continue;
+                }
+                if (guide->Width() != input.Width() || guide->Height() != input.Height())
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+                images[i].Load(pool, *guide);
+                loaded[i] = &images[i];
+            }
+
+            LwrGuides guides;
+            guides.colorVariance = loaded[0];
+            guides.normals = loaded[1];
+            guides.normalsVariance = loaded[2];
+            guides.depth = loaded[3];
+            guides.depthVariance = loaded[4];
+            guides.trans = loaded[5];
+            guides.transVariance = loaded[6];
+
+            LwrSettings settings;
+            settings.radius = static_cast<int>(GetUint("radius"));
+            settings.ridge = GetFloat("ridge");
+
+            FloatImage src;
+            FloatImage dst;
+            src.Load(pool, input);
+            LwrDenoise(pool, src, guides, dst, settings);
+            dst.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+
+    private:
+        static std::vector<const char*> Names()
+        {
+            return { "vColorImg", "normalsImg", "vNormalsImg", "depthImg", "vDepthImg", "transImg", "vTransImg" };
+        }
+    };
+}
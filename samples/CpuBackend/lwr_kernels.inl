@@ -0,0 +1,113 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Batched regression solve of the LWR denoise, included by lwr_filter.h once per
+// instruction set with 'Float' naming that set's vector type. Each lane solves the
+// system of one pixel.
+
+// Solves the normal equations of 'count' pixels (whole vectors) and evaluates the fits
+// at the pixels' own features. 'moments' holds the LwrMoments planes 'stride' floats
+// apart, 'features' the LwrFeatures planes of the centre pixels; the fitted colours go
+// to out[0..2] + i.
+inline void LwrSolve(const float* moments, const float* features, size_t stride, float ridge, size_t count,
+    float* const* out)
+{
+    const int n = LwrFeatures;
+    const Float tiny = Float::Set1(1e-20f);
+    const Float relativeRidge = Float::Set1(ridge);
+
+    for (size_t i = 0; i < count; i += Float::Width)
+    {
+        // lower triangle of the Cholesky factor, overwriting the matrix
+        Float l[LwrFeatures][LwrFeatures];
+        for (int r = 0; r < n; ++r)
+        {
+            for (int c = r; c < n; ++c)
+            {
+                l[c][r] = Float::Load(moments + LwrMatrixIndex(r, c) * stride + i);
+            }
+        }
+
+        // the intercept is not regularized; the others get the measured feature
+        // noise plus a small multiple of the total weight
+        const Float weight = l[0][0];
+        for (int k = 1; k < n; ++k)
+        {
+            const Float noise = Float::Load(moments + (LwrRidgeMoment + LwrFeatureGroup(k)) * stride + i);
+            l[k][k] = l[k][k] + MulAdd(weight, relativeRidge, noise);
+        }
+
+        Float inverseDiagonal[LwrFeatures];
+        for (int c = 0; c < n; ++c)
+        {
+            Float d = l[c][c];
+            for (int k = 0; k < c; ++k)
+            {
+                d = d - l[c][k] * l[c][k];
+            }
+            const Float diagonal = Sqrt(Max(d, tiny));
+            inverseDiagonal[c] = Float::Set1(1.0f) / diagonal;
+            for (int r = c + 1; r < n; ++r)
+            {
+                Float s = l[r][c];
+                for (int k = 0; k < c; ++k)
+                {
+                    s = s - l[r][k] * l[c][k];
+                }
+                l[r][c] = s * inverseDiagonal[c];
+            }
+        }
+
+        Float x[LwrFeatures];
+        for (int k = 0; k < n; ++k)
+        {
+            x[k] = Float::Load(features + k * stride + i);
+        }
+
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            // L z = b, then L^T beta = z
+            Float z[LwrFeatures];
+            for (int r = 0; r < n; ++r)
+            {
+                Float s = Float::Load(moments + (LwrColorMoment + channel * LwrFeatures + r) * stride + i);
+                for (int k = 0; k < r; ++k)
+                {
+                    s = s - l[r][k] * z[k];
+                }
+                z[r] = s * inverseDiagonal[r];
+            }
+            Float result = Float::Zero();
+            for (int r = n - 1; r >= 0; --r)
+            {
+                Float s = z[r];
+                for (int k = r + 1; k < n; ++k)
+                {
+                    s = s - l[k][r] * z[k];
+                }
+                z[r] = s * inverseDiagonal[r];
+                result = MulAdd(z[r], x[r], result);
+            }
+            Max(result, Float::Zero()).Store(out[channel] + i);
+        }
+    }
+}
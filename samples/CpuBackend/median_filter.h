@@ -0,0 +1,325 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Square median filter on the host with the constant-time sliding histogram of
+// Perreault and Hebert.
+//
+// Every column keeps a histogram of the 2 * radius + 1 values above and below the
+// current row, updated with one removal and one insertion per row. The kernel
+// histogram is the sum of 2 * radius + 1 column histograms and slides along the row
+// the same way. Histograms are split in a coarse and a fine level: the coarse level
+// is updated for every pixel, a fine segment only when the median falls into it,
+// catching up on the columns it missed. The work per pixel therefore does not depend
+// on the radius.
+//
+// 8-bit images are filtered exactly on 256 bins. Other formats are quantized per
+// channel to 4096 bins between the channel minimum and maximum, the result being the
+// center of the median bin. Threads work on column stripes, each with its own
+// column histograms.
+
+#include "filter.h"
+#include "float_image.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace CpuBackend
+{
+    namespace detail
+    {
+        template <int Bits>
+        struct MedianHistogram
+        {
+            static const int Bins = 1 << Bits;
+            static const int FineBits = Bits / 2;
+            static const int FineBins = 1 << FineBits;
+            static const int CoarseBins = Bins / FineBins;
+
+            // medians of columns [x0, x1) of a plane of bin indices, borders clamped
+            static void Stripe(const uint16_t* src, uint16_t* dst, long width, long height, long x0, long x1, long radius)
+            {
+                const long columns = x1 - x0 + 2 * radius;
+                const long left = x0 - radius;
+                const uint32_t target = static_cast<uint32_t>((2 * radius + 1) * (2 * radius + 1) / 2);
+
+                // counts fit 16 bits up to radius 127; the fine level is stored per coarse
+                // bin across all columns so catching up on one segment reads contiguous memory
+                std::vector<uint16_t> columnCoarse(columns * CoarseBins, 0);
+                std::vector<uint16_t> columnFine(columns * Bins, 0);
+                std::vector<long> sourceX(columns);
+                for (long c = 0; c < columns; ++c)
+                {
+                    sourceX[c] = BorderIndex(left + c, width, RIF_READ_MODE_CLAMP);
+                }
+
+                auto update = [&](long y, int delta)
+                {
+                    const uint16_t* row = src + BorderIndex(y, height, RIF_READ_MODE_CLAMP) * width;
+                    for (long c = 0; c < columns; ++c)
+                    {
+                        const int bin = row[sourceX[c]];
+                        columnCoarse[c * CoarseBins + (bin >> FineBits)] += delta;
+                        columnFine[((bin >> FineBits) * columns + c) * FineBins + (bin & (FineBins - 1))] += delta;
+                    }
+                };
+                for (long y = -radius; y <= radius; ++y)
+                {
+                    update(y, 1);
+                }
+
+                uint16_t coarse[CoarseBins];
+                std::vector<uint16_t> fine(Bins);
+                long synced[CoarseBins];
+
+                for (long y = 0; y < height; ++y)
+                {
+                    if (y > 0)
+                    {
+                        update(y - radius - 1, -1);
+                        update(y + radius, 1);
+                    }
+
+                    std::fill(coarse, coarse + CoarseBins, uint16_t(0));
+                    for (long c = 0; c <= 2 * radius; ++c)
+                    {
+                        AddSegment(coarse, &columnCoarse[c * CoarseBins], CoarseBins, 1);
+                    }
+                    std::fill(synced, synced + CoarseBins, std::numeric_limits<long>::min() / 2);
+
+                    uint16_t* out = dst + y * width;
+                    for (long x = x0; x < x1; ++x)
+                    {
+                        // column c holds source column left + c, the kernel spans x +- radius
+                        const long first = x - left - radius;
+                        if (x > x0)
+                        {
+                            AddSegment(coarse, &columnCoarse[(first + 2 * radius) * CoarseBins], CoarseBins, 1);
+                            AddSegment(coarse, &columnCoarse[(first - 1) * CoarseBins], CoarseBins, -1);
+                        }
+
+                        uint32_t sum = 0;
+                        int k = 0;
+                        while (sum + coarse[k] <= target)
+                        {
+                            sum += coarse[k++];
+                        }
+
+                        uint16_t* segment = &fine[k * FineBins];
+                        const uint16_t* columnSegment = &columnFine[size_t(k) * columns * FineBins];
+                        if (x - synced[k] > 2 * radius)
+                        {
+                            std::fill(segment, segment + FineBins, uint16_t(0));
+                            for (long c = first; c <= first + 2 * radius; ++c)
+                            {
+                                AddSegment(segment, columnSegment + c * FineBins, FineBins, 1);
+                            }
+                        }
+                        else
+                        {
+                            for (long s = synced[k] + 1; s <= x; ++s)
+                            {
+                                const long f = s - left - radius;
+                                AddSegment(segment, columnSegment + (f + 2 * radius) * FineBins, FineBins, 1);
+                                AddSegment(segment, columnSegment + (f - 1) * FineBins, FineBins, -1);
+                            }
+                        }
+                        synced[k] = x;
+
+                        int j = 0;
+                        while (sum + segment[j] <= target)
+                        {
+                            sum += segment[j++];
+                        }
+                        out[x] = static_cast<uint16_t>(k * FineBins + j);
+                    }
+                }
+            }
+
+            // a fixed trip count the compiler turns into a few vector adds
+            static void AddSegment(uint16_t* histogram, const uint16_t* column, int count, int sign)
+            {
+                if (sign > 0)
+                {
+                    for (int i = 0; i < count; ++i) histogram[i] += column[i];
+                }
+                else
+                {
+                    for (int i = 0; i < count; ++i) histogram[i] -= column[i];
+                }
+            }
+
+            static void Plane(ThreadPool& pool, const uint16_t* src, uint16_t* dst, long width, long height, long radius)
+            {
+                // stripes much wider than the kernel so the halo columns stay a small overhead
+                const long stripe = std::max<long>(64, 4 * radius);
+                const size_t stripes = (width + stripe - 1) / stripe;
+                pool.ParallelFor(stripes, 1, [&](size_t begin, size_t end)
+                {
+                    for (size_t s = begin; s < end; ++s)
+                    {
+                        const long x0 = long(s) * stripe;
+                        Stripe(src, dst, width, height, x0, std::min(width, x0 + stripe), radius);
+                    }
+                });
+            }
+        };
+    }
+
+    // per channel median over a (2 * radius + 1)^2 window; radius is limited to 127
+    inline rif_int MedianFilter(ThreadPool& pool, const Image& input, Image& output, long radius)
+    {
+        if (input.Width() != output.Width() || input.Height() != output.Height())
+        {
+            return RIF_ERROR_INVALID_IMAGE;
+        }
+        if (radius < 0 || radius > 127)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        const long width = static_cast<long>(input.Width());
+        const long height = static_cast<long>(input.Height());
+        const rif_uint components = input.Components();
+        const bool exact = input.Type() == RIF_COMPONENT_TYPE_UINT8;
+        const int bins = exact ? detail::MedianHistogram<8>::Bins : detail::MedianHistogram<12>::Bins;
+
+        // planar bin indices, one plane per channel
+        std::vector<std::vector<uint16_t>> planes(components, std::vector<uint16_t>(width * height));
+        std::vector<float> low(components, 0.0f);
+        std::vector<float> scale(components, 1.0f / 255.0f);
+
+        if (exact)
+        {
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const rif_uchar* row = input.Row(y);
+                    for (long x = 0; x < width; ++x)
+                    {
+                        for (rif_uint c = 0; c < components; ++c)
+                        {
+                            planes[c][y * width + x] = row[x * components + c];
+                        }
+                    }
+                }
+            });
+        }
+        else
+        {
+            std::vector<float> values(width * height * components);
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(y, 0, width, &values[y * width * components], components);
+                }
+            });
+            for (rif_uint c = 0; c < components; ++c)
+            {
+                float lo = std::numeric_limits<float>::max();
+                float hi = -std::numeric_limits<float>::max();
+                for (size_t i = c; i < values.size(); i += components)
+                {
+                    lo = std::min(lo, values[i]);
+                    hi = std::max(hi, values[i]);
+                }
+                low[c] = lo;
+                scale[c] = hi > lo ? (hi - lo) / (bins - 1) : 1.0f;
+            }
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                for (size_t i = begin * width; i < end * width; ++i)
+                {
+                    for (rif_uint c = 0; c < components; ++c)
+                    {
+                        const float bin = (values[i * components + c] - low[c]) / scale[c] + 0.5f;
+                        planes[c][i] = static_cast<uint16_t>(std::min(std::max(bin, 0.0f), float(bins - 1)));
+                    }
+                }
+            });
+        }
+
+        std::vector<uint16_t> median(width * height);
+        for (rif_uint c = 0; c < components; ++c)
+        {
+            if (exact)
+            {
+                detail::MedianHistogram<8>::Plane(pool, planes[c].data(), median.data(), width, height, radius);
+            }
+            else
+            {
+                detail::MedianHistogram<12>::Plane(pool, planes[c].data(), median.data(), width, height, radius);
+            }
+            planes[c].swap(median);
+        }
+
+        const bool direct = exact && output.Type() == RIF_COMPONENT_TYPE_UINT8 && output.Components() == components;
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            std::vector<float> row(width * components);
+            for (size_t y = begin; y < end; ++y)
+            {
+                for (long x = 0; x < width; ++x)
+                {
+                    for (rif_uint c = 0; c < components; ++c)
+                    {
+                        const uint16_t bin = planes[c][y * width + x];
+                        if (direct)
+                        {
+                            output.Row(y)[x * components + c] = static_cast<rif_uchar>(bin);
+                        }
+                        else
+                        {
+                            row[x * components + c] = low[c] + bin * scale[c];
+                        }
+                    }
+                }
+                if (!direct)
+                {
+                    output.StoreRow(y, 0, width, row.data(), components);
+                }
+            }
+        });
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_MEDIAN_DENOISE
+    // "radius" - half size of the square window
+    class MedianDenoiseFilter : public Filter
+    {
+    public:
+        MedianDenoiseFilter()
+            : Filter(RIF_IMAGE_FILTER_MEDIAN_DENOISE)
+        {
+            DeclareUint("radius", 1);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            return MedianFilter(pool, input, output, static_cast<long>(GetUint("radius")));
+        }
+    };
+}
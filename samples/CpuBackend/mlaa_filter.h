@@ -0,0 +1,593 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Morphological antialiasing on the host, after Reshetov, with the lookup tables of
+// Jimenez et al.
+//
+// Pass 1 compares the luma (and optionally the depth) of each pixel with its left and
+// top neighbours and packs the discontinuities into one bit per pixel, 64 pixels per
+// word. Pass 2 measures every edge run: horizontal runs are found directly in the
+// words of a row, vertical ones by walking the bits of the rows above and below. The
+// crossing edges at the two ends of a run select the pattern (L, Z or U shapes), and
+// the pattern with the distances to both ends index a precomputed table of the areas
+// cut by the reconstructed silhouette. The areas are stored per edge. Pass 3 blends
+// every pixel next to an edge with its neighbours across it by those areas.
+//
+// Every pass works on row bands. Pass 2 reads the masks of neighbouring rows but only
+// writes the edges of its own rows, so the bands never overlap.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace CpuBackend
+{
+    // runs are followed at most this far from a pixel in each direction
+    const int MlaaMaxDistance = 16;
+
+    namespace MlaaScalar
+    {
+        using simd::Scalar::Float;
+#include "mlaa_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace MlaaSse
+    {
+        using simd::Sse::Float;
+#include "mlaa_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace MlaaAvx2
+    {
+        using simd::Avx2::Float;
+#include "mlaa_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace MlaaNeon
+    {
+        using simd::Neon::Float;
+#include "mlaa_kernels.inl"
+    }
+#endif
+
+    struct MlaaSettings
+    {
+        float lumaThreshold = 0.1f;
+        float depthThreshold = 0.1f;
+    };
+
+    struct MlaaStatistics
+    {
+        double edgeMs = 0.0;        // luma and edge masks
+        double weightMs = 0.0;      // runs and areas
+        double blendMs = 0.0;
+    };
+
+    // Signed area between an edge and the silhouette reconstructed over its run, for the
+    // pixel 'left' pixels from the start of the run and 'right' from its end. The ends
+    // rise to 'heightLeft' and 'heightRight' (+-0.5 or 0) and the silhouette crosses
+    // the edge in the middle of the run. Positive areas lie on the upper (or left) side.
+    inline float MlaaArea(float heightLeft, float heightRight, int left, int right)
+    {
+        const float middle = (left + right + 1) * 0.5f;
+        auto height = [&](float t)
+        {
+            return t < middle ? heightLeft * (1.0f - t / middle) : heightRight * (t / middle - 1.0f);
+        };
+        const float a = static_cast<float>(left);
+        const float b = a + 1.0f;
+        if (b <= middle || a >= middle)
+        {
+            return 0.5f * (height(a) + height(b));
+        }
+        // the silhouette crosses the edge inside this pixel
+        return 0.5f * (height(a) * (middle - a) + height(b) * (b - middle));
+    }
+
+    // Crossing edges at an end of a run: bit 0 on the upper (left) side, bit 1 on the
+    // lower (right) side. A crossing on one side makes the silhouette rise half a pixel
+    // to that side; none or both leave it on the edge.
+    inline float MlaaEndHeight(int crossing)
+    {
+        static const float heights[4] = { 0.0f, 0.5f, -0.5f, 0.0f };
+        return heights[crossing];
+    }
+
+    // areas indexed by the crossings at both ends and the distances to them
+    class MlaaAreaTable
+    {
+    public:
+        static const MlaaAreaTable& Get()
+        {
+            static const MlaaAreaTable table;
+            return table;
+        }
+
+        float Area(int crossingLeft, int crossingRight, int left, int right) const
+        {
+            return m_area[((crossingLeft * 4 + crossingRight) * MlaaMaxDistance + left) * MlaaMaxDistance + right];
+        }
+
+    private:
+        MlaaAreaTable()
+            : m_area(16 * MlaaMaxDistance * MlaaMaxDistance)
+        {
+            for (int pattern = 0; pattern < 16; ++pattern)
+            {
+                for (int left = 0; left < MlaaMaxDistance; ++left)
+                {
+                    for (int right = 0; right < MlaaMaxDistance; ++right)
+                    {
+                        m_area[(pattern * MlaaMaxDistance + left) * MlaaMaxDistance + right] =
+                            MlaaArea(MlaaEndHeight(pattern / 4), MlaaEndHeight(pattern % 4), left, right);
+                    }
+                }
+            }
+        }
+
+        std::vector<float> m_area;
+    };
+
+    namespace detail
+    {
+        typedef void (*MlaaEdgeFunction)(const float* luma, const float* lumaUp, const float* depth, const float* depthUp,
+            float lumaThreshold, float depthThreshold, size_t words, uint64_t* left, uint64_t* top);
+
+        inline MlaaEdgeFunction SelectMlaaEdges(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+            case simd::Level::Avx2:
+                return MlaaAvx2::MlaaEdgeRow;
+            case simd::Level::Sse:
+                return MlaaSse::MlaaEdgeRow;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return MlaaNeon::MlaaEdgeRow;
+#endif
+            default:
+                return MlaaScalar::MlaaEdgeRow;
+            }
+        }
+
+        inline int CountTrailingZeros(uint64_t bits)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctzll(bits);
+#endif
+        }
+
+        // first bit at or after 'from' equal to 'value', or words * 64
+        inline size_t NextBit(const uint64_t* bits, size_t words, size_t from, bool value)
+        {
+            size_t w = from / 64;
+            if (w >= words)
+            {
+                return words * 64;
+            }
+            uint64_t word = (value ? bits[w] : ~bits[w]) & (~uint64_t(0) << (from % 64));
+            while (!word)
+            {
+                if (++w == words)
+                {
+                    return words * 64;
+                }
+                word = value ? bits[w] : ~bits[w];
+            }
+            return w * 64 + CountTrailingZeros(word);
+        }
+
+        // Edge masks of an image, one bit per pixel. Bit x of Left(y) marks an edge
+        // between pixels x - 1 and x, bit x of Top(y) one between rows y - 1 and y.
+        class MlaaEdges
+        {
+        public:
+            MlaaEdges(long width, long height)
+                : m_width(width)
+                , m_height(height)
+                , m_words((width + 63) / 64)
+                , m_left(m_words * height)
+                , m_top(m_words * height)
+            {   }
+
+            size_t Words() const
+            {
+                return m_words;
+            }
+
+            uint64_t* Left(long y)
+            {
+                return m_left.data() + y * m_words;
+            }
+
+            uint64_t* Top(long y)
+            {
+                return m_top.data() + y * m_words;
+            }
+
+            const uint64_t* Left(long y) const
+            {
+                return m_left.data() + y * m_words;
+            }
+
+            const uint64_t* Top(long y) const
+            {
+                return m_top.data() + y * m_words;
+            }
+
+            // zero outside the image
+            bool IsLeft(long x, long y) const
+            {
+                return x >= 0 && x < m_width && y >= 0 && y < m_height && ((Left(y)[x / 64] >> (x % 64)) & 1);
+            }
+
+            bool IsTop(long x, long y) const
+            {
+                return x >= 0 && x < m_width && y >= 0 && y < m_height && ((Top(y)[x / 64] >> (x % 64)) & 1);
+            }
+
+        private:
+            long m_width;
+            long m_height;
+            size_t m_words;
+            std::vector<uint64_t> m_left;
+            std::vector<uint64_t> m_top;
+        };
+
+        // Luma or depth copied into rows of whole 64-pixel words with one pixel of border
+        // in front; the borders repeat the first and last pixels of the row.
+        class MlaaPlane
+        {
+        public:
+            static const size_t Front = 16;
+
+            MlaaPlane(long width, long height, size_t words)
+                : m_width(width)
+                , m_pitch(Front + words * 64)
+                , m_data(m_pitch * height)
+            {   }
+
+            float* Row(long y)
+            {
+                return m_data.data() + y * m_pitch + Front;
+            }
+
+            const float* Row(long y) const
+            {
+                return m_data.data() + y * m_pitch + Front;
+            }
+
+            void PadRow(long y)
+            {
+                float* row = Row(y);
+                row[-1] = row[0];
+                std::fill(row + m_width, row + m_pitch - Front, row[m_width - 1]);
+            }
+
+        private:
+            long m_width;
+            size_t m_pitch;
+            std::vector<float> m_data;
+        };
+
+        // areas of the horizontal edges of row y, which has at least one row above it
+        inline void MlaaHorizontalAreas(const MlaaEdges& edges, long width, long y, float* areas)
+        {
+            const MlaaAreaTable& table = MlaaAreaTable::Get();
+            const uint64_t* top = edges.Top(y);
+            const size_t words = edges.Words();
+            std::fill(areas, areas + width, 0.0f);
+
+            size_t start = NextBit(top, words, 0, true);
+            while (start < size_t(width))
+            {
+                const long x0 = static_cast<long>(start);
+                const long x1 = std::min(width, static_cast<long>(NextBit(top, words, start, false)));
+                const int crossingLeft = edges.IsLeft(x0, y - 1) | edges.IsLeft(x0, y) << 1;
+                const int crossingRight = edges.IsLeft(x1, y - 1) | edges.IsLeft(x1, y) << 1;
+                for (long x = x0; x < x1; ++x)
+                {
+                    const long left = x - x0;
+                    const long right = x1 - 1 - x;
+                    areas[x] = table.Area(left < MlaaMaxDistance ? crossingLeft : 0, right < MlaaMaxDistance ? crossingRight : 0,
+                        static_cast<int>(std::min<long>(left, MlaaMaxDistance - 1)),
+                        static_cast<int>(std::min<long>(right, MlaaMaxDistance - 1)));
+                }
+                start = NextBit(top, words, x1, true);
+            }
+        }
+
+        // areas of the vertical edges of row y; the runs are followed through the masks
+        // of the rows above and below
+        inline void MlaaVerticalAreas(const MlaaEdges& edges, long width, long height, long y, float* areas)
+        {
+            const MlaaAreaTable& table = MlaaAreaTable::Get();
+            const uint64_t* left = edges.Left(y);
+            const size_t words = edges.Words();
+            std::fill(areas, areas + width, 0.0f);
+
+            for (size_t w = 0; w < words; ++w)
+            {
+                for (uint64_t bits = left[w]; bits; bits &= bits - 1)
+                {
+                    const long x = static_cast<long>(w * 64 + CountTrailingZeros(bits));
+
+                    int up = 0;
+                    while (up < MlaaMaxDistance && edges.IsLeft(x, y - up - 1))
+                    {
+                        ++up;
+                    }
+                    int down = 0;
+                    while (down < MlaaMaxDistance && edges.IsLeft(x, y + down + 1))
+                    {
+                        ++down;
+                    }
+
+                    int crossingUp = 0;
+                    if (up < MlaaMaxDistance)
+                    {
+                        crossingUp = edges.IsTop(x - 1, y - up) | edges.IsTop(x, y - up) << 1;
+                    }
+                    int crossingDown = 0;
+                    if (down < MlaaMaxDistance && y + down + 1 < height)
+                    {
+                        crossingDown = edges.IsTop(x - 1, y + down + 1) | edges.IsTop(x, y + down + 1) << 1;
+                    }
+                    areas[x] = table.Area(crossingUp, crossingDown,
+                        std::min(up, MlaaMaxDistance - 1), std::min(down, MlaaMaxDistance - 1));
+                }
+            }
+        }
+    }
+
+    // 'depth' may be null; its first channel is compared
+    inline void Mlaa(ThreadPool& pool, const FloatImage& src, const FloatImage* depth, FloatImage& dst,
+        const MlaaSettings& settings, MlaaStatistics* statistics = nullptr, simd::Level level = simd::CurrentLevel())
+    {
+        const long width = static_cast<long>(src.Width());
+        const long height = static_cast<long>(src.Height());
+        dst.Resize(width, height);
+        if (width == 0 || height == 0)
+        {
+            return;
+        }
+
+        // pass 1: luma and edge masks
+        auto start = std::chrono::high_resolution_clock::now();
+        detail::MlaaEdges edges(width, height);
+        const size_t words = edges.Words();
+        detail::MlaaPlane luma(width, height, words);
+        detail::MlaaPlane depthPlane(depth ? width : 1, depth ? height : 1, depth ? words : 1);
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            for (long y = static_cast<long>(begin); y < static_cast<long>(end); ++y)
+            {
+                const float* rgba = src.Row(y);
+                float* row = luma.Row(y);
+                for (long x = 0; x < width; ++x)
+                {
+                    row[x] = 0.2126f * rgba[4 * x] + 0.7152f * rgba[4 * x + 1] + 0.0722f * rgba[4 * x + 2];
+                }
+                luma.PadRow(y);
+                if (depth)
+                {
+                    const float* z = depth->Row(y);
+                    float* depthRow = depthPlane.Row(y);
+                    for (long x = 0; x < width; ++x)
+                    {
+                        depthRow[x] = z[4 * x];
+                    }
+                    depthPlane.PadRow(y);
+                }
+            }
+        });
+
+        const detail::MlaaEdgeFunction detect = detail::SelectMlaaEdges(level);
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            for (long y = static_cast<long>(begin); y < static_cast<long>(end); ++y)
+            {
+                // the first row compares with itself, which finds no top edges
+                const long up = std::max(0L, y - 1);
+                detect(luma.Row(y), luma.Row(up), depth ? depthPlane.Row(y) : nullptr, depth ? depthPlane.Row(up) : nullptr,
+                    settings.lumaThreshold, settings.depthThreshold, words, edges.Left(y), edges.Top(y));
+            }
+        });
+        if (statistics)
+        {
+            statistics->edgeMs = detail::MsSince(start);
+        }
+
+        // pass 2: signed areas per edge
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<float> horizontal(width * height);
+        std::vector<float> vertical(width * height);
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            for (long y = static_cast<long>(begin); y < static_cast<long>(end); ++y)
+            {
+                if (y > 0)
+                {
+                    detail::MlaaHorizontalAreas(edges, width, y, &horizontal[y * width]);
+                }
+                detail::MlaaVerticalAreas(edges, width, height, y, &vertical[y * width]);
+            }
+        });
+        if (statistics)
+        {
+            statistics->weightMs = detail::MsSince(start);
+        }
+
+        // pass 3: blend across the edges. A positive area moves colour from the lower
+        // (right) pixel into the upper (left) one, a negative area the other way.
+        start = std::chrono::high_resolution_clock::now();
+        pool.ParallelForRows(height, [&](size_t begin, size_t end)
+        {
+            for (long y = static_cast<long>(begin); y < static_cast<long>(end); ++y)
+            {
+                const float* in = src.Row(y);
+                float* out = dst.Row(y);
+                std::copy(in, in + 4 * width, out);
+
+                // only pixels with an edge on one of their four sides change
+                const uint64_t* top = edges.Top(y);
+                const uint64_t* below = y + 1 < height ? edges.Top(y + 1) : nullptr;
+                const uint64_t* left = edges.Left(y);
+                for (size_t w = 0; w < words; ++w)
+                {
+                    uint64_t bits = top[w] | left[w] | left[w] >> 1;
+                    if (below)
+                    {
+                        bits |= below[w];
+                    }
+                    if (w + 1 < words)
+                    {
+                        bits |= left[w + 1] << 63;
+                    }
+                    for (; bits; bits &= bits - 1)
+                    {
+                        const long x = static_cast<long>(w * 64 + detail::CountTrailingZeros(bits));
+                        const float* neighbours[4];
+                        float weights[4];
+                        int count = 0;
+                        const float areaUp = y > 0 ? horizontal[y * width + x] : 0.0f;
+                        const float areaDown = y + 1 < height ? horizontal[(y + 1) * width + x] : 0.0f;
+                        const float areaLeft = vertical[y * width + x];
+                        const float areaRight = x + 1 < width ? vertical[y * width + x + 1] : 0.0f;
+                        if (areaUp < 0.0f)
+                        {
+                            neighbours[count] = src.Row(y - 1) + 4 * x;
+                            weights[count++] = -areaUp;
+                        }
+                        if (areaDown > 0.0f)
+                        {
+                            neighbours[count] = src.Row(y + 1) + 4 * x;
+                            weights[count++] = areaDown;
+                        }
+                        if (areaLeft < 0.0f)
+                        {
+                            neighbours[count] = in + 4 * (x - 1);
+                            weights[count++] = -areaLeft;
+                        }
+                        if (areaRight > 0.0f)
+                        {
+                            neighbours[count] = in + 4 * (x + 1);
+                            weights[count++] = areaRight;
+                        }
+                        if (!count)
+                        {
+                            continue;
+                        }
+
+                        float total = 0.0f;
+                        for (int i = 0; i < count; ++i)
+                        {
+                            total += weights[i];
+                        }
+                        // corners may ask for more than the whole pixel
+                        const float scale = total > 1.0f ? 1.0f / total : 1.0f;
+                        for (int c = 0; c < 4; ++c)
+                        {
+                            float value = in[4 * x + c] * (1.0f - total * scale);
+                            for (int i = 0; i < count; ++i)
+                            {
+                                value += weights[i] * scale * neighbours[i][c];
+                            }
+                            out[4 * x + c] = value;
+                        }
+                    }
+                }
+            }
+        });
+        if (statistics)
+        {
+            statistics->blendMs = detail::MsSince(start);
+        }
+    }
+
+    // RIF_IMAGE_FILTER_MLAA
+    // "colorTreshold" - luma difference making an edge, "depthImg" - optional depth,
+    // "depthTreshold" - depth difference making an edge
+    class MlaaFilter : public Filter
+    {
+    public:
+        MlaaFilter()
+            : Filter(RIF_IMAGE_FILTER_MLAA)
+        {
+            const MlaaSettings defaults;
+            DeclareFloat("colorTreshold", defaults.lumaThreshold);
+            DeclareImage("depthImg");
+            DeclareFloat("depthTreshold", defaults.depthThreshold);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+
+            FloatImage depth;
+            const Image* depthImage = GetImage("depthImg");
+            if (depthImage)
+            {
+                if (depthImage->Width() != input.Width() || depthImage->Height() != input.Height())
+                {
+                    return RIF_ERROR_INVALID_IMAGE;
+                }
+                depth.Load(pool, *depthImage);
+            }
+
+            MlaaSettings settings;
+            settings.lumaThreshold = GetFloat("colorTreshold");
+            settings.depthThreshold = GetFloat("depthTreshold");
+
+            FloatImage src;
+            FloatImage dst;
+            src.Load(pool, input);
+            Mlaa(pool, src, depthImage ? &depth : nullptr, dst, settings);
+            dst.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+    };
+}
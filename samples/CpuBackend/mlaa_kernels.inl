@@ -0,0 +1,58 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Edge detection of the MLAA, included by mlaa_filter.h once per instruction set with
+// 'Float' naming that set's vector type.
+
+// Packs the edges of one row into 'words' 64-bit words each of left and top edges, bit
+// x of a row standing for pixel x. 'luma' and 'lumaUp' point to pixel 0 of the row and
+// of the row above; the value before pixel 0 and the values after the last pixel
+// repeat the border so they never make an edge. The depth rows may be null.
+inline void MlaaEdgeRow(const float* luma, const float* lumaUp, const float* depth, const float* depthUp,
+    float lumaThreshold, float depthThreshold, size_t words, uint64_t* left, uint64_t* top)
+{
+    const Float lumaLimit = Float::Set1(lumaThreshold);
+    const Float depthLimit = Float::Set1(depthThreshold);
+
+    for (size_t w = 0; w < words; ++w)
+    {
+        uint64_t leftBits = 0;
+        uint64_t topBits = 0;
+        for (int k = 0; k < 64; k += Float::Width)
+        {
+            const size_t x = w * 64 + k;
+            const Float centre = Float::Load(luma + x);
+            unsigned leftMask = GreaterMask(Abs(centre - Float::Load(luma + x - 1)), lumaLimit);
+            unsigned topMask = GreaterMask(Abs(centre - Float::Load(lumaUp + x)), lumaLimit);
+            if (depth)
+            {
+                const Float z = Float::Load(depth + x);
+                leftMask |= GreaterMask(Abs(z - Float::Load(depth + x - 1)), depthLimit);
+                topMask |= GreaterMask(Abs(z - Float::Load(depthUp + x)), depthLimit);
+            }
+            leftBits |= uint64_t(leftMask) << k;
+            topBits |= uint64_t(topMask) << k;
+        }
+        left[w] = leftBits;
+        top[w] = topBits;
+    }
+}
@@ -0,0 +1,399 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Dilation and erosion on the host with the running maximum / minimum of van Herk and
+// Gil-Werman, which costs three comparisons per pixel and pass whatever the radius.
+//
+// A rectangle is a horizontal and a vertical line. A disk is approximated by the
+// octagon obtained from lines in the four directions: a square of half size a and
+// diagonals of half length b with a + 2b = r, which puts the axis extent at r and the
+// diagonal one at 2(a + b), close to r * sqrt(2) with a = r(sqrt(2) - 1). Every pass
+// runs in place on one float copy of the image.
+//
+// Vertical passes filter column blocks straight in the image, the vector lanes across
+// neighbouring columns. Horizontal passes interleave groups of rows into one line so
+// the lanes hold neighbouring rows. Diagonal passes gather blocks of diagonals into
+// columns: diagonal c holds pixels (c + s * y, y), s = +-1, and everything outside the
+// image reads as the identity. Pixels outside the image are ignored, which for
+// rectangles is the same as clamping the borders; disks run on a copy with an identity
+// margin of 2b so their diagonal passes see the same borders.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace CpuBackend
+{
+    const size_t MorphologyGroupRows = 4;
+    const size_t MorphologyStep = 4 * MorphologyGroupRows;
+    const size_t MorphologyBlockPixels = 16;
+
+    namespace MorphologyScalar
+    {
+        using simd::Scalar::Float;
+#include "morphology_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace MorphologySse
+    {
+        using simd::Sse::Float;
+#include "morphology_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace MorphologyAvx2
+    {
+        using simd::Avx2::Float;
+#include "morphology_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace MorphologyAvx512
+    {
+        using simd::Avx512::Float;
+#include "morphology_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace MorphologyNeon
+    {
+        using simd::Neon::Float;
+#include "morphology_kernels.inl"
+    }
+#endif
+
+    enum class MorphologyOperation
+    {
+        Dilate,
+        Erode,
+    };
+
+    enum class MorphologyShape
+    {
+        Rectangle,
+        Disk,
+    };
+
+    struct MorphologySettings
+    {
+        MorphologyOperation operation = MorphologyOperation::Dilate;
+        MorphologyShape shape = MorphologyShape::Rectangle;
+        long radiusX = 1;           // the disk radius for disks
+        long radiusY = 1;
+    };
+
+    // a line of 2 * radius + 1 pixels through the origin along (dx, dy)
+    struct MorphologyPass
+    {
+        int dx;
+        int dy;
+        long radius;
+    };
+
+    // the line passes whose succession is the structuring element of 'settings'
+    inline std::vector<MorphologyPass> MorphologyPasses(const MorphologySettings& settings)
+    {
+        std::vector<MorphologyPass> passes;
+        long square = settings.radiusX;
+        long diagonal = 0;
+        if (settings.shape == MorphologyShape::Disk)
+        {
+            // the diagonals alone only reach every other pixel, so the square is kept at
+            // 1 or more for them to fill in
+            const long r = settings.radiusX;
+            diagonal = std::min(std::lround(r * (1.0 - (std::sqrt(2.0) - 1.0)) / 2.0), (r - 1) / 2);
+            diagonal = std::max(diagonal, 0L);
+            square = r - 2 * diagonal;
+        }
+        const long squareY = settings.shape == MorphologyShape::Disk ? square : settings.radiusY;
+
+        if (square > 0)
+        {
+            passes.push_back({ 1, 0, square });
+        }
+        if (squareY > 0)
+        {
+            passes.push_back({ 0, 1, squareY });
+        }
+        if (diagonal > 0)
+        {
+            passes.push_back({ 1, 1, diagonal });
+            passes.push_back({ -1, 1, diagonal });
+        }
+        return passes;
+    }
+
+    namespace detail
+    {
+        typedef void (*MorphologyLines)(const float*, float*, size_t, long, long, size_t, float, float*);
+
+        struct MorphologyKernels
+        {
+            MorphologyLines dilate;
+            MorphologyLines erode;
+            int width;
+        };
+
+        inline MorphologyKernels SelectMorphologyKernels(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return { MorphologyAvx512::DilateLines, MorphologyAvx512::ErodeLines, MorphologyAvx512::Float::Width };
+            case simd::Level::Avx2:
+                return { MorphologyAvx2::DilateLines, MorphologyAvx2::ErodeLines, MorphologyAvx2::Float::Width };
+            case simd::Level::Sse:
+                return { MorphologySse::DilateLines, MorphologySse::ErodeLines, MorphologySse::Float::Width };
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return { MorphologyNeon::DilateLines, MorphologyNeon::ErodeLines, MorphologyNeon::Float::Width };
+#endif
+            default:
+                return { MorphologyScalar::DilateLines, MorphologyScalar::ErodeLines, MorphologyScalar::Float::Width };
+            }
+        }
+
+        inline void MorphologyHorizontal(ThreadPool& pool, FloatImage& image, long radius, MorphologyLines lines,
+            float identity)
+        {
+            const long width = static_cast<long>(image.Width());
+            const size_t height = image.Height();
+            const size_t groups = (height + MorphologyGroupRows - 1) / MorphologyGroupRows;
+            pool.ParallelFor(groups, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> line(width * MorphologyStep);
+                std::vector<float> scratch((width + 2 * radius + 1) * MorphologyStep);
+                for (size_t g = begin; g < end; ++g)
+                {
+                    const size_t y0 = g * MorphologyGroupRows;
+                    const size_t rows = std::min(MorphologyGroupRows, height - y0);
+                    for (long x = 0; x < width; ++x)
+                    {
+                        for (size_t r = 0; r < rows; ++r)
+                        {
+                            const float* pixel = image.Row(y0 + r) + 4 * x;
+                            std::copy(pixel, pixel + 4, &line[x * MorphologyStep + r * 4]);
+                        }
+                    }
+
+                    lines(line.data(), line.data(), MorphologyStep, width, radius, MorphologyStep, identity, scratch.data());
+
+                    for (long x = 0; x < width; ++x)
+                    {
+                        for (size_t r = 0; r < rows; ++r)
+                        {
+                            const float* sample = &line[x * MorphologyStep + r * 4];
+                            std::copy(sample, sample + 4, image.Row(y0 + r) + 4 * x);
+                        }
+                    }
+                }
+            });
+        }
+
+        inline void MorphologyVertical(ThreadPool& pool, FloatImage& image, long radius, MorphologyLines lines,
+            float identity, int vectorWidth)
+        {
+            const long height = static_cast<long>(image.Height());
+            const size_t block = 4 * MorphologyBlockPixels;
+            const size_t floats = (image.Width() * 4 + vectorWidth - 1) / vectorWidth * vectorWidth;
+            const size_t blocks = (floats + block - 1) / block;
+            pool.ParallelFor(blocks, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> scratch((height + 2 * radius + 1) * block);
+                for (size_t b = begin; b < end; ++b)
+                {
+                    // the pitch covers the vector rounding of the last block
+                    const size_t x0 = b * block;
+                    float* column = image.Row(0) + x0;
+                    lines(column, column, image.Pitch(), height, radius, std::min(block, floats - x0), identity, scratch.data());
+                }
+            });
+        }
+
+        // lines of pixels (c + shear * y, y)
+        inline void MorphologyDiagonal(ThreadPool& pool, FloatImage& image, int shear, long radius, MorphologyLines lines,
+            float identity)
+        {
+            const long width = static_cast<long>(image.Width());
+            const long height = static_cast<long>(image.Height());
+            const long first = shear > 0 ? -(height - 1) : 0;
+            const long count = width + height - 1;
+            const long block = static_cast<long>(MorphologyBlockPixels);
+            const size_t floats = 4 * MorphologyBlockPixels;
+            const size_t blocks = (count + block - 1) / block;
+            pool.ParallelFor(blocks, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<float> columns(height * floats);
+                std::vector<float> scratch((height + 2 * radius + 1) * floats);
+                for (size_t b = begin; b < end; ++b)
+                {
+                    const long c0 = first + long(b) * block;
+                    for (long y = 0; y < height; ++y)
+                    {
+                        // pixels [x0, x0 + block) of row y, the part inside the image copied
+                        const long x0 = c0 + shear * y;
+                        const long lo = std::max(x0, 0L);
+                        const long hi = std::min(x0 + block, width);
+                        float* row = &columns[y * floats];
+                        std::fill(row, row + floats, identity);
+                        if (lo < hi)
+                        {
+                            std::copy(image.Row(y) + 4 * lo, image.Row(y) + 4 * hi, row + 4 * (lo - x0));
+                        }
+                    }
+
+                    lines(columns.data(), columns.data(), floats, height, radius, floats, identity, scratch.data());
+
+                    for (long y = 0; y < height; ++y)
+                    {
+                        const long x0 = c0 + shear * y;
+                        const long lo = std::max(x0, 0L);
+                        const long hi = std::min(x0 + block, width);
+                        if (lo < hi)
+                        {
+                            const float* row = &columns[y * floats];
+                            std::copy(row + 4 * (lo - x0), row + 4 * (hi - x0), image.Row(y) + 4 * lo);
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    // dilates or erodes 'image' in place, channels independently
+    inline void Morphology(ThreadPool& pool, FloatImage& image, const MorphologySettings& settings,
+        simd::Level level = simd::CurrentLevel())
+    {
+        const detail::MorphologyKernels kernels = detail::SelectMorphologyKernels(level);
+        const bool dilate = settings.operation == MorphologyOperation::Dilate;
+        const detail::MorphologyLines lines = dilate ? kernels.dilate : kernels.erode;
+        const float identity = dilate ? std::numeric_limits<float>::lowest() : std::numeric_limits<float>::max();
+
+        const std::vector<MorphologyPass> passes = MorphologyPasses(settings);
+        long margin = 0;
+        for (const MorphologyPass& pass : passes)
+        {
+            margin += pass.dx != 0 && pass.dy != 0 ? pass.radius : 0;
+        }
+
+        // a path through the diagonals can leave the image and come back, so the
+        // intermediate results are kept on a margin as wide as their reach
+        FloatImage padded;
+        FloatImage& target = margin > 0 ? padded : image;
+        if (margin > 0)
+        {
+            padded.Resize(image.Width() + 2 * margin, image.Height() + 2 * margin);
+            pool.ParallelForRows(padded.Height(), [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    std::fill(padded.Row(y), padded.Row(y) + padded.Width() * 4, identity);
+                    if (y >= size_t(margin) && y < image.Height() + margin)
+                    {
+                        const float* row = image.Row(y - margin);
+                        std::copy(row, row + image.Width() * 4, padded.Row(y) + 4 * margin);
+                    }
+                }
+            });
+        }
+
+        for (const MorphologyPass& pass : passes)
+        {
+            if (pass.dy == 0)
+            {
+                detail::MorphologyHorizontal(pool, target, pass.radius, lines, identity);
+            }
+            else if (pass.dx == 0)
+            {
+                detail::MorphologyVertical(pool, target, pass.radius, lines, identity, kernels.width);
+            }
+            else
+            {
+                detail::MorphologyDiagonal(pool, target, pass.dx * pass.dy, pass.radius, lines, identity);
+            }
+        }
+
+        if (margin > 0)
+        {
+            pool.ParallelForRows(image.Height(), [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    const float* row = padded.Row(y + margin) + 4 * margin;
+                    std::copy(row, row + image.Width() * 4, image.Row(y));
+                }
+            });
+        }
+    }
+
+    // RIF_IMAGE_FILTER_DILATE_ERODE
+    // "mode" - RIF_DILATE or RIF_ERODE, "radius" - half size of the element, "radiusY" -
+    // vertical half size of rectangles (radius when 0), "shape" - 0 rectangle, 1 disk
+    class DilateErodeFilter : public Filter
+    {
+    public:
+        DilateErodeFilter()
+            : Filter(RIF_IMAGE_FILTER_DILATE_ERODE)
+        {
+            DeclareUint("mode", RIF_DILATE);
+            DeclareUint("radius", 1);
+            DeclareUint("radiusY", 0);
+            DeclareUint("shape", 0);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (input.Width() != output.Width() || input.Height() != output.Height())
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            if (GetUint("mode") > RIF_ERODE || GetUint("shape") > 1)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+
+            MorphologySettings settings;
+            settings.operation = GetUint("mode") == RIF_ERODE ? MorphologyOperation::Erode : MorphologyOperation::Dilate;
+            settings.shape = static_cast<MorphologyShape>(GetUint("shape"));
+            settings.radiusX = static_cast<long>(GetUint("radius"));
+            settings.radiusY = GetUint("radiusY") > 0 ? static_cast<long>(GetUint("radiusY")) : settings.radiusX;
+
+            FloatImage image;
+            image.Load(pool, input);
+            Morphology(pool, image, settings);
+            image.Store(pool, output);
+            return RIF_SUCCESS;
+        }
+    };
+}
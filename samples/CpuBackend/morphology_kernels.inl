@@ -0,0 +1,101 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Running maximum and minimum of the morphology filter, included by morphology_filter.h
+// once per instruction set with 'Float' naming that set's vector type. No includes
+// here on purpose.
+
+template <bool Dilate>
+inline Float MorphologyCombine(const Float& a, const Float& b)
+{
+    return Dilate ? Max(a, b) : Min(a, b);
+}
+
+// van Herk / Gil-Werman maximum (Dilate) or minimum over windows of 2 * radius + 1
+// samples, centred, along lines of 'length' samples 'pitch' floats apart. Every sample
+// holds 'count' floats (whole vectors) of independent lines; samples outside a line
+// read as 'identity'. The padded line is cut in blocks of one window: 'scratch' takes
+// the block suffixes, (length + 2 * radius + 1) * count floats, and each output is the
+// suffix at its window start combined with the prefix at its window end, three
+// comparisons per sample whatever the radius. 'dst' may equal 'src'.
+template <bool Dilate>
+inline void MorphologyLinesT(const float* src, float* dst, size_t pitch, long length, long radius, size_t count,
+    float identity, float* scratch)
+{
+    const long window = 2 * radius + 1;
+    const long padded = length + 2 * radius;
+    const Float fill = Float::Set1(identity);
+    float* prefix = scratch + padded * count;
+
+    // padded sample j is source sample j - radius
+    for (long j = padded - 1; j >= 0; --j)
+    {
+        const long s = j - radius;
+        const float* in = s >= 0 && s < length ? src + s * pitch : nullptr;
+        float* suffix = scratch + j * count;
+        const bool blockEnd = j == padded - 1 || (j + 1) % window == 0;
+        for (size_t i = 0; i < count; i += Float::Width)
+        {
+            Float v = in ? Float::Load(in + i) : fill;
+            if (!blockEnd)
+            {
+                v = MorphologyCombine<Dilate>(v, Float::Load(suffix + count + i));
+            }
+            v.Store(suffix + i);
+        }
+    }
+
+    // source samples are all read ahead of the outputs that overwrite them
+    for (long j = 0; j < padded; ++j)
+    {
+        const long s = j - radius;
+        const float* in = s >= 0 && s < length ? src + s * pitch : nullptr;
+        const bool blockStart = j % window == 0;
+        float* out = j >= 2 * radius ? dst + (j - 2 * radius) * pitch : nullptr;
+        const float* suffix = out ? scratch + (j - 2 * radius) * count : nullptr;
+        for (size_t i = 0; i < count; i += Float::Width)
+        {
+            Float v = in ? Float::Load(in + i) : fill;
+            if (!blockStart)
+            {
+                v = MorphologyCombine<Dilate>(v, Float::Load(prefix + i));
+            }
+            v.Store(prefix + i);
+            if (out)
+            {
+                MorphologyCombine<Dilate>(Float::Load(suffix + i), v).Store(out + i);
+            }
+        }
+    }
+}
+
+inline void DilateLines(const float* src, float* dst, size_t pitch, long length, long radius, size_t count,
+    float identity, float* scratch)
+{
+    MorphologyLinesT<true>(src, dst, pitch, length, radius, count, identity, scratch);
+}
+
+inline void ErodeLines(const float* src, float* dst, size_t pitch, long length, long radius, size_t count,
+    float identity, float* scratch)
+{
+    MorphologyLinesT<false>(src, dst, pitch, length, radius, count, identity, scratch);
+}
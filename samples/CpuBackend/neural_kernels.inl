@@ -0,0 +1,264 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Convolution and element-wise rows of the neural network runner, included by
+// neural_network.h once per instruction set with 'Float' and 'Int' naming that set's
+// vector types. No includes here on purpose.
+
+// Pixels x Vectors output values of one convolution tile: the input channel of each
+// pixel is broadcast against a vector of output channel weights, so the accumulators
+// stay in registers through all taps and input channels.
+template <int Pixels, int Vectors>
+inline void NeuralConvolutionTile(const NeuralConvolutionRowArgs& args, const float* input, size_t first, float* output)
+{
+    Float sum[Pixels][Vectors];
+    for (int v = 0; v < Vectors; ++v)
+    {
+        const Float bias = Float::Load(args.bias + first + v * Float::Width);
+        for (int p = 0; p < Pixels; ++p)
+        {
+            sum[p][v] = bias;
+        }
+    }
+
+    for (size_t tap = 0; tap < args.taps; ++tap)
+    {
+        const float* in = input + args.offsets[tap];
+        const float* w = args.weights + tap * args.inStride * args.outStride + first;
+        for (size_t c = 0; c < args.inChannels; ++c, w += args.outStride)
+        {
+            Float weight[Vectors];
+            for (int v = 0; v < Vectors; ++v)
+            {
+                weight[v] = Float::Load(w + v * Float::Width);
+            }
+            for (int p = 0; p < Pixels; ++p)
+            {
+                const Float x = Float::Set1(in[p * args.inStride + c]);
+                for (int v = 0; v < Vectors; ++v)
+                {
+                    sum[p][v] = MulAdd(x, weight[v], sum[p][v]);
+                }
+            }
+        }
+    }
+
+    const Float zero = Float::Zero();
+    const Float alpha = Float::Set1(args.alpha);
+    for (int p = 0; p < Pixels; ++p)
+    {
+        for (int v = 0; v < Vectors; ++v)
+        {
+            Float value = sum[p][v];
+            if (args.activation == NeuralActivation::Relu)
+            {
+                value = Max(value, zero);
+            }
+            else if (args.activation == NeuralActivation::LeakyRelu)
+            {
+                value = IfGreater(value, zero, value, value * alpha);
+            }
+            value.Store(output + p * args.outStride + first + v * Float::Width);
+        }
+    }
+}
+
+// 'count' output pixels of one row, output channels [begin, end) (multiples of
+// NeuralChannelBlock). 'input' is the input pixel under the first output pixel.
+inline void NeuralConvolutionRow(const NeuralConvolutionRowArgs& args, const float* input, size_t count, size_t begin,
+    size_t end, float* output)
+{
+    size_t first = begin;
+    for (; first + 2 * Float::Width <= end; first += 2 * Float::Width)
+    {
+        size_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            NeuralConvolutionTile<4, 2>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+        for (; x < count; ++x)
+        {
+            NeuralConvolutionTile<1, 2>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+    }
+    for (; first < end; first += Float::Width)
+    {
+        size_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            NeuralConvolutionTile<4, 1>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+        for (; x < count; ++x)
+        {
+            NeuralConvolutionTile<1, 1>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+    }
+}
+
+// The same tile over int8 values held in int16: DotPairs takes two input channels per
+// step, and the sums are scaled back to float per output channel before the bias and
+// activation.
+template <int Pixels, int Vectors>
+inline void NeuralQuantizedTile(const NeuralQuantizedRowArgs& args, const int16_t* input, size_t first, float* output)
+{
+    Int sum[Pixels][Vectors];
+    for (int p = 0; p < Pixels; ++p)
+    {
+        for (int v = 0; v < Vectors; ++v)
+        {
+            sum[p][v] = Int::Zero();
+        }
+    }
+
+    for (size_t tap = 0; tap < args.taps; ++tap)
+    {
+        const int16_t* in = input + args.offsets[tap];
+        const int32_t* w = args.weights + tap * args.inStride / 2 * args.outStride + first;
+        for (size_t c = 0; c < args.inChannels; c += 2, w += args.outStride)
+        {
+            Int weight[Vectors];
+            for (int v = 0; v < Vectors; ++v)
+            {
+                weight[v] = Int::Load(w + v * Float::Width);
+            }
+            for (int p = 0; p < Pixels; ++p)
+            {
+                const Int x = Int::Set1Pair(in + p * args.inStride + c);
+                for (int v = 0; v < Vectors; ++v)
+                {
+                    sum[p][v] = DotPairs(x, weight[v], sum[p][v]);
+                }
+            }
+        }
+    }
+
+    const Float zero = Float::Zero();
+    const Float alpha = Float::Set1(args.alpha);
+    for (int v = 0; v < Vectors; ++v)
+    {
+        const Float scale = Float::Load(args.scales + first + v * Float::Width);
+        const Float bias = Float::Load(args.bias + first + v * Float::Width);
+        for (int p = 0; p < Pixels; ++p)
+        {
+            Float value = MulAdd(ToFloat(sum[p][v]), scale, bias);
+            if (args.activation == NeuralActivation::Relu)
+            {
+                value = Max(value, zero);
+            }
+            else if (args.activation == NeuralActivation::LeakyRelu)
+            {
+                value = IfGreater(value, zero, value, value * alpha);
+            }
+            value.Store(output + p * args.outStride + first + v * Float::Width);
+        }
+    }
+}
+
+// NeuralConvolutionRow over a quantized input row
+inline void NeuralQuantizedRow(const NeuralQuantizedRowArgs& args, const int16_t* input, size_t count, size_t begin,
+    size_t end, float* output)
+{
+    size_t first = begin;
+    for (; first + 2 * Float::Width <= end; first += 2 * Float::Width)
+    {
+        size_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            NeuralQuantizedTile<4, 2>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+        for (; x < count; ++x)
+        {
+            NeuralQuantizedTile<1, 2>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+    }
+    for (; first < end; first += Float::Width)
+    {
+        size_t x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            NeuralQuantizedTile<4, 1>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+        for (; x < count; ++x)
+        {
+            NeuralQuantizedTile<1, 1>(args, input + x * args.inStride, first, output + x * args.outStride);
+        }
+    }
+}
+
+// 'count' pixels of 'stride' floats times the steps of their channels, rounded and
+// clamped to the int8 range
+inline void NeuralQuantizeRow(const float* input, const float* steps, size_t stride, size_t count, int16_t* output)
+{
+    const Float low = Float::Set1(-127.0f);
+    const Float high = Float::Set1(127.0f);
+    for (size_t x = 0; x < count; ++x, input += stride, output += stride)
+    {
+        for (size_t c = 0; c < stride; c += Float::Width)
+        {
+            const Float value = Float::Load(input + c) * Float::Load(steps + c);
+            Int::Round(Min(Max(value, low), high)).StoreInt16(output + c);
+        }
+    }
+}
+
+// out = activation(a * scale + b) over 'count' floats; 'b' may be null
+inline void NeuralElementwiseRow(const float* a, const float* b, float scale, NeuralActivation activation, float alpha,
+    size_t count, float* out)
+{
+    const Float zero = Float::Zero();
+    const Float s = Float::Set1(scale);
+    const Float leak = Float::Set1(alpha);
+    for (size_t i = 0; i < count; i += Float::Width)
+    {
+        Float value = Float::Load(a + i) * s;
+        if (b)
+        {
+            value = value + Float::Load(b + i);
+        }
+        if (activation == NeuralActivation::Relu)
+        {
+            value = Max(value, zero);
+        }
+        else if (activation == NeuralActivation::LeakyRelu)
+        {
+            value = IfGreater(value, zero, value, value * leak);
+        }
+        value.Store(out + i);
+    }
+}
+
+// 2x2 maximum of 'count' output pixels of 'stride' floats; the last column and row
+// repeat when the input size is odd, so the zero border never takes part
+inline void NeuralMaxPoolRow(const float* row0, const float* row1, size_t inWidth, size_t stride, size_t count, float* out)
+{
+    for (size_t x = 0; x < count; ++x)
+    {
+        const size_t x0 = 2 * x;
+        const size_t x1 = std::min(x0 + 1, inWidth - 1);
+        for (size_t i = 0; i < stride; i += Float::Width)
+        {
+            const Float top = Max(Float::Load(row0 + x0 * stride + i), Float::Load(row0 + x1 * stride + i));
+            const Float bottom = Max(Float::Load(row1 + x0 * stride + i), Float::Load(row1 + x1 * stride + i));
+            Max(top, bottom).Store(out + x * stride + i);
+        }
+    }
+}
@@ -0,0 +1,507 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Process-wide cache of loaded networks, shared by every AI filter of every context.
+// An entry is keyed by a hash of the model file's bytes and the compute type (for int8
+// also the calibration file's bytes), so a model reached by another path or copied
+// elsewhere is still shared, and an edited file is loaded again. The input size is not
+// part of the key: the packed weights do not depend on it.
+//
+// Keys are remembered per path until the file's size or modification time (to the
+// nanosecond where the file system keeps it) changes, so a filter finding its network
+// shared does not read the model. Filters hold their network by shared_ptr and the cache
+// only by weak_ptr, so a network goes with the last filter using it. With a cache
+// directory, a network missing from memory is read from a packed file there (weights
+// already in the layout of the kernels, int8 already quantized) and written to one after
+// a parse. Packed files are in the byte order of the machine and carry a version; ones
+// that do not match are parsed over.
+
+#include "neural_network.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace CpuBackend
+{
+    namespace detail
+    {
+        // FNV-1a, continued from 'hash'
+        inline uint64_t HashBytes(const std::vector<uint8_t>& data, uint64_t hash = 14695981039346656037ull)
+        {
+            for (uint8_t byte : data)
+            {
+                hash = (hash ^ byte) * 1099511628211ull;
+            }
+            return hash;
+        }
+
+        const char PackedNeuralMagic[8] = { 'r', 'i', 'f', 'n', 'n', 'p', 'k', '1' };
+
+        template <typename T>
+        void WritePacked(std::ostream& file, const T& value)
+        {
+            file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        void WritePacked(std::ostream& file, const std::vector<T>& values)
+        {
+            WritePacked(file, uint64_t(values.size()));
+            file.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(T)));
+        }
+
+        template <typename T>
+        bool ReadPacked(std::istream& file, T& value)
+        {
+            return bool(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+        template <typename T>
+        bool ReadPacked(std::istream& file, std::vector<T>& values)
+        {
+            // a count past any real network means a damaged file
+            uint64_t count = 0;
+            if (!ReadPacked(file, count) || count > (uint64_t(1) << 28))
+            {
+                return false;
+            }
+            values.resize(size_t(count));
+            return bool(file.read(reinterpret_cast<char*>(values.data()), std::streamsize(values.size() * sizeof(T))));
+        }
+
+        inline bool ReadPackedSize(std::istream& file, size_t& value)
+        {
+            uint64_t wide = 0;
+            const bool read = ReadPacked(file, wide);
+            value = size_t(wide);
+            return read;
+        }
+
+        // whether the kernels can run 'network' without reading past any tensor or weight
+        // array: each op reads the input or tensors written before it, with the channels
+        // the op expects, and its weights have the size of its geometry
+        inline bool ValidPackedNeuralNetwork(const NeuralNetwork& network)
+        {
+            const size_t tensors = network.tensors;
+            if (network.ops.empty() || network.inputChannels == 0 || network.input < 0 || size_t(network.input) >= tensors ||
+                network.output < 0 || size_t(network.output) >= tensors || network.lastUse.size() != tensors ||
+                network.lastUse[network.output] != network.ops.size())
+            {
+                return false;
+            }
+
+            // the channels of every tensor written so far, 0 for the others
+            std::vector<size_t> channels(tensors, 0);
+            channels[network.input] = network.inputChannels;
+            for (size_t index = 0; index < network.ops.size(); ++index)
+            {
+                const NeuralOp& op = network.ops[index];
+                if (op.inputs.empty() || op.output < 0 || size_t(op.output) >= tensors || channels[op.output] != 0 ||
+                    op.channels == 0 || uint8_t(op.type) > uint8_t(NeuralOpType::Elementwise) ||
+                    uint8_t(op.activation) > uint8_t(NeuralActivation::LeakyRelu) || op.like < -1 || op.like >= int(tensors))
+                {
+                    return false;
+                }
+                size_t sum = 0;
+                for (int tensor : op.inputs)
+                {
+                    if (tensor < 0 || size_t(tensor) >= tensors || channels[tensor] == 0 || network.lastUse[tensor] < index)
+                    {
+                        return false;
+                    }
+                    sum += channels[tensor];
+                }
+
+                const size_t in = channels[op.inputs[0]];
+                const bool single = op.inputs.size() == 1;
+                const size_t taps = op.kernel * op.kernel;
+                const size_t inStride = NeuralStride(op.inChannels);
+                const size_t outStride = NeuralStride(op.channels);
+                bool valid = false;
+                switch (op.type)
+                {
+                case NeuralOpType::Convolution:
+                    valid = single && op.inChannels == in && op.kernel % 2 == 1 && op.kernel <= 3 && op.bias.size() == outStride &&
+                        (op.quantizedWeights.empty() ? op.weights.size() == taps * inStride * outStride :
+                            op.quantizedWeights.size() == taps * inStride / 2 * outStride && op.inputSteps.size() == inStride &&
+                            op.outputScales.size() == outStride);
+                    break;
+                case NeuralOpType::MaxPool:
+                    valid = single && op.channels == in;
+                    break;
+                case NeuralOpType::Upsample:
+                    valid = single && op.channels == in && (op.like >= 0 || op.block > 0);
+                    break;
+                case NeuralOpType::Concat:
+                    valid = op.channels == sum;
+                    break;
+                case NeuralOpType::DepthToSpace:
+                    valid = single && op.block > 0 && op.channels * op.block * op.block == in;
+                    break;
+                case NeuralOpType::Elementwise:
+                    valid = op.inputs.size() <= 2 && sum == op.channels * op.inputs.size() && op.channels == in;
+                    break;
+                }
+                if (!valid)
+                {
+                    return false;
+                }
+                channels[op.output] = op.channels;
+            }
+            return channels[network.output] == network.outputChannels;
+        }
+    }
+
+    // Writes 'network' to 'path' with 'key' (see AcquireNeuralNetwork) in its header. The
+    // file is written under a name of its own and renamed to 'path' once complete, so
+    // other processes reading 'path' never see part of it.
+    inline rif_int SavePackedNeuralNetwork(const std::string& path, uint64_t key, const NeuralNetwork& network)
+    {
+        using detail::WritePacked;
+        static std::atomic<unsigned> written(0);
+#if defined(WIN32) || defined(_WIN32)
+        const int process = _getpid();
+#else
+        const int process = int(getpid());
+#endif
+        const std::string temporary = path + "." + std::to_string(process) + "." + std::to_string(written++) + ".tmp";
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(detail::PackedNeuralMagic, sizeof(detail::PackedNeuralMagic));
+        WritePacked(file, key);
+        WritePacked(file, uint32_t(NeuralChannelBlock));
+        WritePacked(file, uint64_t(network.tensors));
+        WritePacked(file, int32_t(network.input));
+        WritePacked(file, int32_t(network.output));
+        WritePacked(file, uint64_t(network.inputChannels));
+        WritePacked(file, uint64_t(network.outputChannels));
+        WritePacked(file, std::vector<uint64_t>(network.lastUse.begin(), network.lastUse.end()));
+        WritePacked(file, uint64_t(network.ops.size()));
+        for (const NeuralOp& op : network.ops)
+        {
+            WritePacked(file, op.type);
+            WritePacked(file, std::vector<int32_t>(op.inputs.begin(), op.inputs.end()));
+            WritePacked(file, int32_t(op.output));
+            WritePacked(file, uint64_t(op.channels));
+            WritePacked(file, uint64_t(op.kernel));
+            WritePacked(file, uint64_t(op.inChannels));
+            WritePacked(file, op.weights);
+            WritePacked(file, op.bias);
+            WritePacked(file, op.activation);
+            WritePacked(file, op.alpha);
+            WritePacked(file, op.scale);
+            WritePacked(file, uint64_t(op.block));
+            WritePacked(file, int32_t(op.like));
+            WritePacked(file, op.quantizedWeights);
+            WritePacked(file, op.inputSteps);
+            WritePacked(file, op.outputScales);
+        }
+        file.close();
+        if (!file)
+        {
+            std::remove(temporary.c_str());
+            return RIF_ERROR_IO_ERROR;
+        }
+#if defined(WIN32) || defined(_WIN32)
+        // rename does not replace an existing file there
+        std::remove(path.c_str());
+#endif
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return RIF_ERROR_IO_ERROR;
+        }
+        return RIF_SUCCESS;
+    }
+
+    // Reads a network written by SavePackedNeuralNetwork. Returns RIF_ERROR_IO_ERROR when
+    // the file cannot be read and RIF_ERROR_INVALID_PARAMETER when it is not a packed
+    // network of this version for 'key'.
+    inline rif_int LoadPackedNeuralNetwork(const std::string& path, uint64_t key, NeuralNetwork& network)
+    {
+        using detail::ReadPacked;
+        using detail::ReadPackedSize;
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(detail::PackedNeuralMagic)];
+        if (!file.read(magic, sizeof(magic)))
+        {
+            return RIF_ERROR_IO_ERROR;
+        }
+        uint64_t storedKey = 0;
+        uint32_t block = 0;
+        if (!std::equal(magic, magic + sizeof(magic), detail::PackedNeuralMagic) || !ReadPacked(file, storedKey) ||
+            storedKey != key || !ReadPacked(file, block) || block != NeuralChannelBlock)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        NeuralNetwork result;
+        int32_t input = -1;
+        int32_t output = -1;
+        std::vector<uint64_t> lastUse;
+        size_t count = 0;
+        bool read = ReadPackedSize(file, result.tensors) && ReadPacked(file, input) && ReadPacked(file, output) &&
+            ReadPackedSize(file, result.inputChannels) && ReadPackedSize(file, result.outputChannels) &&
+            ReadPacked(file, lastUse) && ReadPackedSize(file, count) && count <= result.tensors;
+        result.input = input;
+        result.output = output;
+        result.lastUse.assign(lastUse.begin(), lastUse.end());
+        result.ops.resize(read ? count : 0);
+        for (NeuralOp& op : result.ops)
+        {
+            std::vector<int32_t> inputs;
+            int32_t opOutput = -1;
+            int32_t like = -1;
+            read = read && ReadPacked(file, op.type) && ReadPacked(file, inputs) && ReadPacked(file, opOutput) &&
+                ReadPackedSize(file, op.channels) && ReadPackedSize(file, op.kernel) && ReadPackedSize(file, op.inChannels) &&
+                ReadPacked(file, op.weights) && ReadPacked(file, op.bias) && ReadPacked(file, op.activation) &&
+                ReadPacked(file, op.alpha) && ReadPacked(file, op.scale) && ReadPackedSize(file, op.block) &&
+                ReadPacked(file, like) && ReadPacked(file, op.quantizedWeights) && ReadPacked(file, op.inputSteps) &&
+                ReadPacked(file, op.outputScales);
+            op.inputs.assign(inputs.begin(), inputs.end());
+            op.output = opOutput;
+            op.like = like;
+        }
+        if (!read || !detail::ValidPackedNeuralNetwork(result))
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        network = std::move(result);
+        return RIF_SUCCESS;
+    }
+
+    namespace detail
+    {
+        // size and modification time (in nanoseconds) of a file; size -1 when there is none
+        struct FileStamp
+        {
+            int64_t size = -1;
+            int64_t time = 0;
+
+            bool operator==(const FileStamp& other) const
+            {
+                return size == other.size && time == other.time;
+            }
+        };
+
+        inline FileStamp StampFile(const std::string& path)
+        {
+            FileStamp stamp;
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0)
+            {
+                stamp.size = int64_t(info.st_size);
+                stamp.time = int64_t(info.st_mtime) * 1000000000;
+                // within a second only the size would tell a quick edit apart
+#if defined(__APPLE__)
+                stamp.time += int64_t(info.st_mtimespec.tv_nsec);
+#elif !defined(WIN32) && !defined(_WIN32)
+                stamp.time += int64_t(info.st_mtim.tv_nsec);
+#endif
+            }
+            return stamp;
+        }
+
+        // the key of a model path, valid while the stamps of its files stay the same
+        struct NeuralKeyMemo
+        {
+            FileStamp model;
+            FileStamp calibration;
+            uint64_t key = 0;
+        };
+
+        struct NeuralNetworkCache
+        {
+            std::mutex mutex;
+            std::map<std::pair<uint64_t, bool>, std::weak_ptr<const NeuralNetwork>> networks;
+            std::map<std::pair<std::string, bool>, NeuralKeyMemo> keys;
+        };
+
+        inline NeuralNetworkCache& GetNeuralNetworkCache()
+        {
+            static NeuralNetworkCache cache;
+            return cache;
+        }
+    }
+
+    // The cache key of the model at 'modelPath': a hash of its bytes and, when
+    // 'quantized', of its calibration file's. The files are only read again when their
+    // size or modification time changes. RIF_ERROR_IO_ERROR if either is unreadable.
+    inline rif_int NeuralNetworkKey(const std::string& modelPath, bool quantized, uint64_t& key)
+    {
+        detail::NeuralKeyMemo memo;
+        memo.model = detail::StampFile(modelPath);
+        if (quantized)
+        {
+            memo.calibration = detail::StampFile(NeuralCalibrationPath(modelPath));
+        }
+        detail::NeuralNetworkCache& cache = detail::GetNeuralNetworkCache();
+        const std::pair<std::string, bool> name(modelPath, quantized);
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.keys.find(name);
+            if (found != cache.keys.end() && memo.model.size >= 0 && found->second.model == memo.model &&
+                found->second.calibration == memo.calibration)
+            {
+                key = found->second.key;
+                return RIF_SUCCESS;
+            }
+        }
+
+        std::vector<uint8_t> data;
+        if (!detail::ReadNeuralFile(modelPath, data))
+        {
+            return RIF_ERROR_IO_ERROR;
+        }
+        key = detail::HashBytes(data);
+        if (quantized)
+        {
+            if (!detail::ReadNeuralFile(NeuralCalibrationPath(modelPath), data))
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+            key = detail::HashBytes(data, key);
+        }
+        memo.key = key;
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.keys[name] = memo;
+        return RIF_SUCCESS;
+    }
+
+    // the packed file of 'key' in 'cacheDirectory'
+    inline std::string PackedNeuralNetworkPath(const std::string& cacheDirectory, uint64_t key)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string name(16, '0');
+        for (int i = 15; i >= 0; --i, key >>= 4)
+        {
+            name[i] = digits[key & 15];
+        }
+        const char last = cacheDirectory.empty() ? '/' : cacheDirectory.back();
+        return cacheDirectory + (last == '/' || last == '\\' ? "" : "/") + name + ".rifnn";
+    }
+
+    // The network of the model at 'modelPath', int8 quantized with its calibration file
+    // (see NeuralCalibrationPath) when 'quantized', shared with every other caller
+    // asking for the same bytes. 'cacheDirectory' may be empty. Fails as
+    // LoadNeuralNetwork, LoadNeuralCalibration and QuantizeNeuralNetwork do.
+    inline rif_int AcquireNeuralNetwork(const std::string& modelPath, bool quantized, const std::string& cacheDirectory,
+        std::shared_ptr<const NeuralNetwork>& network)
+    {
+        uint64_t key = 0;
+        rif_int status = NeuralNetworkKey(modelPath, quantized, key);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        detail::NeuralNetworkCache& cache = detail::GetNeuralNetworkCache();
+        {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            auto found = cache.networks.find(std::make_pair(key, quantized));
+            if (found != cache.networks.end())
+            {
+                if (std::shared_ptr<const NeuralNetwork> shared = found->second.lock())
+                {
+                    network = std::move(shared);
+                    return RIF_SUCCESS;
+                }
+            }
+        }
+
+        // loaded outside the lock; when two threads race for one model the first insert wins
+        std::shared_ptr<NeuralNetwork> loaded = std::make_shared<NeuralNetwork>();
+        const std::string packedPath = cacheDirectory.empty() ? std::string() : PackedNeuralNetworkPath(cacheDirectory, key);
+        if (packedPath.empty() || LoadPackedNeuralNetwork(packedPath, key, *loaded) != RIF_SUCCESS)
+        {
+            status = LoadNeuralNetwork(modelPath, *loaded);
+            if (status == RIF_SUCCESS && quantized)
+            {
+                NeuralCalibration ranges;
+                NeuralNetwork parsed = std::move(*loaded);
+                status = LoadNeuralCalibration(NeuralCalibrationPath(modelPath), parsed, ranges);
+                if (status == RIF_SUCCESS)
+                {
+                    status = QuantizeNeuralNetwork(parsed, ranges, *loaded);
+                }
+            }
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            // the packed file only saves time later, so failing to write it is not an error
+            if (!packedPath.empty())
+            {
+                SavePackedNeuralNetwork(packedPath, key, *loaded);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        for (auto i = cache.networks.begin(); i != cache.networks.end();)
+        {
+            i = i->second.expired() ? cache.networks.erase(i) : std::next(i);
+        }
+        std::weak_ptr<const NeuralNetwork>& entry = cache.networks[std::make_pair(key, quantized)];
+        if (std::shared_ptr<const NeuralNetwork> shared = entry.lock())
+        {
+            network = std::move(shared);
+            return RIF_SUCCESS;
+        }
+        network = std::move(loaded);
+        entry = network;
+        return RIF_SUCCESS;
+    }
+
+    // Drops the remembered keys and the entries of networks no filter holds any more;
+    // returns how many networks are left.
+    inline size_t TrimNeuralNetworkCache()
+    {
+        detail::NeuralNetworkCache& cache = detail::GetNeuralNetworkCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.keys.clear();
+        for (auto i = cache.networks.begin(); i != cache.networks.end();)
+        {
+            i = i->second.expired() ? cache.networks.erase(i) : std::next(i);
+        }
+        return cache.networks.size();
+    }
+}
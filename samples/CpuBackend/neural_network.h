@@ -0,0 +1,2101 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Host inference of the convolutional networks RIF ships in models/: the ONNX models
+// and the TensorFlow GraphDefs (.pb) are read with a protobuf wire reader and turned
+// into a short list of operations: convolutions with their bias and activation fused,
+// 2x2 max pooling, nearest upsampling, channel concatenation, depth to space and
+// scaled additions. Other operators fail the load with RIF_ERROR_UNSUPPORTED.
+//
+// Activations are NHWC with the channels of a pixel padded to a multiple of
+// NeuralChannelBlock and a one pixel zero border around the image, so 3x3 convolutions
+// with SAME padding read their halo without bounds checks and every pixel is whole
+// vectors for all instruction sets. Convolutions are direct: weights are repacked at
+// load time to [tap][input channel][output channel], and each tile accumulates a few
+// pixels by a few output channel vectors in registers. Rows and output channel groups
+// are the parallel tasks. Weights stored as float16 or bfloat16 are widened at load.
+//
+// Networks compute in float32 unless quantized: CalibrateNeuralNetwork records the
+// range of every input channel of every convolution over sample inputs, and
+// QuantizeNeuralNetwork turns those ranges into int8 convolutions. Each input channel
+// gets its own step, which is folded into the weights, and the weights of each output
+// channel get their own scale; the int8 values are held in int16 and multiplied in
+// pairs into 32-bit sums, with vpdpwssd where the CPU has AVX512-VNNI. Each quantized
+// convolution rounds its float32 input first; the other operations and the activations
+// between operations stay float32.
+
+#include "filter.h"
+#include "protobuf_reader.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+// rif_compute_type extension only understood by the host backend
+#ifndef RIF_COMPUTE_TYPE_INT8
+#define RIF_COMPUTE_TYPE_INT8 0x1000u
+#endif
+
+namespace CpuBackend
+{
+    const size_t NeuralChannelBlock = 16;
+
+    enum class NeuralActivation : uint8_t
+    {
+        None,
+        Relu,
+        LeakyRelu,
+    };
+
+    struct NeuralConvolutionRowArgs
+    {
+        const float* weights;           // [tap][inStride][outStride]
+        const float* bias;              // outStride
+        const ptrdiff_t* offsets;       // input offset of every tap, in floats
+        size_t taps;
+        size_t inChannels;
+        size_t inStride;                // floats per input pixel
+        size_t outStride;               // floats per output pixel
+        NeuralActivation activation;
+        float alpha;
+    };
+
+    struct NeuralQuantizedRowArgs
+    {
+        const int32_t* weights;         // [tap][inStride / 2][outStride], pairs of int16
+        const float* scales;            // outStride, of the sums
+        const float* bias;              // outStride
+        const ptrdiff_t* offsets;       // input offset of every tap, in values
+        size_t taps;
+        size_t inChannels;
+        size_t inStride;                // values per input pixel
+        size_t outStride;               // floats per output pixel
+        NeuralActivation activation;
+        float alpha;
+    };
+
+    namespace NeuralScalar
+    {
+        using simd::Scalar::Float;
+        using simd::Scalar::Int;
+#include "neural_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace NeuralSse
+    {
+        using simd::Sse::Float;
+        using simd::Sse::Int;
+#include "neural_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace NeuralAvx2
+    {
+        using simd::Avx2::Float;
+        using simd::Avx2::Int;
+#include "neural_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace NeuralAvx512
+    {
+        using simd::Avx512::Float;
+        using simd::Avx512::Int;
+#include "neural_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+
+    CPU_BACKEND_AVX512VNNI_BEGIN
+    namespace NeuralAvx512Vnni
+    {
+        using simd::Avx512Vnni::Float;
+        using simd::Avx512Vnni::Int;
+#include "neural_kernels.inl"
+    }
+    CPU_BACKEND_AVX512VNNI_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace NeuralNeon
+    {
+        using simd::Neon::Float;
+        using simd::Neon::Int;
+#include "neural_kernels.inl"
+    }
+#endif
+
+    // NHWC activations of 'Channels()' channels padded to 'Stride()' floats per pixel,
+    // with one pixel of zeros around the image
+    class NeuralTensor
+    {
+    public:
+        void Resize(size_t width, size_t height, size_t channels)
+        {
+            m_width = width;
+            m_height = height;
+            m_channels = channels;
+            m_stride = (channels + NeuralChannelBlock - 1) / NeuralChannelBlock * NeuralChannelBlock;
+            m_rowPitch = (width + 2) * m_stride;
+            m_data.assign((height + 2) * m_rowPitch, 0.0f);
+        }
+
+        size_t Width() const
+        {
+            return m_width;
+        }
+
+        size_t Height() const
+        {
+            return m_height;
+        }
+
+        size_t Channels() const
+        {
+            return m_channels;
+        }
+
+        size_t Stride() const
+        {
+            return m_stride;
+        }
+
+        size_t RowPitch() const
+        {
+            return m_rowPitch;
+        }
+
+        // x and y may be -1 or the width and height, which are the border
+        float* Pixel(long x, long y)
+        {
+            return m_data.data() + (y + 1) * m_rowPitch + (x + 1) * m_stride;
+        }
+
+        const float* Pixel(long x, long y) const
+        {
+            return m_data.data() + (y + 1) * m_rowPitch + (x + 1) * m_stride;
+        }
+
+        bool SameShape(size_t width, size_t height, size_t channels) const
+        {
+            return m_width == width && m_height == height && m_channels == channels;
+        }
+
+        // the size of the last Resize, which later Reshapes fit in
+        size_t CapacityWidth() const
+        {
+            return m_stride ? m_rowPitch / m_stride - 2 : 0;
+        }
+
+        size_t CapacityHeight() const
+        {
+            return m_rowPitch ? m_data.size() / m_rowPitch - 2 : 0;
+        }
+
+        // width x height in the storage of the last Resize, keeping the row pitch and
+        // clearing the new border; false if it does not fit
+        bool Reshape(size_t width, size_t height)
+        {
+            if (width == m_width && height == m_height)
+            {
+                return true;
+            }
+            if (width > CapacityWidth() || height > CapacityHeight())
+            {
+                return false;
+            }
+            m_width = width;
+            m_height = height;
+            std::fill(Pixel(-1, long(height)), Pixel(long(width) + 1, long(height)), 0.0f);
+            for (size_t y = 0; y < height; ++y)
+            {
+                std::fill(Pixel(long(width), long(y)), Pixel(long(width) + 1, long(y)), 0.0f);
+            }
+            return true;
+        }
+
+    private:
+        size_t m_width = 0;
+        size_t m_height = 0;
+        size_t m_channels = 0;
+        size_t m_stride = 0;
+        size_t m_rowPitch = 0;
+        std::vector<float> m_data;
+    };
+
+    enum class NeuralOpType : uint8_t
+    {
+        Convolution,
+        MaxPool,            // 2x2, stride 2, the output rounded up
+        Upsample,           // nearest, to the size of tensor 'like' or by 'block'
+        Concat,             // channels of the inputs in order
+        DepthToSpace,       // 'block' x 'block' pixels from groups of channels
+        Elementwise,        // activation(inputs[0] * scale + inputs[1])
+    };
+
+    struct NeuralOp
+    {
+        NeuralOpType type = NeuralOpType::Elementwise;
+        std::vector<int> inputs;
+        int output = -1;
+        size_t channels = 0;                // of the output
+        size_t kernel = 1;                  // convolution width and height, odd
+        size_t inChannels = 0;
+        std::vector<float> weights;         // [ky][kx][input stride][output stride]
+        std::vector<float> bias;            // output stride
+        NeuralActivation activation = NeuralActivation::None;
+        float alpha = 0.0f;                 // slope of LeakyRelu below 0
+        float scale = 1.0f;
+        size_t block = 2;
+        int like = -1;
+
+        // set by QuantizeNeuralNetwork, which clears 'weights'
+        std::vector<int32_t> quantizedWeights;  // [ky][kx][input stride / 2][output stride], int8 values in int16 pairs
+        std::vector<float> inputSteps;          // input stride, the inverse of each channel's quantization step
+        std::vector<float> outputScales;        // output stride, the value of one unit of the integer sums
+    };
+
+    struct NeuralNetwork
+    {
+        std::vector<NeuralOp> ops;
+        size_t tensors = 0;
+        int input = -1;
+        int output = -1;
+        size_t inputChannels = 0;
+        size_t outputChannels = 0;
+        std::vector<size_t> lastUse;        // per tensor, the last op reading it
+        std::string error;                  // why the load failed
+
+        // the sizes of all tensors for an input of width x height; false if the
+        // network cannot run on it
+        bool InferSizes(size_t width, size_t height, std::vector<std::pair<size_t, size_t>>& sizes) const
+        {
+            sizes.assign(tensors, std::make_pair(size_t(0), size_t(0)));
+            sizes[input] = std::make_pair(width, height);
+            for (const NeuralOp& op : ops)
+            {
+                std::pair<size_t, size_t> size = sizes[op.inputs[0]];
+                switch (op.type)
+                {
+                case NeuralOpType::MaxPool:
+                    size = std::make_pair((size.first + 1) / 2, (size.second + 1) / 2);
+                    break;
+                case NeuralOpType::Upsample:
+                    size = op.like >= 0 ? sizes[op.like] : std::make_pair(size.first * op.block, size.second * op.block);
+                    break;
+                case NeuralOpType::DepthToSpace:
+                    size = std::make_pair(size.first * op.block, size.second * op.block);
+                    break;
+                case NeuralOpType::Concat:
+                case NeuralOpType::Elementwise:
+                    for (int input : op.inputs)
+                    {
+                        if (sizes[input] != size)
+                        {
+                            return false;
+                        }
+                    }
+                    break;
+                default:
+                    break;
+                }
+                if (size.first == 0 || size.second == 0)
+                {
+                    return false;
+                }
+                sizes[op.output] = size;
+            }
+            return true;
+        }
+
+        // multiply-adds of the convolutions for an input of width x height
+        double MultiplyAdds(size_t width, size_t height) const
+        {
+            std::vector<std::pair<size_t, size_t>> sizes;
+            if (!InferSizes(width, height, sizes))
+            {
+                return 0.0;
+            }
+            double total = 0.0;
+            for (const NeuralOp& op : ops)
+            {
+                if (op.type == NeuralOpType::Convolution)
+                {
+                    total += double(sizes[op.output].first) * sizes[op.output].second * op.kernel * op.kernel * op.inChannels * op.channels;
+                }
+            }
+            return total;
+        }
+
+        // weight of output channel 'o' for input channel 'i' at tap (kx, ky) of 'op',
+        // which must not be quantized
+        static float Weight(const NeuralOp& op, size_t o, size_t i, size_t kx, size_t ky)
+        {
+            const size_t inStride = (op.inChannels + NeuralChannelBlock - 1) / NeuralChannelBlock * NeuralChannelBlock;
+            const size_t outStride = op.bias.size();
+            return op.weights[((ky * op.kernel + kx) * inStride + i) * outStride + o];
+        }
+    };
+
+    // per operation, the largest |value| seen in each input channel of the convolutions
+    // (empty for the other operations)
+    struct NeuralCalibration
+    {
+        std::vector<std::vector<float>> ranges;
+    };
+
+    namespace detail
+    {
+        struct NeuralKernels
+        {
+            void (*convolutionRow)(const NeuralConvolutionRowArgs&, const float*, size_t, size_t, size_t, float*);
+            void (*quantizedRow)(const NeuralQuantizedRowArgs&, const int16_t*, size_t, size_t, size_t, float*);
+            void (*quantizeRow)(const float*, const float*, size_t, size_t, int16_t*);
+            void (*elementwiseRow)(const float*, const float*, float, NeuralActivation, float, size_t, float*);
+            void (*maxPoolRow)(const float*, const float*, size_t, size_t, size_t, float*);
+            int width;
+        };
+
+        inline NeuralKernels SelectNeuralKernels(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                if (simd::CurrentAvx512Vnni())
+                {
+                    return { NeuralAvx512::NeuralConvolutionRow, NeuralAvx512Vnni::NeuralQuantizedRow, NeuralAvx512::NeuralQuantizeRow,
+                        NeuralAvx512::NeuralElementwiseRow, NeuralAvx512::NeuralMaxPoolRow, NeuralAvx512::Float::Width };
+                }
+                return { NeuralAvx512::NeuralConvolutionRow, NeuralAvx512::NeuralQuantizedRow, NeuralAvx512::NeuralQuantizeRow,
+                    NeuralAvx512::NeuralElementwiseRow,
+                    NeuralAvx512::NeuralMaxPoolRow, NeuralAvx512::Float::Width };
+            case simd::Level::Avx2:
+                return { NeuralAvx2::NeuralConvolutionRow, NeuralAvx2::NeuralQuantizedRow, NeuralAvx2::NeuralQuantizeRow,
+                    NeuralAvx2::NeuralElementwiseRow,
+                    NeuralAvx2::NeuralMaxPoolRow, NeuralAvx2::Float::Width };
+            case simd::Level::Sse:
+                return { NeuralSse::NeuralConvolutionRow, NeuralSse::NeuralQuantizedRow, NeuralSse::NeuralQuantizeRow,
+                    NeuralSse::NeuralElementwiseRow,
+                    NeuralSse::NeuralMaxPoolRow, NeuralSse::Float::Width };
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return { NeuralNeon::NeuralConvolutionRow, NeuralNeon::NeuralQuantizedRow, NeuralNeon::NeuralQuantizeRow,
+                    NeuralNeon::NeuralElementwiseRow,
+                    NeuralNeon::NeuralMaxPoolRow, NeuralNeon::Float::Width };
+#endif
+            default:
+                return { NeuralScalar::NeuralConvolutionRow, NeuralScalar::NeuralQuantizedRow, NeuralScalar::NeuralQuantizeRow,
+                    NeuralScalar::NeuralElementwiseRow,
+                    NeuralScalar::NeuralMaxPoolRow, NeuralScalar::Float::Width };
+            }
+        }
+
+        inline size_t NeuralStride(size_t channels)
+        {
+            return (channels + NeuralChannelBlock - 1) / NeuralChannelBlock * NeuralChannelBlock;
+        }
+
+        inline float HalfToFloat(uint16_t half)
+        {
+            const uint32_t sign = uint32_t(half & 0x8000) << 16;
+            const uint32_t exponent = (half >> 10) & 0x1f;
+            uint32_t mantissa = half & 0x3ff;
+            uint32_t bits;
+            if (exponent == 0x1f)
+            {
+                bits = sign | 0x7f800000 | (mantissa << 13);
+            }
+            else if (exponent != 0)
+            {
+                bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+            }
+            else if (mantissa == 0)
+            {
+                bits = sign;
+            }
+            else
+            {
+                // subnormal: normalize the mantissa
+                int shift = 0;
+                while ((mantissa & 0x400) == 0)
+                {
+                    mantissa <<= 1;
+                    ++shift;
+                }
+                bits = sign | (uint32_t(113 - shift) << 23) | ((mantissa & 0x3ff) << 13);
+            }
+            float value;
+            std::memcpy(&value, &bits, 4);
+            return value;
+        }
+
+        // a constant of the model file, widened to float
+        struct NeuralConstant
+        {
+            std::vector<int64_t> dims;
+            std::vector<float> values;
+        };
+
+        // Collects the operations of a model in file order, which both formats keep
+        // topological, then fuses activations into convolutions and drops what the
+        // output does not need.
+        class NeuralGraphBuilder
+        {
+        public:
+            explicit NeuralGraphBuilder(NeuralNetwork& network)
+                : m_network(network)
+            {
+                m_network = NeuralNetwork();
+            }
+
+            rif_int Fail(rif_int status, const std::string& message)
+            {
+                if (m_status == RIF_SUCCESS)
+                {
+                    m_status = status;
+                    m_network.error = message;
+                }
+                return m_status;
+            }
+
+            rif_int Status() const
+            {
+                return m_status;
+            }
+
+            void SetInput(const std::string& name, size_t channels)
+            {
+                m_network.input = NewTensor(channels);
+                m_network.inputChannels = channels;
+                m_values[name] = m_network.input;
+            }
+
+            void SetConstant(const std::string& name, NeuralConstant constant)
+            {
+                m_constants[name] = std::move(constant);
+            }
+
+            const NeuralConstant* Constant(const std::string& name) const
+            {
+                auto it = m_constants.find(name);
+                return it == m_constants.end() ? nullptr : &it->second;
+            }
+
+            // -1 and a failure when 'name' is not a tensor computed so far
+            int Value(const std::string& name)
+            {
+                auto it = m_values.find(name);
+                if (it == m_values.end())
+                {
+                    Fail(RIF_ERROR_INVALID_PARAMETER, "unknown tensor " + name);
+                    return -1;
+                }
+                return it->second;
+            }
+
+            void Alias(const std::string& name, int tensor)
+            {
+                m_values[name] = tensor;
+            }
+
+            // ONNX Shape: only the spatial size of 'tensor' is ever used
+            void SetShape(const std::string& name, int tensor)
+            {
+                m_shapes[name] = tensor;
+            }
+
+            int Shape(const std::string& name) const
+            {
+                auto it = m_shapes.find(name);
+                return it == m_shapes.end() ? -1 : it->second;
+            }
+
+            // the op producing 'tensor', or nullptr for the input
+            NeuralOp* Producer(int tensor)
+            {
+                for (NeuralOp& op : m_network.ops)
+                {
+                    if (op.output == tensor)
+                    {
+                        return &op;
+                    }
+                }
+                return nullptr;
+            }
+
+            size_t Channels(int tensor) const
+            {
+                return tensor >= 0 ? m_channels[tensor] : 0;
+            }
+
+            // appends 'op' computing 'name'
+            void Add(const std::string& name, NeuralOp op)
+            {
+                for (int input : op.inputs)
+                {
+                    if (input < 0)
+                    {
+                        Fail(RIF_ERROR_INVALID_PARAMETER, "missing input of " + name);
+                        return;
+                    }
+                }
+                op.output = NewTensor(op.channels);
+                m_values[name] = op.output;
+                m_network.ops.push_back(std::move(op));
+            }
+
+            // 'weights' are [output][input][ky][kx] when 'oihw', otherwise [ky][kx][input][output]
+            void AddConvolution(const std::string& name, int input, const NeuralConstant& weights, bool oihw, const NeuralConstant* bias)
+            {
+                if (weights.dims.size() != 4)
+                {
+                    Fail(RIF_ERROR_INVALID_PARAMETER, "convolution weights of " + name + " are not 4D");
+                    return;
+                }
+                NeuralOp op;
+                op.type = NeuralOpType::Convolution;
+                op.inputs.push_back(input);
+                op.channels = size_t(oihw ? weights.dims[0] : weights.dims[3]);
+                op.inChannels = size_t(oihw ? weights.dims[1] : weights.dims[2]);
+                op.kernel = size_t(oihw ? weights.dims[2] : weights.dims[0]);
+                const size_t kernelX = size_t(oihw ? weights.dims[3] : weights.dims[1]);
+                if (op.kernel != kernelX || op.kernel % 2 == 0 || op.kernel > 3)
+                {
+                    Fail(RIF_ERROR_UNSUPPORTED, "convolution " + name + " is not 1x1 or 3x3");
+                    return;
+                }
+                if (op.inChannels != Channels(input))
+                {
+                    Fail(RIF_ERROR_INVALID_PARAMETER, "convolution " + name + " expects another channel count");
+                    return;
+                }
+                if (weights.values.size() != op.channels * op.inChannels * op.kernel * op.kernel ||
+                    (bias && bias->values.size() != op.channels))
+                {
+                    Fail(RIF_ERROR_INVALID_PARAMETER, "weights of " + name + " have the wrong size");
+                    return;
+                }
+
+                const size_t inStride = NeuralStride(op.inChannels);
+                const size_t outStride = NeuralStride(op.channels);
+                const size_t k = op.kernel;
+                op.weights.assign(k * k * inStride * outStride, 0.0f);
+                op.bias.assign(outStride, 0.0f);
+                for (size_t o = 0; o < op.channels; ++o)
+                {
+                    for (size_t i = 0; i < op.inChannels; ++i)
+                    {
+                        for (size_t ky = 0; ky < k; ++ky)
+                        {
+                            for (size_t kx = 0; kx < k; ++kx)
+                            {
+                                const size_t source = oihw ? ((o * op.inChannels + i) * k + ky) * k + kx :
+                                    ((ky * k + kx) * op.inChannels + i) * op.channels + o;
+                                op.weights[((ky * k + kx) * inStride + i) * outStride + o] = weights.values[source];
+                            }
+                        }
+                    }
+                    op.bias[o] = bias ? bias->values[o] : 0.0f;
+                }
+                Add(name, std::move(op));
+            }
+
+            void AddActivation(const std::string& name, int input, NeuralActivation activation, float alpha)
+            {
+                NeuralOp op;
+                op.type = NeuralOpType::Elementwise;
+                op.inputs.push_back(input);
+                op.channels = Channels(input);
+                op.activation = activation;
+                op.alpha = alpha;
+                Add(name, std::move(op));
+            }
+
+            void AddConcat(const std::string& name, const std::vector<int>& inputs)
+            {
+                NeuralOp op;
+                op.type = NeuralOpType::Concat;
+                op.inputs = inputs;
+                for (int input : inputs)
+                {
+                    op.channels += Channels(input);
+                }
+                Add(name, std::move(op));
+            }
+
+            // fuses activations into the convolutions before them, removes operations
+            // the output does not depend on and finds where each tensor is last read
+            rif_int Finish(int output)
+            {
+                if (m_status != RIF_SUCCESS)
+                {
+                    return m_status;
+                }
+                if (output < 0 || m_network.input < 0)
+                {
+                    return Fail(RIF_ERROR_INVALID_PARAMETER, "the model has no input or output");
+                }
+                m_network.output = output;
+                m_network.outputChannels = Channels(output);
+
+                std::vector<NeuralOp>& ops = m_network.ops;
+                for (size_t i = 0; i < ops.size(); ++i)
+                {
+                    NeuralOp& op = ops[i];
+                    if (op.type != NeuralOpType::Elementwise || op.inputs.size() != 1 || op.scale != 1.0f)
+                    {
+                        continue;
+                    }
+                    NeuralOp* producer = Producer(op.inputs[0]);
+                    if (!producer || producer->type != NeuralOpType::Convolution || producer->activation != NeuralActivation::None ||
+                        Uses(op.inputs[0]) != 1 || op.inputs[0] == output)
+                    {
+                        continue;
+                    }
+                    producer->activation = op.activation;
+                    producer->alpha = op.alpha;
+                    Rename(op.output, producer->output);
+                    if (output == op.output)
+                    {
+                        output = producer->output;
+                    }
+                    op.inputs.clear();
+                }
+
+                // dead operations, last first so their inputs become dead too
+                std::vector<bool> live(m_channels.size(), false);
+                live[output] = true;
+                std::vector<NeuralOp> kept;
+                for (size_t i = ops.size(); i-- > 0;)
+                {
+                    if (ops[i].inputs.empty() || !live[ops[i].output])
+                    {
+                        continue;
+                    }
+                    for (int input : ops[i].inputs)
+                    {
+                        live[input] = true;
+                    }
+                    if (ops[i].like >= 0)
+                    {
+                        live[ops[i].like] = true;
+                    }
+                    kept.push_back(std::move(ops[i]));
+                }
+                std::reverse(kept.begin(), kept.end());
+                ops = std::move(kept);
+                m_network.output = output;
+                m_network.tensors = m_channels.size();
+
+                m_network.lastUse.assign(m_network.tensors, 0);
+                for (size_t i = 0; i < ops.size(); ++i)
+                {
+                    for (int input : ops[i].inputs)
+                    {
+                        m_network.lastUse[input] = i;
+                    }
+                }
+                m_network.lastUse[output] = ops.size();
+                return ops.empty() ? Fail(RIF_ERROR_INVALID_PARAMETER, "the model computes nothing") : RIF_SUCCESS;
+            }
+
+        private:
+            int NewTensor(size_t channels)
+            {
+                m_channels.push_back(channels);
+                return int(m_channels.size() - 1);
+            }
+
+            size_t Uses(int tensor) const
+            {
+                size_t uses = 0;
+                for (const NeuralOp& op : m_network.ops)
+                {
+                    uses += std::count(op.inputs.begin(), op.inputs.end(), tensor);
+                }
+                return uses;
+            }
+
+            void Rename(int from, int to)
+            {
+                for (NeuralOp& op : m_network.ops)
+                {
+                    std::replace(op.inputs.begin(), op.inputs.end(), from, to);
+                    if (op.like == from)
+                    {
+                        op.like = to;
+                    }
+                }
+            }
+
+            NeuralNetwork& m_network;
+            rif_int m_status = RIF_SUCCESS;
+            std::vector<size_t> m_channels;
+            std::map<std::string, int> m_values;
+            std::map<std::string, int> m_shapes;
+            std::map<std::string, NeuralConstant> m_constants;
+        };
+
+        inline bool ReadNeuralFile(const std::string& path, std::vector<uint8_t>& data)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            const std::streamoff size = file ? std::streamoff(file.tellg()) : 0;
+            if (size <= 0)
+            {
+                return false;
+            }
+            data.resize(size_t(size));
+            file.seekg(0);
+            return bool(file.read(reinterpret_cast<char*>(data.data()), size));
+        }
+
+        //
+        // ONNX
+        //
+
+        // TensorProto: dims 1, data_type 2, float_data 4, int32_data 5, name 8, raw_data 9
+        inline bool ReadOnnxTensor(ProtobufReader reader, std::string& name, NeuralConstant& constant)
+        {
+            int64_t type = 0;
+            std::vector<int64_t> halves;
+            const uint8_t* raw = nullptr;
+            size_t rawSize = 0;
+            while (reader.Next())
+            {
+                switch (reader.Field())
+                {
+                case 1: reader.AppendInts(constant.dims); break;
+                case 2: type = reader.Int(); break;
+                case 4: reader.AppendFloats(constant.values); break;
+                case 5: reader.AppendInts(halves); break;
+                case 8: name = reader.String(); break;
+                case 9: raw = reader.Data(); rawSize = reader.Size(); break;
+                default: break;
+                }
+            }
+
+            // float, float16 and bfloat16
+            if (type == 1 && raw)
+            {
+                constant.values.resize(rawSize / 4);
+                std::memcpy(constant.values.data(), raw, constant.values.size() * 4);
+            }
+            else if (type == 10 || type == 16)
+            {
+                std::vector<uint16_t> bits(halves.begin(), halves.end());
+                if (raw)
+                {
+                    bits.resize(rawSize / 2);
+                    std::memcpy(bits.data(), raw, bits.size() * 2);
+                }
+                for (uint16_t b : bits)
+                {
+                    float value;
+                    const uint32_t wide = uint32_t(b) << 16;
+                    std::memcpy(&value, &wide, 4);
+                    constant.values.push_back(type == 10 ? HalfToFloat(b) : value);
+                }
+            }
+            else if (type == 7 && raw)
+            {
+                // int64, only ever shapes and axes
+                for (size_t i = 0; i + 8 <= rawSize; i += 8)
+                {
+                    int64_t value;
+                    std::memcpy(&value, raw + i, 8);
+                    constant.values.push_back(float(value));
+                }
+            }
+            return !reader.Failed();
+        }
+
+        struct OnnxAttribute
+        {
+            int64_t i = 0;
+            float f = 0.0f;
+            std::string s;
+            std::vector<int64_t> ints;
+        };
+
+        // the attributes of a NodeProto by name: name 1, f 2, i 3, s 4, ints 8
+        inline std::map<std::string, OnnxAttribute> ReadOnnxAttributes(const std::vector<ProtobufReader>& attributes)
+        {
+            std::map<std::string, OnnxAttribute> result;
+            for (ProtobufReader reader : attributes)
+            {
+                std::string name;
+                OnnxAttribute attribute;
+                while (reader.Next())
+                {
+                    switch (reader.Field())
+                    {
+                    case 1: name = reader.String(); break;
+                    case 2: attribute.f = reader.Float(); break;
+                    case 3: attribute.i = reader.Int(); break;
+                    case 4: attribute.s = reader.String(); break;
+                    case 8: reader.AppendInts(attribute.ints); break;
+                    default: break;
+                    }
+                }
+                result[name] = attribute;
+            }
+            return result;
+        }
+
+        // stride 1, no dilation, one group and SAME or symmetric k / 2 padding
+        inline bool OnnxSamePadding(std::map<std::string, OnnxAttribute>& attributes, size_t kernel)
+        {
+            for (const char* name : { "strides", "dilations" })
+            {
+                for (int64_t value : attributes[name].ints)
+                {
+                    if (value != 1)
+                    {
+                        return false;
+                    }
+                }
+            }
+            if (attributes.count("group") && attributes["group"].i != 1)
+            {
+                return false;
+            }
+            const std::string& pad = attributes["auto_pad"].s;
+            if (pad == "SAME_UPPER" || pad == "SAME_LOWER")
+            {
+                return true;
+            }
+            for (int64_t value : attributes["pads"].ints)
+            {
+                if (value != int64_t(kernel / 2))
+                {
+                    return false;
+                }
+            }
+            return pad.empty() || pad == "NOTSET";
+        }
+
+        // ModelProto: graph 7. GraphProto: node 1, initializer 5, input 11, output 12.
+        // NodeProto: input 1, output 2, op_type 4, attribute 5.
+        inline rif_int LoadOnnxNetwork(const std::vector<uint8_t>& data, NeuralNetwork& network)
+        {
+            NeuralGraphBuilder builder(network);
+            ProtobufReader model(data.data(), data.size());
+            ProtobufReader graph(nullptr, 0);
+            while (model.Next())
+            {
+                if (model.Field() == 7)
+                {
+                    graph = model.Message();
+                }
+            }
+
+            std::vector<ProtobufReader> nodes;
+            std::vector<std::string> inputs;
+            std::string output;
+            while (graph.Next())
+            {
+                if (graph.Field() == 1)
+                {
+                    nodes.push_back(graph.Message());
+                }
+                else if (graph.Field() == 5)
+                {
+                    std::string name;
+                    NeuralConstant constant;
+                    if (!ReadOnnxTensor(graph.Message(), name, constant))
+                    {
+                        return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "malformed initializer");
+                    }
+                    builder.SetConstant(name, std::move(constant));
+                }
+                else if (graph.Field() == 11 || graph.Field() == 12)
+                {
+                    // ValueInfoProto: name 1
+                    ProtobufReader info = graph.Message();
+                    while (info.Next())
+                    {
+                        if (info.Field() == 1 && graph.Field() == 11)
+                        {
+                            inputs.push_back(info.String());
+                        }
+                        else if (info.Field() == 1 && output.empty())
+                        {
+                            output = info.String();
+                        }
+                    }
+                }
+            }
+            if (model.Failed() || graph.Failed() || nodes.empty())
+            {
+                return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "not an ONNX model");
+            }
+            for (const std::string& input : inputs)
+            {
+                if (!builder.Constant(input))
+                {
+                    // the graphs take NHWC colour
+                    builder.SetInput(input, 3);
+                    break;
+                }
+            }
+
+            for (ProtobufReader node : nodes)
+            {
+                std::vector<std::string> in;
+                std::vector<std::string> out;
+                std::vector<ProtobufReader> attributeReaders;
+                std::string type;
+                while (node.Next())
+                {
+                    switch (node.Field())
+                    {
+                    case 1: in.push_back(node.String()); break;
+                    case 2: out.push_back(node.String()); break;
+                    case 4: type = node.String(); break;
+                    case 5: attributeReaders.push_back(node.Message()); break;
+                    default: break;
+                    }
+                }
+                if (in.empty() || out.empty())
+                {
+                    return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "malformed node");
+                }
+                std::map<std::string, OnnxAttribute> attributes = ReadOnnxAttributes(attributeReaders);
+                const std::string& name = out[0];
+
+                if (type == "Transpose")
+                {
+                    // NHWC <-> NCHW around the graph; tensors here are always NHWC
+                    const std::vector<int64_t>& perm = attributes["perm"].ints;
+                    if (perm != std::vector<int64_t>{ 0, 3, 1, 2 } && perm != std::vector<int64_t>{ 0, 2, 3, 1 })
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported transpose " + name);
+                    }
+                    builder.Alias(name, builder.Value(in[0]));
+                }
+                else if (type == "Identity")
+                {
+                    builder.Alias(name, builder.Value(in[0]));
+                }
+                else if (type == "Shape")
+                {
+                    builder.SetShape(name, builder.Value(in[0]));
+                }
+                else if (type == "Conv")
+                {
+                    const NeuralConstant* weights = builder.Constant(in.size() > 1 ? in[1] : std::string());
+                    const NeuralConstant* bias = in.size() > 2 ? builder.Constant(in[2]) : nullptr;
+                    if (!weights || weights->dims.size() != 4 || !OnnxSamePadding(attributes, size_t(weights->dims[2])))
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported convolution " + name);
+                    }
+                    builder.AddConvolution(name, builder.Value(in[0]), *weights, true, bias);
+                }
+                else if (type == "Relu" || type == "LeakyRelu")
+                {
+                    const float alpha = attributes.count("alpha") ? attributes["alpha"].f : 0.01f;
+                    builder.AddActivation(name, builder.Value(in[0]), type == "Relu" ? NeuralActivation::Relu : NeuralActivation::LeakyRelu, alpha);
+                }
+                else if (type == "MaxPool")
+                {
+                    if (attributes["kernel_shape"].ints != std::vector<int64_t>{ 2, 2 } || attributes["strides"].ints != std::vector<int64_t>{ 2, 2 })
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported pooling " + name);
+                    }
+                    NeuralOp op;
+                    op.type = NeuralOpType::MaxPool;
+                    op.inputs.push_back(builder.Value(in[0]));
+                    op.channels = builder.Channels(op.inputs[0]);
+                    builder.Add(name, std::move(op));
+                }
+                else if (type == "Resize" || type == "Upsample")
+                {
+                    // to the size of a Shape, or by constant scales of 1, 1, s, s
+                    NeuralOp op;
+                    op.type = NeuralOpType::Upsample;
+                    op.inputs.push_back(builder.Value(in[0]));
+                    op.channels = builder.Channels(op.inputs[0]);
+                    op.like = in.size() > 3 ? builder.Shape(in[3]) : -1;
+                    const NeuralConstant* scales = builder.Constant(in.size() > 2 && type == "Resize" ? in[2] : (in.size() > 1 ? in[1] : std::string()));
+                    if (op.like < 0 && scales && scales->values.size() == 4 && scales->values[2] == scales->values[3] && scales->values[2] >= 1.0f)
+                    {
+                        op.block = size_t(scales->values[2]);
+                    }
+                    else if (op.like < 0)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported resize " + name);
+                    }
+                    if (attributes["mode"].s != "nearest")
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "only nearest resizing is supported, not in " + name);
+                    }
+                    builder.Add(name, std::move(op));
+                }
+                else if (type == "Concat")
+                {
+                    if (attributes["axis"].i != 1)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "concatenation " + name + " is not over channels");
+                    }
+                    std::vector<int> values;
+                    for (const std::string& input : in)
+                    {
+                        values.push_back(builder.Value(input));
+                    }
+                    builder.AddConcat(name, values);
+                }
+                else if (type == "DepthToSpace")
+                {
+                    if (attributes.count("mode") && attributes["mode"].s != "DCR")
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "only DCR depth to space is supported, not in " + name);
+                    }
+                    NeuralOp op;
+                    op.type = NeuralOpType::DepthToSpace;
+                    op.inputs.push_back(builder.Value(in[0]));
+                    op.block = size_t(std::max<int64_t>(1, attributes["blocksize"].i));
+                    op.channels = builder.Channels(op.inputs[0]) / (op.block * op.block);
+                    builder.Add(name, std::move(op));
+                }
+                else
+                {
+                    return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported operator " + type);
+                }
+                if (builder.Status() != RIF_SUCCESS)
+                {
+                    return builder.Status();
+                }
+            }
+            return builder.Finish(output.empty() ? -1 : builder.Value(output));
+        }
+
+        //
+        // TensorFlow
+        //
+
+        // TensorProto: dtype 1, tensor_shape 2, tensor_content 4, float_val 5, int_val 7, half_val 13
+        inline bool ReadTensorFlowTensor(ProtobufReader reader, NeuralConstant& constant)
+        {
+            int64_t type = 0;
+            const uint8_t* content = nullptr;
+            size_t contentSize = 0;
+            std::vector<int64_t> integers;
+            while (reader.Next())
+            {
+                switch (reader.Field())
+                {
+                case 1:
+                    type = reader.Int();
+                    break;
+                case 2:
+                {
+                    // TensorShapeProto: dim 2, Dim: size 1
+                    ProtobufReader shape = reader.Message();
+                    while (shape.Next())
+                    {
+                        if (shape.Field() == 2)
+                        {
+                            ProtobufReader dim = shape.Message();
+                            while (dim.Next())
+                            {
+                                if (dim.Field() == 1)
+                                {
+                                    constant.dims.push_back(dim.Int());
+                                }
+                            }
+                        }
+                    }
+                    break;
+                }
+                case 4: content = reader.Data(); contentSize = reader.Size(); break;
+                case 5: reader.AppendFloats(constant.values); break;
+                case 7: case 13: reader.AppendInts(integers); break;
+                default: break;
+                }
+            }
+
+            // DT_FLOAT 1, DT_INT32 3, DT_HALF 19
+            if (type == 1 && content)
+            {
+                constant.values.resize(contentSize / 4);
+                std::memcpy(constant.values.data(), content, constant.values.size() * 4);
+            }
+            else if (type == 3)
+            {
+                for (size_t i = 0; content && i + 4 <= contentSize; i += 4)
+                {
+                    int32_t value;
+                    std::memcpy(&value, content + i, 4);
+                    integers.push_back(value);
+                }
+                for (int64_t value : integers)
+                {
+                    constant.values.push_back(float(value));
+                }
+            }
+            else if (type == 19)
+            {
+                for (size_t i = 0; content && i + 2 <= contentSize; i += 2)
+                {
+                    uint16_t value;
+                    std::memcpy(&value, content + i, 2);
+                    integers.push_back(value);
+                }
+                for (int64_t value : integers)
+                {
+                    constant.values.push_back(HalfToFloat(uint16_t(value)));
+                }
+            }
+
+            // a scalar given once stands for the whole shape
+            size_t count = 1;
+            for (int64_t dim : constant.dims)
+            {
+                count *= size_t(dim);
+            }
+            if (constant.values.size() == 1 && count > 1)
+            {
+                constant.values.assign(count, constant.values[0]);
+            }
+            return !reader.Failed();
+        }
+
+        struct TensorFlowAttribute
+        {
+            int64_t i = 0;
+            float f = 0.0f;
+            std::string s;
+            std::vector<int64_t> ints;
+            NeuralConstant tensor;
+        };
+
+        // "name:0" and "^name" both refer to node 'name'
+        inline std::string TensorFlowNodeName(const std::string& input)
+        {
+            const size_t begin = !input.empty() && input[0] == '^' ? 1 : 0;
+            const size_t colon = input.find(':', begin);
+            return input.substr(begin, colon == std::string::npos ? std::string::npos : colon - begin);
+        }
+
+        // GraphDef: node 1. NodeDef: name 1, op 2, input 3, attr 5 (key 1, value 2).
+        // AttrValue: list 1 (i 3), s 2, i 3, f 4, tensor 8.
+        inline rif_int LoadTensorFlowNetwork(const std::vector<uint8_t>& data, NeuralNetwork& network)
+        {
+            NeuralGraphBuilder builder(network);
+            struct Node
+            {
+                std::string name;
+                std::string op;
+                std::vector<std::string> inputs;
+                std::map<std::string, TensorFlowAttribute> attributes;
+            };
+            std::vector<Node> nodes;
+            std::map<std::string, size_t> uses;
+
+            ProtobufReader graph(data.data(), data.size());
+            while (graph.Next())
+            {
+                if (graph.Field() != 1)
+                {
+                    continue;
+                }
+                Node node;
+                ProtobufReader reader = graph.Message();
+                while (reader.Next())
+                {
+                    if (reader.Field() == 1)
+                    {
+                        node.name = reader.String();
+                    }
+                    else if (reader.Field() == 2)
+                    {
+                        node.op = reader.String();
+                    }
+                    else if (reader.Field() == 3 && reader.String()[0] != '^')
+                    {
+                        node.inputs.push_back(TensorFlowNodeName(reader.String()));
+                        ++uses[node.inputs.back()];
+                    }
+                    else if (reader.Field() == 5)
+                    {
+                        ProtobufReader entry = reader.Message();
+                        std::string key;
+                        TensorFlowAttribute attribute;
+                        while (entry.Next())
+                        {
+                            if (entry.Field() == 1)
+                            {
+                                key = entry.String();
+                                continue;
+                            }
+                            ProtobufReader value = entry.Message();
+                            while (entry.Field() == 2 && value.Next())
+                            {
+                                switch (value.Field())
+                                {
+                                case 1:
+                                {
+                                    ProtobufReader list = value.Message();
+                                    while (list.Next())
+                                    {
+                                        if (list.Field() == 3)
+                                        {
+                                            list.AppendInts(attribute.ints);
+                                        }
+                                    }
+                                    break;
+                                }
+                                case 2: attribute.s = value.String(); break;
+                                case 3: attribute.i = value.Int(); break;
+                                case 4: attribute.f = value.Float(); break;
+                                case 8: ReadTensorFlowTensor(value.Message(), attribute.tensor); break;
+                                default: break;
+                                }
+                            }
+                        }
+                        node.attributes[key] = std::move(attribute);
+                    }
+                }
+                nodes.push_back(std::move(node));
+            }
+            if (graph.Failed() || nodes.empty())
+            {
+                return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "not a TensorFlow GraphDef");
+            }
+
+            std::string output;
+            for (Node& node : nodes)
+            {
+                const std::string& name = node.name;
+                std::vector<std::string>& in = node.inputs;
+                auto attribute = [&](const char* key) -> TensorFlowAttribute& { return node.attributes[key]; };
+                if (node.op != "Const" && node.op != "Placeholder" && in.empty())
+                {
+                    return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "node " + name + " has no inputs");
+                }
+                if ((node.attributes.count("data_format") && attribute("data_format").s != "NHWC"))
+                {
+                    return builder.Fail(RIF_ERROR_UNSUPPORTED, "node " + name + " is not NHWC");
+                }
+
+                if (node.op == "Placeholder")
+                {
+                    builder.SetInput(name, 3);
+                }
+                else if (node.op == "Const")
+                {
+                    builder.SetConstant(name, std::move(attribute("value").tensor));
+                }
+                else if (node.op == "Identity")
+                {
+                    builder.Alias(name, builder.Value(in[0]));
+                }
+                else if (node.op == "Conv2D")
+                {
+                    const NeuralConstant* weights = builder.Constant(in.size() > 1 ? in[1] : std::string());
+                    bool unit = attribute("padding").s == "SAME";
+                    for (const char* key : { "strides", "dilations" })
+                    {
+                        for (int64_t value : attribute(key).ints)
+                        {
+                            unit &= value == 1;
+                        }
+                    }
+                    if (!weights || !unit)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported convolution " + name);
+                    }
+                    builder.AddConvolution(name, builder.Value(in[0]), *weights, false, nullptr);
+                }
+                else if (node.op == "BiasAdd")
+                {
+                    // into the convolution it follows
+                    const int value = builder.Value(in[0]);
+                    NeuralOp* producer = builder.Producer(value);
+                    const NeuralConstant* bias = builder.Constant(in.size() > 1 ? in[1] : std::string());
+                    if (!producer || producer->type != NeuralOpType::Convolution || uses[in[0]] != 1 || !bias ||
+                        bias->values.size() != producer->channels)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "bias " + name + " does not follow a convolution");
+                    }
+                    std::copy(bias->values.begin(), bias->values.end(), producer->bias.begin());
+                    builder.Alias(name, value);
+                }
+                else if (node.op == "Relu" || node.op == "LeakyRelu")
+                {
+                    const float alpha = node.attributes.count("alpha") ? attribute("alpha").f : 0.2f;
+                    builder.AddActivation(name, builder.Value(in[0]), node.op == "Relu" ? NeuralActivation::Relu : NeuralActivation::LeakyRelu, alpha);
+                }
+                else if (node.op == "Mul" && in.size() == 2 && (builder.Constant(in[0]) || builder.Constant(in[1])))
+                {
+                    // by a scalar
+                    const bool first = builder.Constant(in[0]) != nullptr;
+                    const NeuralConstant* factor = builder.Constant(in[first ? 0 : 1]);
+                    if (factor->values.size() != 1)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "multiplication " + name + " is not by a scalar");
+                    }
+                    NeuralOp op;
+                    op.type = NeuralOpType::Elementwise;
+                    op.inputs.push_back(builder.Value(in[first ? 1 : 0]));
+                    op.channels = builder.Channels(op.inputs[0]);
+                    op.scale = factor->values[0];
+                    builder.Add(name, std::move(op));
+                }
+                else if (node.op == "Maximum" && in.size() == 2)
+                {
+                    // max(x * alpha, x) is a LeakyRelu
+                    const int a = builder.Value(in[0]);
+                    const int b = builder.Value(in[1]);
+                    NeuralOp* pa = builder.Producer(a);
+                    NeuralOp* pb = builder.Producer(b);
+                    auto scales = [](const NeuralOp* op, int x)
+                    {
+                        return op && op->type == NeuralOpType::Elementwise && op->inputs.size() == 1 && op->inputs[0] == x &&
+                            op->activation == NeuralActivation::None && op->scale >= 0.0f && op->scale < 1.0f;
+                    };
+                    const NeuralOp* scaled = scales(pa, b) ? pa : (scales(pb, a) ? pb : nullptr);
+                    if (!scaled)
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "maximum " + name + " is not a LeakyRelu");
+                    }
+                    builder.AddActivation(name, scaled->inputs[0], NeuralActivation::LeakyRelu, scaled->scale);
+                }
+                else if ((node.op == "Add" || node.op == "AddV2") && in.size() == 2)
+                {
+                    // a scaled residual x * s + y takes the scale along
+                    int a = builder.Value(in[0]);
+                    int b = builder.Value(in[1]);
+                    NeuralOp op;
+                    op.type = NeuralOpType::Elementwise;
+                    NeuralOp* pa = builder.Producer(a);
+                    NeuralOp* pb = builder.Producer(b);
+                    auto scaleOnly = [](const NeuralOp* p) { return p && p->type == NeuralOpType::Elementwise && p->inputs.size() == 1 &&
+                        p->activation == NeuralActivation::None; };
+                    if (scaleOnly(pb) && !scaleOnly(pa) && uses[in[1]] == 1)
+                    {
+                        std::swap(a, b);
+                        std::swap(pa, pb);
+                    }
+                    if (scaleOnly(pa) && uses[TensorFlowNodeName(in[a == builder.Value(in[0]) ? 0 : 1])] == 1)
+                    {
+                        op.scale = pa->scale;
+                        a = pa->inputs[0];
+                    }
+                    op.inputs = { a, b };
+                    op.channels = builder.Channels(a);
+                    if (builder.Channels(b) != op.channels)
+                    {
+                        return builder.Fail(RIF_ERROR_INVALID_PARAMETER, "addition " + name + " of different channel counts");
+                    }
+                    builder.Add(name, std::move(op));
+                }
+                else if (node.op == "ConcatV2")
+                {
+                    const NeuralConstant* axis = builder.Constant(in.back());
+                    if (!axis || axis->values.size() != 1 || (axis->values[0] != 3.0f && axis->values[0] != -1.0f))
+                    {
+                        return builder.Fail(RIF_ERROR_UNSUPPORTED, "concatenation " + name + " is not over channels");
+                    }
+                    std::vector<int> values;
+                    for (size_t i = 0; i + 1 < in.size(); ++i)
+                    {
+                        values.push_back(builder.Value(in[i]));
+                    }
+                    builder.AddConcat(name, values);
+                }
+                else if (node.op == "DepthToSpace")
+                {
+                    NeuralOp op;
+                    op.type = NeuralOpType::DepthToSpace;
+                    op.inputs.push_back(builder.Value(in[0]));
+                    op.block = size_t(std::max<int64_t>(1, attribute("block_size").i));
+                    op.channels = builder.Channels(op.inputs[0]) / (op.block * op.block);
+                    builder.Add(name, std::move(op));
+                }
+                else
+                {
+                    return builder.Fail(RIF_ERROR_UNSUPPORTED, "unsupported operator " + node.op);
+                }
+                if (builder.Status() != RIF_SUCCESS)
+                {
+                    return builder.Status();
+                }
+                // the output is the last computed node nothing reads
+                if (node.op != "Const" && node.op != "Placeholder" && uses[name] == 0)
+                {
+                    output = name;
+                }
+            }
+            return builder.Finish(output.empty() ? -1 : builder.Value(output));
+        }
+    }
+
+    // Reads an .onnx model or a TensorFlow .pb GraphDef into 'network'. Returns
+    // RIF_ERROR_IO_ERROR when the file cannot be read and RIF_ERROR_UNSUPPORTED for
+    // operators or attributes outside the set above; 'network.error' says which.
+    inline rif_int LoadNeuralNetwork(const std::string& path, NeuralNetwork& network)
+    {
+        std::vector<uint8_t> data;
+        if (!detail::ReadNeuralFile(path, data))
+        {
+            network = NeuralNetwork();
+            network.error = "cannot read " + path;
+            return RIF_ERROR_IO_ERROR;
+        }
+        const bool onnx = path.size() >= 5 && path.compare(path.size() - 5, 5, ".onnx") == 0;
+        return onnx ? detail::LoadOnnxNetwork(data, network) : detail::LoadTensorFlowNetwork(data, network);
+    }
+
+    // What runs of one network allocate and work out for the capacity of their input
+    // tensors: a slot per tensor (tensors whose lifetimes do not overlap share one), the
+    // slots' tensors for each image of the batch and the convolution tap offsets. A run
+    // on at most 'batch' inputs of the planned capacity, at that size or Reshaped
+    // smaller, reuses all of it; another capacity, a larger batch or another network
+    // plans again. Networks are told apart by address, so a workspace must not outlive
+    // the network it was planned for.
+    struct NeuralWorkspace
+    {
+        const NeuralNetwork* network = nullptr;
+        size_t width = 0;                               // the planned capacity
+        size_t height = 0;
+        size_t batch = 0;
+        int kept = -1;                                  // a tensor whose slot no other takes over
+        std::vector<std::pair<size_t, size_t>> sizes;   // of the tensors in the last run
+        std::vector<size_t> slots;                      // per tensor but the input
+        std::vector<NeuralTensor> tensors;              // 'batch' per slot
+        std::vector<std::vector<ptrdiff_t>> offsets;    // per operation, for convolutions
+        std::vector<std::vector<int16_t>> quantizedInputs;  // per image
+        std::vector<char> skipped;                      // per operation, in the last run
+
+        // the value of 'tensor' for image 'item' at the end of the last run: the output,
+        // the kept tensor, or whatever last took over their slots
+        NeuralTensor& Tensor(int tensor, size_t item = 0)
+        {
+            return tensors[slots[tensor] * batch + item];
+        }
+
+        NeuralTensor& Output(size_t item = 0)
+        {
+            return Tensor(network->output, item);
+        }
+    };
+
+    // A tensor that a run keeps, or takes from outside, as the temporal denoiser does
+    // with decoder features of the previous frame. Without 'value' the run computes
+    // 'tensor' and keeps it for workspace.Tensor(tensor); with it the run reads 'value'
+    // instead, which has the tensor's size, channels and row pitch, and skips the
+    // operations that only computed it.
+    struct NeuralFeedback
+    {
+        int tensor = -1;
+        const NeuralTensor* value = nullptr;
+    };
+
+    // the input of the level-th Upsample from the end (1: the last), which a U-Net
+    // decoder brings up to full resolution from there on; -1 if there is none
+    inline int NeuralFeedbackTensor(const NeuralNetwork& network, size_t level)
+    {
+        for (size_t index = network.ops.size(); index-- > 0;)
+        {
+            if (network.ops[index].type == NeuralOpType::Upsample && --level == 0)
+            {
+                return network.ops[index].inputs[0];
+            }
+        }
+        return -1;
+    }
+
+    namespace detail
+    {
+        // plans 'workspace' for 'network' on batches of up to 'batch' inputs of capacity
+        // width x height, never releasing the slot of tensor 'kept'; false if the network
+        // cannot run on them
+        inline bool PlanNeuralNetwork(const NeuralNetwork& network, size_t width, size_t height, size_t batch, int kept,
+            NeuralWorkspace& workspace)
+        {
+            if (workspace.network == &network && workspace.width == width && workspace.height == height && workspace.batch >= batch &&
+                workspace.kept == kept)
+            {
+                return true;
+            }
+            workspace.network = nullptr;
+            if (network.ops.empty() || !network.InferSizes(width, height, workspace.sizes))
+            {
+                return false;
+            }
+
+            // the slot of an output is a released one of the same shape, or a new one;
+            // inputs are released after their last reader
+            std::vector<size_t> channels(network.tensors, network.inputChannels);
+            std::vector<size_t> released;
+            workspace.slots.assign(network.tensors, 0);
+            workspace.tensors.clear();
+            workspace.offsets.assign(network.ops.size(), std::vector<ptrdiff_t>());
+            workspace.quantizedInputs.resize(batch);
+            for (size_t index = 0; index < network.ops.size(); ++index)
+            {
+                const NeuralOp& op = network.ops[index];
+                const std::pair<size_t, size_t> size = workspace.sizes[op.output];
+                channels[op.output] = op.channels;
+                auto reuse = std::find_if(released.begin(), released.end(),
+                    [&](size_t slot) { return workspace.tensors[slot * batch].SameShape(size.first, size.second, op.channels); });
+                if (reuse != released.end())
+                {
+                    workspace.slots[op.output] = *reuse;
+                    released.erase(reuse);
+                }
+                else
+                {
+                    workspace.slots[op.output] = workspace.tensors.size() / batch;
+                    workspace.tensors.resize(workspace.tensors.size() + batch);
+                    for (size_t item = 0; item < batch; ++item)
+                    {
+                        workspace.tensors[workspace.tensors.size() - batch + item].Resize(size.first, size.second, op.channels);
+                    }
+                }
+
+                if (op.type == NeuralOpType::Convolution)
+                {
+                    const std::pair<size_t, size_t> in = workspace.sizes[op.inputs[0]];
+                    const ptrdiff_t stride = ptrdiff_t(NeuralStride(channels[op.inputs[0]]));
+                    const ptrdiff_t rowPitch = ptrdiff_t(in.first + 2) * stride;
+                    const long radius = long(op.kernel / 2);
+                    for (long ky = -radius; ky <= radius; ++ky)
+                    {
+                        for (long kx = -radius; kx <= radius; ++kx)
+                        {
+                            workspace.offsets[index].push_back(ky * rowPitch + kx * stride);
+                        }
+                    }
+                }
+
+                for (int tensor : op.inputs)
+                {
+                    if (tensor != network.input && tensor != kept && network.lastUse[tensor] == index &&
+                        std::find(released.begin(), released.end(), workspace.slots[tensor]) == released.end())
+                    {
+                        released.push_back(workspace.slots[tensor]);
+                    }
+                }
+            }
+            workspace.network = &network;
+            workspace.width = width;
+            workspace.height = height;
+            workspace.batch = batch;
+            workspace.kept = kept;
+            return true;
+        }
+
+        // largest |value| of each of the first 'channels' channels of 'tensor', raised into 'ranges'
+        inline void RecordRanges(const NeuralTensor& tensor, size_t channels, std::vector<float>& ranges)
+        {
+            ranges.resize(std::max(ranges.size(), channels), 0.0f);
+            for (size_t y = 0; y < tensor.Height(); ++y)
+            {
+                for (size_t x = 0; x < tensor.Width(); ++x)
+                {
+                    const float* pixel = tensor.Pixel(long(x), long(y));
+                    for (size_t c = 0; c < channels; ++c)
+                    {
+                        ranges[c] = std::max(ranges[c], std::fabs(pixel[c]));
+                    }
+                }
+            }
+        }
+
+        // 'tensor' rounded to int8 steps per channel, in int16 with the geometry and zero
+        // border of the tensor; 'values' is reused, so only its border is cleared
+        inline void QuantizeTensor(ThreadPool& pool, const NeuralKernels& kernels, const NeuralTensor& tensor,
+            const std::vector<float>& steps, std::vector<int16_t>& values)
+        {
+            const size_t rowPitch = tensor.RowPitch();
+            const size_t stride = tensor.Stride();
+            const size_t rowEnd = (tensor.Width() + 2) * stride;
+            values.resize((tensor.Height() + 2) * rowPitch);
+            std::fill(values.begin(), values.begin() + rowEnd, int16_t(0));
+            std::fill(values.begin() + (tensor.Height() + 1) * rowPitch, values.begin() + (tensor.Height() + 1) * rowPitch + rowEnd, int16_t(0));
+            pool.ParallelForRows(tensor.Height(), [&](size_t begin, size_t end)
+            {
+                for (size_t y = begin; y < end; ++y)
+                {
+                    int16_t* row = values.data() + (y + 1) * rowPitch;
+                    std::fill(row, row + stride, int16_t(0));
+                    std::fill(row + rowEnd - stride, row + rowEnd, int16_t(0));
+                    kernels.quantizeRow(tensor.Pixel(0, long(y)), steps.data(), stride, tensor.Width(), row + stride);
+                }
+            });
+        }
+
+        // parallel tasks per thread that the operations aim for
+        const size_t NeuralTasksPerThread = 8;
+
+        // the operations of ExecuteNeuralNetwork on images first .. first + count - 1
+        inline rif_int ExecuteNeuralOperations(ThreadPool& pool, const NeuralNetwork& network, const NeuralKernels& kernels,
+            const NeuralTensor* const* inputs, size_t first, size_t count, NeuralWorkspace& workspace, NeuralCalibration* calibration,
+            const NeuralTensor* given, int givenTensor)
+        {
+            auto value = [&](int tensor, size_t item) -> const NeuralTensor&
+            {
+                if (tensor == givenTensor)
+                {
+                    return *given;
+                }
+                return tensor == network.input ? *inputs[first + item] : workspace.Tensor(tensor, first + item);
+            };
+
+            for (size_t index = 0; index < network.ops.size(); ++index)
+            {
+                // every operation writes all of its outputs but the zero border
+                const NeuralOp& op = network.ops[index];
+                if (workspace.skipped[index])
+                {
+                    continue;
+                }
+                NeuralTensor* outs = &workspace.tensors[workspace.slots[op.output] * workspace.batch + first];
+                for (size_t item = 0; item < count; ++item)
+                {
+                    if (!outs[item].Reshape(workspace.sizes[op.output].first, workspace.sizes[op.output].second))
+                    {
+                        return RIF_ERROR_INVALID_PARAMETER;
+                    }
+                }
+                const NeuralTensor& in = value(op.inputs[0], 0);
+                const size_t width = outs[0].Width();
+                const size_t height = outs[0].Height();
+                const size_t stride = outs[0].Stride();
+
+                switch (op.type)
+                {
+                case NeuralOpType::Convolution:
+                {
+                    const bool quantized = !op.quantizedWeights.empty();
+                    for (size_t item = 0; item < count; ++item)
+                    {
+                        if (calibration)
+                        {
+                            RecordRanges(value(op.inputs[0], item), op.inChannels, calibration->ranges[index]);
+                        }
+                        if (quantized)
+                        {
+                            QuantizeTensor(pool, kernels, value(op.inputs[0], item), op.inputSteps, workspace.quantizedInputs[item]);
+                        }
+                    }
+
+                    const std::vector<ptrdiff_t>& offsets = workspace.offsets[index];
+                    const NeuralConvolutionRowArgs args = { op.weights.data(), op.bias.data(), offsets.data(), offsets.size(),
+                        op.inChannels, in.Stride(), stride, op.activation, op.alpha };
+                    const NeuralQuantizedRowArgs quantizedArgs = { op.quantizedWeights.data(), op.outputScales.data(), op.bias.data(),
+                        offsets.data(), offsets.size(), op.inChannels, in.Stride(), stride, op.activation, op.alpha };
+
+                    // a row of one image by a group of two channel blocks is one task
+                    const size_t groups = (stride / NeuralChannelBlock + 1) / 2;
+                    const size_t tasks = count * height * groups;
+                    pool.ParallelFor(tasks, std::max<size_t>(1, tasks / (pool.ThreadCount() * NeuralTasksPerThread)), [&](size_t begin, size_t end)
+                    {
+                        for (size_t task = begin; task < end; ++task)
+                        {
+                            const size_t item = task / (height * groups);
+                            const size_t y = task / groups % height;
+                            const size_t from = task % groups * 2 * NeuralChannelBlock;
+                            const size_t to = std::min(stride, from + 2 * NeuralChannelBlock);
+                            if (quantized)
+                            {
+                                const int16_t* row = workspace.quantizedInputs[item].data() + (y + 1) * in.RowPitch() + in.Stride();
+                                kernels.quantizedRow(quantizedArgs, row, width, from, to, outs[item].Pixel(0, long(y)));
+                            }
+                            else
+                            {
+                                kernels.convolutionRow(args, value(op.inputs[0], item).Pixel(0, long(y)), width, from, to,
+                                    outs[item].Pixel(0, long(y)));
+                            }
+                        }
+                    });
+                    break;
+                }
+                case NeuralOpType::MaxPool:
+                    pool.ParallelForRows(count * height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t row = begin; row < end; ++row)
+                        {
+                            const NeuralTensor& source = value(op.inputs[0], row / height);
+                            const long y0 = long(2 * (row % height));
+                            const long y1 = std::min(y0 + 1, long(in.Height()) - 1);
+                            kernels.maxPoolRow(source.Pixel(0, y0), source.Pixel(0, y1), in.Width(), stride, width,
+                                outs[row / height].Pixel(0, long(row % height)));
+                        }
+                    });
+                    break;
+                case NeuralOpType::Upsample:
+                    // nearest as TensorFlow's ResizeNearestNeighbor: source = floor(x * in / out)
+                    pool.ParallelForRows(count * height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t row = begin; row < end; ++row)
+                        {
+                            const NeuralTensor& source = value(op.inputs[0], row / height);
+                            const size_t y = row % height;
+                            const long sy = long(y * in.Height() / height);
+                            for (size_t x = 0; x < width; ++x)
+                            {
+                                const float* pixel = source.Pixel(long(x * in.Width() / width), sy);
+                                std::copy(pixel, pixel + stride, outs[row / height].Pixel(long(x), long(y)));
+                            }
+                        }
+                    });
+                    break;
+                case NeuralOpType::Concat:
+                    pool.ParallelForRows(count * height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t row = begin; row < end; ++row)
+                        {
+                            const size_t item = row / height;
+                            const size_t y = row % height;
+                            for (size_t x = 0; x < width; ++x)
+                            {
+                                float* target = outs[item].Pixel(long(x), long(y));
+                                for (int tensor : op.inputs)
+                                {
+                                    const NeuralTensor& part = value(tensor, item);
+                                    const float* source = part.Pixel(long(x), long(y));
+                                    target = std::copy(source, source + part.Channels(), target);
+                                }
+                                std::fill(target, outs[item].Pixel(long(x), long(y)) + stride, 0.0f);
+                            }
+                        }
+                    });
+                    break;
+                case NeuralOpType::DepthToSpace:
+                    // output (x * b + j, y * b + i) channel c is input (x, y) channel (i * b + j) * C + c
+                    pool.ParallelForRows(count * height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t row = begin; row < end; ++row)
+                        {
+                            const NeuralTensor& source = value(op.inputs[0], row / height);
+                            const size_t y = row % height;
+                            for (size_t x = 0; x < width; ++x)
+                            {
+                                const size_t i = y % op.block;
+                                const size_t j = x % op.block;
+                                const float* pixel = source.Pixel(long(x / op.block), long(y / op.block)) + (i * op.block + j) * op.channels;
+                                float* target = outs[row / height].Pixel(long(x), long(y));
+                                std::copy(pixel, pixel + op.channels, target);
+                                std::fill(target + op.channels, target + stride, 0.0f);
+                            }
+                        }
+                    });
+                    break;
+                case NeuralOpType::Elementwise:
+                    pool.ParallelForRows(count * height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t row = begin; row < end; ++row)
+                        {
+                            const size_t item = row / height;
+                            const long y = long(row % height);
+                            const float* second = op.inputs.size() > 1 ? value(op.inputs[1], item).Pixel(0, y) : nullptr;
+                            kernels.elementwiseRow(value(op.inputs[0], item).Pixel(0, y), second, op.scale, op.activation, op.alpha,
+                                width * stride, outs[item].Pixel(0, y));
+                        }
+                    });
+                    break;
+                }
+            }
+            return RIF_SUCCESS;
+        }
+
+        // RunNeuralNetwork on 'count' inputs of one size and capacity into 'workspace',
+        // recording the convolution input ranges into 'calibration' when given. Each
+        // operation runs over a group of images before the next one. A run of one image
+        // may have 'feedback'.
+        inline rif_int ExecuteNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor* const* inputs,
+            size_t count, NeuralWorkspace& workspace, simd::Level level, NeuralCalibration* calibration, const NeuralFeedback& feedback)
+        {
+            const int kept = feedback.tensor;
+            if (count == 0 || (kept >= 0 && (count != 1 || kept >= int(network.tensors) || kept == network.input)))
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            const NeuralTensor& front = *inputs[0];
+            for (size_t item = 0; item < count; ++item)
+            {
+                const NeuralTensor& input = *inputs[item];
+                if (input.Channels() != network.inputChannels || input.Width() != front.Width() || input.Height() != front.Height() ||
+                    input.RowPitch() != front.RowPitch() || input.CapacityHeight() != front.CapacityHeight())
+                {
+                    return RIF_ERROR_INVALID_PARAMETER;
+                }
+            }
+            if (!PlanNeuralNetwork(network, front.CapacityWidth(), front.CapacityHeight(), count, kept, workspace) ||
+                !network.InferSizes(front.Width(), front.Height(), workspace.sizes))
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+
+            // with a given value, only the operations the output needs without it run
+            workspace.skipped.assign(network.ops.size(), 0);
+            if (feedback.value)
+            {
+                const NeuralTensor& slot = workspace.Tensor(kept);
+                const std::pair<size_t, size_t> size = workspace.sizes[kept];
+                if (kept == network.output || !feedback.value->SameShape(size.first, size.second, slot.Channels()) ||
+                    feedback.value->RowPitch() != slot.RowPitch())
+                {
+                    return RIF_ERROR_INVALID_PARAMETER;
+                }
+                std::vector<char> needed(network.tensors, 0);
+                needed[network.output] = 1;
+                for (size_t index = network.ops.size(); index-- > 0;)
+                {
+                    const NeuralOp& op = network.ops[index];
+                    workspace.skipped[index] = !needed[op.output] || op.output == kept;
+                    for (int tensor : op.inputs)
+                    {
+                        needed[tensor] |= !workspace.skipped[index];
+                    }
+                }
+            }
+
+            // Images go through in groups just large enough to give every thread work;
+            // larger groups only spread each operation over more memory.
+            const NeuralKernels kernels = SelectNeuralKernels(level);
+            const size_t rows = std::max<size_t>(1, front.Height());
+            const size_t group = std::min(count, (pool.ThreadCount() * NeuralTasksPerThread + rows - 1) / rows);
+            if (calibration)
+            {
+                calibration->ranges.resize(network.ops.size());
+            }
+            for (size_t first = 0; first < count; first += group)
+            {
+                const rif_int status = ExecuteNeuralOperations(pool, network, kernels, inputs, first, std::min(group, count - first),
+                    workspace, calibration, feedback.value, feedback.value ? kept : -1);
+                if (status != RIF_SUCCESS)
+                {
+                    return status;
+                }
+            }
+            return RIF_SUCCESS;
+        }
+    }
+
+    // Runs 'network' on 'input', which has the network's input channel count; 'output'
+    // is resized to the result.
+    inline rif_int RunNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor& input,
+        NeuralTensor& output, simd::Level level = simd::CurrentLevel())
+    {
+        NeuralWorkspace workspace;
+        const NeuralTensor* inputs[] = { &input };
+        const rif_int status = detail::ExecuteNeuralNetwork(pool, network, inputs, 1, workspace, level, nullptr, NeuralFeedback());
+        if (status == RIF_SUCCESS)
+        {
+            std::swap(output, workspace.Output());
+        }
+        return status;
+    }
+
+    // RunNeuralNetwork with the result in workspace.Output(); a workspace planned for
+    // this network and the capacity of 'input' runs without allocating
+    inline rif_int RunNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor& input,
+        NeuralWorkspace& workspace, simd::Level level = simd::CurrentLevel())
+    {
+        const NeuralTensor* inputs[] = { &input };
+        return detail::ExecuteNeuralNetwork(pool, network, inputs, 1, workspace, level, nullptr, NeuralFeedback());
+    }
+
+    // RunNeuralNetwork on a batch of 'count' inputs of the same size and capacity, with
+    // result i in workspace.Output(i). The batch shares the weights and the parallel
+    // loop of each operation, which keeps the threads busy on small images.
+    inline rif_int RunNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor* const* inputs,
+        size_t count, NeuralWorkspace& workspace, simd::Level level = simd::CurrentLevel())
+    {
+        return detail::ExecuteNeuralNetwork(pool, network, inputs, count, workspace, level, nullptr, NeuralFeedback());
+    }
+
+    // RunNeuralNetwork on one input with 'feedback'; runs keeping the same tensor share
+    // the plan, whether given its value or not
+    inline rif_int RunNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor& input,
+        const NeuralFeedback& feedback, NeuralWorkspace& workspace, simd::Level level = simd::CurrentLevel())
+    {
+        const NeuralTensor* inputs[] = { &input };
+        return detail::ExecuteNeuralNetwork(pool, network, inputs, 1, workspace, level, nullptr, feedback);
+    }
+
+    // Runs 'network' on 'input' and widens the ranges of 'calibration' to the values
+    // its convolutions read; called once per sample input.
+    inline rif_int CalibrateNeuralNetwork(ThreadPool& pool, const NeuralNetwork& network, const NeuralTensor& input,
+        NeuralCalibration& calibration)
+    {
+        NeuralWorkspace workspace;
+        const NeuralTensor* inputs[] = { &input };
+        return detail::ExecuteNeuralNetwork(pool, network, inputs, 1, workspace, simd::CurrentLevel(), &calibration, NeuralFeedback());
+    }
+
+    // 'network' with int8 convolutions for the ranges of 'calibration'. Inputs beyond a
+    // channel's range are clamped to it.
+    inline rif_int QuantizeNeuralNetwork(const NeuralNetwork& network, const NeuralCalibration& calibration, NeuralNetwork& quantized)
+    {
+        if (calibration.ranges.size() != network.ops.size())
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        quantized = network;
+        for (size_t index = 0; index < quantized.ops.size(); ++index)
+        {
+            NeuralOp& op = quantized.ops[index];
+            const std::vector<float>& ranges = calibration.ranges[index];
+            if (op.type != NeuralOpType::Convolution)
+            {
+                continue;
+            }
+            if (ranges.size() != op.inChannels || op.weights.empty())
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+
+            const size_t taps = op.kernel * op.kernel;
+            const size_t inStride = detail::NeuralStride(op.inChannels);
+            const size_t outStride = op.bias.size();
+            std::vector<float> steps(inStride, 0.0f);
+            op.inputSteps.assign(inStride, 0.0f);
+            for (size_t i = 0; i < op.inChannels; ++i)
+            {
+                steps[i] = ranges[i] / 127.0f;
+                op.inputSteps[i] = ranges[i] > 0.0f ? 127.0f / ranges[i] : 0.0f;
+            }
+
+            // the weights times the step of their input channel, scaled per output channel
+            auto weight = [&](size_t tap, size_t i, size_t o) { return op.weights[(tap * inStride + i) * outStride + o] * steps[i]; };
+            op.outputScales.assign(outStride, 0.0f);
+            for (size_t o = 0; o < op.channels; ++o)
+            {
+                float largest = 0.0f;
+                for (size_t tap = 0; tap < taps; ++tap)
+                {
+                    for (size_t i = 0; i < op.inChannels; ++i)
+                    {
+                        largest = std::max(largest, std::fabs(weight(tap, i, o)));
+                    }
+                }
+                op.outputScales[o] = largest / 127.0f;
+            }
+
+            op.quantizedWeights.assign(taps * inStride / 2 * outStride, 0);
+            for (size_t tap = 0; tap < taps; ++tap)
+            {
+                for (size_t pair = 0; pair < inStride / 2; ++pair)
+                {
+                    for (size_t o = 0; o < op.channels; ++o)
+                    {
+                        const float scale = op.outputScales[o] > 0.0f ? 1.0f / op.outputScales[o] : 0.0f;
+                        const long low = std::lrint(weight(tap, 2 * pair, o) * scale);
+                        const long high = std::lrint(weight(tap, 2 * pair + 1, o) * scale);
+                        op.quantizedWeights[(tap * inStride / 2 + pair) * outStride + o] =
+                            int32_t(uint32_t(uint16_t(int16_t(low))) | uint32_t(uint16_t(int16_t(high))) << 16);
+                    }
+                }
+            }
+            op.weights.clear();
+            op.weights.shrink_to_fit();
+        }
+        return RIF_SUCCESS;
+    }
+
+    // the calibration file of the model at 'modelPath'
+    inline std::string NeuralCalibrationPath(const std::string& modelPath)
+    {
+        return modelPath + ".int8";
+    }
+
+    // Calibration files are text: a header with the operation count, then one line per
+    // convolution with its operation index, input channel count and channel ranges.
+    inline rif_int SaveNeuralCalibration(const std::string& path, const NeuralCalibration& calibration)
+    {
+        std::ofstream file(path);
+        file << "rif-neural-calibration 1 " << calibration.ranges.size() << "\n";
+        file.precision(9);
+        for (size_t index = 0; index < calibration.ranges.size(); ++index)
+        {
+            const std::vector<float>& ranges = calibration.ranges[index];
+            if (ranges.empty())
+            {
+                continue;
+            }
+            file << index << " " << ranges.size();
+            for (float range : ranges)
+            {
+                file << " " << range;
+            }
+            file << "\n";
+        }
+        return file ? RIF_SUCCESS : RIF_ERROR_IO_ERROR;
+    }
+
+    // RIF_ERROR_INVALID_PARAMETER when the file was written for another network
+    inline rif_int LoadNeuralCalibration(const std::string& path, const NeuralNetwork& network, NeuralCalibration& calibration)
+    {
+        std::ifstream file(path);
+        std::string magic;
+        int version = 0;
+        size_t count = 0;
+        if (!(file >> magic >> version >> count))
+        {
+            return RIF_ERROR_IO_ERROR;
+        }
+        if (magic != "rif-neural-calibration" || version != 1 || count != network.ops.size())
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        calibration.ranges.assign(count, std::vector<float>());
+        size_t index = 0;
+        size_t channels = 0;
+        while (file >> index >> channels)
+        {
+            if (index >= count || channels != network.ops[index].inChannels)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            calibration.ranges[index].resize(channels);
+            for (float& range : calibration.ranges[index])
+            {
+                file >> range;
+            }
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            if ((network.ops[i].type == NeuralOpType::Convolution) != !calibration.ranges[i].empty())
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+        }
+        return file.eof() ? RIF_SUCCESS : RIF_ERROR_INVALID_PARAMETER;
+    }
+}
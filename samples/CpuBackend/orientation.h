@@ -0,0 +1,515 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Rotations, flips and transposes on the host.
+//
+// Every orientation is a row-preserving copy (identity, flips, rotation by 180) or a
+// transpose. Row-preserving copies move whole rows, reversing them in registers when
+// the columns flip. The other four transpose the image with the mirroring folded into
+// the addressing: the source or destination is walked bottom-up through a negative
+// pitch. Transposes run on tiles of about 16 KiB so both sides stay in L1, and 4-byte
+// pixels move as 4 x 4 blocks transposed in SSE or NEON registers.
+//
+// In place, row-preserving orientations swap rows or pixels pairwise. Square images
+// also transpose in place, swapping tiles across the diagonal through a tile-sized
+// buffer. A rotation by 90 in place is that transpose followed by a flip. Non-square
+// images cannot change shape in place.
+
+#include "filter.h"
+#include "simd.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace CpuBackend
+{
+    enum class Orientation
+    {
+        Identity,
+        FlipHorizontal,
+        FlipVertical,
+        Rotate180,
+        Transpose,      // dst(x, y) = src(y, x)
+        Rotate90,       // clockwise
+        Rotate270,
+        Transverse,     // transpose about the other diagonal
+    };
+
+    inline bool OrientationSwapsAxes(Orientation orientation)
+    {
+        return orientation >= Orientation::Transpose;
+    }
+
+    namespace detail
+    {
+        // rows 'pitch' bytes apart; the pitch is negative for a bottom-up walk
+        struct PixelRows
+        {
+            rif_uchar* data;
+            std::ptrdiff_t pitch;
+
+            rif_uchar* Row(size_t y) const
+            {
+                return data + std::ptrdiff_t(y) * pitch;
+            }
+        };
+
+        inline PixelRows RowsOf(const Image& image, bool bottomUp)
+        {
+            rif_uchar* data = const_cast<rif_uchar*>(image.Row(bottomUp ? image.Height() - 1 : 0));
+            const std::ptrdiff_t pitch = std::ptrdiff_t(image.Pitch());
+            return { data, bottomUp ? -pitch : pitch };
+        }
+
+        template <size_t Size>
+        struct PixelBytes
+        {
+            rif_uchar b[Size];
+        };
+
+        // dst pixel x = src pixel width - 1 - x; 'src' may be 'dst'
+        template <size_t Size>
+        inline void ReverseRowT(const rif_uchar* src, rif_uchar* dst, size_t width, bool vectors)
+        {
+            typedef PixelBytes<Size> Pixel;
+            size_t left = 0;
+            size_t right = width;
+#if defined(CPU_BACKEND_X86) || defined(CPU_BACKEND_NEON)
+            // four pixels from each end per step, both loaded before either is stored
+            if (vectors && (Size == 4 || Size == 8 || Size == 16))
+            {
+                const size_t step = 16 / Size;
+                while (right - left >= 2 * step)
+                {
+#if defined(CPU_BACKEND_X86)
+                    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + left * Size));
+                    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (right - step) * Size));
+                    __m128i ra = a;
+                    __m128i rb = b;
+                    if (Size == 4)
+                    {
+                        ra = _mm_shuffle_epi32(a, 0x1b);
+                        rb = _mm_shuffle_epi32(b, 0x1b);
+                    }
+                    else if (Size == 8)
+                    {
+                        ra = _mm_shuffle_epi32(a, 0x4e);
+                        rb = _mm_shuffle_epi32(b, 0x4e);
+                    }
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + left * Size), rb);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (right - step) * Size), ra);
+#else
+                    const uint32x4_t a = vld1q_u32(reinterpret_cast<const uint32_t*>(src + left * Size));
+                    const uint32x4_t b = vld1q_u32(reinterpret_cast<const uint32_t*>(src + (right - step) * Size));
+                    uint32x4_t ra = a;
+                    uint32x4_t rb = b;
+                    if (Size == 4)
+                    {
+                        ra = vrev64q_u32(vextq_u32(a, a, 2));
+                        rb = vrev64q_u32(vextq_u32(b, b, 2));
+                    }
+                    else if (Size == 8)
+                    {
+                        ra = vextq_u32(a, a, 2);
+                        rb = vextq_u32(b, b, 2);
+                    }
+                    vst1q_u32(reinterpret_cast<uint32_t*>(dst + left * Size), rb);
+                    vst1q_u32(reinterpret_cast<uint32_t*>(dst + (right - step) * Size), ra);
+#endif
+                    left += step;
+                    right -= step;
+                }
+            }
+#else
+            (void)vectors;
+#endif
+            while (right > left + 1)
+            {
+                Pixel a, b;
+                memcpy(&a, src + left * Size, Size);
+                memcpy(&b, src + (right - 1) * Size, Size);
+                memcpy(dst + left * Size, &b, Size);
+                memcpy(dst + (right - 1) * Size, &a, Size);
+                ++left;
+                --right;
+            }
+            if (right == left + 1 && src != dst)
+            {
+                memcpy(dst + left * Size, src + left * Size, Size);
+            }
+        }
+
+        // dst(dx + j, dy + i) = src(sx + i, sy + j) for i < width, j < height
+        template <size_t Size>
+        inline void TransposeBlockT(const PixelRows& src, size_t sx, size_t sy, size_t width, size_t height,
+            const PixelRows& dst, size_t dx, size_t dy, bool vectors)
+        {
+            size_t j0 = 0;
+#if defined(CPU_BACKEND_X86) || defined(CPU_BACKEND_NEON)
+            if (vectors && Size == 4)
+            {
+                for (; j0 + 4 <= height; j0 += 4)
+                {
+                    size_t i = 0;
+                    for (; i + 4 <= width; i += 4)
+                    {
+                        const rif_uchar* s = src.Row(sy + j0) + (sx + i) * 4;
+#if defined(CPU_BACKEND_X86)
+                        __m128 r0 = _mm_loadu_ps(reinterpret_cast<const float*>(s));
+                        __m128 r1 = _mm_loadu_ps(reinterpret_cast<const float*>(s + src.pitch));
+                        __m128 r2 = _mm_loadu_ps(reinterpret_cast<const float*>(s + 2 * src.pitch));
+                        __m128 r3 = _mm_loadu_ps(reinterpret_cast<const float*>(s + 3 * src.pitch));
+                        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                        rif_uchar* d = dst.Row(dy + i) + (dx + j0) * 4;
+                        _mm_storeu_ps(reinterpret_cast<float*>(d), r0);
+                        _mm_storeu_ps(reinterpret_cast<float*>(d + dst.pitch), r1);
+                        _mm_storeu_ps(reinterpret_cast<float*>(d + 2 * dst.pitch), r2);
+                        _mm_storeu_ps(reinterpret_cast<float*>(d + 3 * dst.pitch), r3);
+#else
+                        uint32x4x4_t r;
+                        r.val[0] = vld1q_u32(reinterpret_cast<const uint32_t*>(s));
+                        r.val[1] = vld1q_u32(reinterpret_cast<const uint32_t*>(s + src.pitch));
+                        r.val[2] = vld1q_u32(reinterpret_cast<const uint32_t*>(s + 2 * src.pitch));
+                        r.val[3] = vld1q_u32(reinterpret_cast<const uint32_t*>(s + 3 * src.pitch));
+                        const uint32x4x2_t t01 = vtrnq_u32(r.val[0], r.val[1]);
+                        const uint32x4x2_t t23 = vtrnq_u32(r.val[2], r.val[3]);
+                        rif_uchar* d = dst.Row(dy + i) + (dx + j0) * 4;
+                        vst1q_u32(reinterpret_cast<uint32_t*>(d), vcombine_u32(vget_low_u32(t01.val[0]), vget_low_u32(t23.val[0])));
+                        vst1q_u32(reinterpret_cast<uint32_t*>(d + dst.pitch), vcombine_u32(vget_low_u32(t01.val[1]), vget_low_u32(t23.val[1])));
+                        vst1q_u32(reinterpret_cast<uint32_t*>(d + 2 * dst.pitch), vcombine_u32(vget_high_u32(t01.val[0]), vget_high_u32(t23.val[0])));
+                        vst1q_u32(reinterpret_cast<uint32_t*>(d + 3 * dst.pitch), vcombine_u32(vget_high_u32(t01.val[1]), vget_high_u32(t23.val[1])));
+#endif
+                    }
+                    for (; i < width; ++i)
+                    {
+                        for (size_t j = j0; j < j0 + 4; ++j)
+                        {
+                            memcpy(dst.Row(dy + i) + (dx + j) * 4, src.Row(sy + j) + (sx + i) * 4, 4);
+                        }
+                    }
+                }
+            }
+#else
+            (void)vectors;
+#endif
+            for (size_t j = j0; j < height; ++j)
+            {
+                const rif_uchar* s = src.Row(sy + j) + sx * Size;
+                for (size_t i = 0; i < width; ++i)
+                {
+                    memcpy(dst.Row(dy + i) + (dx + j) * Size, s + i * Size, Size);
+                }
+            }
+        }
+
+        typedef void (*ReverseRowFunction)(const rif_uchar*, rif_uchar*, size_t, bool);
+        typedef void (*TransposeBlockFunction)(const PixelRows&, size_t, size_t, size_t, size_t, const PixelRows&, size_t, size_t, bool);
+
+        struct OrientationKernels
+        {
+            ReverseRowFunction reverse;
+            TransposeBlockFunction transpose;
+            size_t tile;    // pixels per tile side
+        };
+
+        // every pixel size an image can have: 1 to 4 components of 1, 2 or 4 bytes
+        inline bool SelectOrientationKernels(size_t pixelSize, OrientationKernels* kernels)
+        {
+            switch (pixelSize)
+            {
+            case 1: *kernels = { ReverseRowT<1>, TransposeBlockT<1>, 128 }; return true;
+            case 2: *kernels = { ReverseRowT<2>, TransposeBlockT<2>, 64 }; return true;
+            case 3: *kernels = { ReverseRowT<3>, TransposeBlockT<3>, 64 }; return true;
+            case 4: *kernels = { ReverseRowT<4>, TransposeBlockT<4>, 64 }; return true;
+            case 6: *kernels = { ReverseRowT<6>, TransposeBlockT<6>, 32 }; return true;
+            case 8: *kernels = { ReverseRowT<8>, TransposeBlockT<8>, 32 }; return true;
+            case 12: *kernels = { ReverseRowT<12>, TransposeBlockT<12>, 32 }; return true;
+            case 16: *kernels = { ReverseRowT<16>, TransposeBlockT<16>, 32 }; return true;
+            default: return false;
+            }
+        }
+
+        // source rows bottom-up and destination rows bottom-up for each transposing
+        // orientation, see the header comment
+        inline void TransposeMirrors(Orientation orientation, bool* sourceBottomUp, bool* destinationBottomUp)
+        {
+            *sourceBottomUp = orientation == Orientation::Rotate90 || orientation == Orientation::Transverse;
+            *destinationBottomUp = orientation == Orientation::Rotate270 || orientation == Orientation::Transverse;
+        }
+
+        inline void TransposeImage(ThreadPool& pool, const Image& input, Image& output, Orientation orientation,
+            const OrientationKernels& kernels, bool vectors)
+        {
+            bool sourceBottomUp, destinationBottomUp;
+            TransposeMirrors(orientation, &sourceBottomUp, &destinationBottomUp);
+            const PixelRows src = RowsOf(input, sourceBottomUp);
+            const PixelRows dst = RowsOf(output, destinationBottomUp);
+            const size_t width = input.Width();
+            const size_t height = input.Height();
+            const size_t tile = kernels.tile;
+            const size_t tileRows = (height + tile - 1) / tile;
+            pool.ParallelFor(tileRows, 1, [&](size_t begin, size_t end)
+            {
+                for (size_t ty = begin; ty < end; ++ty)
+                {
+                    const size_t y = ty * tile;
+                    for (size_t x = 0; x < width; x += tile)
+                    {
+                        kernels.transpose(src, x, y, std::min(tile, width - x), std::min(tile, height - y), dst, y, x, vectors);
+                    }
+                }
+            });
+        }
+
+        // square images only: tiles across the diagonal swap through a buffer
+        inline void TransposeInPlace(ThreadPool& pool, Image& image, const OrientationKernels& kernels, bool vectors)
+        {
+            const PixelRows rows = RowsOf(image, false);
+            const size_t size = image.Width();
+            const size_t pixelSize = image.PixelSize();
+            const size_t tile = kernels.tile;
+            const size_t tiles = (size + tile - 1) / tile;
+            pool.ParallelFor(tiles, 1, [&](size_t begin, size_t end)
+            {
+                std::vector<rif_uchar> storage(tile * tile * pixelSize);
+                const PixelRows buffer = { storage.data(), std::ptrdiff_t(tile * pixelSize) };
+                for (size_t ty = begin; ty < end; ++ty)
+                {
+                    const size_t y = ty * tile;
+                    const size_t h = std::min(tile, size - y);
+                    for (size_t x = y; x < size; x += tile)
+                    {
+                        const size_t w = std::min(tile, size - x);
+                        // tile (x, y) into the buffer, tile (y, x) into its place, the buffer into (y, x)
+                        kernels.transpose(rows, x, y, w, h, buffer, 0, 0, vectors);
+                        if (x != y)
+                        {
+                            kernels.transpose(rows, y, x, h, w, rows, x, y, vectors);
+                        }
+                        for (size_t i = 0; i < w; ++i)
+                        {
+                            memcpy(rows.Row(x + i) + y * pixelSize, buffer.Row(i), h * pixelSize);
+                        }
+                    }
+                }
+            });
+        }
+
+        // identity, flips and rotation by 180; 'input' may be 'output'
+        inline void OrientRows(ThreadPool& pool, const Image& input, Image& output, Orientation orientation,
+            const OrientationKernels& kernels, bool vectors)
+        {
+            const bool flipX = orientation == Orientation::FlipHorizontal || orientation == Orientation::Rotate180;
+            const bool flipY = orientation == Orientation::FlipVertical || orientation == Orientation::Rotate180;
+            const size_t width = input.Width();
+            const size_t height = input.Height();
+            const size_t bytes = width * input.PixelSize();
+            const bool inPlace = &input == &output;
+
+            if (!inPlace)
+            {
+                pool.ParallelForRows(height, [&](size_t begin, size_t end)
+                {
+                    for (size_t y = begin; y < end; ++y)
+                    {
+                        const rif_uchar* src = input.Row(flipY ? height - 1 - y : y);
+                        if (flipX)
+                        {
+                            kernels.reverse(src, output.Row(y), width, vectors);
+                        }
+                        else
+                        {
+                            memcpy(output.Row(y), src, bytes);
+                        }
+                    }
+                });
+                return;
+            }
+
+            if (!flipY)
+            {
+                if (flipX)
+                {
+                    pool.ParallelForRows(height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t y = begin; y < end; ++y)
+                        {
+                            kernels.reverse(output.Row(y), output.Row(y), width, vectors);
+                        }
+                    });
+                }
+                return;
+            }
+
+            // rows y and height - 1 - y swap, reversed on the way for a rotation; the
+            // middle row of an odd height stays put
+            pool.ParallelForRows((height + 1) / 2, [&](size_t begin, size_t end)
+            {
+                std::vector<rif_uchar> saved(bytes);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    rif_uchar* top = output.Row(y);
+                    rif_uchar* bottom = output.Row(height - 1 - y);
+                    if (top == bottom)
+                    {
+                        if (flipX)
+                        {
+                            kernels.reverse(top, top, width, vectors);
+                        }
+                        continue;
+                    }
+                    memcpy(saved.data(), top, bytes);
+                    if (flipX)
+                    {
+                        kernels.reverse(bottom, top, width, vectors);
+                        kernels.reverse(saved.data(), bottom, width, vectors);
+                    }
+                    else
+                    {
+                        memcpy(top, bottom, bytes);
+                        memcpy(bottom, saved.data(), bytes);
+                    }
+                }
+            });
+        }
+    }
+
+    // Writes 'input' oriented into 'output', whose size must be the input's, swapped for
+    // transposing orientations. Formats may differ for row-preserving orientations and
+    // are converted a row at a time; transposes need the same format. 'output' may be
+    // 'input' except for transposes of non-square images.
+    inline rif_int Orient(ThreadPool& pool, const Image& input, Image& output, Orientation orientation,
+        simd::Level level = simd::CurrentLevel())
+    {
+        const bool swaps = OrientationSwapsAxes(orientation);
+        const size_t width = input.Width();
+        const size_t height = input.Height();
+        if (output.Width() != (swaps ? height : width) || output.Height() != (swaps ? width : height))
+        {
+            return RIF_ERROR_INVALID_IMAGE;
+        }
+
+        detail::OrientationKernels kernels;
+        const bool sameFormat = input.Type() == output.Type() && input.Components() == output.Components();
+        const bool vectors = level != simd::Level::Scalar;
+        if (!sameFormat || !detail::SelectOrientationKernels(input.PixelSize(), &kernels))
+        {
+            if (swaps || &input == &output)
+            {
+                return RIF_ERROR_INVALID_IMAGE;
+            }
+            const bool flipX = orientation == Orientation::FlipHorizontal || orientation == Orientation::Rotate180;
+            const bool flipY = orientation == Orientation::FlipVertical || orientation == Orientation::Rotate180;
+            pool.ParallelForRows(height, [&](size_t begin, size_t end)
+            {
+                std::vector<float> row(width * 4);
+                for (size_t y = begin; y < end; ++y)
+                {
+                    input.LoadRow(flipY ? height - 1 - y : y, 0, width, row.data(), 4);
+                    if (flipX)
+                    {
+                        for (size_t x = 0; x < width / 2; ++x)
+                        {
+                            std::swap_ranges(&row[x * 4], &row[x * 4] + 4, &row[(width - 1 - x) * 4]);
+                        }
+                    }
+                    output.StoreRow(y, 0, width, row.data(), 4);
+                }
+            });
+            return RIF_SUCCESS;
+        }
+
+        if (!swaps)
+        {
+            detail::OrientRows(pool, input, output, orientation, kernels, vectors);
+            return RIF_SUCCESS;
+        }
+        if (&input != &output)
+        {
+            detail::TransposeImage(pool, input, output, orientation, kernels, vectors);
+            return RIF_SUCCESS;
+        }
+
+        // in place: the square transpose, then the flip that completes the orientation
+        if (width != height)
+        {
+            return RIF_ERROR_INVALID_IMAGE;
+        }
+        detail::TransposeInPlace(pool, output, kernels, vectors);
+        switch (orientation)
+        {
+        case Orientation::Rotate90:
+            detail::OrientRows(pool, output, output, Orientation::FlipHorizontal, kernels, vectors);
+            break;
+        case Orientation::Rotate270:
+            detail::OrientRows(pool, output, output, Orientation::FlipVertical, kernels, vectors);
+            break;
+        case Orientation::Transverse:
+            detail::OrientRows(pool, output, output, Orientation::Rotate180, kernels, vectors);
+            break;
+        default:
+            break;
+        }
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_FLIP_VERT / RIF_IMAGE_FILTER_FLIP_HOR, in place when the output is
+    // the input
+    class FlipFilter : public Filter
+    {
+    public:
+        explicit FlipFilter(rif_image_filter_type type)
+            : Filter(type)
+        {   }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            return Orient(pool, input, output, Type() == RIF_IMAGE_FILTER_FLIP_VERT ? Orientation::FlipVertical : Orientation::FlipHorizontal);
+        }
+    };
+
+    // RIF_IMAGE_FILTER_ROTATE
+    // "angle" - clockwise, in degrees, rounded to a multiple of 90. The output is the
+    // input's size, swapped for 90 and 270; in place for 180 and for square images.
+    class RotateFilter : public Filter
+    {
+    public:
+        RotateFilter()
+            : Filter(RIF_IMAGE_FILTER_ROTATE)
+        {
+            DeclareFloat("angle", 90.0f);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            const long quarters = ((std::lround(GetFloat("angle") / 90.0f) % 4) + 4) % 4;
+            static const Orientation orientations[] =
+            {
+                Orientation::Identity, Orientation::Rotate90, Orientation::Rotate180, Orientation::Rotate270,
+            };
+            return Orient(pool, input, output, orientations[quarters]);
+        }
+    };
+}
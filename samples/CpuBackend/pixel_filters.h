@@ -0,0 +1,144 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "filter.h"
+
+#include <cmath>
+
+namespace CpuBackend
+{
+    // RIF_IMAGE_FILTER_GAMMA_CORRECTION, "cGamma": color = color^(1/gamma), alpha is kept
+    class GammaCorrectionFilter : public PixelFilter
+    {
+    public:
+        GammaCorrectionFilter()
+            : PixelFilter(RIF_IMAGE_FILTER_GAMMA_CORRECTION)
+        {
+            DeclareFloat("cGamma", 2.2f);
+        }
+
+    protected:
+        rif_int Prepare(const Image&, const Image&) override
+        {
+            return GetFloat("cGamma") > 0.0f ? RIF_SUCCESS : RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        void ProcessRow(size_t, float* rgba, size_t width) const override
+        {
+            const float exponent = 1.0f / GetFloat("cGamma");
+            for (size_t i = 0; i < width; ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    rgba[i * 4 + c] = std::pow(std::max(rgba[i * 4 + c], 0.0f), exponent);
+                }
+            }
+        }
+    };
+
+    // RIF_IMAGE_FILTER_ADD/SUB/MUL/DIV/MAX/MIN: output = input (op) "srcImg", per channel
+    class ArithmeticFilter : public PixelFilter
+    {
+    public:
+        explicit ArithmeticFilter(rif_image_filter_type type)
+            : PixelFilter(type)
+        {
+            DeclareImage("srcImg");
+        }
+
+    protected:
+        rif_int Prepare(const Image& input, const Image&) override
+        {
+            const Image* other = GetImage("srcImg");
+            if (!other)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+            return other->Width() == input.Width() && other->Height() == input.Height() ? RIF_SUCCESS : RIF_ERROR_INVALID_IMAGE;
+        }
+
+        void ProcessRow(size_t y, float* rgba, size_t width) const override
+        {
+            std::vector<float> other(width * 4);
+            GetImage("srcImg")->LoadRow(y, 0, width, other.data(), 4);
+
+            float* a = rgba;
+            const float* b = other.data();
+            const size_t count = width * 4;
+            switch (Type())
+            {
+            case RIF_IMAGE_FILTER_ADD:
+                for (size_t i = 0; i < count; ++i) a[i] += b[i];
+                break;
+            case RIF_IMAGE_FILTER_SUB:
+                for (size_t i = 0; i < count; ++i) a[i] -= b[i];
+                break;
+            case RIF_IMAGE_FILTER_MUL:
+                for (size_t i = 0; i < count; ++i) a[i] *= b[i];
+                break;
+            case RIF_IMAGE_FILTER_DIV:
+                for (size_t i = 0; i < count; ++i) a[i] = b[i] != 0.0f ? a[i] / b[i] : 0.0f;
+                break;
+            case RIF_IMAGE_FILTER_MAX:
+                for (size_t i = 0; i < count; ++i) a[i] = std::max(a[i], b[i]);
+                break;
+            case RIF_IMAGE_FILTER_MIN:
+                for (size_t i = 0; i < count; ++i) a[i] = std::min(a[i], b[i]);
+                break;
+            }
+        }
+    };
+
+    // RIF_IMAGE_FILTER_CONVERT: copies the input into the output format
+    class ConvertFilter : public PixelFilter
+    {
+    public:
+        ConvertFilter()
+            : PixelFilter(RIF_IMAGE_FILTER_CONVERT)
+        {   }
+
+    protected:
+        void ProcessRow(size_t, float*, size_t) const override
+        {
+        }
+    };
+
+    // RIF_IMAGE_FILTER_BGRA_TO_RGBA
+    class BgraToRgbaFilter : public PixelFilter
+    {
+    public:
+        BgraToRgbaFilter()
+            : PixelFilter(RIF_IMAGE_FILTER_BGRA_TO_RGBA)
+        {   }
+
+    protected:
+        void ProcessRow(size_t, float* rgba, size_t width) const override
+        {
+            for (size_t i = 0; i < width; ++i)
+            {
+                std::swap(rgba[i * 4 + 0], rgba[i * 4 + 2]);
+            }
+        }
+    };
+}
@@ -0,0 +1,211 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Reader of the protobuf wire format, enough to walk ONNX models and TensorFlow
+// GraphDefs field by field without the generated classes: a message is a sequence of
+// (field number, wire type, value) records, and nested messages, strings and packed
+// arrays are length-delimited byte ranges that get a reader of their own.
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace CpuBackend
+{
+    class ProtobufReader
+    {
+    public:
+        enum WireType
+        {
+            Varint = 0,
+            Fixed64 = 1,
+            Bytes = 2,
+            Fixed32 = 5,
+        };
+
+        ProtobufReader(const uint8_t* data, size_t size)
+            : m_data(data), m_end(data + size)
+        {   }
+
+        // moves to the next field; false at the end of the message or on malformed data
+        bool Next()
+        {
+            if (m_data >= m_end || m_failed)
+            {
+                return false;
+            }
+            const uint64_t key = ReadVarint();
+            m_field = static_cast<uint32_t>(key >> 3);
+            m_wireType = static_cast<WireType>(key & 7);
+            m_value = 0;
+            m_bytes = nullptr;
+            m_size = 0;
+            switch (m_wireType)
+            {
+            case Varint:
+                m_value = ReadVarint();
+                break;
+            case Fixed64:
+                Take(8);
+                break;
+            case Bytes:
+                m_size = static_cast<size_t>(ReadVarint());
+                Take(m_size);
+                break;
+            case Fixed32:
+                Take(4);
+                break;
+            default:
+                m_failed = true;
+            }
+            return !m_failed;
+        }
+
+        // true when the data ended in the middle of a field
+        bool Failed() const
+        {
+            return m_failed;
+        }
+
+        uint32_t Field() const
+        {
+            return m_field;
+        }
+
+        WireType Type() const
+        {
+            return m_wireType;
+        }
+
+        int64_t Int() const
+        {
+            return static_cast<int64_t>(m_value);
+        }
+
+        float Float() const
+        {
+            float value = 0.0f;
+            if (m_wireType == Fixed32)
+            {
+                std::memcpy(&value, m_bytes, 4);
+            }
+            return value;
+        }
+
+        const uint8_t* Data() const
+        {
+            return m_bytes;
+        }
+
+        size_t Size() const
+        {
+            return m_size;
+        }
+
+        std::string String() const
+        {
+            return m_wireType == Bytes ? std::string(reinterpret_cast<const char*>(m_bytes), m_size) : std::string();
+        }
+
+        // the nested message of a length-delimited field
+        ProtobufReader Message() const
+        {
+            return m_wireType == Bytes ? ProtobufReader(m_bytes, m_size) : ProtobufReader(nullptr, 0);
+        }
+
+        // appends a repeated integer field, packed or not
+        void AppendInts(std::vector<int64_t>& values) const
+        {
+            if (m_wireType == Varint)
+            {
+                values.push_back(Int());
+            }
+            else if (m_wireType == Bytes)
+            {
+                ProtobufReader packed(m_bytes, m_size);
+                while (packed.m_data < packed.m_end && !packed.m_failed)
+                {
+                    values.push_back(static_cast<int64_t>(packed.ReadVarint()));
+                }
+            }
+        }
+
+        // appends a repeated float field, packed or not
+        void AppendFloats(std::vector<float>& values) const
+        {
+            if (m_wireType == Fixed32)
+            {
+                values.push_back(Float());
+            }
+            else if (m_wireType == Bytes)
+            {
+                const size_t first = values.size();
+                values.resize(first + m_size / 4);
+                std::memcpy(values.data() + first, m_bytes, m_size / 4 * 4);
+            }
+        }
+
+    private:
+        uint64_t ReadVarint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (m_data >= m_end)
+                {
+                    break;
+                }
+                const uint8_t byte = *m_data++;
+                value |= uint64_t(byte & 0x7f) << shift;
+                if (byte < 0x80)
+                {
+                    return value;
+                }
+            }
+            m_failed = true;
+            return 0;
+        }
+
+        void Take(size_t size)
+        {
+            if (size_t(m_end - m_data) < size)
+            {
+                m_failed = true;
+                return;
+            }
+            m_bytes = m_data;
+            m_data += size;
+        }
+
+        const uint8_t* m_data;
+        const uint8_t* m_end;
+        bool m_failed = false;
+        uint32_t m_field = 0;
+        WireType m_wireType = Varint;
+        uint64_t m_value = 0;
+        const uint8_t* m_bytes = nullptr;
+        size_t m_size = 0;
+    };
+}
@@ -0,0 +1,539 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Separable resampling on the host for every RIF_IMAGE_INTERPOLATION_* kernel.
+//
+// The weights of an axis are computed once per (input size, output size, kernel). With
+// in / out = p / q in lowest terms, output i + q samples the source p pixels after
+// output i with the same weights, so an axis only stores the first tap and the
+// weights of its q phases. When reducing, the kernel is stretched by in / out so
+// every source pixel contributes. Weights are normalized per phase and the borders
+// clamp.
+//
+// The horizontal pass goes first so the input is converted one row at a time: groups
+// of ResampleGroupRows rows are interleaved into one line, which makes every tap a
+// whole-vector multiply-add. Its float result, output width by input height, is
+// filtered vertically in column blocks for bands of output rows and converted to the
+// output format a row at a time, so uint8 and float16 images are never widened as a
+// whole.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <cmath>
+#include <vector>
+
+namespace CpuBackend
+{
+    const size_t ResampleGroupRows = 4;
+    const size_t ResampleStep = 4 * ResampleGroupRows;
+
+    struct ResampleAxis
+    {
+        size_t in = 0;
+        size_t out = 0;
+        rif_uint interpolation = ~0u;
+        int taps = 0;
+        size_t phases = 1;
+        long advance = 0;               // source pixels between outputs 'phases' apart
+        std::vector<long> starts;       // first tap of each phase, may be outside the image
+        std::vector<float> weights;     // 'taps' per phase, zero padded
+    };
+
+    inline long ResampleStart(const ResampleAxis& axis, size_t i)
+    {
+        return axis.starts[i % axis.phases] + long(i / axis.phases) * axis.advance;
+    }
+
+    inline const float* ResampleWeights(const ResampleAxis& axis, size_t i)
+    {
+        return &axis.weights[(i % axis.phases) * axis.taps];
+    }
+
+    namespace ResampleScalar
+    {
+        using simd::Scalar::Float;
+#include "resample_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace ResampleSse
+    {
+        using simd::Sse::Float;
+#include "resample_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace ResampleAvx2
+    {
+        using simd::Avx2::Float;
+#include "resample_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace ResampleAvx512
+    {
+        using simd::Avx512::Float;
+#include "resample_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace ResampleNeon
+    {
+        using simd::Neon::Float;
+#include "resample_kernels.inl"
+    }
+#endif
+
+    namespace detail
+    {
+        const double Pi = 3.14159265358979323846;
+
+        inline double Sinc(double x)
+        {
+            return x == 0.0 ? 1.0 : std::sin(Pi * x) / (Pi * x);
+        }
+
+        // Mitchell-Netravali cubic with parameters B and C
+        inline double MitchellNetravali(double x, double b, double c)
+        {
+            if (x < 1.0)
+            {
+                return ((12.0 - 9.0 * b - 6.0 * c) * x * x * x + (-18.0 + 12.0 * b + 6.0 * c) * x * x + (6.0 - 2.0 * b)) / 6.0;
+            }
+            if (x < 2.0)
+            {
+                return ((-b - 6.0 * c) * x * x * x + (6.0 * b + 30.0 * c) * x * x + (-12.0 * b - 48.0 * c) * x + (8.0 * b + 24.0 * c)) / 6.0;
+            }
+            return 0.0;
+        }
+
+        // Dodgson's quadratic; r = 1 interpolates, r = 0.5 approximates
+        inline double DodgsonQuadratic(double x, double r)
+        {
+            if (x < 0.5)
+            {
+                return -2.0 * r * x * x + 0.5 * (r + 1.0);
+            }
+            if (x < 1.5)
+            {
+                return r * x * x + (-2.0 * r - 0.5) * x + 0.75 * (r + 1.0);
+            }
+            return 0.0;
+        }
+
+        // modified Bessel function of the first kind, order 0
+        inline double BesselI0(double x)
+        {
+            double sum = 1.0;
+            double term = 1.0;
+            for (int k = 1; k < 32; ++k)
+            {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // half width of a kernel in source pixels at scale 1
+        inline double ResampleSupport(rif_uint interpolation)
+        {
+            switch (interpolation)
+            {
+            case RIF_IMAGE_INTERPOLATION_NEAREST:
+            case RIF_IMAGE_INTERPOLATION_BOX:
+                return 0.5;
+            case RIF_IMAGE_INTERPOLATION_BILINEAR:
+            case RIF_IMAGE_INTERPOLATION_TENT:
+                return 1.0;
+            case RIF_IMAGE_INTERPOLATION_GAUSS:
+            case RIF_IMAGE_INTERPOLATION_BELL:
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_INTERP:
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_APPROX:
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_MIX:
+                return 1.5;
+            case RIF_IMAGE_INTERPOLATION_LANCZOS4:
+                return 4.0;
+            case RIF_IMAGE_INTERPOLATION_LANCZOS6:
+                return 6.0;
+            case RIF_IMAGE_INTERPOLATION_LANCZOS12:
+                return 12.0;
+            case RIF_IMAGE_INTERPOLATION_LANCZOS3:
+            case RIF_IMAGE_INTERPOLATION_KAISER:
+            case RIF_IMAGE_INTERPOLATION_BLACKMAN:
+                return 3.0;
+            default:
+                // BICUBIC, LANCZOS (two lobes), BSPLINE, MITCHELL, CATMULL
+                return 2.0;
+            }
+        }
+
+        // the kernel at distance x >= 0, in source pixels at scale 1
+        inline double ResampleKernel(rif_uint interpolation, double x)
+        {
+            const double support = ResampleSupport(interpolation);
+            if (x >= support)
+            {
+                return 0.0;
+            }
+            switch (interpolation)
+            {
+            case RIF_IMAGE_INTERPOLATION_NEAREST:
+            case RIF_IMAGE_INTERPOLATION_BOX:
+                return 1.0;
+            case RIF_IMAGE_INTERPOLATION_BILINEAR:
+            case RIF_IMAGE_INTERPOLATION_TENT:
+                return 1.0 - x;
+            case RIF_IMAGE_INTERPOLATION_BICUBIC:
+            {
+                // Keys with a = -0.75
+                const double a = -0.75;
+                return x < 1.0 ? ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0 : ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+            }
+            case RIF_IMAGE_INTERPOLATION_LANCZOS:
+            case RIF_IMAGE_INTERPOLATION_LANCZOS3:
+            case RIF_IMAGE_INTERPOLATION_LANCZOS4:
+            case RIF_IMAGE_INTERPOLATION_LANCZOS6:
+            case RIF_IMAGE_INTERPOLATION_LANCZOS12:
+                return Sinc(x) * Sinc(x / support);
+            case RIF_IMAGE_INTERPOLATION_KAISER:
+            {
+                const double beta = 6.5;
+                const double r = x / support;
+                return Sinc(x) * BesselI0(beta * std::sqrt(1.0 - r * r)) / BesselI0(beta);
+            }
+            case RIF_IMAGE_INTERPOLATION_BLACKMAN:
+                return Sinc(x) * (0.42 + 0.5 * std::cos(Pi * x / support) + 0.08 * std::cos(2.0 * Pi * x / support));
+            case RIF_IMAGE_INTERPOLATION_GAUSS:
+                // sigma 0.5
+                return std::exp(-2.0 * x * x);
+            case RIF_IMAGE_INTERPOLATION_BELL:
+                return x < 0.5 ? 0.75 - x * x : 0.5 * (x - 1.5) * (x - 1.5);
+            case RIF_IMAGE_INTERPOLATION_BSPLINE:
+                return MitchellNetravali(x, 1.0, 0.0);
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_INTERP:
+                return DodgsonQuadratic(x, 1.0);
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_APPROX:
+                return DodgsonQuadratic(x, 0.5);
+            case RIF_IMAGE_INTERPOLATION_QUADRATIC_MIX:
+                return DodgsonQuadratic(x, 0.8);
+            case RIF_IMAGE_INTERPOLATION_MITCHELL:
+                return MitchellNetravali(x, 1.0 / 3.0, 1.0 / 3.0);
+            case RIF_IMAGE_INTERPOLATION_CATMULL:
+                return MitchellNetravali(x, 0.0, 0.5);
+            default:
+                return 0.0;
+            }
+        }
+
+        inline size_t GreatestCommonDivisor(size_t a, size_t b)
+        {
+            while (b != 0)
+            {
+                const size_t t = a % b;
+                a = b;
+                b = t;
+            }
+            return a;
+        }
+
+        // Kernel argument of source pixel j for output i. The output centre is
+        // ((2 i + 1) in - out) / (2 out) source pixels; the distance is scaled by
+        // max(in, out) / out. Computed from integers, so outputs one period apart get
+        // bit-identical weights and a tap right on the support edge is treated the same
+        // way in every phase.
+        inline double ResampleDistance(size_t in, size_t out, size_t i, long j)
+        {
+            const long long numerator = 2LL * j * static_cast<long long>(out) - (2LL * i + 1) * static_cast<long long>(in) + static_cast<long long>(out);
+            return double(numerator < 0 ? -numerator : numerator) / (2.0 * double(std::max(in, out)));
+        }
+
+        // first tap and normalized weights of output i
+        inline long ResampleTaps(rif_uint interpolation, size_t in, size_t out, size_t i, int taps, float* weights)
+        {
+            if (interpolation == RIF_IMAGE_INTERPOLATION_NEAREST)
+            {
+                weights[0] = 1.0f;
+                return static_cast<long>((2 * i + 1) * in / (2 * out));
+            }
+
+            // one tap of slack on the left covers the rounding of the centre
+            const double scale = std::max(1.0, double(in) / double(out));
+            const double center = ((2.0 * i + 1.0) * in - double(out)) / (2.0 * out);
+            const long start = static_cast<long>(std::floor(center - ResampleSupport(interpolation) * scale));
+            std::vector<double> w(taps);
+            double sum = 0.0;
+            for (int t = 0; t < taps; ++t)
+            {
+                w[t] = ResampleKernel(interpolation, ResampleDistance(in, out, i, start + t));
+                sum += w[t];
+            }
+            for (int t = 0; t < taps; ++t)
+            {
+                weights[t] = sum != 0.0 ? static_cast<float>(w[t] / sum) : 0.0f;
+            }
+            return start;
+        }
+
+        struct ResampleKernels
+        {
+            void (*line)(const float*, const ResampleAxis&, size_t, float*);
+            void (*columns)(const float* const*, const float*, int, size_t, size_t, float*);
+            int width;
+        };
+
+        inline ResampleKernels SelectResampleKernels(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return { ResampleAvx512::ResampleLine, ResampleAvx512::ResampleColumns, ResampleAvx512::Float::Width };
+            case simd::Level::Avx2:
+                return { ResampleAvx2::ResampleLine, ResampleAvx2::ResampleColumns, ResampleAvx2::Float::Width };
+            case simd::Level::Sse:
+                return { ResampleSse::ResampleLine, ResampleSse::ResampleColumns, ResampleSse::Float::Width };
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return { ResampleNeon::ResampleLine, ResampleNeon::ResampleColumns, ResampleNeon::Float::Width };
+#endif
+            default:
+                return { ResampleScalar::ResampleLine, ResampleScalar::ResampleColumns, ResampleScalar::Float::Width };
+            }
+        }
+    }
+
+    // polyphase table of one axis; output pixel centres map to source centres
+    inline ResampleAxis BuildResampleAxis(size_t in, size_t out, rif_uint interpolation)
+    {
+        ResampleAxis axis;
+        axis.in = in;
+        axis.out = out;
+        axis.interpolation = interpolation;
+        if (in == 0 || out == 0)
+        {
+            return axis;
+        }
+
+        const size_t divisor = detail::GreatestCommonDivisor(in, out);
+        const double scale = std::max(1.0, double(in) / double(out));
+        axis.phases = out / divisor;
+        axis.advance = static_cast<long>(in / divisor);
+        axis.taps = interpolation == RIF_IMAGE_INTERPOLATION_NEAREST ? 1 :
+            static_cast<int>(std::floor(2.0 * detail::ResampleSupport(interpolation) * scale)) + 2;
+
+        axis.starts.resize(axis.phases);
+        axis.weights.assign(axis.phases * axis.taps, 0.0f);
+        for (size_t phase = 0; phase < axis.phases; ++phase)
+        {
+            axis.starts[phase] = detail::ResampleTaps(interpolation, in, out, phase, axis.taps, &axis.weights[phase * axis.taps]);
+        }
+
+        // drop the zero taps at both ends that the slack left in every phase
+        int first = axis.taps;
+        int last = 0;
+        for (size_t phase = 0; phase < axis.phases; ++phase)
+        {
+            const float* w = &axis.weights[phase * axis.taps];
+            for (int t = 0; t < axis.taps; ++t)
+            {
+                if (w[t] != 0.0f)
+                {
+                    first = std::min(first, t);
+                    last = std::max(last, t);
+                }
+            }
+        }
+        if (first > 0 || last + 1 < axis.taps)
+        {
+            const int taps = std::max(1, last - first + 1);
+            std::vector<float> weights(axis.phases * taps);
+            for (size_t phase = 0; phase < axis.phases; ++phase)
+            {
+                const float* w = &axis.weights[phase * axis.taps + std::min(first, last)];
+                std::copy(w, w + taps, &weights[phase * taps]);
+                axis.starts[phase] += std::min(first, last);
+            }
+            axis.taps = taps;
+            axis.weights.swap(weights);
+        }
+        return axis;
+    }
+
+    // tables of both axes, rebuilt only when the sizes or the kernel change
+    struct ResamplePlan
+    {
+        ResampleAxis horizontal;
+        ResampleAxis vertical;
+
+        void Prepare(size_t inWidth, size_t inHeight, size_t outWidth, size_t outHeight, rif_uint interpolation)
+        {
+            Prepare(horizontal, inWidth, outWidth, interpolation);
+            Prepare(vertical, inHeight, outHeight, interpolation);
+        }
+
+    private:
+        static void Prepare(ResampleAxis& axis, size_t in, size_t out, rif_uint interpolation)
+        {
+            if (axis.in != in || axis.out != out || axis.interpolation != interpolation)
+            {
+                axis = BuildResampleAxis(in, out, interpolation);
+            }
+        }
+    };
+
+    // Resamples 'input' to the size of 'output'. 'plan' keeps the weight tables between
+    // calls and may be null.
+    inline rif_int Resample(ThreadPool& pool, const Image& input, Image& output, rif_uint interpolation, ResamplePlan* plan = nullptr,
+        simd::Level level = simd::CurrentLevel())
+    {
+        if (interpolation > RIF_IMAGE_INTERPOLATION_CATMULL)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        const size_t inWidth = input.Width();
+        const size_t inHeight = input.Height();
+        const size_t outWidth = output.Width();
+        const size_t outHeight = output.Height();
+        if (inWidth == 0 || inHeight == 0 || outWidth == 0 || outHeight == 0)
+        {
+            return RIF_ERROR_INVALID_IMAGE;
+        }
+
+        ResamplePlan local;
+        ResamplePlan& tables = plan ? *plan : local;
+        tables.Prepare(inWidth, inHeight, outWidth, outHeight, interpolation);
+        const ResampleAxis& horizontalAxis = tables.horizontal;
+        const ResampleAxis& verticalAxis = tables.vertical;
+        const detail::ResampleKernels kernels = detail::SelectResampleKernels(level);
+
+        // horizontal: one line group of ResampleGroupRows rows at a time
+        FloatImage horizontal(outWidth, inHeight);
+        const bool directInput = input.Type() == RIF_COMPONENT_TYPE_FLOAT32 && input.Components() == 4;
+        const long pad = horizontalAxis.taps + 2;
+        const size_t groups = (inHeight + ResampleGroupRows - 1) / ResampleGroupRows;
+        pool.ParallelFor(groups, 1, [&](size_t begin, size_t end)
+        {
+            std::vector<float> row(directInput ? 0 : inWidth * 4);
+            std::vector<float> line((inWidth + 2 * pad) * ResampleStep);
+            std::vector<float> result(outWidth * ResampleStep);
+            for (size_t g = begin; g < end; ++g)
+            {
+                const size_t y0 = g * ResampleGroupRows;
+                for (size_t r = 0; r < ResampleGroupRows; ++r)
+                {
+                    const size_t y = std::min(y0 + r, inHeight - 1);
+                    const float* src = input.RowAs<float>(y);
+                    if (!directInput)
+                    {
+                        input.LoadRow(y, 0, inWidth, row.data(), 4);
+                        src = row.data();
+                    }
+                    for (long x = -pad; x < long(inWidth) + pad; ++x)
+                    {
+                        const float* pixel = src + 4 * BorderIndex(x, long(inWidth), RIF_READ_MODE_CLAMP);
+                        std::copy(pixel, pixel + 4, &line[(x + pad) * ResampleStep + r * 4]);
+                    }
+                }
+
+                kernels.line(&line[pad * ResampleStep], horizontalAxis, outWidth, result.data());
+
+                for (size_t r = 0; r < ResampleGroupRows && y0 + r < inHeight; ++r)
+                {
+                    float* dst = horizontal.Row(y0 + r);
+                    for (size_t x = 0; x < outWidth; ++x)
+                    {
+                        const float* sample = &result[x * ResampleStep + r * 4];
+                        std::copy(sample, sample + 4, dst + 4 * x);
+                    }
+                }
+            }
+        });
+
+        // vertical: column blocks keep the source rows of a band's outputs in L1
+        const bool directOutput = output.Type() == RIF_COMPONENT_TYPE_FLOAT32 && output.Components() == 4;
+        const size_t count = (outWidth * 4 + kernels.width - 1) / kernels.width * kernels.width;
+        const size_t bandRows = 16;
+        const size_t block = 256;
+        const size_t bands = (outHeight + bandRows - 1) / bandRows;
+        pool.ParallelFor(bands, 1, [&](size_t begin, size_t end)
+        {
+            std::vector<float> buffer(directOutput ? 0 : bandRows * count);
+            std::vector<const float*> rows(verticalAxis.taps);
+            for (size_t band = begin; band < end; ++band)
+            {
+                const size_t y0 = band * bandRows;
+                const size_t y1 = std::min(outHeight, y0 + bandRows);
+                for (size_t x0 = 0; x0 < count; x0 += block)
+                {
+                    const size_t x1 = std::min(count, x0 + block);
+                    for (size_t y = y0; y < y1; ++y)
+                    {
+                        const long start = ResampleStart(verticalAxis, y);
+                        for (int t = 0; t < verticalAxis.taps; ++t)
+                        {
+                            rows[t] = horizontal.Row(BorderIndex(start + t, long(inHeight), RIF_READ_MODE_CLAMP));
+                        }
+                        float* dst = directOutput ? output.RowAs<float>(y) : &buffer[(y - y0) * count];
+                        kernels.columns(rows.data(), ResampleWeights(verticalAxis, y), verticalAxis.taps, x0, x1, dst);
+                    }
+                }
+                if (!directOutput)
+                {
+                    for (size_t y = y0; y < y1; ++y)
+                    {
+                        output.StoreRow(y, 0, outWidth, &buffer[(y - y0) * count], 4);
+                    }
+                }
+            }
+        });
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_RESAMPLE
+    // "interpOperator" - RIF_IMAGE_INTERPOLATION_*; the output image's size is the
+    // target size. The weight tables are kept while the sizes and kernel stay the same.
+    class ResampleFilter : public Filter
+    {
+    public:
+        ResampleFilter()
+            : Filter(RIF_IMAGE_FILTER_RESAMPLE)
+        {
+            DeclareUint("interpOperator", RIF_IMAGE_INTERPOLATION_BILINEAR);
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            return Resample(pool, input, output, GetUint("interpOperator"), &m_plan);
+        }
+
+    private:
+        ResamplePlan m_plan;
+    };
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Resampling passes, included by resample_filter.h once per instruction set with
+// 'Float' naming that set's vector type. No includes here on purpose.
+
+// Horizontal pass over a line group: 'line' holds ResampleGroupRows source rows
+// interleaved, one sample of ResampleStep floats per source pixel, and is valid for
+// the taps reaching past both ends. Writes outputs [0, count) in the same layout.
+inline void ResampleLine(const float* line, const ResampleAxis& axis, size_t count, float* out)
+{
+    const int vectors = static_cast<int>(ResampleStep / Float::Width);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* weights = ResampleWeights(axis, i);
+        const float* src = line + ResampleStart(axis, i) * long(ResampleStep);
+        Float acc[ResampleStep / Float::Width];
+        for (int v = 0; v < vectors; ++v)
+        {
+            acc[v] = Float::Zero();
+        }
+        for (int t = 0; t < axis.taps; ++t)
+        {
+            const Float w = Float::Set1(weights[t]);
+            for (int v = 0; v < vectors; ++v)
+            {
+                acc[v] = MulAdd(Float::Load(src + t * ResampleStep + v * Float::Width), w, acc[v]);
+            }
+        }
+        for (int v = 0; v < vectors; ++v)
+        {
+            acc[v].Store(out + i * ResampleStep + v * Float::Width);
+        }
+    }
+}
+
+// Vertical pass for floats [begin, end) of one output row, whole vectors; rows[t] is
+// the source row of tap t.
+inline void ResampleColumns(const float* const* rows, const float* weights, int taps, size_t begin, size_t end, float* out)
+{
+    for (size_t i = begin; i < end; i += Float::Width)
+    {
+        Float acc = Float::Load(rows[0] + i) * Float::Set1(weights[0]);
+        for (int t = 1; t < taps; ++t)
+        {
+            acc = MulAdd(Float::Load(rows[t] + i), Float::Set1(weights[t]), acc);
+        }
+        acc.Store(out + i);
+    }
+}
@@ -0,0 +1,741 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Minimal float vector types for the host kernels. Kernels are written once in an
+// .inl file against an unqualified 'Float' and included into one namespace per
+// instruction set, e.g.
+//
+//     namespace BlurAvx2 { using simd::Avx2::Float; #include "blur_kernels.inl" }
+//
+// The AVX2 copy is compiled between CPU_BACKEND_AVX2_BEGIN/END so it needs no global
+// compiler flags, and is only called when the running CPU reports AVX2 and FMA. The
+// same goes for AVX-512 (the F subset only); kernels without an AVX-512 copy run their
+// AVX2 one on such CPUs.
+//
+// Every set also has an 'Int' of 32-bit lanes, as many as its Float, for the integer
+// dot products of quantized kernels: DotPairs multiplies the signed 16-bit halves of
+// two lanes and adds both products to a 32-bit accumulator (pmaddwd on x86; the
+// AVX-512 copy runs it on 256-bit halves as it only assumes the F subset). CPUs with
+// AVX512-VNNI get the Avx512Vnni set, AVX-512 floats with a single-instruction DotPairs
+// (vpdpwssd), compiled between CPU_BACKEND_AVX512VNNI_BEGIN/END. Round converts floats
+// to the nearest integer (ties to even) and StoreInt16 narrows with saturation.
+//
+// Exp, Log and Pow are polynomial approximations. Over the float range Exp has a
+// relative error below 3e-7 (inputs are clamped to [-87, 88]); Log an absolute error
+// below 2e-7 in [0.5, 2] and a relative error below 2e-7 elsewhere, for positive normal
+// inputs (smaller ones are raised to FLT_MIN); Pow(a, b) = Exp(b Log(a)), so its relative
+// error stays below 3e-7 + 1.2e-7 |b ln a|. The scalar fallback uses the C library.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_BACKEND_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define CPU_BACKEND_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(CPU_BACKEND_X86) && defined(__clang__)
+#define CPU_BACKEND_AVX2_BEGIN _Pragma("clang attribute push(__attribute__((target(\"avx2,fma\"))), apply_to = function)")
+#define CPU_BACKEND_AVX2_END _Pragma("clang attribute pop")
+#define CPU_BACKEND_AVX512_BEGIN _Pragma("clang attribute push(__attribute__((target(\"avx512f,avx2,fma\"))), apply_to = function)")
+#define CPU_BACKEND_AVX512_END _Pragma("clang attribute pop")
+#define CPU_BACKEND_AVX512VNNI_BEGIN _Pragma("clang attribute push(__attribute__((target(\"avx512f,avx512vnni,avx2,fma\"))), apply_to = function)")
+#define CPU_BACKEND_AVX512VNNI_END _Pragma("clang attribute pop")
+#elif defined(CPU_BACKEND_X86) && defined(__GNUC__)
+#define CPU_BACKEND_AVX2_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx2,fma\")")
+#define CPU_BACKEND_AVX2_END _Pragma("GCC pop_options")
+// GCC's AVX-512 intrinsics start from an undefined vector, which -Wall reports as
+// uninitialized in every function they are inlined into
+#define CPU_BACKEND_AVX512_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,avx2,fma\")") \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+    _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define CPU_BACKEND_AVX512_END _Pragma("GCC diagnostic pop") _Pragma("GCC pop_options")
+#define CPU_BACKEND_AVX512VNNI_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"avx512f,avx512vnni,avx2,fma\")") \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+    _Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define CPU_BACKEND_AVX512VNNI_END _Pragma("GCC diagnostic pop") _Pragma("GCC pop_options")
+#else
+#define CPU_BACKEND_AVX2_BEGIN
+#define CPU_BACKEND_AVX2_END
+#define CPU_BACKEND_AVX512_BEGIN
+#define CPU_BACKEND_AVX512_END
+#define CPU_BACKEND_AVX512VNNI_BEGIN
+#define CPU_BACKEND_AVX512VNNI_END
+#endif
+
+namespace CpuBackend
+{
+    namespace simd
+    {
+        enum class Level
+        {
+            Scalar,
+            Sse,
+            Avx2,
+            Avx512,
+            Neon,
+        };
+
+        inline const char* LevelName(Level level)
+        {
+            switch (level)
+            {
+            case Level::Sse:
+                return "SSE";
+            case Level::Avx2:
+                return "AVX2";
+            case Level::Avx512:
+                return "AVX-512";
+            case Level::Neon:
+                return "NEON";
+            default:
+                return "scalar";
+            }
+        }
+
+        // best instruction set of the running CPU; RIF_CPU_SIMD=scalar|sse|avx2 caps it for comparisons
+        inline Level DetectLevel()
+        {
+            Level level = Level::Scalar;
+#if defined(CPU_BACKEND_X86)
+            level = Level::Sse;
+#if defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 0);
+            if (regs[0] >= 7)
+            {
+                __cpuid(regs, 1);
+                const bool fma = (regs[2] & (1 << 12)) != 0;
+                const bool osxsave = (regs[2] & (1 << 27)) != 0;
+                __cpuidex(regs, 7, 0);
+                const bool avx2 = (regs[1] & (1 << 5)) != 0;
+                const unsigned long long xcr0 = _xgetbv(0);
+                if (fma && osxsave && avx2 && (xcr0 & 6) == 6)
+                {
+                    level = Level::Avx2;
+                    // AVX-512 also needs the opmask and upper ZMM state enabled
+                    if ((regs[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6)
+                    {
+                        level = Level::Avx512;
+                    }
+                }
+            }
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            {
+                level = Level::Avx2;
+                if (__builtin_cpu_supports("avx512f"))
+                {
+                    level = Level::Avx512;
+                }
+            }
+#endif
+#elif defined(CPU_BACKEND_NEON)
+            level = Level::Neon;
+#endif
+            const char* cap = getenv("RIF_CPU_SIMD");
+            if (cap && std::string(cap) == "scalar")
+            {
+                level = Level::Scalar;
+            }
+            else if (cap && std::string(cap) == "sse" && (level == Level::Avx2 || level == Level::Avx512))
+            {
+                level = Level::Sse;
+            }
+            else if (cap && std::string(cap) == "avx2" && level == Level::Avx512)
+            {
+                level = Level::Avx2;
+            }
+            return level;
+        }
+
+        inline Level CurrentLevel()
+        {
+            static const Level level = DetectLevel();
+            return level;
+        }
+
+        // whether AVX-512 kernels may use the Avx512Vnni set; RIF_CPU_SIMD=avx512 turns it off
+        inline bool DetectAvx512Vnni()
+        {
+            bool vnni = false;
+#if defined(CPU_BACKEND_X86)
+            if (CurrentLevel() == Level::Avx512)
+            {
+#if defined(_MSC_VER)
+                int regs[4];
+                __cpuidex(regs, 7, 0);
+                vnni = (regs[2] & (1 << 11)) != 0;
+#else
+                vnni = __builtin_cpu_supports("avx512vnni") != 0;
+#endif
+            }
+#endif
+            const char* cap = getenv("RIF_CPU_SIMD");
+            return vnni && !(cap && std::string(cap) == "avx512");
+        }
+
+        inline bool CurrentAvx512Vnni()
+        {
+            static const bool vnni = DetectAvx512Vnni();
+            return vnni;
+        }
+
+        namespace detail
+        {
+            const float Log2e = 1.44269504f;
+            const float MinNormal = 1.17549435e-38f;
+            const int SqrtHalfBits = 0x3f3504f3;       // bit pattern of sqrt(1/2)
+        }
+
+        // portable fallback, four lanes the compiler is free to vectorize
+        namespace Scalar
+        {
+            struct Float
+            {
+                static const int Width = 4;
+                float v[4];
+
+                static Float Load(const float* p)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = p[i];
+                    return r;
+                }
+                static Float Set1(float x)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = x;
+                    return r;
+                }
+                static Float Zero()
+                {
+                    return Set1(0.0f);
+                }
+                void Store(float* p) const
+                {
+                    for (int i = 0; i < 4; ++i) p[i] = v[i];
+                }
+                friend Float operator+(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] + b.v[i];
+                    return r;
+                }
+                friend Float operator-(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] - b.v[i];
+                    return r;
+                }
+                friend Float operator*(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i];
+                    return r;
+                }
+                // a * b + c
+                friend Float MulAdd(const Float& a, const Float& b, const Float& c)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i] + c.v[i];
+                    return r;
+                }
+                friend Float Min(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::min(a.v[i], b.v[i]);
+                    return r;
+                }
+                friend Float Max(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::max(a.v[i], b.v[i]);
+                    return r;
+                }
+                friend Float operator/(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] / b.v[i];
+                    return r;
+                }
+                friend Float Abs(const Float& a)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::fabs(a.v[i]);
+                    return r;
+                }
+                friend Float Sqrt(const Float& a)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]);
+                    return r;
+                }
+                friend Float Exp(const Float& a)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::exp(a.v[i]);
+                    return r;
+                }
+                friend Float Log(const Float& a)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::log(std::max(a.v[i], detail::MinNormal));
+                    return r;
+                }
+                friend Float Pow(const Float& a, const Float& b)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = std::pow(std::max(a.v[i], detail::MinNormal), b.v[i]);
+                    return r;
+                }
+                // x where a > b, y elsewhere
+                friend Float IfGreater(const Float& a, const Float& b, const Float& x, const Float& y)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? x.v[i] : y.v[i];
+                    return r;
+                }
+                // bit i set where lane i of a is greater than lane i of b
+                friend unsigned GreaterMask(const Float& a, const Float& b)
+                {
+                    unsigned mask = 0;
+                    for (int i = 0; i < 4; ++i) mask |= (a.v[i] > b.v[i] ? 1u : 0u) << i;
+                    return mask;
+                }
+            };
+
+            struct Int
+            {
+                static const int Width = 4;
+                int32_t v[4];
+
+                static Int Load(const int32_t* p)
+                {
+                    Int r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = p[i];
+                    return r;
+                }
+                static Int Set1(int32_t x)
+                {
+                    Int r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = x;
+                    return r;
+                }
+                static Int Zero()
+                {
+                    return Set1(0);
+                }
+                // every lane holds the 16-bit pair p[0], p[1]
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Set1(x);
+                }
+                static Int Round(const Float& a)
+                {
+                    Int r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = int32_t(std::lrint(a.v[i]));
+                    return r;
+                }
+                void StoreInt16(int16_t* p) const
+                {
+                    for (int i = 0; i < 4; ++i) p[i] = int16_t(std::min(std::max(v[i], -32768), 32767));
+                }
+                // c + lo(a) * lo(b) + hi(a) * hi(b) with the 16-bit halves signed
+                friend Int DotPairs(const Int& a, const Int& b, const Int& c)
+                {
+                    Int r;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        const uint32_t x = static_cast<uint32_t>(a.v[i]);
+                        const uint32_t y = static_cast<uint32_t>(b.v[i]);
+                        r.v[i] = c.v[i] + int32_t(int16_t(x & 0xffff)) * int16_t(y & 0xffff) + int32_t(int16_t(x >> 16)) * int16_t(y >> 16);
+                    }
+                    return r;
+                }
+                friend Float ToFloat(const Int& a)
+                {
+                    Float r;
+                    for (int i = 0; i < 4; ++i) r.v[i] = static_cast<float>(a.v[i]);
+                    return r;
+                }
+            };
+        }
+
+#if defined(CPU_BACKEND_X86)
+        namespace Sse
+        {
+            struct Float
+            {
+                static const int Width = 4;
+                __m128 v;
+
+                static Float Load(const float* p) { return Float{ _mm_loadu_ps(p) }; }
+                static Float Set1(float x) { return Float{ _mm_set1_ps(x) }; }
+                static Float Zero() { return Float{ _mm_setzero_ps() }; }
+                void Store(float* p) const { _mm_storeu_ps(p, v); }
+            };
+
+            inline Float operator+(const Float& a, const Float& b) { return Float{ _mm_add_ps(a.v, b.v) }; }
+            inline Float operator-(const Float& a, const Float& b) { return Float{ _mm_sub_ps(a.v, b.v) }; }
+            inline Float operator*(const Float& a, const Float& b) { return Float{ _mm_mul_ps(a.v, b.v) }; }
+            inline Float MulAdd(const Float& a, const Float& b, const Float& c) { return Float{ _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) }; }
+            inline Float Min(const Float& a, const Float& b) { return Float{ _mm_min_ps(a.v, b.v) }; }
+            inline Float Max(const Float& a, const Float& b) { return Float{ _mm_max_ps(a.v, b.v) }; }
+
+#include "simd_exp.inl"
+
+            inline Float operator/(const Float& a, const Float& b) { return Float{ _mm_div_ps(a.v, b.v) }; }
+            inline Float Abs(const Float& a) { return Float{ _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+            inline Float Sqrt(const Float& a) { return Float{ _mm_sqrt_ps(a.v) }; }
+            inline unsigned GreaterMask(const Float& a, const Float& b) { return static_cast<unsigned>(_mm_movemask_ps(_mm_cmpgt_ps(a.v, b.v))); }
+
+            inline Float Exp(const Float& a)
+            {
+                const __m128 x = _mm_min_ps(_mm_max_ps(a.v, _mm_set1_ps(-87.0f)), _mm_set1_ps(88.0f));
+                const __m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(detail::Log2e)));
+                const Float p = ExpReduced(Float{ x }, Float{ _mm_cvtepi32_ps(n) });
+                return p * Float{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23)) };
+            }
+
+            inline Float Log(const Float& a)
+            {
+                const __m128i bits = _mm_sub_epi32(_mm_castps_si128(_mm_max_ps(a.v, _mm_set1_ps(detail::MinNormal))), _mm_set1_epi32(detail::SqrtHalfBits));
+                const __m128i m = _mm_add_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(detail::SqrtHalfBits));
+                return LogReduced(Float{ _mm_sub_ps(_mm_castsi128_ps(m), _mm_set1_ps(1.0f)) }, Float{ _mm_cvtepi32_ps(_mm_srai_epi32(bits, 23)) });
+            }
+
+            inline Float Pow(const Float& a, const Float& b) { return Exp(b * Log(a)); }
+
+            inline Float IfGreater(const Float& a, const Float& b, const Float& x, const Float& y)
+            {
+                const __m128 mask = _mm_cmpgt_ps(a.v, b.v);
+                return Float{ _mm_or_ps(_mm_and_ps(mask, x.v), _mm_andnot_ps(mask, y.v)) };
+            }
+
+            struct Int
+            {
+                static const int Width = 4;
+                __m128i v;
+
+                static Int Load(const int32_t* p) { return Int{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)) }; }
+                static Int Set1(int32_t x) { return Int{ _mm_set1_epi32(x) }; }
+                static Int Zero() { return Int{ _mm_setzero_si128() }; }
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Int{ _mm_set1_epi32(x) };
+                }
+                static Int Round(const Float& a) { return Int{ _mm_cvtps_epi32(a.v) }; }
+                void StoreInt16(int16_t* p) const { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(v, v)); }
+            };
+
+            inline Int DotPairs(const Int& a, const Int& b, const Int& c) { return Int{ _mm_add_epi32(c.v, _mm_madd_epi16(a.v, b.v)) }; }
+            inline Float ToFloat(const Int& a) { return Float{ _mm_cvtepi32_ps(a.v) }; }
+        }
+
+        CPU_BACKEND_AVX2_BEGIN
+        namespace Avx2
+        {
+            struct Float
+            {
+                static const int Width = 8;
+                __m256 v;
+
+                static Float Load(const float* p) { return Float{ _mm256_loadu_ps(p) }; }
+                static Float Set1(float x) { return Float{ _mm256_set1_ps(x) }; }
+                static Float Zero() { return Float{ _mm256_setzero_ps() }; }
+                void Store(float* p) const { _mm256_storeu_ps(p, v); }
+            };
+
+            inline Float operator+(const Float& a, const Float& b) { return Float{ _mm256_add_ps(a.v, b.v) }; }
+            inline Float operator-(const Float& a, const Float& b) { return Float{ _mm256_sub_ps(a.v, b.v) }; }
+            inline Float operator*(const Float& a, const Float& b) { return Float{ _mm256_mul_ps(a.v, b.v) }; }
+            inline Float MulAdd(const Float& a, const Float& b, const Float& c) { return Float{ _mm256_fmadd_ps(a.v, b.v, c.v) }; }
+            inline Float Min(const Float& a, const Float& b) { return Float{ _mm256_min_ps(a.v, b.v) }; }
+            inline Float Max(const Float& a, const Float& b) { return Float{ _mm256_max_ps(a.v, b.v) }; }
+
+#include "simd_exp.inl"
+
+            inline Float operator/(const Float& a, const Float& b) { return Float{ _mm256_div_ps(a.v, b.v) }; }
+            inline Float Abs(const Float& a) { return Float{ _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+            inline Float Sqrt(const Float& a) { return Float{ _mm256_sqrt_ps(a.v) }; }
+            inline unsigned GreaterMask(const Float& a, const Float& b) { return static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ))); }
+
+            inline Float Exp(const Float& a)
+            {
+                const __m256 x = _mm256_min_ps(_mm256_max_ps(a.v, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.0f));
+                const __m256i n = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(detail::Log2e)));
+                const Float p = ExpReduced(Float{ x }, Float{ _mm256_cvtepi32_ps(n) });
+                return p * Float{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23)) };
+            }
+
+            inline Float Log(const Float& a)
+            {
+                const __m256i bits = _mm256_sub_epi32(_mm256_castps_si256(_mm256_max_ps(a.v, _mm256_set1_ps(detail::MinNormal))), _mm256_set1_epi32(detail::SqrtHalfBits));
+                const __m256i m = _mm256_add_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(detail::SqrtHalfBits));
+                return LogReduced(Float{ _mm256_sub_ps(_mm256_castsi256_ps(m), _mm256_set1_ps(1.0f)) }, Float{ _mm256_cvtepi32_ps(_mm256_srai_epi32(bits, 23)) });
+            }
+
+            inline Float Pow(const Float& a, const Float& b) { return Exp(b * Log(a)); }
+
+            inline Float IfGreater(const Float& a, const Float& b, const Float& x, const Float& y)
+            {
+                return Float{ _mm256_blendv_ps(y.v, x.v, _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)) };
+            }
+
+            struct Int
+            {
+                static const int Width = 8;
+                __m256i v;
+
+                static Int Load(const int32_t* p) { return Int{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) }; }
+                static Int Set1(int32_t x) { return Int{ _mm256_set1_epi32(x) }; }
+                static Int Zero() { return Int{ _mm256_setzero_si256() }; }
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Int{ _mm256_set1_epi32(x) };
+                }
+                static Int Round(const Float& a) { return Int{ _mm256_cvtps_epi32(a.v) }; }
+                void StoreInt16(int16_t* p) const
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+                }
+            };
+
+            inline Int DotPairs(const Int& a, const Int& b, const Int& c) { return Int{ _mm256_add_epi32(c.v, _mm256_madd_epi16(a.v, b.v)) }; }
+            inline Float ToFloat(const Int& a) { return Float{ _mm256_cvtepi32_ps(a.v) }; }
+        }
+        CPU_BACKEND_AVX2_END
+
+        CPU_BACKEND_AVX512_BEGIN
+        namespace Avx512
+        {
+            struct Float
+            {
+                static const int Width = 16;
+                __m512 v;
+
+                static Float Load(const float* p) { return Float{ _mm512_loadu_ps(p) }; }
+                static Float Set1(float x) { return Float{ _mm512_set1_ps(x) }; }
+                static Float Zero() { return Float{ _mm512_setzero_ps() }; }
+                void Store(float* p) const { _mm512_storeu_ps(p, v); }
+            };
+
+            inline Float operator+(const Float& a, const Float& b) { return Float{ _mm512_add_ps(a.v, b.v) }; }
+            inline Float operator-(const Float& a, const Float& b) { return Float{ _mm512_sub_ps(a.v, b.v) }; }
+            inline Float operator*(const Float& a, const Float& b) { return Float{ _mm512_mul_ps(a.v, b.v) }; }
+            inline Float MulAdd(const Float& a, const Float& b, const Float& c) { return Float{ _mm512_fmadd_ps(a.v, b.v, c.v) }; }
+            inline Float Min(const Float& a, const Float& b) { return Float{ _mm512_min_ps(a.v, b.v) }; }
+            inline Float Max(const Float& a, const Float& b) { return Float{ _mm512_max_ps(a.v, b.v) }; }
+
+#include "simd_exp.inl"
+
+            inline Float operator/(const Float& a, const Float& b) { return Float{ _mm512_div_ps(a.v, b.v) }; }
+            inline Float Abs(const Float& a) { return Float{ _mm512_abs_ps(a.v) }; }
+            inline Float Sqrt(const Float& a) { return Float{ _mm512_sqrt_ps(a.v) }; }
+            inline unsigned GreaterMask(const Float& a, const Float& b) { return static_cast<unsigned>(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)); }
+
+            inline Float Exp(const Float& a)
+            {
+                const __m512 x = _mm512_min_ps(_mm512_max_ps(a.v, _mm512_set1_ps(-87.0f)), _mm512_set1_ps(88.0f));
+                const __m512i n = _mm512_cvtps_epi32(_mm512_mul_ps(x, _mm512_set1_ps(detail::Log2e)));
+                const Float p = ExpReduced(Float{ x }, Float{ _mm512_cvtepi32_ps(n) });
+                return p * Float{ _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(n, _mm512_set1_epi32(127)), 23)) };
+            }
+
+            inline Float Log(const Float& a)
+            {
+                const __m512i bits = _mm512_sub_epi32(_mm512_castps_si512(_mm512_max_ps(a.v, _mm512_set1_ps(detail::MinNormal))), _mm512_set1_epi32(detail::SqrtHalfBits));
+                const __m512i m = _mm512_add_epi32(_mm512_and_si512(bits, _mm512_set1_epi32(0x007fffff)), _mm512_set1_epi32(detail::SqrtHalfBits));
+                return LogReduced(Float{ _mm512_sub_ps(_mm512_castsi512_ps(m), _mm512_set1_ps(1.0f)) }, Float{ _mm512_cvtepi32_ps(_mm512_srai_epi32(bits, 23)) });
+            }
+
+            inline Float Pow(const Float& a, const Float& b) { return Exp(b * Log(a)); }
+
+            inline Float IfGreater(const Float& a, const Float& b, const Float& x, const Float& y)
+            {
+                return Float{ _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ), y.v, x.v) };
+            }
+
+            struct Int
+            {
+                static const int Width = 16;
+                __m512i v;
+
+                static Int Load(const int32_t* p) { return Int{ _mm512_loadu_si512(p) }; }
+                static Int Set1(int32_t x) { return Int{ _mm512_set1_epi32(x) }; }
+                static Int Zero() { return Int{ _mm512_setzero_si512() }; }
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Int{ _mm512_set1_epi32(x) };
+                }
+                static Int Round(const Float& a) { return Int{ _mm512_cvtps_epi32(a.v) }; }
+                void StoreInt16(int16_t* p) const { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtsepi32_epi16(v)); }
+            };
+
+            inline Int DotPairs(const Int& a, const Int& b, const Int& c)
+            {
+                const __m256i low = _mm256_madd_epi16(_mm512_castsi512_si256(a.v), _mm512_castsi512_si256(b.v));
+                const __m256i high = _mm256_madd_epi16(_mm512_extracti64x4_epi64(a.v, 1), _mm512_extracti64x4_epi64(b.v, 1));
+                return Int{ _mm512_add_epi32(c.v, _mm512_inserti64x4(_mm512_castsi256_si512(low), high, 1)) };
+            }
+            inline Float ToFloat(const Int& a) { return Float{ _mm512_cvtepi32_ps(a.v) }; }
+        }
+        CPU_BACKEND_AVX512_END
+
+        CPU_BACKEND_AVX512VNNI_BEGIN
+        namespace Avx512Vnni
+        {
+            using Avx512::Float;
+
+            struct Int
+            {
+                static const int Width = 16;
+                __m512i v;
+
+                static Int Load(const int32_t* p) { return Int{ _mm512_loadu_si512(p) }; }
+                static Int Set1(int32_t x) { return Int{ _mm512_set1_epi32(x) }; }
+                static Int Zero() { return Int{ _mm512_setzero_si512() }; }
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Int{ _mm512_set1_epi32(x) };
+                }
+                static Int Round(const Float& a) { return Int{ _mm512_cvtps_epi32(a.v) }; }
+                void StoreInt16(int16_t* p) const { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtsepi32_epi16(v)); }
+            };
+
+            inline Int DotPairs(const Int& a, const Int& b, const Int& c) { return Int{ _mm512_dpwssd_epi32(c.v, a.v, b.v) }; }
+            inline Float ToFloat(const Int& a) { return Float{ _mm512_cvtepi32_ps(a.v) }; }
+        }
+        CPU_BACKEND_AVX512VNNI_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+        namespace Neon
+        {
+            struct Float
+            {
+                static const int Width = 4;
+                float32x4_t v;
+
+                static Float Load(const float* p) { return Float{ vld1q_f32(p) }; }
+                static Float Set1(float x) { return Float{ vdupq_n_f32(x) }; }
+                static Float Zero() { return Float{ vdupq_n_f32(0.0f) }; }
+                void Store(float* p) const { vst1q_f32(p, v); }
+            };
+
+            inline Float operator+(const Float& a, const Float& b) { return Float{ vaddq_f32(a.v, b.v) }; }
+            inline Float operator-(const Float& a, const Float& b) { return Float{ vsubq_f32(a.v, b.v) }; }
+            inline Float operator*(const Float& a, const Float& b) { return Float{ vmulq_f32(a.v, b.v) }; }
+            inline Float MulAdd(const Float& a, const Float& b, const Float& c) { return Float{ vmlaq_f32(c.v, a.v, b.v) }; }
+            inline Float Min(const Float& a, const Float& b) { return Float{ vminq_f32(a.v, b.v) }; }
+            inline Float Max(const Float& a, const Float& b) { return Float{ vmaxq_f32(a.v, b.v) }; }
+
+#include "simd_exp.inl"
+
+            inline Float operator/(const Float& a, const Float& b) { return Float{ vdivq_f32(a.v, b.v) }; }
+            inline Float Abs(const Float& a) { return Float{ vabsq_f32(a.v) }; }
+            inline Float Sqrt(const Float& a) { return Float{ vsqrtq_f32(a.v) }; }
+
+            inline unsigned GreaterMask(const Float& a, const Float& b)
+            {
+                static const uint32_t bits[4] = { 1, 2, 4, 8 };
+                return vaddvq_u32(vandq_u32(vcgtq_f32(a.v, b.v), vld1q_u32(bits)));
+            }
+
+            inline Float Exp(const Float& a)
+            {
+                const float32x4_t x = vminq_f32(vmaxq_f32(a.v, vdupq_n_f32(-87.0f)), vdupq_n_f32(88.0f));
+                const int32x4_t n = vcvtnq_s32_f32(vmulq_f32(x, vdupq_n_f32(detail::Log2e)));
+                const Float p = ExpReduced(Float{ x }, Float{ vcvtq_f32_s32(n) });
+                return p * Float{ vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23)) };
+            }
+
+            inline Float Log(const Float& a)
+            {
+                const int32x4_t bits = vsubq_s32(vreinterpretq_s32_f32(vmaxq_f32(a.v, vdupq_n_f32(detail::MinNormal))), vdupq_n_s32(detail::SqrtHalfBits));
+                const int32x4_t m = vaddq_s32(vandq_s32(bits, vdupq_n_s32(0x007fffff)), vdupq_n_s32(detail::SqrtHalfBits));
+                return LogReduced(Float{ vsubq_f32(vreinterpretq_f32_s32(m), vdupq_n_f32(1.0f)) }, Float{ vcvtq_f32_s32(vshrq_n_s32(bits, 23)) });
+            }
+
+            inline Float Pow(const Float& a, const Float& b) { return Exp(b * Log(a)); }
+
+            inline Float IfGreater(const Float& a, const Float& b, const Float& x, const Float& y)
+            {
+                return Float{ vbslq_f32(vcgtq_f32(a.v, b.v), x.v, y.v) };
+            }
+
+            struct Int
+            {
+                static const int Width = 4;
+                int32x4_t v;
+
+                static Int Load(const int32_t* p) { return Int{ vld1q_s32(p) }; }
+                static Int Set1(int32_t x) { return Int{ vdupq_n_s32(x) }; }
+                static Int Zero() { return Int{ vdupq_n_s32(0) }; }
+                static Int Set1Pair(const int16_t* p)
+                {
+                    int32_t x;
+                    std::memcpy(&x, p, sizeof(x));
+                    return Int{ vdupq_n_s32(x) };
+                }
+                static Int Round(const Float& a) { return Int{ vcvtnq_s32_f32(a.v) }; }
+                void StoreInt16(int16_t* p) const { vst1_s16(p, vqmovn_s32(v)); }
+            };
+
+            inline Int DotPairs(const Int& a, const Int& b, const Int& c)
+            {
+                const int16x8_t x = vreinterpretq_s16_s32(a.v);
+                const int16x8_t y = vreinterpretq_s16_s32(b.v);
+                const int32x4_t low = vmull_s16(vget_low_s16(x), vget_low_s16(y));
+                const int32x4_t high = vmull_s16(vget_high_s16(x), vget_high_s16(y));
+                return Int{ vaddq_s32(c.v, vpaddq_s32(low, high)) };
+            }
+            inline Float ToFloat(const Int& a) { return Float{ vcvtq_f32_s32(a.v) }; }
+        }
+#endif
+    }
+}
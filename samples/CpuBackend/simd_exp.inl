@@ -0,0 +1,58 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Shared parts of the vector Exp and Log, included by simd.h into every vector
+// namespace so they are compiled for that instruction set.
+
+// e^(x - n ln 2) for |x - n ln 2| <= ln 2 / 2: Cody-Waite reduction and a degree 6
+// Taylor polynomial, relative error below 2e-7; Exp then scales by 2^n
+inline Float ExpReduced(const Float& x, const Float& n)
+{
+    const Float r = MulAdd(n, Float::Set1(-1.42860677e-6f), MulAdd(n, Float::Set1(-0.693145752f), x));
+    Float p = Float::Set1(1.0f / 720.0f);
+    p = MulAdd(p, r, Float::Set1(1.0f / 120.0f));
+    p = MulAdd(p, r, Float::Set1(1.0f / 24.0f));
+    p = MulAdd(p, r, Float::Set1(1.0f / 6.0f));
+    p = MulAdd(p, r, Float::Set1(0.5f));
+    p = MulAdd(p, r, Float::Set1(1.0f));
+    return MulAdd(p, r, Float::Set1(1.0f));
+}
+
+// ln(1 + f) + e ln 2 for f in [sqrt(1/2) - 1, sqrt(2) - 1]: the Cephes logf polynomial
+// with ln 2 split in two so the e terms stay exact
+inline Float LogReduced(const Float& f, const Float& e)
+{
+    const Float z = f * f;
+    Float p = Float::Set1(7.0376836292e-2f);
+    p = MulAdd(p, f, Float::Set1(-1.1514610310e-1f));
+    p = MulAdd(p, f, Float::Set1(1.1676998740e-1f));
+    p = MulAdd(p, f, Float::Set1(-1.2420140846e-1f));
+    p = MulAdd(p, f, Float::Set1(1.4249322787e-1f));
+    p = MulAdd(p, f, Float::Set1(-1.6668057665e-1f));
+    p = MulAdd(p, f, Float::Set1(2.0000714765e-1f));
+    p = MulAdd(p, f, Float::Set1(-2.4999993993e-1f));
+    p = MulAdd(p, f, Float::Set1(3.3333331174e-1f));
+    Float y = p * f * z;
+    y = MulAdd(e, Float::Set1(-2.12194440e-4f), y);
+    y = MulAdd(z, Float::Set1(-0.5f), y);
+    return MulAdd(e, Float::Set1(0.693359375f), f + y);
+}
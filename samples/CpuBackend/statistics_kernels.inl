@@ -0,0 +1,128 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Row reduction of the image statistics, included by image_statistics.h once per
+// instruction set with 'Float' naming that set's vector type.
+
+// Adds the 'pixels' RGBA pixels at 'rgba' to 'partial' and their luminance bins to
+// 'histogram'. Pixels are split into planes a chunk at a time; every chunk is summed
+// in float vectors and then added to the double sums, so float sums never grow long.
+inline void StatisticsRow(const float* rgba, size_t pixels, const StatisticsConstants& c, StatisticsPartial& partial,
+    uint32_t* histogram)
+{
+    const Float red = Float::Set1(0.2126f);
+    const Float green = Float::Set1(0.7152f);
+    const Float blue = Float::Set1(0.0722f);
+    const Float zero = Float::Zero();
+    const Float delta = Float::Set1(c.logDelta);
+    const Float inverseLn2 = Float::Set1(1.0f / 0.693147181f);
+    const Float histogramMin = Float::Set1(c.histogramMin);
+    const Float histogramScale = Float::Set1(c.histogramScale);
+    const Float lastBin = Float::Set1(static_cast<float>(c.bins - 1));
+
+    Float minimum[5], maximum[5];
+    for (int k = 0; k < 5; ++k)
+    {
+        minimum[k] = Float::Set1(std::numeric_limits<float>::max());
+        maximum[k] = Float::Set1(-std::numeric_limits<float>::max());
+    }
+
+    float planes[4][StatisticsChunk];
+    float bins[StatisticsChunk];
+    float lanes[Float::Width];
+    for (size_t start = 0; start < pixels; start += StatisticsChunk)
+    {
+        const size_t count = std::min<size_t>(StatisticsChunk, pixels - start);
+        const size_t vectors = count / Float::Width * Float::Width;
+        const float* src = rgba + 4 * start;
+        for (size_t i = 0; i < count; ++i)
+        {
+            planes[0][i] = src[4 * i];
+            planes[1][i] = src[4 * i + 1];
+            planes[2][i] = src[4 * i + 2];
+            planes[3][i] = src[4 * i + 3];
+        }
+
+        // channels, luminance and log luminance
+        Float sums[6] = { zero, zero, zero, zero, zero, zero };
+        for (size_t i = 0; i < vectors; i += Float::Width)
+        {
+            Float v[5];
+            for (int k = 0; k < 4; ++k)
+            {
+                v[k] = Float::Load(planes[k] + i);
+            }
+            v[4] = MulAdd(v[0], red, MulAdd(v[1], green, v[2] * blue));
+            for (int k = 0; k < 5; ++k)
+            {
+                minimum[k] = Min(minimum[k], v[k]);
+                maximum[k] = Max(maximum[k], v[k]);
+                sums[k] = sums[k] + v[k];
+            }
+            const Float logLuminance = Log(Max(v[4], zero) + delta);
+            sums[5] = sums[5] + logLuminance;
+
+            const Float t = c.logHistogram ? logLuminance * inverseLn2 : v[4];
+            Min(Max((t - histogramMin) * histogramScale, zero), lastBin).Store(bins + i);
+        }
+        for (int k = 0; k < 6; ++k)
+        {
+            sums[k].Store(lanes);
+            double sum = 0.0;
+            for (int j = 0; j < Float::Width; ++j)
+            {
+                sum += lanes[j];
+            }
+            partial.sum[k] += sum;
+        }
+        for (size_t i = 0; i < vectors; ++i)
+        {
+            ++histogram[static_cast<int>(bins[i])];
+        }
+
+        // the pixels past the last whole vector
+        for (size_t i = vectors; i < count; ++i)
+        {
+            float v[5] = { planes[0][i], planes[1][i], planes[2][i], planes[3][i], 0.0f };
+            v[4] = 0.2126f * v[0] + 0.7152f * v[1] + 0.0722f * v[2];
+            for (int k = 0; k < 5; ++k)
+            {
+                partial.min[k] = std::min(partial.min[k], v[k]);
+                partial.max[k] = std::max(partial.max[k], v[k]);
+                partial.sum[k] += v[k];
+            }
+            const float logLuminance = std::log(std::max(v[4], 0.0f) + c.logDelta);
+            partial.sum[5] += logLuminance;
+            const float t = c.logHistogram ? logLuminance / 0.693147181f : v[4];
+            ++histogram[static_cast<int>(std::min(std::max((t - c.histogramMin) * c.histogramScale, 0.0f), float(c.bins - 1)))];
+        }
+    }
+
+    for (int k = 0; k < 5; ++k)
+    {
+        minimum[k].Store(lanes);
+        partial.min[k] = std::min(partial.min[k], *std::min_element(lanes, lanes + Float::Width));
+        maximum[k].Store(lanes);
+        partial.max[k] = std::max(partial.max[k], *std::max_element(lanes, lanes + Float::Width));
+    }
+    partial.count += pixels;
+}
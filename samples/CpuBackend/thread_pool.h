@@ -0,0 +1,286 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CpuBackend
+{
+    // Work-stealing pool for data-parallel loops. ParallelFor hands the whole range to
+    // the calling thread, which keeps splitting it in half and pushing the upper halves
+    // to the back of its own deque until a piece is no larger than the grain. Idle
+    // workers steal from the front of other deques, so they take the biggest pieces
+    // first and the split tree adapts to uneven per-row cost. The calling thread always
+    // takes part, which also makes nested ParallelFor calls from inside a kernel safe.
+    class ThreadPool
+    {
+    public:
+        using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+        // 'threadCount' - threads including the caller, 0 uses every hardware thread
+        explicit ThreadPool(unsigned threadCount = 0)
+        {
+            if (threadCount == 0)
+            {
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            // one deque per worker plus one shared by all external callers
+            for (unsigned i = 0; i < threadCount; ++i)
+            {
+                m_queues.emplace_back(new Queue());
+            }
+            for (unsigned i = 0; i + 1 < threadCount; ++i)
+            {
+                m_workers.emplace_back([this, i]() { WorkerLoop(i); });
+            }
+        }
+
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleepMutex);
+                m_stop = true;
+            }
+            m_sleepCv.notify_all();
+            for (auto& worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // worker threads plus the calling thread
+        unsigned ThreadCount() const
+        {
+            return static_cast<unsigned>(m_workers.size()) + 1;
+        }
+
+        // calls 'function' on disjoint sub-ranges covering [0, count) and returns when all
+        // of them are done; sub-ranges are at most 'grain' long
+        void ParallelFor(size_t count, size_t grain, const RangeFunction& function)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+            grain = std::max<size_t>(grain, 1);
+            if (m_workers.empty() || count <= grain)
+            {
+                function(0, count);
+                return;
+            }
+
+            Job job;
+            job.function = &function;
+            job.grain = grain;
+            job.remaining.store(count, std::memory_order_relaxed);
+
+            const size_t self = LocalQueue();
+            Run(Range{ &job, 0, count }, self);
+
+            // help with whatever is queued, ours or not, until our job is complete
+            while (job.remaining.load(std::memory_order_acquire) != 0)
+            {
+                Range range;
+                if (TryPop(self, range) || TrySteal(self, range))
+                {
+                    Run(range, self);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // rows [0, height) in bands sized so that every thread gets several of them
+        void ParallelForRows(size_t height, const RangeFunction& function, size_t minRows = 4)
+        {
+            size_t grain = std::max(minRows, height / (size_t(ThreadCount()) * 8));
+            ParallelFor(height, grain, function);
+        }
+
+    private:
+        struct Job
+        {
+            const RangeFunction* function;
+            size_t grain;
+            std::atomic<size_t> remaining;
+        };
+
+        struct Range
+        {
+            Job* job;
+            size_t begin;
+            size_t end;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<Range> ranges;
+        };
+
+        struct WorkerIdentity
+        {
+            const ThreadPool* pool = nullptr;
+            size_t index = 0;
+        };
+
+        static WorkerIdentity& LocalIdentity()
+        {
+            thread_local WorkerIdentity identity;
+            return identity;
+        }
+
+        size_t LocalQueue() const
+        {
+            // workers own queues [0, workers), external threads share the last one
+            const WorkerIdentity& identity = LocalIdentity();
+            return (identity.pool == this) ? identity.index : m_queues.size() - 1;
+        }
+
+        void Push(size_t queue, const Range& range)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+                m_queues[queue]->ranges.push_back(range);
+            }
+            // sequentially consistent with the sleeping count of WorkerLoop: either this
+            // sees the worker going to sleep or the worker sees this range
+            m_queued.fetch_add(1);
+            if (m_sleeping.load() > 0)
+            {
+                // a worker holds the lock from its check of m_queued until it waits, so
+                // taking it here keeps the notify from landing in between
+                {
+                    std::lock_guard<std::mutex> lock(m_sleepMutex);
+                }
+                m_sleepCv.notify_one();
+            }
+        }
+
+        bool TryPop(size_t queue, Range& range)
+        {
+            std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+            if (m_queues[queue]->ranges.empty())
+            {
+                return false;
+            }
+            range = m_queues[queue]->ranges.back();
+            m_queues[queue]->ranges.pop_back();
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool TrySteal(size_t self, Range& range)
+        {
+            const size_t count = m_queues.size();
+            for (size_t i = 1; i <= count; ++i)
+            {
+                Queue& victim = *m_queues[(self + i) % count];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.ranges.empty())
+                {
+                    range = victim.ranges.front();
+                    victim.ranges.pop_front();
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Run(Range range, size_t self)
+        {
+            while (range.end - range.begin > range.job->grain)
+            {
+                size_t middle = range.begin + (range.end - range.begin) / 2;
+                Push(self, Range{ range.job, middle, range.end });
+                range.end = middle;
+            }
+            (*range.job->function)(range.begin, range.end);
+            range.job->remaining.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+        }
+
+        void WorkerLoop(unsigned index)
+        {
+            LocalIdentity().pool = this;
+            LocalIdentity().index = index;
+
+            for (;;)
+            {
+                Range range;
+                if (TryPop(index, range) || TrySteal(index, range))
+                {
+                    Run(range, index);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_sleepMutex);
+                if (m_stop)
+                {
+                    return;
+                }
+                m_sleeping.fetch_add(1);
+                m_sleepCv.wait(lock, [this]()
+                {
+                    return m_stop || m_queued.load() > 0;
+                });
+                m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<std::unique_ptr<Queue>> m_queues;
+        std::vector<std::thread> m_workers;
+
+        std::atomic<long> m_queued{ 0 };
+        std::atomic<int> m_sleeping{ 0 };
+        std::mutex m_sleepMutex;
+        std::condition_variable m_sleepCv;
+        bool m_stop = false;
+
+    };
+
+    namespace detail
+    {
+        // milliseconds since 'start', for the per-pass statistics of the filters
+        inline double MsSince(std::chrono::high_resolution_clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+}
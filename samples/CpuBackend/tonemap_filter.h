@@ -0,0 +1,471 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// Tone mapping on the host, fused with exposure, display encoding and 8-bit
+// quantization.
+//
+// Every operator is a compile-time policy of tonemap_kernels.inl. A row function is
+// instantiated per operator, encoding (none, gamma, sRGB) and output type, so one
+// pass reads the HDR pixels and writes the display ones with no intermediate image
+// and no per-pixel branches. Float32 RGBA input and float32 or uint8 RGBA output are
+// read and written in place; other formats go through one converted row at a time.
+// The transcendental functions are the approximations of simd.h, whose error bounds
+// are listed there.
+
+#include "filter.h"
+#include "image_statistics.h"
+#include "simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace CpuBackend
+{
+    enum class ToneMapOperator
+    {
+        Linear,
+        Exponential,
+        Reinhard02,
+        Drago,
+        Filmic,
+        Aces,
+        MaxWhite,
+        PhotoLinear,
+        Photo,
+        FilmicUncharted,
+        AutoLinear,         // Linear with the key taken from the log-average luminance
+    };
+
+    enum class ToneMapEncode
+    {
+        None,
+        Gamma,      // x^(1 / gamma)
+        Srgb,       // the piecewise sRGB transfer function
+    };
+
+    // operator constants derived from ToneMapParameters, see each policy for their meaning
+    struct ToneMapConstants
+    {
+        float exposure = 1.0f;
+        float k[4] = {};
+        float inverseGamma = 1.0f;
+    };
+
+    typedef void (*ToneMapRowFunction)(const float* rgba, size_t pixels, const ToneMapConstants& constants, void* out);
+
+    const size_t ToneMapChunk = 64;
+
+    namespace ToneMapScalar
+    {
+        using simd::Scalar::Float;
+#include "tonemap_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace ToneMapSse
+    {
+        using simd::Sse::Float;
+#include "tonemap_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace ToneMapAvx2
+    {
+        using simd::Avx2::Float;
+#include "tonemap_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace ToneMapAvx512
+    {
+        using simd::Avx512::Float;
+#include "tonemap_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace ToneMapNeon
+    {
+        using simd::Neon::Float;
+#include "tonemap_kernels.inl"
+    }
+#endif
+
+    // the parameters of all operators; each uses its own subset
+    struct ToneMapParameters
+    {
+        float key = 1.0f;               // Linear
+        float exposure = 1.0f;          // Exponential, Filmic, Photo, FilmicUncharted
+        float intensity = 1.0f;         // Exponential
+        float preScale = 1.0f;          // Reinhard02
+        float postScale = 1.0f;
+        float burn = 10.0f;             // Reinhard02 white point
+        float averageLuminance = 0.5f;  // Drago; 0 takes the image's log average
+        float maxLuminance = 10.0f;     // Drago; 0 takes the image's maximum
+        float bias = 0.85f;
+        float contrast = 1.0f;          // Filmic
+        bool applyToneMap = true;
+        float sensitivity = 100.0f;     // PhotoLinear, and Photo with useIso
+        float exposureTime = 1.0f;
+        float fstop = 1.0f;
+        bool useIso = false;            // Photo
+        float whitePoint = 10.0f;
+        float saturation = 1.0f;
+    };
+
+    struct ToneMapSettings
+    {
+        ToneMapOperator op = ToneMapOperator::Reinhard02;
+        ToneMapParameters parameters;
+        float exposure = 1.0f;          // applied before the operator
+        ToneMapEncode encode = ToneMapEncode::None;
+        float gamma = 2.2f;
+    };
+
+    // middle grey that AutoLinear maps the log-average luminance to
+    const float ToneMapAutoKey = 0.18f;
+
+    // the operators whose constants depend on the image
+    inline bool ToneMapNeedsStatistics(const ToneMapSettings& settings)
+    {
+        const ToneMapParameters& p = settings.parameters;
+        return settings.op == ToneMapOperator::MaxWhite || settings.op == ToneMapOperator::AutoLinear ||
+            (settings.op == ToneMapOperator::Drago && (p.averageLuminance <= 0.0f || p.maxLuminance <= 0.0f));
+    }
+
+    // 'statistics' of the input are needed when ToneMapNeedsStatistics is true and may be
+    // null otherwise
+    inline ToneMapConstants ComputeToneMapConstants(const ToneMapSettings& settings, const ImageStatistics* statistics)
+    {
+        const ToneMapParameters& p = settings.parameters;
+        ToneMapConstants c;
+        c.exposure = settings.exposure;
+        c.inverseGamma = settings.gamma > 0.0f ? 1.0f / settings.gamma : 1.0f;
+
+        // ISO 12232 saturation based exposure: 78 / (0.65 S) N^2 / t maps to white
+        auto photographic = [](float sensitivity, float time, float fstop)
+        {
+            return 0.65f * sensitivity * time / (78.0f * std::max(fstop * fstop, 1e-6f));
+        };
+
+        switch (settings.op)
+        {
+        case ToneMapOperator::Linear:
+            c.k[0] = p.key;
+            break;
+        case ToneMapOperator::Exponential:
+            c.k[0] = p.intensity * p.exposure;
+            break;
+        case ToneMapOperator::Reinhard02:
+            c.k[0] = p.preScale;
+            c.k[1] = p.postScale;
+            c.k[2] = 1.0f / std::max(p.burn * p.burn, 1e-12f);
+            break;
+        case ToneMapOperator::AutoLinear:
+            c.k[0] = statistics && statistics->logAverageLuminance > 0.0f ? ToneMapAutoKey / statistics->logAverageLuminance : 1.0f;
+            break;
+        case ToneMapOperator::Drago:
+        {
+            const float imageAverage = statistics ? statistics->logAverageLuminance : 0.0f;
+            const float imageMaximum = statistics ? statistics->maxLuminance : 0.0f;
+            const float average = std::max(p.averageLuminance > 0.0f ? p.averageLuminance : imageAverage, 1e-6f);
+            const float maximum = std::max((p.maxLuminance > 0.0f ? p.maxLuminance : imageMaximum) / average, 1e-6f);
+            // a bias outside (0, 1) makes the exponent degenerate
+            const float bias = std::min(std::max(p.bias, 0.01f), 0.99f);
+            c.k[0] = 1.0f / average;
+            c.k[1] = 1.0f / maximum;
+            c.k[2] = std::log(bias) / std::log(0.5f);
+            c.k[3] = 1.0f / std::log10(maximum + 1.0f);
+            break;
+        }
+        case ToneMapOperator::Filmic:
+            c.k[0] = p.exposure;
+            c.k[1] = p.contrast;
+            c.k[2] = p.applyToneMap ? 1.0f : 0.0f;
+            break;
+        case ToneMapOperator::MaxWhite:
+        {
+            const float maxWhite = statistics ? std::max(statistics->max[0], std::max(statistics->max[1], statistics->max[2])) : 0.0f;
+            c.k[0] = maxWhite > 0.0f ? 1.0f / maxWhite : 1.0f;
+            break;
+        }
+        case ToneMapOperator::PhotoLinear:
+            c.k[0] = photographic(p.sensitivity, p.exposureTime, p.fstop);
+            break;
+        case ToneMapOperator::Photo:
+            c.k[0] = p.useIso ? photographic(p.sensitivity, p.exposure, p.fstop) : p.exposure;
+            c.k[1] = 1.0f / std::max(p.whitePoint * p.whitePoint, 1e-12f);
+            c.k[2] = p.saturation;
+            break;
+        case ToneMapOperator::FilmicUncharted:
+        {
+            // Hable's exposure bias of 2 and linear white of 11.2
+            auto curve = [](double x)
+            {
+                return (x * (0.15 * x + 0.05) + 0.004) / (x * (0.15 * x + 0.5) + 0.06) - 0.02 / 0.3;
+            };
+            c.k[0] = 2.0f * p.exposure;
+            c.k[1] = static_cast<float>(1.0 / curve(11.2));
+            break;
+        }
+        default:
+            break;
+        }
+        return c;
+    }
+
+    namespace detail
+    {
+        inline ToneMapRowFunction SelectToneMapRow(simd::Level level, ToneMapOperator op, ToneMapEncode encode, bool bytes)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return ToneMapAvx512::ToneMapRow(op, encode, bytes);
+            case simd::Level::Avx2:
+                return ToneMapAvx2::ToneMapRow(op, encode, bytes);
+            case simd::Level::Sse:
+                return ToneMapSse::ToneMapRow(op, encode, bytes);
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return ToneMapNeon::ToneMapRow(op, encode, bytes);
+#endif
+            default:
+                return ToneMapScalar::ToneMapRow(op, encode, bytes);
+            }
+        }
+
+        typedef void (*ToneMapMathFunction)(int function, const float* x, const float* y, size_t count, float* out);
+
+        inline ToneMapMathFunction SelectToneMapMath(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return ToneMapAvx512::ToneMapMath;
+            case simd::Level::Avx2:
+                return ToneMapAvx2::ToneMapMath;
+            case simd::Level::Sse:
+                return ToneMapSse::ToneMapMath;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return ToneMapNeon::ToneMapMath;
+#endif
+            default:
+                return ToneMapScalar::ToneMapMath;
+            }
+        }
+
+    }
+
+    // One pass from 'input' to 'output' of the same size. Uint8 output is quantized by
+    // the kernel itself when it has four components.
+    inline rif_int ToneMap(ThreadPool& pool, const Image& input, Image& output, const ToneMapSettings& settings,
+        simd::Level level = simd::CurrentLevel())
+    {
+        if (input.Width() != output.Width() || input.Height() != output.Height())
+        {
+            return RIF_ERROR_INVALID_IMAGE;
+        }
+
+        ImageStatistics statistics;
+        if (ToneMapNeedsStatistics(settings))
+        {
+            StatisticsSettings statisticsSettings;
+            statisticsSettings.bins = 1;
+            statistics = ComputeImageStatistics(pool, input, statisticsSettings, level);
+        }
+        const ToneMapConstants constants = ComputeToneMapConstants(settings, &statistics);
+
+        const size_t width = input.Width();
+        const bool directInput = input.Type() == RIF_COMPONENT_TYPE_FLOAT32 && input.Components() == 4;
+        const bool rgba = output.Components() == 4;
+        const bool bytes = rgba && output.Type() == RIF_COMPONENT_TYPE_UINT8;
+        const bool directOutput = bytes || (rgba && output.Type() == RIF_COMPONENT_TYPE_FLOAT32);
+        const ToneMapRowFunction row = detail::SelectToneMapRow(level, settings.op, settings.encode, bytes);
+
+        pool.ParallelForRows(input.Height(), [&](size_t begin, size_t end)
+        {
+            std::vector<float> source(directInput ? 0 : width * 4);
+            std::vector<float> result(directOutput ? 0 : width * 4);
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float* src = input.RowAs<float>(y);
+                if (!directInput)
+                {
+                    input.LoadRow(y, 0, width, source.data(), 4);
+                    src = source.data();
+                }
+                if (directOutput)
+                {
+                    row(src, width, constants, output.Row(y));
+                }
+                else
+                {
+                    row(src, width, constants, result.data());
+                    output.StoreRow(y, 0, width, result.data(), 4);
+                }
+            }
+        });
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_*_TONEMAP
+    // LINEAR "cKey"; EXPONENTIAL "cExposure", "cIntensity"; REINHARD02 "preScale",
+    // "postScale", "burn"; DRAGO "avLum", "maxLum", "cBias"; FILMIC "cExposure",
+    // "cContrast", "cApplyToneMap"; PHOTO_LINEAR "sensitivity", "exposureTime", "fstop";
+    // PHOTO "exposure", "fstop", "useISO", "ISO", "whitepoint", "saturation";
+    // FILMIC_UNCHARTED "exposure"; ACES, MAXWHITE and AUTOLINEAR have none. MAXWHITE,
+    // AUTOLINEAR and DRAGO with a zero "avLum" or "maxLum" read the input's statistics
+    class ToneMapFilter : public Filter
+    {
+    public:
+        explicit ToneMapFilter(rif_image_filter_type type)
+            : Filter(type)
+        {
+            const ToneMapParameters defaults;
+            switch (type)
+            {
+            case RIF_IMAGE_FILTER_LINEAR_TONEMAP:
+                DeclareFloat("cKey", defaults.key);
+                break;
+            case RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP:
+                DeclareFloat("cExposure", defaults.exposure);
+                DeclareFloat("cIntensity", defaults.intensity);
+                break;
+            case RIF_IMAGE_FILTER_REINHARD02_TONEMAP:
+                DeclareFloat("preScale", defaults.preScale);
+                DeclareFloat("postScale", defaults.postScale);
+                DeclareFloat("burn", defaults.burn);
+                break;
+            case RIF_IMAGE_FILTER_DRAGO_TONEMAP:
+                DeclareFloat("avLum", defaults.averageLuminance);
+                DeclareFloat("maxLum", defaults.maxLuminance);
+                DeclareFloat("cBias", defaults.bias);
+                break;
+            case RIF_IMAGE_FILTER_FILMIC_TONEMAP:
+                DeclareFloat("cExposure", defaults.exposure);
+                DeclareFloat("cContrast", defaults.contrast);
+                DeclareUint("cApplyToneMap", defaults.applyToneMap ? 1 : 0);
+                break;
+            case RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP:
+                DeclareFloat("sensitivity", defaults.sensitivity);
+                DeclareFloat("exposureTime", defaults.exposureTime);
+                DeclareFloat("fstop", defaults.fstop);
+                break;
+            case RIF_IMAGE_FILTER_PHOTO_TONEMAP:
+                DeclareFloat("exposure", defaults.exposure);
+                DeclareFloat("fstop", defaults.fstop);
+                DeclareUint("useISO", defaults.useIso ? 1 : 0);
+                DeclareUint("ISO", static_cast<rif_uint>(defaults.sensitivity));
+                DeclareFloat("whitepoint", defaults.whitePoint);
+                DeclareFloat("saturation", defaults.saturation);
+                break;
+            case RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP:
+                DeclareFloat("exposure", defaults.exposure);
+                break;
+            default:
+                break;
+            }
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            ToneMapSettings settings;
+            OperatorOf(Type(), &settings.op);
+            ToneMapParameters& p = settings.parameters;
+            switch (Type())
+            {
+            case RIF_IMAGE_FILTER_LINEAR_TONEMAP:
+                p.key = GetFloat("cKey");
+                break;
+            case RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP:
+                p.exposure = GetFloat("cExposure");
+                p.intensity = GetFloat("cIntensity");
+                break;
+            case RIF_IMAGE_FILTER_REINHARD02_TONEMAP:
+                p.preScale = GetFloat("preScale");
+                p.postScale = GetFloat("postScale");
+                p.burn = GetFloat("burn");
+                break;
+            case RIF_IMAGE_FILTER_DRAGO_TONEMAP:
+                p.averageLuminance = GetFloat("avLum");
+                p.maxLuminance = GetFloat("maxLum");
+                p.bias = GetFloat("cBias");
+                break;
+            case RIF_IMAGE_FILTER_FILMIC_TONEMAP:
+                p.exposure = GetFloat("cExposure");
+                p.contrast = GetFloat("cContrast");
+                p.applyToneMap = GetUint("cApplyToneMap") != 0;
+                break;
+            case RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP:
+                p.sensitivity = GetFloat("sensitivity");
+                p.exposureTime = GetFloat("exposureTime");
+                p.fstop = GetFloat("fstop");
+                break;
+            case RIF_IMAGE_FILTER_PHOTO_TONEMAP:
+                p.exposure = GetFloat("exposure");
+                p.fstop = GetFloat("fstop");
+                p.useIso = GetUint("useISO") != 0;
+                p.sensitivity = static_cast<float>(GetUint("ISO"));
+                p.whitePoint = GetFloat("whitepoint");
+                p.saturation = GetFloat("saturation");
+                break;
+            case RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP:
+                p.exposure = GetFloat("exposure");
+                break;
+            default:
+                break;
+            }
+            return ToneMap(pool, input, output, settings);
+        }
+
+    private:
+        static bool OperatorOf(rif_image_filter_type type, ToneMapOperator* op)
+        {
+            switch (type)
+            {
+            case RIF_IMAGE_FILTER_LINEAR_TONEMAP: *op = ToneMapOperator::Linear; return true;
+            case RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP: *op = ToneMapOperator::Exponential; return true;
+            case RIF_IMAGE_FILTER_REINHARD02_TONEMAP: *op = ToneMapOperator::Reinhard02; return true;
+            case RIF_IMAGE_FILTER_DRAGO_TONEMAP: *op = ToneMapOperator::Drago; return true;
+            case RIF_IMAGE_FILTER_FILMIC_TONEMAP: *op = ToneMapOperator::Filmic; return true;
+            case RIF_IMAGE_FILTER_ACES_TONEMAP: *op = ToneMapOperator::Aces; return true;
+            case RIF_IMAGE_FILTER_MAXWHITE_TONEMAP: *op = ToneMapOperator::MaxWhite; return true;
+            case RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP: *op = ToneMapOperator::PhotoLinear; return true;
+            case RIF_IMAGE_FILTER_PHOTO_TONEMAP: *op = ToneMapOperator::Photo; return true;
+            case RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP: *op = ToneMapOperator::FilmicUncharted; return true;
+            case RIF_IMAGE_FILTER_AUTOLINEAR_TONEMAP: *op = ToneMapOperator::AutoLinear; return true;
+            default: return false;
+            }
+        }
+    };
+}
@@ -0,0 +1,354 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Fused tone mapping rows, included by tonemap_filter.h once per instruction set with
+// 'Float' naming that set's vector type. Every operator is a policy applied to three
+// colour vectors in place; ToneMapRow instantiates one row function per operator,
+// encoding and output type so nothing is decided per pixel.
+
+inline Float ToneMapLuminance(const Float& r, const Float& g, const Float& b)
+{
+    return MulAdd(r, Float::Set1(0.2126f), MulAdd(g, Float::Set1(0.7152f), b * Float::Set1(0.0722f)));
+}
+
+// x * k0
+struct LinearToneMap
+{
+    Float scale;
+
+    explicit LinearToneMap(const ToneMapConstants& c) : scale(Float::Set1(c.k[0])) {   }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = r * scale;
+        g = g * scale;
+        b = b * scale;
+    }
+};
+
+// 1 - e^(-k0 x)
+struct ExponentialToneMap
+{
+    Float scale;
+
+    explicit ExponentialToneMap(const ToneMapConstants& c) : scale(Float::Set1(-c.k[0])) {   }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        const Float one = Float::Set1(1.0f);
+        r = one - Exp(r * scale);
+        g = one - Exp(g * scale);
+        b = one - Exp(b * scale);
+    }
+};
+
+// x' = k0 x, k1 x' (1 + k2 x') / (1 + x')
+struct Reinhard02ToneMap
+{
+    Float pre, post, inverseWhite2;
+
+    explicit Reinhard02ToneMap(const ToneMapConstants& c)
+        : pre(Float::Set1(c.k[0])), post(Float::Set1(c.k[1])), inverseWhite2(Float::Set1(c.k[2])) {   }
+
+    Float Curve(const Float& x) const
+    {
+        const Float one = Float::Set1(1.0f);
+        const Float scaled = x * pre;
+        return post * scaled * MulAdd(scaled, inverseWhite2, one) / (scaled + one);
+    }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = Curve(r);
+        g = Curve(g);
+        b = Curve(b);
+    }
+};
+
+// Drago et al. on the luminance of x' = k0 x with k1 = 1 / Lmax, k2 = ln(bias) / ln(0.5)
+// and k3 = 1 / log10(Lmax + 1); the colour is scaled by Ld / L
+struct DragoToneMap
+{
+    Float pre, inverseMax, biasPower, normalize;
+
+    explicit DragoToneMap(const ToneMapConstants& c)
+        : pre(Float::Set1(c.k[0])), inverseMax(Float::Set1(c.k[1])), biasPower(Float::Set1(c.k[2])), normalize(Float::Set1(c.k[3])) {   }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        const Float one = Float::Set1(1.0f);
+        r = r * pre;
+        g = g * pre;
+        b = b * pre;
+        const Float luminance = Max(ToneMapLuminance(r, g, b), Float::Set1(1e-8f));
+        const Float denominator = Log(MulAdd(Pow(luminance * inverseMax, biasPower), Float::Set1(8.0f), Float::Set1(2.0f)));
+        const Float scale = Log(luminance + one) * normalize / (denominator * luminance);
+        r = r * scale;
+        g = g * scale;
+        b = b * scale;
+    }
+};
+
+// x' = k0 x, then the log-logistic curve x'^k1 / (x'^k1 + 1) when k2 is set
+struct FilmicToneMap
+{
+    Float exposure, contrast;
+    bool curve;
+
+    explicit FilmicToneMap(const ToneMapConstants& c)
+        : exposure(Float::Set1(c.k[0])), contrast(Float::Set1(c.k[1])), curve(c.k[2] != 0.0f) {   }
+
+    Float Curve(const Float& x) const
+    {
+        const Float s = Pow(Max(x, Float::Zero()), contrast);
+        return s / (s + Float::Set1(1.0f));
+    }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = r * exposure;
+        g = g * exposure;
+        b = b * exposure;
+        if (curve)
+        {
+            r = Curve(r);
+            g = Curve(g);
+            b = Curve(b);
+        }
+    }
+};
+
+// Narkowicz's fit of the ACES reference rendering, on 0.6 x
+struct AcesToneMap
+{
+    explicit AcesToneMap(const ToneMapConstants&) {   }
+
+    static Float Curve(const Float& x)
+    {
+        const Float v = x * Float::Set1(0.6f);
+        const Float n = v * MulAdd(v, Float::Set1(2.51f), Float::Set1(0.03f));
+        const Float d = MulAdd(v, MulAdd(v, Float::Set1(2.43f), Float::Set1(0.59f)), Float::Set1(0.14f));
+        return Min(Max(n / d, Float::Zero()), Float::Set1(1.0f));
+    }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = Curve(r);
+        g = Curve(g);
+        b = Curve(b);
+    }
+};
+
+// x' = k0 x, Reinhard with white point 1 / sqrt(k1), then the saturation k2 around
+// the luminance
+struct PhotoToneMap
+{
+    Float exposure, inverseWhite2, saturation;
+
+    explicit PhotoToneMap(const ToneMapConstants& c)
+        : exposure(Float::Set1(c.k[0])), inverseWhite2(Float::Set1(c.k[1])), saturation(Float::Set1(c.k[2])) {   }
+
+    Float Curve(const Float& x) const
+    {
+        const Float one = Float::Set1(1.0f);
+        const Float scaled = x * exposure;
+        return scaled * MulAdd(scaled, inverseWhite2, one) / (scaled + one);
+    }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = Curve(r);
+        g = Curve(g);
+        b = Curve(b);
+        const Float luminance = ToneMapLuminance(r, g, b);
+        r = MulAdd(r - luminance, saturation, luminance);
+        g = MulAdd(g - luminance, saturation, luminance);
+        b = MulAdd(b - luminance, saturation, luminance);
+    }
+};
+
+// Hable's curve on k0 x, normalized by k1 = 1 / curve(W)
+struct FilmicUnchartedToneMap
+{
+    Float exposure, normalize;
+
+    explicit FilmicUnchartedToneMap(const ToneMapConstants& c)
+        : exposure(Float::Set1(c.k[0])), normalize(Float::Set1(c.k[1])) {   }
+
+    static Float Curve(const Float& x)
+    {
+        // A = 0.15, B = 0.5, C = 0.1, D = 0.2, E = 0.02, F = 0.3
+        const Float n = MulAdd(x, MulAdd(x, Float::Set1(0.15f), Float::Set1(0.05f)), Float::Set1(0.004f));
+        const Float d = MulAdd(x, MulAdd(x, Float::Set1(0.15f), Float::Set1(0.5f)), Float::Set1(0.06f));
+        return n / d - Float::Set1(0.02f / 0.3f);
+    }
+
+    void operator()(Float& r, Float& g, Float& b) const
+    {
+        r = Curve(r * exposure) * normalize;
+        g = Curve(g * exposure) * normalize;
+        b = Curve(b * exposure) * normalize;
+    }
+};
+
+template <ToneMapEncode Encode>
+inline Float ToneMapEncodeValue(const Float& x, const Float& inverseGamma)
+{
+    switch (Encode)
+    {
+    case ToneMapEncode::Gamma:
+        return Pow(Max(x, Float::Zero()), inverseGamma);
+    case ToneMapEncode::Srgb:
+    {
+        const Float v = Max(x, Float::Zero());
+        const Float curve = MulAdd(Pow(v, Float::Set1(1.0f / 2.4f)), Float::Set1(1.055f), Float::Set1(-0.055f));
+        return IfGreater(v, Float::Set1(0.0031308f), curve, v * Float::Set1(12.92f));
+    }
+    default:
+        return x;
+    }
+}
+
+// Pixels are split into planes a chunk at a time so the vectors hold one channel of
+// Float::Width pixels; the chunk stays in L1 and the image is read and written once.
+template <typename Operator, ToneMapEncode Encode, bool Bytes>
+void ToneMapRowT(const float* rgba, size_t pixels, const ToneMapConstants& c, void* out)
+{
+    const Operator tone(c);
+    const Float exposure = Float::Set1(c.exposure);
+    const Float inverseGamma = Float::Set1(c.inverseGamma);
+    const Float zero = Float::Zero();
+    const Float one = Float::Set1(1.0f);
+    const Float byteScale = Float::Set1(255.0f);
+    const Float half = Float::Set1(0.5f);
+
+    float planes[4][ToneMapChunk] = {};
+    for (size_t start = 0; start < pixels; start += ToneMapChunk)
+    {
+        const size_t count = std::min<size_t>(ToneMapChunk, pixels - start);
+        const float* src = rgba + 4 * start;
+        for (size_t i = 0; i < count; ++i)
+        {
+            planes[0][i] = src[4 * i];
+            planes[1][i] = src[4 * i + 1];
+            planes[2][i] = src[4 * i + 2];
+            planes[3][i] = src[4 * i + 3];
+        }
+
+        for (size_t i = 0; i < count; i += Float::Width)
+        {
+            Float r = Float::Load(planes[0] + i) * exposure;
+            Float g = Float::Load(planes[1] + i) * exposure;
+            Float b = Float::Load(planes[2] + i) * exposure;
+            tone(r, g, b);
+            r = ToneMapEncodeValue<Encode>(r, inverseGamma);
+            g = ToneMapEncodeValue<Encode>(g, inverseGamma);
+            b = ToneMapEncodeValue<Encode>(b, inverseGamma);
+            if (Bytes)
+            {
+                // round to nearest, the conversion below truncates
+                r = MulAdd(Min(Max(r, zero), one), byteScale, half);
+                g = MulAdd(Min(Max(g, zero), one), byteScale, half);
+                b = MulAdd(Min(Max(b, zero), one), byteScale, half);
+                MulAdd(Min(Max(Float::Load(planes[3] + i), zero), one), byteScale, half).Store(planes[3] + i);
+            }
+            r.Store(planes[0] + i);
+            g.Store(planes[1] + i);
+            b.Store(planes[2] + i);
+        }
+
+        if (Bytes)
+        {
+            uint8_t* dst = static_cast<uint8_t*>(out) + 4 * start;
+            for (size_t i = 0; i < count; ++i)
+            {
+                dst[4 * i] = static_cast<uint8_t>(planes[0][i]);
+                dst[4 * i + 1] = static_cast<uint8_t>(planes[1][i]);
+                dst[4 * i + 2] = static_cast<uint8_t>(planes[2][i]);
+                dst[4 * i + 3] = static_cast<uint8_t>(planes[3][i]);
+            }
+        }
+        else
+        {
+            float* dst = static_cast<float*>(out) + 4 * start;
+            for (size_t i = 0; i < count; ++i)
+            {
+                dst[4 * i] = planes[0][i];
+                dst[4 * i + 1] = planes[1][i];
+                dst[4 * i + 2] = planes[2][i];
+                dst[4 * i + 3] = planes[3][i];
+            }
+        }
+    }
+}
+
+template <typename Operator>
+inline ToneMapRowFunction ToneMapRowFor(ToneMapEncode encode, bool bytes)
+{
+    switch (encode)
+    {
+    case ToneMapEncode::Gamma:
+        return bytes ? ToneMapRowT<Operator, ToneMapEncode::Gamma, true> : ToneMapRowT<Operator, ToneMapEncode::Gamma, false>;
+    case ToneMapEncode::Srgb:
+        return bytes ? ToneMapRowT<Operator, ToneMapEncode::Srgb, true> : ToneMapRowT<Operator, ToneMapEncode::Srgb, false>;
+    default:
+        return bytes ? ToneMapRowT<Operator, ToneMapEncode::None, true> : ToneMapRowT<Operator, ToneMapEncode::None, false>;
+    }
+}
+
+inline ToneMapRowFunction ToneMapRow(ToneMapOperator op, ToneMapEncode encode, bool bytes)
+{
+    switch (op)
+    {
+    case ToneMapOperator::Linear:
+    case ToneMapOperator::AutoLinear:
+    case ToneMapOperator::MaxWhite:
+    case ToneMapOperator::PhotoLinear:
+        return ToneMapRowFor<LinearToneMap>(encode, bytes);
+    case ToneMapOperator::Exponential:
+        return ToneMapRowFor<ExponentialToneMap>(encode, bytes);
+    case ToneMapOperator::Drago:
+        return ToneMapRowFor<DragoToneMap>(encode, bytes);
+    case ToneMapOperator::Filmic:
+        return ToneMapRowFor<FilmicToneMap>(encode, bytes);
+    case ToneMapOperator::Aces:
+        return ToneMapRowFor<AcesToneMap>(encode, bytes);
+    case ToneMapOperator::Photo:
+        return ToneMapRowFor<PhotoToneMap>(encode, bytes);
+    case ToneMapOperator::FilmicUncharted:
+        return ToneMapRowFor<FilmicUnchartedToneMap>(encode, bytes);
+    default:
+        return ToneMapRowFor<Reinhard02ToneMap>(encode, bytes);
+    }
+}
+
+// Exp (0), Log (1) or Pow (2) of 'count' values (whole vectors), for accuracy checks of
+// the approximations the operators use
+inline void ToneMapMath(int function, const float* x, const float* y, size_t count, float* out)
+{
+    for (size_t i = 0; i < count; i += Float::Width)
+    {
+        const Float a = Float::Load(x + i);
+        const Float r = function == 0 ? Exp(a) : (function == 1 ? Log(a) : Pow(a, Float::Load(y + i)));
+        r.Store(out + i);
+    }
+}
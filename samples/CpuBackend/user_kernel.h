@@ -0,0 +1,1633 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+// RIF_IMAGE_FILTER_USER_DEFINED on the host: the OpenCL-flavoured "code" the device
+// backends compile is parsed into register code and interpreted over blocks of
+// UserKernelLanes pixels, one float per lane in every register.
+//
+// The dialect covers what the kernels of the samples use: int, float, intN, floatN
+// and vecN (N = 2..4) variables with swizzles, the C operators except the bitwise ones,
+// (vecN) casts and vector literals, if/else, for and while loops, return, and the
+// built-ins GET_BUFFER_SIZE, GET_COORD_OR_RETURN, ReadPixelTyped, WritePixelTyped,
+// convert_*, mix, clamp, min, max, step, smoothstep, dot, length, distance,
+// normalize, exp, log, pow, sqrt, sin, cos, floor, ceil, fract and abs. Vectors are
+// split into one register per component. Integers are floats holding whole numbers,
+// exact up to 2^24, with C division and remainder.
+//
+// Control flow is converted to lane masks: both sides of a branch run with the
+// assignments of the inactive lanes masked out, a branch or loop body no lane takes
+// is jumped over, and loops run until no lane is left in them. 'return' retires its
+// lanes for the rest of the kernel. Reads clamp to the image, writes outside it are
+// dropped. The images are converted to float RGBA for the run; the output keeps the
+// pixels the kernel does not write.
+//
+// Compiled kernels are shared by all filters in a cache keyed by the source hash.
+
+#include "filter.h"
+#include "float_image.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CpuBackend
+{
+    const size_t UserKernelLanes = 64;
+
+    enum class UserOp : uint8_t
+    {
+        Copy,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Mod,
+        Min,
+        Max,
+        Abs,
+        Floor,
+        Trunc,
+        Sqrt,
+        Exp,
+        Log,
+        Pow,
+        Sin,
+        Cos,
+        Less,
+        LessEqual,
+        Equal,
+        NotEqual,
+        And,
+        Or,
+        Not,
+        Select,         // a ? b : c
+        Read,           // out..out + 3 = image 'extra' at (a, b)
+        Write,          // image 'extra' at (a, b) = c..c + 3 where mask 'out'
+        Jump,           // to 'extra'
+        JumpIfNone,     // to 'extra' when no lane of a is set
+    };
+
+    struct UserInstruction
+    {
+        UserOp op;
+        uint16_t out;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+        int32_t extra;
+    };
+
+    // A constant register holds a literal or the width (axis 0) or height (axis 1) of an
+    // image: 0 the input, 1 the output.
+    struct UserConstant
+    {
+        float value;
+        int image;
+        int axis;
+    };
+
+    // Registers: 0 and 1 are the pixel x and y, 2 is 1 for lanes inside the row, then
+    // come the constants and the values of the kernel.
+    struct UserKernel
+    {
+        std::string source;
+        bool valid = false;
+        std::string error;              // first error with its line when not valid
+        std::vector<UserInstruction> code;
+        std::vector<UserConstant> constants;
+        size_t registers = 0;
+    };
+
+    struct UserKernelImage
+    {
+        float* data;
+        size_t pitch;
+        long width;
+        long height;
+    };
+
+    namespace UserKernelScalar
+    {
+        using simd::Scalar::Float;
+#include "user_kernel_kernels.inl"
+    }
+
+#if defined(CPU_BACKEND_X86)
+    namespace UserKernelSse
+    {
+        using simd::Sse::Float;
+#include "user_kernel_kernels.inl"
+    }
+
+    CPU_BACKEND_AVX2_BEGIN
+    namespace UserKernelAvx2
+    {
+        using simd::Avx2::Float;
+#include "user_kernel_kernels.inl"
+    }
+    CPU_BACKEND_AVX2_END
+
+    CPU_BACKEND_AVX512_BEGIN
+    namespace UserKernelAvx512
+    {
+        using simd::Avx512::Float;
+#include "user_kernel_kernels.inl"
+    }
+    CPU_BACKEND_AVX512_END
+#endif
+
+#if defined(CPU_BACKEND_NEON)
+    namespace UserKernelNeon
+    {
+        using simd::Neon::Float;
+#include "user_kernel_kernels.inl"
+    }
+#endif
+
+    namespace detail
+    {
+        typedef void (*UserKernelFunction)(const UserInstruction*, size_t, float* const*, const UserKernelImage*);
+
+        inline UserKernelFunction SelectUserKernelFunction(simd::Level level)
+        {
+            switch (level)
+            {
+#if defined(CPU_BACKEND_X86)
+            case simd::Level::Avx512:
+                return UserKernelAvx512::UserKernelRun;
+            case simd::Level::Avx2:
+                return UserKernelAvx2::UserKernelRun;
+            case simd::Level::Sse:
+                return UserKernelSse::UserKernelRun;
+#endif
+#if defined(CPU_BACKEND_NEON)
+            case simd::Level::Neon:
+                return UserKernelNeon::UserKernelRun;
+#endif
+            default:
+                return UserKernelScalar::UserKernelRun;
+            }
+        }
+
+        enum class UserType
+        {
+            Bool,
+            Int,
+            Float,
+        };
+
+        // a value of 'size' components; size 0 is no value
+        struct UserValue
+        {
+            UserType type = UserType::Float;
+            int size = 0;
+            int reg[4] = {};
+        };
+
+        // Single pass compiler from source to register code. Values are emitted as soon
+        // as they are parsed; the first error stops the parse.
+        class UserKernelCompiler
+        {
+        public:
+            explicit UserKernelCompiler(UserKernel& kernel)
+                : m_kernel(kernel)
+            {   }
+
+            void Compile()
+            {
+                m_kernel.code.clear();
+                m_kernel.constants.clear();
+                m_kernel.valid = false;
+                m_kernel.error.clear();
+                if (!Tokenize())
+                {
+                    return;
+                }
+
+                m_scopes.resize(1);
+                m_alive = Temporary();
+                m_mask = m_alive;
+                EmitTo(UserOp::Copy, m_alive, InRangeRegister);
+                while (!m_failed && Peek().kind != Token::End)
+                {
+                    Statement();
+                }
+                if (m_failed)
+                {
+                    return;
+                }
+                for (size_t jump : m_exits)
+                {
+                    m_kernel.code[jump].extra = static_cast<int32_t>(m_kernel.code.size());
+                }
+
+                // the temporaries go after the constants, whose count is only known now
+                const size_t base = FirstConstant + m_kernel.constants.size();
+                if (base + m_temporaries > 0xffff)
+                {
+                    m_kernel.error = "too many values";
+                    return;
+                }
+                auto place = [&](uint16_t& r) { r = uint16_t(r >= TemporaryBase ? base + (r - TemporaryBase) : r); };
+                for (UserInstruction& instruction : m_kernel.code)
+                {
+                    place(instruction.out);
+                    place(instruction.a);
+                    place(instruction.b);
+                    place(instruction.c);
+                }
+                m_kernel.registers = base + m_temporaries;
+                m_kernel.valid = true;
+            }
+
+        private:
+            static const int InRangeRegister = 2;
+            static const int FirstConstant = 3;
+            // temporaries are numbered from here while compiling
+            static const int TemporaryBase = 0x8000;
+
+            struct Token
+            {
+                enum Kind
+                {
+                    End,
+                    Identifier,
+                    Number,
+                    Symbol,
+                } kind;
+                std::string text;
+                size_t line;
+            };
+
+            //
+            // Tokens
+            //
+
+            bool Tokenize()
+            {
+                const std::string& s = m_kernel.source;
+                static const char* symbols[] = { "<=", ">=", "==", "!=", "&&", "||", "+=", "-=", "*=", "/=", "++", "--" };
+                size_t line = 1;
+                size_t i = 0;
+                while (i < s.size())
+                {
+                    const char ch = s[i];
+                    if (ch == '\n')
+                    {
+                        ++line;
+                        ++i;
+                    }
+                    else if (std::isspace(static_cast<unsigned char>(ch)))
+                    {
+                        ++i;
+                    }
+                    else if (s.compare(i, 2, "//") == 0)
+                    {
+                        i = std::min(s.find('\n', i), s.size());
+                    }
+                    else if (s.compare(i, 2, "/*") == 0)
+                    {
+                        const size_t end = s.find("*/", i + 2);
+                        line += std::count(s.begin() + i, end == std::string::npos ? s.end() : s.begin() + end, '\n');
+                        i = end == std::string::npos ? s.size() : end + 2;
+                    }
+                    else if (std::isalpha(static_cast<unsigned char>(ch)) || ch == '_')
+                    {
+                        size_t j = i;
+                        while (j < s.size() && (std::isalnum(static_cast<unsigned char>(s[j])) || s[j] == '_')) ++j;
+                        m_tokens.push_back({ Token::Identifier, s.substr(i, j - i), line });
+                        i = j;
+                    }
+                    else if (std::isdigit(static_cast<unsigned char>(ch)) || (ch == '.' && i + 1 < s.size() && std::isdigit(static_cast<unsigned char>(s[i + 1]))))
+                    {
+                        char* end = nullptr;
+                        std::strtod(s.c_str() + i, &end);
+                        size_t j = end - s.c_str();
+                        while (j < s.size() && (s[j] == 'f' || s[j] == 'F' || s[j] == 'u' || s[j] == 'U')) ++j;
+                        m_tokens.push_back({ Token::Number, s.substr(i, j - i), line });
+                        i = j;
+                    }
+                    else
+                    {
+                        std::string symbol(1, ch);
+                        for (const char* candidate : symbols)
+                        {
+                            if (s.compare(i, 2, candidate) == 0)
+                            {
+                                symbol = candidate;
+                            }
+                        }
+                        if (std::string("(){}[],;.+-*/%=<>!?:&|").find(ch) == std::string::npos)
+                        {
+                            m_kernel.error = "line " + std::to_string(line) + ": unexpected character '" + symbol + "'";
+                            return false;
+                        }
+                        m_tokens.push_back({ Token::Symbol, symbol, line });
+                        i += symbol.size();
+                    }
+                }
+                m_tokens.push_back({ Token::End, std::string(), line });
+                return true;
+            }
+
+            const Token& Peek(size_t ahead = 0) const
+            {
+                return m_tokens[std::min(m_next + ahead, m_tokens.size() - 1)];
+            }
+
+            bool IsSymbol(const char* symbol, size_t ahead = 0) const
+            {
+                return Peek(ahead).kind == Token::Symbol && Peek(ahead).text == symbol;
+            }
+
+            bool Accept(const char* symbol)
+            {
+                if (IsSymbol(symbol))
+                {
+                    ++m_next;
+                    return true;
+                }
+                return false;
+            }
+
+            void Expect(const char* symbol)
+            {
+                if (!Accept(symbol))
+                {
+                    Fail(std::string("expected '") + symbol + "'");
+                }
+            }
+
+            std::string Identifier()
+            {
+                if (Peek().kind != Token::Identifier)
+                {
+                    Fail("expected a name");
+                    return std::string();
+                }
+                return m_tokens[m_next++].text;
+            }
+
+            UserValue Fail(const std::string& message)
+            {
+                if (!m_failed)
+                {
+                    m_failed = true;
+                    m_kernel.error = "line " + std::to_string(Peek().line) + ": " + message +
+                        (Peek().kind == Token::End ? " at the end" : " near '" + Peek().text + "'");
+                }
+                return UserValue();
+            }
+
+            //
+            // Registers and code
+            //
+
+            int Temporary()
+            {
+                if (m_temporaries == 0x7000)
+                {
+                    Fail("too many values");
+                    return TemporaryBase;
+                }
+                return TemporaryBase + m_temporaries++;
+            }
+
+            int Constant(float value, int image = -1, int axis = 0)
+            {
+                for (size_t i = 0; i < m_kernel.constants.size(); ++i)
+                {
+                    const UserConstant& constant = m_kernel.constants[i];
+                    if (constant.image == image && (image >= 0 ? constant.axis == axis : constant.value == value))
+                    {
+                        return FirstConstant + int(i);
+                    }
+                }
+                m_kernel.constants.push_back({ value, image, axis });
+                return FirstConstant + int(m_kernel.constants.size() - 1);
+            }
+
+            void EmitTo(UserOp op, int out, int a, int b = 0, int c = 0, int extra = 0)
+            {
+                m_kernel.code.push_back({ op, uint16_t(out), uint16_t(a), uint16_t(b), uint16_t(c), extra });
+            }
+
+            int Emit(UserOp op, int a, int b = 0, int c = 0)
+            {
+                const int out = Temporary();
+                EmitTo(op, out, a, b, c);
+                return out;
+            }
+
+            size_t EmitJump(UserOp op, int mask)
+            {
+                EmitTo(op, 0, mask);
+                return m_kernel.code.size() - 1;
+            }
+
+            void PatchHere(size_t jump)
+            {
+                m_kernel.code[jump].extra = static_cast<int32_t>(m_kernel.code.size());
+            }
+
+            // assignment of one component, masked inside branches and loops
+            void Store(int target, int value)
+            {
+                if (m_depth == 0)
+                {
+                    EmitTo(UserOp::Copy, target, value);
+                }
+                else
+                {
+                    EmitTo(UserOp::Select, target, m_mask, value, target);
+                }
+            }
+
+            //
+            // Types
+            //
+
+            // 'int2' -> Int, 2; false when 'name' is not a type
+            static bool ParseType(const std::string& name, UserType* type, int* size)
+            {
+                static const struct
+                {
+                    const char* name;
+                    UserType type;
+                    bool scalar;
+                    bool vector;
+                } bases[] =
+                {
+                    { "bool", UserType::Int, true, false },
+                    { "uint", UserType::Int, true, true },
+                    { "int", UserType::Int, true, true },
+                    { "float", UserType::Float, true, true },
+                    { "vec", UserType::Float, false, true },
+                };
+                for (const auto& base : bases)
+                {
+                    const size_t length = std::strlen(base.name);
+                    if (name.compare(0, length, base.name) != 0)
+                    {
+                        continue;
+                    }
+                    const std::string rest = name.substr(length);
+                    if (rest.empty() && base.scalar)
+                    {
+                        *type = base.type;
+                        *size = 1;
+                        return true;
+                    }
+                    if (rest.size() == 1 && rest[0] >= '2' && rest[0] <= '4' && base.vector)
+                    {
+                        *type = base.type;
+                        *size = rest[0] - '0';
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            bool IsTypeName(size_t ahead = 0) const
+            {
+                UserType type;
+                int size;
+                return Peek(ahead).kind == Token::Identifier && ParseType(Peek(ahead).text, &type, &size);
+            }
+
+            static UserType Promote(UserType a, UserType b)
+            {
+                return a == UserType::Float || b == UserType::Float ? UserType::Float : UserType::Int;
+            }
+
+            UserValue Scalar(UserType type, int reg)
+            {
+                UserValue value;
+                value.type = type;
+                value.size = 1;
+                value.reg[0] = reg;
+                return value;
+            }
+
+            // a scalar repeated to 'size' components
+            UserValue Broadcast(const UserValue& value, int size)
+            {
+                if (value.size == size || value.size != 1)
+                {
+                    return value;
+                }
+                UserValue result = value;
+                result.size = size;
+                for (int i = 1; i < size; ++i)
+                {
+                    result.reg[i] = value.reg[0];
+                }
+                return result;
+            }
+
+            // C conversion: floats to integers truncate
+            UserValue Convert(const UserValue& value, UserType type)
+            {
+                if (type != UserType::Int || value.type != UserType::Float)
+                {
+                    UserValue result = value;
+                    result.type = type == UserType::Bool ? UserType::Int : type;
+                    return result;
+                }
+                UserValue result = value;
+                result.type = UserType::Int;
+                for (int i = 0; i < value.size; ++i)
+                {
+                    result.reg[i] = Emit(UserOp::Trunc, value.reg[i]);
+                }
+                return result;
+            }
+
+            // (type) value and vector literals: one scalar broadcasts, otherwise the
+            // components are concatenated
+            UserValue Construct(UserType type, int size, const std::vector<UserValue>& parts)
+            {
+                UserValue result;
+                result.type = type;
+                result.size = size;
+                if (parts.size() == 1 && parts[0].size == 1)
+                {
+                    return Convert(Broadcast(parts[0], size), type);
+                }
+                int count = 0;
+                for (const UserValue& part : parts)
+                {
+                    const UserValue converted = Convert(part, type);
+                    for (int i = 0; i < converted.size; ++i)
+                    {
+                        if (count == size)
+                        {
+                            return Fail("too many components for a " + std::to_string(size) + " component value");
+                        }
+                        result.reg[count++] = converted.reg[i];
+                    }
+                }
+                return count == size ? result : Fail("wrong number of components");
+            }
+
+            // one scalar 0 / 1 register
+            int Condition(const UserValue& value)
+            {
+                if (value.size != 1)
+                {
+                    Fail("conditions need a scalar");
+                    return 0;
+                }
+                return value.type == UserType::Bool ? value.reg[0] : Emit(UserOp::NotEqual, value.reg[0], Constant(0.0f));
+            }
+
+            // component-wise 'op' with scalars broadcast
+            UserValue Componentwise(UserOp op, UserValue a, UserValue b, UserType type)
+            {
+                if (a.size == 0 || b.size == 0)
+                {
+                    return Fail("missing operand");
+                }
+                const int size = std::max(a.size, b.size);
+                a = Broadcast(a, size);
+                b = Broadcast(b, size);
+                if (a.size != b.size)
+                {
+                    return Fail("operands of different sizes");
+                }
+                UserValue result;
+                result.type = type;
+                result.size = size;
+                for (int i = 0; i < size; ++i)
+                {
+                    result.reg[i] = Emit(op, a.reg[i], b.reg[i]);
+                }
+                return result;
+            }
+
+            UserValue Unary(UserOp op, const UserValue& a)
+            {
+                if (a.size == 0)
+                {
+                    return Fail("missing operand");
+                }
+                UserValue result = a;
+                for (int i = 0; i < a.size; ++i)
+                {
+                    result.reg[i] = Emit(op, a.reg[i]);
+                }
+                return result;
+            }
+
+            UserValue Arithmetic(char op, const UserValue& a, const UserValue& b)
+            {
+                const UserType type = Promote(a.type, b.type);
+                switch (op)
+                {
+                case '+': return Componentwise(UserOp::Add, a, b, type);
+                case '-': return Componentwise(UserOp::Sub, a, b, type);
+                case '*': return Componentwise(UserOp::Mul, a, b, type);
+                case '/':
+                {
+                    const UserValue quotient = Componentwise(UserOp::Div, a, b, type);
+                    return type == UserType::Int ? Unary(UserOp::Trunc, quotient) : quotient;
+                }
+                case '%':
+                    return type == UserType::Int ? Componentwise(UserOp::Mod, a, b, type) : Fail("'%' needs integers");
+                }
+                return Fail("unknown operator");
+            }
+
+            UserValue FloatValue(const UserValue& value)
+            {
+                return Convert(value, UserType::Float);
+            }
+
+            //
+            // Variables
+            //
+
+            struct Variable
+            {
+                UserType type;
+                int size;
+                int reg[4];
+            };
+
+            Variable* Lookup(const std::string& name)
+            {
+                for (size_t i = m_scopes.size(); i-- > 0;)
+                {
+                    auto it = m_scopes[i].find(name);
+                    if (it != m_scopes[i].end())
+                    {
+                        return &it->second;
+                    }
+                }
+                return nullptr;
+            }
+
+            // '.xy' and the like, as component indices
+            bool Swizzle(const std::string& text, int size, std::vector<int>* components)
+            {
+                components->clear();
+                for (char ch : text)
+                {
+                    const size_t index = std::string("xyzw").find(ch);
+                    if (index == std::string::npos || int(index) >= size || components->size() == 4)
+                    {
+                        Fail("bad swizzle '." + text + "'");
+                        return false;
+                    }
+                    components->push_back(int(index));
+                }
+                return true;
+            }
+
+            UserValue Pick(const UserValue& value, const std::vector<int>& components)
+            {
+                UserValue result;
+                result.type = value.type;
+                result.size = int(components.size());
+                for (size_t i = 0; i < components.size(); ++i)
+                {
+                    result.reg[i] = value.reg[components[i]];
+                }
+                return result;
+            }
+
+            UserValue Load(const Variable& variable)
+            {
+                UserValue value;
+                value.type = variable.type;
+                value.size = variable.size;
+                std::copy(variable.reg, variable.reg + 4, value.reg);
+                return value;
+            }
+
+            void Assign(Variable& variable, const std::vector<int>& components, UserValue value)
+            {
+                value = Convert(Broadcast(value, int(components.size())), variable.type);
+                if (value.size != int(components.size()))
+                {
+                    Fail("assignment of a value of the wrong size");
+                    return;
+                }
+                for (size_t i = 0; i < components.size(); ++i)
+                {
+                    Store(variable.reg[components[i]], value.reg[i]);
+                }
+            }
+
+            //
+            // Statements
+            //
+
+            void Statement()
+            {
+                if (Accept("{"))
+                {
+                    m_scopes.emplace_back();
+                    while (!m_failed && !IsSymbol("}") && Peek().kind != Token::End)
+                    {
+                        Statement();
+                    }
+                    Expect("}");
+                    m_scopes.pop_back();
+                    return;
+                }
+                if (Accept(";"))
+                {
+                    return;
+                }
+
+                const std::string word = Peek().kind == Token::Identifier ? Peek().text : std::string();
+                if (word == "if")
+                {
+                    ++m_next;
+                    If();
+                }
+                else if (word == "for" || word == "while")
+                {
+                    ++m_next;
+                    Loop(word == "for");
+                }
+                else if (word == "return")
+                {
+                    ++m_next;
+                    ReturnWhere(Constant(1.0f));
+                    Expect(";");
+                }
+                else if (word == "break" || word == "continue")
+                {
+                    Fail("'" + word + "' is not supported");
+                }
+                else if (word == "GET_COORD_OR_RETURN")
+                {
+                    ++m_next;
+                    CoordOrReturn();
+                    Expect(";");
+                }
+                else
+                {
+                    Simple();
+                    Expect(";");
+                }
+            }
+
+            // declarations, assignments, increments and calls
+            void Simple()
+            {
+                if (Peek().kind == Token::Identifier && Peek().text == "const")
+                {
+                    ++m_next;
+                }
+                if (IsTypeName() && Peek(1).kind == Token::Identifier)
+                {
+                    Declaration();
+                    return;
+                }
+
+                const bool prefix = IsSymbol("++") || IsSymbol("--");
+                const std::string prefixOp = prefix ? m_tokens[m_next++].text : std::string();
+                if (Peek().kind == Token::Identifier && Lookup(Peek().text) && !IsSymbol("(", 1))
+                {
+                    Variable& variable = *Lookup(Identifier());
+                    std::vector<int> components;
+                    for (int i = 0; i < variable.size; ++i)
+                    {
+                        components.push_back(i);
+                    }
+                    if (Accept("."))
+                    {
+                        Swizzle(Identifier(), variable.size, &components);
+                    }
+                    const UserValue current = Pick(Load(variable), components);
+
+                    std::string op = prefixOp;
+                    if (op.empty() && Peek().kind == Token::Symbol)
+                    {
+                        op = Peek().text;
+                        ++m_next;
+                    }
+                    if (op == "++" || op == "--")
+                    {
+                        Assign(variable, components, Arithmetic(op[0], current, Scalar(UserType::Int, Constant(1.0f))));
+                    }
+                    else if (op == "=")
+                    {
+                        Assign(variable, components, Expression());
+                    }
+                    else if (op == "+=" || op == "-=" || op == "*=" || op == "/=")
+                    {
+                        Assign(variable, components, Arithmetic(op[0], current, Expression()));
+                    }
+                    else
+                    {
+                        Fail("expected an assignment");
+                    }
+                    return;
+                }
+                if (prefix)
+                {
+                    Fail("expected a variable");
+                    return;
+                }
+                Expression();
+            }
+
+            void Declaration()
+            {
+                UserType type;
+                int size;
+                ParseType(Identifier(), &type, &size);
+                do
+                {
+                    const std::string name = Identifier();
+                    if (m_failed)
+                    {
+                        return;
+                    }
+                    if (m_scopes.back().count(name))
+                    {
+                        Fail("'" + name + "' is already declared");
+                        return;
+                    }
+                    Variable variable = { type, size, {} };
+                    for (int i = 0; i < size; ++i)
+                    {
+                        variable.reg[i] = Temporary();
+                    }
+                    const UserValue value = Accept("=") ? Expression() : Scalar(type, Constant(0.0f));
+                    std::vector<int> components;
+                    for (int i = 0; i < size; ++i)
+                    {
+                        components.push_back(i);
+                    }
+                    // the name is only visible after its initializer
+                    Assign(variable, components, value);
+                    m_scopes.back()[name] = variable;
+                } while (!m_failed && Accept(","));
+            }
+
+            // lanes of the current mask where 'condition' is set leave the kernel
+            void ReturnWhere(int condition)
+            {
+                const int leaving = Emit(UserOp::And, m_mask, condition);
+                const int staying = Emit(UserOp::Not, leaving);
+                EmitTo(UserOp::And, m_alive, m_alive, staying);
+                if (m_mask != m_alive)
+                {
+                    m_mask = Emit(UserOp::And, m_mask, staying);
+                }
+                m_returned = true;
+                if (m_depth == 0)
+                {
+                    m_exits.push_back(EmitJump(UserOp::JumpIfNone, m_alive));
+                }
+            }
+
+            // GET_COORD_OR_RETURN(coord, size): coord is the pixel, lanes outside size leave
+            void CoordOrReturn()
+            {
+                Expect("(");
+                Variable* coord = Lookup(Identifier());
+                Expect(",");
+                const UserValue size = Expression();
+                Expect(")");
+                if (m_failed)
+                {
+                    return;
+                }
+                if (!coord || coord->size != 2 || size.size != 2)
+                {
+                    Fail("GET_COORD_OR_RETURN needs two int2");
+                    return;
+                }
+                Assign(*coord, { 0, 1 }, Construct(UserType::Int, 2, { Scalar(UserType::Int, 0), Scalar(UserType::Int, 1) }));
+                const int outsideX = Emit(UserOp::LessEqual, size.reg[0], coord->reg[0]);
+                const int outsideY = Emit(UserOp::LessEqual, size.reg[1], coord->reg[1]);
+                ReturnWhere(Emit(UserOp::Or, outsideX, outsideY));
+            }
+
+            void If()
+            {
+                Expect("(");
+                const int condition = Condition(Expression());
+                Expect(")");
+                if (m_failed)
+                {
+                    return;
+                }
+
+                const int outer = m_mask;
+                const bool returned = m_returned;
+                m_returned = false;
+                const int thenMask = Emit(UserOp::And, outer, condition);
+                const int elseMask = Emit(UserOp::And, outer, Emit(UserOp::Not, condition));
+
+                const size_t skipThen = EmitJump(UserOp::JumpIfNone, thenMask);
+                ++m_depth;
+                m_mask = thenMask;
+                Statement();
+                if (Peek().kind == Token::Identifier && Peek().text == "else")
+                {
+                    ++m_next;
+                    // both sides run when the lanes disagree
+                    PatchHere(skipThen);
+                    const size_t skipElse = EmitJump(UserOp::JumpIfNone, elseMask);
+                    m_mask = elseMask;
+                    Statement();
+                    PatchHere(skipElse);
+                }
+                else
+                {
+                    PatchHere(skipThen);
+                }
+                --m_depth;
+
+                // lanes that returned inside stay out of what follows
+                m_mask = m_returned && outer != m_alive ? Emit(UserOp::And, outer, m_alive) : outer;
+                m_returned = m_returned || returned;
+            }
+
+            void Loop(bool isFor)
+            {
+                m_scopes.emplace_back();
+                Expect("(");
+                size_t stepBegin = 0;
+                size_t stepEnd = 0;
+                if (isFor && !Accept(";"))
+                {
+                    Simple();
+                    Expect(";");
+                }
+
+                const int outer = m_mask;
+                const bool returned = m_returned;
+                m_returned = false;
+                const int loopMask = Temporary();
+                EmitTo(UserOp::Copy, loopMask, outer);
+                const size_t top = m_kernel.code.size();
+                if (!isFor || !IsSymbol(";"))
+                {
+                    EmitTo(UserOp::And, loopMask, loopMask, Condition(Expression()));
+                }
+                const size_t exit = EmitJump(UserOp::JumpIfNone, loopMask);
+
+                // the step is compiled here but belongs after the body
+                ++m_depth;
+                m_mask = loopMask;
+                if (isFor)
+                {
+                    Expect(";");
+                    stepBegin = m_kernel.code.size();
+                    if (!IsSymbol(")"))
+                    {
+                        Simple();
+                    }
+                    stepEnd = m_kernel.code.size();
+                }
+                Expect(")");
+                std::vector<UserInstruction> step(m_kernel.code.begin() + stepBegin, m_kernel.code.begin() + stepEnd);
+                m_kernel.code.resize(isFor ? stepBegin : m_kernel.code.size());
+
+                Statement();
+                if (m_mask != loopMask)
+                {
+                    EmitTo(UserOp::Copy, loopMask, m_mask);
+                }
+                m_mask = loopMask;
+                // the step has no jumps, so it moves as it is
+                m_kernel.code.insert(m_kernel.code.end(), step.begin(), step.end());
+                EmitTo(UserOp::Jump, 0, 0, 0, 0, static_cast<int32_t>(top));
+                PatchHere(exit);
+                --m_depth;
+
+                m_mask = m_returned && outer != m_alive ? Emit(UserOp::And, outer, m_alive) : outer;
+                m_returned = m_returned || returned;
+                m_scopes.pop_back();
+            }
+
+            //
+            // Expressions
+            //
+
+            UserValue Expression()
+            {
+                return m_failed ? UserValue() : Ternary();
+            }
+
+            UserValue Ternary()
+            {
+                const UserValue condition = LogicalOr();
+                if (!Accept("?"))
+                {
+                    return condition;
+                }
+                const int mask = Condition(condition);
+                UserValue a = Expression();
+                Expect(":");
+                UserValue b = Ternary();
+                if (m_failed)
+                {
+                    return UserValue();
+                }
+                const int size = std::max(a.size, b.size);
+                const UserType type = Promote(a.type, b.type);
+                a = Broadcast(a, size);
+                b = Broadcast(b, size);
+                if (a.size != b.size)
+                {
+                    return Fail("'?:' on values of different sizes");
+                }
+                UserValue result;
+                result.type = type;
+                result.size = size;
+                for (int i = 0; i < size; ++i)
+                {
+                    result.reg[i] = Emit(UserOp::Select, mask, a.reg[i], b.reg[i]);
+                }
+                return result;
+            }
+
+            UserValue LogicalOr()
+            {
+                UserValue left = LogicalAnd();
+                while (!m_failed && Accept("||"))
+                {
+                    const int a = Condition(left);
+                    left = Scalar(UserType::Bool, Emit(UserOp::Or, a, Condition(LogicalAnd())));
+                }
+                return left;
+            }
+
+            UserValue LogicalAnd()
+            {
+                UserValue left = Equality();
+                while (!m_failed && Accept("&&"))
+                {
+                    const int a = Condition(left);
+                    left = Scalar(UserType::Bool, Emit(UserOp::And, a, Condition(Equality())));
+                }
+                return left;
+            }
+
+            UserValue Compare(UserOp op, const UserValue& a, const UserValue& b, bool swap)
+            {
+                if (a.size != 1 || b.size != 1)
+                {
+                    return Fail("comparisons need scalars");
+                }
+                return Scalar(UserType::Bool, swap ? Emit(op, b.reg[0], a.reg[0]) : Emit(op, a.reg[0], b.reg[0]));
+            }
+
+            UserValue Equality()
+            {
+                UserValue left = Relational();
+                for (;;)
+                {
+                    if (Accept("=="))
+                    {
+                        left = Compare(UserOp::Equal, left, Relational(), false);
+                    }
+                    else if (Accept("!="))
+                    {
+                        left = Compare(UserOp::NotEqual, left, Relational(), false);
+                    }
+                    else
+                    {
+                        return left;
+                    }
+                }
+            }
+
+            UserValue Relational()
+            {
+                UserValue left = Additive();
+                for (;;)
+                {
+                    if (Accept("<"))
+                    {
+                        left = Compare(UserOp::Less, left, Additive(), false);
+                    }
+                    else if (Accept("<="))
+                    {
+                        left = Compare(UserOp::LessEqual, left, Additive(), false);
+                    }
+                    else if (Accept(">"))
+                    {
+                        left = Compare(UserOp::Less, left, Additive(), true);
+                    }
+                    else if (Accept(">="))
+                    {
+                        left = Compare(UserOp::LessEqual, left, Additive(), true);
+                    }
+                    else
+                    {
+                        return left;
+                    }
+                }
+            }
+
+            UserValue Additive()
+            {
+                UserValue left = Multiplicative();
+                while (!m_failed && (IsSymbol("+") || IsSymbol("-")))
+                {
+                    const char op = m_tokens[m_next++].text[0];
+                    left = Arithmetic(op, left, Multiplicative());
+                }
+                return left;
+            }
+
+            UserValue Multiplicative()
+            {
+                UserValue left = Prefix();
+                while (!m_failed && (IsSymbol("*") || IsSymbol("/") || IsSymbol("%")))
+                {
+                    const char op = m_tokens[m_next++].text[0];
+                    left = Arithmetic(op, left, Prefix());
+                }
+                return left;
+            }
+
+            UserValue Prefix()
+            {
+                if (Accept("-"))
+                {
+                    const UserValue value = Prefix();
+                    return Arithmetic('-', Scalar(value.type, Constant(0.0f)), value);
+                }
+                if (Accept("+"))
+                {
+                    return Prefix();
+                }
+                if (Accept("!"))
+                {
+                    return Scalar(UserType::Bool, Emit(UserOp::Not, Condition(Prefix())));
+                }
+                // (type) casts and (vecN)(x, y, ...) literals
+                if (IsSymbol("(") && IsTypeName(1) && IsSymbol(")", 2))
+                {
+                    UserType type;
+                    int size;
+                    ParseType(Peek(1).text, &type, &size);
+                    m_next += 3;
+                    if (size > 1 && Accept("("))
+                    {
+                        return Construct(type, size, Arguments());
+                    }
+                    return Construct(type, size, { Prefix() });
+                }
+                return Postfix(Primary());
+            }
+
+            UserValue Postfix(UserValue value)
+            {
+                while (!m_failed && Accept("."))
+                {
+                    std::vector<int> components;
+                    if (Swizzle(Identifier(), value.size, &components))
+                    {
+                        value = Pick(value, components);
+                    }
+                }
+                return value;
+            }
+
+            // a parenthesized argument list after its '('
+            std::vector<UserValue> Arguments()
+            {
+                std::vector<UserValue> arguments;
+                if (Accept(")"))
+                {
+                    return arguments;
+                }
+                do
+                {
+                    arguments.push_back(Expression());
+                } while (!m_failed && Accept(","));
+                Expect(")");
+                return arguments;
+            }
+
+            UserValue Primary()
+            {
+                const Token token = Peek();
+                if (token.kind == Token::Number)
+                {
+                    ++m_next;
+                    const bool isFloat = token.text.find_first_of(".eEfF") != std::string::npos;
+                    return Scalar(isFloat ? UserType::Float : UserType::Int, Constant(std::strtof(token.text.c_str(), nullptr)));
+                }
+                if (Accept("("))
+                {
+                    const UserValue value = Expression();
+                    Expect(")");
+                    return value;
+                }
+                if (token.kind != Token::Identifier)
+                {
+                    return Fail("expected a value");
+                }
+                ++m_next;
+                if (Accept("("))
+                {
+                    return Call(token.text);
+                }
+                if (token.text == "true" || token.text == "false")
+                {
+                    return Scalar(UserType::Bool, Constant(token.text == "true" ? 1.0f : 0.0f));
+                }
+                const Variable* variable = Lookup(token.text);
+                return variable ? Load(*variable) : Fail("unknown name '" + token.text + "'");
+            }
+
+            // inputImage or outputImage as an argument, then the ',' or ')' after it
+            int ImageArgument()
+            {
+                const std::string name = Identifier();
+                if (name != "inputImage" && name != "outputImage")
+                {
+                    Fail("expected inputImage or outputImage");
+                }
+                return name == "outputImage" ? 1 : 0;
+            }
+
+            // a value of 'size' components in consecutive registers
+            int Consecutive(const UserValue& value)
+            {
+                bool consecutive = true;
+                for (int i = 1; i < value.size; ++i)
+                {
+                    consecutive &= value.reg[i] == value.reg[0] + i && value.reg[0] >= TemporaryBase;
+                }
+                if (consecutive)
+                {
+                    return value.reg[0];
+                }
+                const int first = Temporary();
+                for (int i = 1; i < value.size; ++i)
+                {
+                    Temporary();
+                }
+                for (int i = 0; i < value.size; ++i)
+                {
+                    EmitTo(UserOp::Copy, first + i, value.reg[i]);
+                }
+                return first;
+            }
+
+            UserValue Call(std::string name)
+            {
+                // the image access built-ins take an image first
+                if (name == "GET_BUFFER_SIZE")
+                {
+                    const int image = ImageArgument();
+                    Expect(")");
+                    return Construct(UserType::Int, 2, { Scalar(UserType::Int, Constant(0.0f, image, 0)),
+                        Scalar(UserType::Int, Constant(0.0f, image, 1)) });
+                }
+                if (name == "ReadPixelTyped")
+                {
+                    const int image = ImageArgument();
+                    Expect(",");
+                    const std::vector<UserValue> coordinates = Arguments();
+                    if (m_failed || coordinates.size() != 2 || coordinates[0].size != 1 || coordinates[1].size != 1)
+                    {
+                        return Fail("ReadPixelTyped needs an image, x and y");
+                    }
+                    UserValue value;
+                    value.type = UserType::Float;
+                    value.size = 4;
+                    value.reg[0] = Temporary();
+                    for (int i = 1; i < 4; ++i)
+                    {
+                        value.reg[i] = Temporary();
+                    }
+                    EmitTo(UserOp::Read, value.reg[0], coordinates[0].reg[0], coordinates[1].reg[0], 0, image);
+                    return value;
+                }
+                if (name == "WritePixelTyped")
+                {
+                    const int image = ImageArgument();
+                    Expect(",");
+                    const std::vector<UserValue> arguments = Arguments();
+                    if (m_failed || arguments.size() != 3 || arguments[0].size != 1 || arguments[1].size != 1)
+                    {
+                        return Fail("WritePixelTyped needs an image, x, y and a value");
+                    }
+                    const UserValue pixel = Construct(UserType::Float, 4, { FloatValue(arguments[2]) });
+                    if (m_failed)
+                    {
+                        return UserValue();
+                    }
+                    const int channels = Consecutive(pixel);
+                    EmitTo(UserOp::Write, m_mask, arguments[0].reg[0], arguments[1].reg[0], channels, image);
+                    return UserValue();
+                }
+
+                std::vector<UserValue> args = Arguments();
+                if (m_failed)
+                {
+                    return UserValue();
+                }
+                for (const UserValue& arg : args)
+                {
+                    if (arg.size == 0)
+                    {
+                        return Fail("'" + name + "' takes values");
+                    }
+                }
+                auto arity = [&](size_t count)
+                {
+                    if (args.size() != count)
+                    {
+                        Fail("'" + name + "' takes " + std::to_string(count) + " arguments");
+                        return false;
+                    }
+                    return true;
+                };
+
+                UserType type;
+                int size;
+                if (name.compare(0, 8, "convert_") == 0 && ParseType(name.substr(8), &type, &size))
+                {
+                    return arity(1) ? Construct(type, size, args) : UserValue();
+                }
+                if (ParseType(name, &type, &size))
+                {
+                    return Construct(type, size, args);
+                }
+
+                // the precision variants share the plain implementations
+                for (const char* prefix : { "native_", "half_" })
+                {
+                    if (name.compare(0, std::strlen(prefix), prefix) == 0)
+                    {
+                        name = name.substr(std::strlen(prefix));
+                    }
+                }
+
+                static const struct
+                {
+                    const char* name;
+                    UserOp op;
+                } unary[] =
+                {
+                    { "exp", UserOp::Exp },
+                    { "log", UserOp::Log },
+                    { "sqrt", UserOp::Sqrt },
+                    { "sin", UserOp::Sin },
+                    { "cos", UserOp::Cos },
+                    { "fabs", UserOp::Abs },
+                    { "abs", UserOp::Abs },
+                    { "floor", UserOp::Floor },
+                    { "trunc", UserOp::Trunc },
+                };
+                for (const auto& entry : unary)
+                {
+                    if (name == entry.name)
+                    {
+                        return arity(1) ? Unary(entry.op, entry.op == UserOp::Abs ? args[0] : FloatValue(args[0])) : UserValue();
+                    }
+                }
+
+                if (name == "ceil" && arity(1))
+                {
+                    const UserValue negative = Arithmetic('-', Scalar(UserType::Float, Constant(0.0f)), FloatValue(args[0]));
+                    return Arithmetic('-', Scalar(UserType::Float, Constant(0.0f)), Unary(UserOp::Floor, negative));
+                }
+                if (name == "fract" && arity(1))
+                {
+                    return Arithmetic('-', FloatValue(args[0]), Unary(UserOp::Floor, FloatValue(args[0])));
+                }
+                if ((name == "min" || name == "fmin" || name == "max" || name == "fmax") && arity(2))
+                {
+                    const UserOp op = name.find("min") != std::string::npos ? UserOp::Min : UserOp::Max;
+                    return Componentwise(op, args[0], args[1], Promote(args[0].type, args[1].type));
+                }
+                if (name == "pow" && arity(2))
+                {
+                    return Componentwise(UserOp::Pow, FloatValue(args[0]), FloatValue(args[1]), UserType::Float);
+                }
+                if (name == "clamp" && arity(3))
+                {
+                    const UserType t = Promote(args[0].type, Promote(args[1].type, args[2].type));
+                    return Componentwise(UserOp::Min, Componentwise(UserOp::Max, args[0], args[1], t), args[2], t);
+                }
+                if (name == "mix" && arity(3))
+                {
+                    // a + (b - a) * t
+                    const UserValue a = FloatValue(args[0]);
+                    return Arithmetic('+', a, Arithmetic('*', Arithmetic('-', FloatValue(args[1]), a), FloatValue(args[2])));
+                }
+                if (name == "step" && arity(2))
+                {
+                    // 0 where x < edge
+                    return Unary(UserOp::Not, Componentwise(UserOp::Less, args[1], args[0], UserType::Float));
+                }
+                if (name == "smoothstep" && arity(3))
+                {
+                    const UserValue e0 = FloatValue(args[0]);
+                    const UserValue ramp = Arithmetic('/', Arithmetic('-', FloatValue(args[2]), e0), Arithmetic('-', FloatValue(args[1]), e0));
+                    const UserValue t = Componentwise(UserOp::Min, Componentwise(UserOp::Max, ramp, Scalar(UserType::Float, Constant(0.0f)),
+                        UserType::Float), Scalar(UserType::Float, Constant(1.0f)), UserType::Float);
+                    const UserValue shape = Arithmetic('-', Scalar(UserType::Float, Constant(3.0f)), Arithmetic('*', Scalar(UserType::Float, Constant(2.0f)), t));
+                    return Arithmetic('*', Arithmetic('*', t, t), shape);
+                }
+                if ((name == "dot" || name == "distance") && arity(2))
+                {
+                    const UserValue v = name == "dot" ? FloatValue(args[0]) : Arithmetic('-', FloatValue(args[0]), FloatValue(args[1]));
+                    const UserValue w = name == "dot" ? FloatValue(args[1]) : v;
+                    const UserValue products = Arithmetic('*', v, w);
+                    UserValue sum = Pick(products, { 0 });
+                    for (int i = 1; i < products.size; ++i)
+                    {
+                        sum = Arithmetic('+', sum, Pick(products, { i }));
+                    }
+                    return name == "dot" ? sum : Unary(UserOp::Sqrt, sum);
+                }
+                if ((name == "length" || name == "normalize") && arity(1))
+                {
+                    const UserValue v = FloatValue(args[0]);
+                    const UserValue squares = Arithmetic('*', v, v);
+                    UserValue sum = Pick(squares, { 0 });
+                    for (int i = 1; i < squares.size; ++i)
+                    {
+                        sum = Arithmetic('+', sum, Pick(squares, { i }));
+                    }
+                    const UserValue length = Unary(UserOp::Sqrt, sum);
+                    return name == "length" ? length : Arithmetic('/', v, length);
+                }
+                return m_failed ? UserValue() : Fail("unknown function '" + name + "'");
+            }
+
+            UserKernel& m_kernel;
+            std::vector<Token> m_tokens;
+            size_t m_next = 0;
+            bool m_failed = false;
+            int m_temporaries = 0;
+            std::vector<std::map<std::string, Variable>> m_scopes;
+            int m_alive = 0;                // lanes that did not return
+            int m_mask = 0;                 // lanes running the current statement
+            int m_depth = 0;                // branches and loops around it
+            bool m_returned = false;        // a return since the enclosing branch began
+            std::vector<size_t> m_exits;    // jumps to the end of the kernel
+        };
+    }
+
+    // the compiled form of 'source', shared by the filters holding it; check 'valid'
+    // before use. The cache only holds weak references, so a kernel, valid or not, is
+    // dropped once no filter holds it and compiled again when asked for later.
+    inline std::shared_ptr<const UserKernel> CompileUserKernel(const std::string& source)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<std::string, std::weak_ptr<const UserKernel>> cache;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = cache.find(source);
+            if (found != cache.end())
+            {
+                if (std::shared_ptr<const UserKernel> kernel = found->second.lock())
+                {
+                    return kernel;
+                }
+            }
+        }
+
+        // compiled outside the lock, so filters with other kernels do not wait; when two
+        // threads race for one source the first insert wins
+        std::shared_ptr<UserKernel> compiled = std::make_shared<UserKernel>();
+        compiled->source = source;
+        detail::UserKernelCompiler compiler(*compiled);
+        compiler.Compile();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto i = cache.begin(); i != cache.end();)
+        {
+            i = i->second.expired() ? cache.erase(i) : std::next(i);
+        }
+        std::weak_ptr<const UserKernel>& entry = cache[source];
+        if (std::shared_ptr<const UserKernel> kernel = entry.lock())
+        {
+            return kernel;
+        }
+        entry = compiled;
+        return compiled;
+    }
+
+    // runs 'kernel' over every pixel of 'output'
+    inline rif_int RunUserKernel(ThreadPool& pool, const UserKernel& kernel, const Image& input, Image& output,
+        simd::Level level = simd::CurrentLevel())
+    {
+        if (!kernel.valid)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        FloatImage source;
+        FloatImage target;
+        source.Load(pool, input);
+        target.Load(pool, output);
+        const UserKernelImage images[2] =
+        {
+            { source.Row(0), source.Pitch(), long(source.Width()), long(source.Height()) },
+            { target.Row(0), target.Pitch(), long(target.Width()), long(target.Height()) },
+        };
+
+        const detail::UserKernelFunction run = detail::SelectUserKernelFunction(level);
+        const size_t width = output.Width();
+        pool.ParallelForRows(output.Height(), [&](size_t begin, size_t end)
+        {
+            std::vector<float> storage(kernel.registers * UserKernelLanes);
+            std::vector<float*> registers(kernel.registers);
+            for (size_t r = 0; r < kernel.registers; ++r)
+            {
+                registers[r] = &storage[r * UserKernelLanes];
+            }
+            for (size_t i = 0; i < kernel.constants.size(); ++i)
+            {
+                const UserConstant& constant = kernel.constants[i];
+                const float value = constant.image < 0 ? constant.value :
+                    float(constant.axis == 0 ? images[constant.image].width : images[constant.image].height);
+                std::fill(registers[3 + i], registers[3 + i] + UserKernelLanes, value);
+            }
+
+            for (size_t y = begin; y < end; ++y)
+            {
+                for (size_t x0 = 0; x0 < width; x0 += UserKernelLanes)
+                {
+                    for (size_t i = 0; i < UserKernelLanes; ++i)
+                    {
+                        registers[0][i] = float(x0 + i);
+                        registers[1][i] = float(y);
+                        registers[2][i] = x0 + i < width ? 1.0f : 0.0f;
+                    }
+                    run(kernel.code.data(), kernel.code.size(), registers.data(), images);
+                }
+            }
+        });
+
+        target.Store(pool, output);
+        return RIF_SUCCESS;
+    }
+
+    // RIF_IMAGE_FILTER_USER_DEFINED
+    // "code" - the kernel body, see the top of this file for the dialect; code that does
+    // not compile fails Execute with RIF_ERROR_INVALID_PARAMETER
+    class UserDefinedFilter : public Filter
+    {
+    public:
+        UserDefinedFilter()
+            : Filter(RIF_IMAGE_FILTER_USER_DEFINED)
+        {
+            DeclareString("code", "");
+        }
+
+        rif_int Execute(ThreadPool& pool, const Image& input, Image& output) override
+        {
+            if (!m_kernel || m_kernel->source != GetString("code"))
+            {
+                m_kernel = CompileUserKernel(GetString("code"));
+            }
+            return RunUserKernel(pool, *m_kernel, input, output);
+        }
+
+    private:
+        std::shared_ptr<const UserKernel> m_kernel;
+    };
+}
@@ -0,0 +1,185 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// User kernel interpreter loop, included by user_kernel.h once per instruction set
+// with 'Float' naming that set's vector type. No includes here on purpose.
+
+// Runs 'program' over one block of UserKernelLanes pixels. Every register holds one
+// float per lane; masks are 0 or 1.
+inline void UserKernelRun(const UserInstruction* program, size_t instructions, float* const* registers,
+    const UserKernelImage* images)
+{
+    const size_t lanes = UserKernelLanes;
+    const Float zero = Float::Zero();
+    const Float half = Float::Set1(0.5f);
+    const Float one = Float::Set1(1.0f);
+    size_t pc = 0;
+    while (pc < instructions)
+    {
+        const UserInstruction& instruction = program[pc++];
+        const float* a = registers[instruction.a];
+        const float* b = registers[instruction.b];
+        const float* c = registers[instruction.c];
+        float* out = registers[instruction.out];
+        switch (instruction.op)
+        {
+        case UserOp::Copy:
+            for (size_t i = 0; i < lanes; i += Float::Width) Float::Load(a + i).Store(out + i);
+            break;
+        case UserOp::Add:
+            for (size_t i = 0; i < lanes; i += Float::Width) (Float::Load(a + i) + Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Sub:
+            for (size_t i = 0; i < lanes; i += Float::Width) (Float::Load(a + i) - Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Mul:
+            for (size_t i = 0; i < lanes; i += Float::Width) (Float::Load(a + i) * Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Div:
+            for (size_t i = 0; i < lanes; i += Float::Width) (Float::Load(a + i) / Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Mod:
+            for (size_t i = 0; i < lanes; ++i) out[i] = b[i] != 0.0f ? a[i] - b[i] * std::trunc(a[i] / b[i]) : 0.0f;
+            break;
+        case UserOp::Min:
+            for (size_t i = 0; i < lanes; i += Float::Width) Min(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Max:
+            for (size_t i = 0; i < lanes; i += Float::Width) Max(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Abs:
+            for (size_t i = 0; i < lanes; i += Float::Width) Abs(Float::Load(a + i)).Store(out + i);
+            break;
+        case UserOp::Floor:
+            for (size_t i = 0; i < lanes; ++i) out[i] = std::floor(a[i]);
+            break;
+        case UserOp::Trunc:
+            for (size_t i = 0; i < lanes; ++i) out[i] = std::trunc(a[i]);
+            break;
+        case UserOp::Sqrt:
+            for (size_t i = 0; i < lanes; i += Float::Width) Sqrt(Float::Load(a + i)).Store(out + i);
+            break;
+        case UserOp::Exp:
+            for (size_t i = 0; i < lanes; i += Float::Width) Exp(Float::Load(a + i)).Store(out + i);
+            break;
+        case UserOp::Log:
+            for (size_t i = 0; i < lanes; i += Float::Width) Log(Float::Load(a + i)).Store(out + i);
+            break;
+        case UserOp::Pow:
+            for (size_t i = 0; i < lanes; i += Float::Width) Pow(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Sin:
+            for (size_t i = 0; i < lanes; ++i) out[i] = std::sin(a[i]);
+            break;
+        case UserOp::Cos:
+            for (size_t i = 0; i < lanes; ++i) out[i] = std::cos(a[i]);
+            break;
+        case UserOp::Less:
+            for (size_t i = 0; i < lanes; i += Float::Width) IfGreater(Float::Load(b + i), Float::Load(a + i), one, zero).Store(out + i);
+            break;
+        case UserOp::LessEqual:
+            for (size_t i = 0; i < lanes; i += Float::Width) IfGreater(Float::Load(a + i), Float::Load(b + i), zero, one).Store(out + i);
+            break;
+        case UserOp::Equal:
+            for (size_t i = 0; i < lanes; i += Float::Width)
+            {
+                const Float x = Float::Load(a + i);
+                const Float y = Float::Load(b + i);
+                IfGreater(x, y, zero, IfGreater(y, x, zero, one)).Store(out + i);
+            }
+            break;
+        case UserOp::NotEqual:
+            for (size_t i = 0; i < lanes; i += Float::Width)
+            {
+                const Float x = Float::Load(a + i);
+                const Float y = Float::Load(b + i);
+                IfGreater(x, y, one, IfGreater(y, x, one, zero)).Store(out + i);
+            }
+            break;
+        case UserOp::And:
+            for (size_t i = 0; i < lanes; i += Float::Width) Min(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Or:
+            for (size_t i = 0; i < lanes; i += Float::Width) Max(Float::Load(a + i), Float::Load(b + i)).Store(out + i);
+            break;
+        case UserOp::Not:
+            for (size_t i = 0; i < lanes; i += Float::Width) (one - Float::Load(a + i)).Store(out + i);
+            break;
+        case UserOp::Select:
+            for (size_t i = 0; i < lanes; i += Float::Width)
+            {
+                IfGreater(Float::Load(a + i), half, Float::Load(b + i), Float::Load(c + i)).Store(out + i);
+            }
+            break;
+        case UserOp::Read:
+        {
+            // coordinates clamp to the image; out..out + 3 take the channels
+            const UserKernelImage& image = images[instruction.extra];
+            float* channels[4] = { out, registers[instruction.out + 1], registers[instruction.out + 2], registers[instruction.out + 3] };
+            for (size_t i = 0; i < lanes; ++i)
+            {
+                const long x = std::min(std::max(static_cast<long>(a[i]), 0L), image.width - 1);
+                const long y = std::min(std::max(static_cast<long>(b[i]), 0L), image.height - 1);
+                const float* pixel = image.data + y * image.pitch + 4 * x;
+                channels[0][i] = pixel[0];
+                channels[1][i] = pixel[1];
+                channels[2][i] = pixel[2];
+                channels[3][i] = pixel[3];
+            }
+            break;
+        }
+        case UserOp::Write:
+        {
+            // 'out' is the mask, c..c + 3 the channels; writes outside the image are dropped
+            const UserKernelImage& image = images[instruction.extra];
+            const float* channels[4] = { c, registers[instruction.c + 1], registers[instruction.c + 2], registers[instruction.c + 3] };
+            for (size_t i = 0; i < lanes; ++i)
+            {
+                const long x = static_cast<long>(a[i]);
+                const long y = static_cast<long>(b[i]);
+                if (out[i] > 0.5f && x >= 0 && x < image.width && y >= 0 && y < image.height)
+                {
+                    float* pixel = image.data + y * image.pitch + 4 * x;
+                    pixel[0] = channels[0][i];
+                    pixel[1] = channels[1][i];
+                    pixel[2] = channels[2][i];
+                    pixel[3] = channels[3][i];
+                }
+            }
+            break;
+        }
+        case UserOp::Jump:
+            pc = static_cast<size_t>(instruction.extra);
+            break;
+        case UserOp::JumpIfNone:
+        {
+            unsigned any = 0;
+            for (size_t i = 0; i < lanes; i += Float::Width) any |= GreaterMask(Float::Load(a + i), half);
+            if (!any)
+            {
+                pc = static_cast<size_t>(instruction.extra);
+            }
+            break;
+        }
+        }
+    }
+}
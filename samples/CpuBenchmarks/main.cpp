@@ -0,0 +1,3616 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../CpuBackend/image_io.h"
+#include "../Utils/cmd_parser.h"
+
+// Accuracy checks and timings of the host kernels. Every section has a check that
+// compares a kernel against a straightforward reference implementation and a
+// benchmark; "-test" runs the checks only and fails the process on a mismatch.
+
+struct Options
+{
+    size_t width = 1920;
+    size_t height = 1080;
+    int repeat = 3;
+    std::string images = "images";
+    std::string models = "models";
+    std::string cache = ".";            // packed model files are written here and removed
+};
+
+// best of 'repeat' runs, in milliseconds
+template <typename Function>
+double TimeMs(int repeat, Function function)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeat; ++i)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        function();
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    return best;
+}
+
+// noise over smooth gradients and hard edges, values in [0, 1]
+CpuBackend::FloatImage MakeTestImage(size_t width, size_t height, unsigned seed = 1)
+{
+    CpuBackend::FloatImage image(width, height);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> noise(0.0f, 0.25f);
+    for (size_t y = 0; y < height; ++y)
+    {
+        float* row = image.Row(y);
+        for (size_t x = 0; x < width; ++x)
+        {
+            const bool square = ((x / 16) + (y / 16)) % 2 == 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                float base = c == 3 ? 1.0f : 0.5f * float(x + c * y) / float(width + c * height);
+                row[x * 4 + c] = std::min(1.0f, base + (square ? 0.25f : 0.0f) + (c < 3 ? noise(random) : 0.0f));
+            }
+        }
+    }
+    return image;
+}
+
+float MaxAbsDifference(const CpuBackend::FloatImage& a, const CpuBackend::FloatImage& b)
+{
+    float result = 0.0f;
+    for (size_t y = 0; y < a.Height(); ++y)
+    {
+        for (size_t i = 0; i < a.Width() * 4; ++i)
+        {
+            result = std::max(result, std::fabs(a.Row(y)[i] - b.Row(y)[i]));
+        }
+    }
+    return result;
+}
+
+// mean over the colour channels
+float MeanAbsDifference(const CpuBackend::FloatImage& a, const CpuBackend::FloatImage& b)
+{
+    double sum = 0.0;
+    for (size_t y = 0; y < a.Height(); ++y)
+    {
+        for (size_t x = 0; x < a.Width(); ++x)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                sum += std::fabs(a.Row(y)[x * 4 + c] - b.Row(y)[x * 4 + c]);
+            }
+        }
+    }
+    return static_cast<float>(sum / (a.Width() * a.Height() * 3));
+}
+
+bool Report(const std::string& name, float error, float tolerance)
+{
+    const bool pass = error <= tolerance;
+    std::cout << "  " << std::left << std::setw(44) << name << std::right << " error " << std::scientific
+        << std::setprecision(2) << error << " (tolerance " << tolerance << ") " << (pass ? "ok" : "FAILED")
+        << std::defaultfloat << std::endl;
+    return pass;
+}
+
+std::unique_ptr<CpuBackend::Image> MakeImage(size_t width, size_t height, rif_uint components, rif_component_type type)
+{
+    rif_image_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.image_width = static_cast<rif_uint>(width);
+    desc.image_height = static_cast<rif_uint>(height);
+    desc.num_components = components;
+    desc.type = type;
+    return std::unique_ptr<CpuBackend::Image>(new CpuBackend::Image(desc, nullptr));
+}
+
+// 'source' converted to 'type'; the channels past 'components' are dropped
+std::unique_ptr<CpuBackend::Image> ToImage(const CpuBackend::FloatImage& source, rif_uint components, rif_component_type type)
+{
+    std::unique_ptr<CpuBackend::Image> image = MakeImage(source.Width(), source.Height(), components, type);
+    std::vector<float> row(source.Width() * components);
+    for (size_t y = 0; y < source.Height(); ++y)
+    {
+        for (size_t x = 0; x < source.Width(); ++x)
+        {
+            std::copy(source.Row(y) + x * 4, source.Row(y) + x * 4 + components, &row[x * components]);
+        }
+        image->StoreRow(y, 0, source.Width(), row.data(), components);
+    }
+    return image;
+}
+
+// largest difference between two images of the same size, read as float
+float MaxAbsDifference(const CpuBackend::Image& a, const CpuBackend::Image& b)
+{
+    const rif_uint components = a.Components();
+    std::vector<float> rowA(a.Width() * components);
+    std::vector<float> rowB(a.Width() * components);
+    float result = 0.0f;
+    for (size_t y = 0; y < a.Height(); ++y)
+    {
+        a.LoadRow(y, 0, a.Width(), rowA.data(), components);
+        b.LoadRow(y, 0, a.Width(), rowB.data(), components);
+        for (size_t i = 0; i < rowA.size(); ++i)
+        {
+            result = std::max(result, std::fabs(rowA[i] - rowB[i]));
+        }
+    }
+    return result;
+}
+
+// the test image from disk, or a synthetic one when it cannot be read
+std::unique_ptr<CpuBackend::Image> LoadTestImage(const Options& options, const std::string& name)
+{
+    CpuBackend::Context context(1);
+    CpuBackend::Image* image = nullptr;
+    const std::string path = options.images + "/" + name;
+    if (CpuBackend::LoadImage(&context, path, &image) == RIF_SUCCESS)
+    {
+        return std::unique_ptr<CpuBackend::Image>(image);
+    }
+    std::cout << "  " << path << " not found, using a synthetic image" << std::endl;
+    return ToImage(MakeTestImage(options.width, options.height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+}
+
+//
+// Gaussian blur
+//
+
+// separable convolution in double precision with a kernel truncated at 'radius'
+CpuBackend::FloatImage ReferenceBlur(const CpuBackend::FloatImage& src, float sigma, int radius, rif_uint readMode)
+{
+    const long width = long(src.Width());
+    const long height = long(src.Height());
+    std::vector<double> weights(radius + 1);
+    double sum = 0.0;
+    for (int k = 0; k <= radius; ++k)
+    {
+        weights[k] = std::exp(-0.5 * k * k / (double(sigma) * sigma));
+        sum += k ? 2.0 * weights[k] : weights[k];
+    }
+
+    std::vector<double> horizontal(width * height * 4);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                double acc = 0.0;
+                for (int k = -radius; k <= radius; ++k)
+                {
+                    acc += weights[std::abs(k)] * src.Row(y)[CpuBackend::BorderIndex(x + k, width, readMode) * 4 + c];
+                }
+                horizontal[(y * width + x) * 4 + c] = acc / sum;
+            }
+        }
+    }
+
+    CpuBackend::FloatImage dst(width, height);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                double acc = 0.0;
+                for (int k = -radius; k <= radius; ++k)
+                {
+                    acc += weights[std::abs(k)] * horizontal[(CpuBackend::BorderIndex(y + k, height, readMode) * width + x) * 4 + c];
+                }
+                dst.Row(y)[x * 4 + c] = float(acc / sum);
+            }
+        }
+    }
+    return dst;
+}
+
+bool TestBlur(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Gaussian blur vs direct convolution (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    const CpuBackend::FloatImage src = MakeTestImage(157, 83);
+    const rif_uint modes[] = { RIF_READ_MODE_CLAMP, RIF_READ_MODE_MIRROR, RIF_READ_MODE_WRAP };
+    const char* modeNames[] = { "clamp", "mirror", "wrap" };
+
+    bool pass = true;
+    for (int m = 0; m < 3; ++m)
+    {
+        for (float sigma : { 0.8f, 2.0f, 4.0f })
+        {
+            CpuBackend::GaussianBlurSettings settings;
+            settings.sigma = sigma;
+            settings.radius = int(std::ceil(3.0f * sigma));
+            settings.readMode = modes[m];
+            settings.method = CpuBackend::GaussianBlurMethod::Fir;
+
+            CpuBackend::FloatImage dst;
+            CpuBackend::GaussianBlur(pool, src, dst, settings);
+            const CpuBackend::FloatImage reference = ReferenceBlur(src, sigma, settings.radius, modes[m]);
+            pass &= Report(std::string("FIR ") + modeNames[m] + " sigma " + std::to_string(sigma).substr(0, 4),
+                MaxAbsDifference(dst, reference), 1e-5f);
+        }
+
+        // the recursive filter approximates the untruncated Gaussian
+        for (float sigma : { 3.0f, 8.0f, 20.0f })
+        {
+            CpuBackend::GaussianBlurSettings settings;
+            settings.sigma = sigma;
+            settings.readMode = modes[m];
+            settings.method = CpuBackend::GaussianBlurMethod::Iir;
+
+            CpuBackend::FloatImage dst;
+            CpuBackend::GaussianBlur(pool, src, dst, settings);
+            const CpuBackend::FloatImage reference = ReferenceBlur(src, sigma, int(std::ceil(6.0f * sigma)), modes[m]);
+            pass &= Report(std::string("IIR ") + modeNames[m] + " sigma " + std::to_string(sigma).substr(0, 4),
+                MaxAbsDifference(dst, reference), 2e-2f);
+        }
+    }
+    return pass;
+}
+
+void BenchmarkBlur(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    std::cout << "Gaussian blur " << options.width << "x" << options.height << " RGBA float, "
+        << pool.ThreadCount() << " threads" << std::endl;
+    const CpuBackend::FloatImage src = MakeTestImage(options.width, options.height);
+    const double megapixels = options.width * double(options.height) * 1e-6;
+
+    std::cout << "  sigma      auto       FIR       IIR  (ms)" << std::endl;
+    for (float sigma : { 1.0f, 2.0f, 4.0f, 8.0f, 16.0f, 32.0f, 64.0f })
+    {
+        CpuBackend::GaussianBlurSettings settings;
+        settings.sigma = sigma;
+        settings.radius = int(std::ceil(3.0f * sigma));
+        CpuBackend::FloatImage dst;
+
+        double times[3];
+        const CpuBackend::GaussianBlurMethod methods[] = { CpuBackend::GaussianBlurMethod::Auto,
+            CpuBackend::GaussianBlurMethod::Fir, CpuBackend::GaussianBlurMethod::Iir };
+        for (int i = 0; i < 3; ++i)
+        {
+            settings.method = methods[i];
+            times[i] = TimeMs(options.repeat, [&]() { CpuBackend::GaussianBlur(pool, src, dst, settings); });
+        }
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(5) << sigma << std::setw(10) << times[0]
+            << std::setw(10) << times[1] << std::setw(10) << times[2] << "   auto " << std::setprecision(0)
+            << megapixels / (times[0] * 1e-3) << " MP/s" << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// Median
+//
+
+// sorts every window, borders clamped like the histogram version
+void ReferenceMedian(const CpuBackend::Image& input, CpuBackend::Image& output, long radius)
+{
+    const long width = static_cast<long>(input.Width());
+    const long height = static_cast<long>(input.Height());
+    const rif_uint components = input.Components();
+    std::vector<float> values(width * height * components);
+    for (long y = 0; y < height; ++y)
+    {
+        input.LoadRow(y, 0, width, &values[y * width * components], components);
+    }
+
+    std::vector<float> window((2 * radius + 1) * (2 * radius + 1));
+    std::vector<float> row(width * components);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            for (rif_uint c = 0; c < components; ++c)
+            {
+                size_t n = 0;
+                for (long dy = -radius; dy <= radius; ++dy)
+                {
+                    for (long dx = -radius; dx <= radius; ++dx)
+                    {
+                        const long sx = CpuBackend::BorderIndex(x + dx, width, RIF_READ_MODE_CLAMP);
+                        const long sy = CpuBackend::BorderIndex(y + dy, height, RIF_READ_MODE_CLAMP);
+                        window[n++] = values[(sy * width + sx) * components + c];
+                    }
+                }
+                std::nth_element(window.begin(), window.begin() + n / 2, window.end());
+                row[x * components + c] = window[n / 2];
+            }
+        }
+        output.StoreRow(y, 0, width, row.data(), components);
+    }
+}
+
+bool TestMedian(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Histogram median vs sorting" << std::endl;
+    const CpuBackend::FloatImage source = MakeTestImage(97, 61);
+
+    bool pass = true;
+    for (rif_component_type type : { RIF_COMPONENT_TYPE_UINT8, RIF_COMPONENT_TYPE_FLOAT32 })
+    {
+        std::unique_ptr<CpuBackend::Image> input = ToImage(source, 4, type);
+        std::unique_ptr<CpuBackend::Image> output = MakeImage(97, 61, 4, type);
+        std::unique_ptr<CpuBackend::Image> reference = MakeImage(97, 61, 4, type);
+        for (long radius : { 0L, 1L, 3L, 7L, 40L })
+        {
+            CpuBackend::MedianFilter(pool, *input, *output, radius);
+            ReferenceMedian(*input, *reference, radius);
+            // the float path returns the center of a 1/4095 wide bin of the channel range
+            const bool exact = type == RIF_COMPONENT_TYPE_UINT8;
+            pass &= Report(std::string(exact ? "uint8" : "float") + " radius " + std::to_string(radius),
+                MaxAbsDifference(*output, *reference), exact ? 0.0f : 1.0f / 4095.0f);
+        }
+    }
+    return pass;
+}
+
+void BenchmarkMedian(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    std::unique_ptr<CpuBackend::Image> source = LoadTestImage(options, "color.jpg");
+    const size_t width = source->Width();
+    const size_t height = source->Height();
+    const rif_uint components = source->Components();
+    std::unique_ptr<CpuBackend::Image> bytes = MakeImage(width, height, components, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> output = MakeImage(width, height, components, RIF_COMPONENT_TYPE_UINT8);
+    std::vector<float> row(width * components);
+    for (size_t y = 0; y < height; ++y)
+    {
+        source->LoadRow(y, 0, width, row.data(), components);
+        bytes->StoreRow(y, 0, width, row.data(), components);
+    }
+    std::unique_ptr<CpuBackend::Image> floatOutput = MakeImage(width, height, components, source->Type());
+
+    std::cout << "Median " << width << "x" << height << "x" << components << ", " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  radius   uint8 ns/px   float ns/px   sorting ns/px" << std::endl;
+    const double pixels = double(width) * height;
+    for (long radius : { 1L, 2L, 4L, 8L, 16L, 32L, 50L })
+    {
+        const double bytesMs = TimeMs(options.repeat, [&]() { CpuBackend::MedianFilter(pool, *bytes, *output, radius); });
+        const double floatMs = TimeMs(options.repeat, [&]() { CpuBackend::MedianFilter(pool, *source, *floatOutput, radius); });
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(6) << radius << std::setw(14)
+            << bytesMs * 1e6 / pixels << std::setw(14) << floatMs * 1e6 / pixels;
+        // single threaded and quadratic in the radius, only run while it stays reasonable
+        if (radius <= 8)
+        {
+            const double sortMs = TimeMs(1, [&]() { ReferenceMedian(*bytes, *output, radius); });
+            std::cout << std::setw(16) << sortMs * 1e6 / pixels;
+        }
+        else
+        {
+            std::cout << std::setw(16) << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// Bilateral
+//
+
+bool TestBilateral(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Bilateral grid vs exact window, mean error" << std::endl;
+    // grey, so the luminance the grid sorts by is the distance the exact filter uses
+    CpuBackend::FloatImage src = MakeTestImage(160, 96);
+    for (size_t y = 0; y < src.Height(); ++y)
+    {
+        for (size_t x = 0; x < src.Width(); ++x)
+        {
+            float* p = src.Row(y) + 4 * x;
+            p[0] = p[1] = p[2] = CpuBackend::Luminance(p);
+        }
+    }
+
+    bool pass = true;
+    for (int radius : { 6, 12, 24 })
+    {
+        for (float cellScale : { 1.0f, 0.5f })
+        {
+            CpuBackend::BilateralSettings settings;
+            settings.radius = radius;
+            settings.sigmas = { 0.1f };
+            settings.method = CpuBackend::BilateralMethod::Exact;
+            CpuBackend::FloatImage exact;
+            CpuBackend::BilateralDenoise(pool, src, {}, exact, settings);
+
+            settings.method = CpuBackend::BilateralMethod::Grid;
+            settings.gridSpatial = CpuBackend::BilateralSpatialSigma(radius) * cellScale;
+            settings.gridRange = cellScale;
+            CpuBackend::FloatImage grid;
+            CpuBackend::BilateralDenoise(pool, src, {}, grid, settings);
+            // finer cells must get closer to the exact filter
+            pass &= Report("radius " + std::to_string(radius) + " cell " + std::to_string(cellScale).substr(0, 3) + " sigma",
+                MeanAbsDifference(grid, exact), cellScale < 1.0f ? 0.005f : 0.02f);
+        }
+    }
+    return pass;
+}
+
+void BenchmarkBilateral(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    std::unique_ptr<CpuBackend::Image> image = LoadTestImage(options, "color.jpg");
+    CpuBackend::FloatImage src;
+    src.Load(pool, *image);
+    const double pixels = double(src.Width()) * src.Height();
+
+    std::cout << "Bilateral " << src.Width() << "x" << src.Height() << ", " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  radius   grid ns/px   grid 1/2 cell ns/px   exact ns/px" << std::endl;
+    for (int radius : { 2, 4, 8, 16, 32, 64 })
+    {
+        CpuBackend::BilateralSettings settings;
+        settings.radius = radius;
+        settings.sigmas = { 0.1f };
+        CpuBackend::FloatImage dst;
+
+        settings.method = CpuBackend::BilateralMethod::Grid;
+        const double gridMs = TimeMs(options.repeat, [&]() { CpuBackend::BilateralDenoise(pool, src, {}, dst, settings); });
+        settings.gridSpatial = CpuBackend::BilateralSpatialSigma(radius) * 0.5f;
+        settings.gridRange = 0.5f;
+        const double fineMs = TimeMs(options.repeat, [&]() { CpuBackend::BilateralDenoise(pool, src, {}, dst, settings); });
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(6) << radius << std::setw(13)
+            << gridMs * 1e6 / pixels << std::setw(22) << fineMs * 1e6 / pixels;
+        // quadratic in the radius, only run while it stays reasonable
+        if (radius <= 8)
+        {
+            settings.method = CpuBackend::BilateralMethod::Exact;
+            const double exactMs = TimeMs(1, [&]() { CpuBackend::BilateralDenoise(pool, src, {}, dst, settings); });
+            std::cout << std::setw(14) << exactMs * 1e6 / pixels;
+        }
+        else
+        {
+            std::cout << std::setw(14) << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// EAW
+//
+
+struct EawScene
+{
+    CpuBackend::FloatImage color;
+    CpuBackend::FloatImage variance;
+    CpuBackend::FloatImage normals;
+    CpuBackend::FloatImage depth;
+    CpuBackend::FloatImage trans;
+
+    CpuBackend::EawGuides Guides() const
+    {
+        CpuBackend::EawGuides guides;
+        guides.variance = &variance;
+        guides.normals = &normals;
+        guides.depth = &depth;
+        guides.trans = &trans;
+        return guides;
+    }
+};
+
+// noisy colour over a few objects with their own normals, depths and ids
+EawScene MakeEawScene(size_t width, size_t height)
+{
+    EawScene scene;
+    scene.color = MakeTestImage(width, height);
+    scene.variance.Resize(width, height);
+    scene.normals.Resize(width, height);
+    scene.depth.Resize(width, height);
+    scene.trans.Resize(width, height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            const int object = int(x * 3 / width) + 3 * int(y * 2 / height);
+            const float angle = 0.7f * object + 0.002f * (x + y);
+            float* n = scene.normals.Row(y) + 4 * x;
+            n[0] = std::sin(angle);
+            n[1] = 0.0f;
+            n[2] = std::cos(angle);
+            scene.depth.Row(y)[4 * x] = 1.0f + 0.5f * object + 0.001f * y;
+            std::fill(scene.trans.Row(y) + 4 * x, scene.trans.Row(y) + 4 * x + 3, 0.1f * object);
+            std::fill(scene.variance.Row(y) + 4 * x, scene.variance.Row(y) + 4 * x + 3, 0.02f);
+        }
+    }
+    return scene;
+}
+
+// whole image, one pixel at a time, in double precision
+CpuBackend::FloatImage ReferenceEaw(const EawScene& scene, const CpuBackend::EawSettings& settings)
+{
+    const long width = long(scene.color.Width());
+    const long height = long(scene.color.Height());
+    const double h[5] = { 1.0 / 16.0, 1.0 / 4.0, 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+    CpuBackend::FloatImage current = scene.color;
+    CpuBackend::FloatImage next(width, height);
+    for (int iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+        const CpuBackend::EawPassConstants c = CpuBackend::EawPass(settings, iteration);
+        for (long y = 0; y < height; ++y)
+        {
+            for (long x = 0; x < width; ++x)
+            {
+                const float* p = current.Row(y) + 4 * x;
+                const float* pv = scene.variance.Row(y) + 4 * x;
+                const float* pn = scene.normals.Row(y) + 4 * x;
+                const float* pt = scene.trans.Row(y) + 4 * x;
+                const double variance = (pv[0] + pv[1] + pv[2]) / 3.0;
+                double acc[3] = { 0.0, 0.0, 0.0 };
+                double total = 0.0;
+                for (int ky = 0; ky < 5; ++ky)
+                {
+                    for (int kx = 0; kx < 5; ++kx)
+                    {
+                        const long qx = x + (kx - 2) * c.step;
+                        const long qy = y + (ky - 2) * c.step;
+                        if (qx < 0 || qx >= width || qy < 0 || qy >= height)
+                        {
+                            continue;
+                        }
+                        const float* q = current.Row(qy) + 4 * qx;
+                        const float* qn = scene.normals.Row(qy) + 4 * qx;
+                        const float* qt = scene.trans.Row(qy) + 4 * qx;
+                        double colorDistance = 0.0;
+                        double transDistance = 0.0;
+                        double dot = 0.0;
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            colorDistance += double(p[i] - q[i]) * (p[i] - q[i]);
+                            transDistance += double(pt[i] - qt[i]) * (pt[i] - qt[i]);
+                            dot += double(pn[i]) * qn[i];
+                        }
+                        const double e = colorDistance * c.color / (variance + 1e-4) + std::max(0.0, 1.0 - dot) * c.normal
+                            + std::fabs(scene.depth.Row(y)[4 * x] - scene.depth.Row(qy)[4 * qx]) * c.depth
+                            + transDistance * c.trans;
+                        const double w = h[ky] * h[kx] * std::exp(-e);
+                        for (int i = 0; i < 3; ++i)
+                        {
+                            acc[i] += w * q[i];
+                        }
+                        total += w;
+                    }
+                }
+                float* out = next.Row(y) + 4 * x;
+                for (int i = 0; i < 3; ++i)
+                {
+                    out[i] = float(acc[i] / total);
+                }
+                out[3] = p[3];
+            }
+        }
+        std::swap(current, next);
+    }
+    return current;
+}
+
+bool TestEaw(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "EAW tiles vs whole image reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    const EawScene scene = MakeEawScene(157, 83);
+
+    bool pass = true;
+    // small tiles so the halos cross several tiles, and the default tiling
+    for (size_t tileSize : { 32, 0 })
+    {
+        for (int iterations : { 1, 3 })
+        {
+            CpuBackend::EawSettings settings;
+            settings.iterations = iterations;
+            settings.tileSize = tileSize;
+            CpuBackend::FloatImage dst;
+            CpuBackend::EawDenoise(pool, scene.color, scene.Guides(), dst, settings);
+            pass &= Report("tile " + std::to_string(tileSize) + " iterations " + std::to_string(iterations),
+                MaxAbsDifference(dst, ReferenceEaw(scene, settings)), 1e-4f);
+        }
+    }
+    return pass;
+}
+
+void BenchmarkEaw(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const EawScene scene = MakeEawScene(options.width, options.height);
+    CpuBackend::EawSettings settings;
+    settings.iterations = 5;
+    CpuBackend::EawStatistics statistics;
+    CpuBackend::FloatImage dst;
+
+    std::cout << "EAW " << options.width << "x" << options.height << ", " << settings.iterations << " iterations, "
+        << pool.ThreadCount() << " threads" << std::endl;
+    double best = 1e30;
+    CpuBackend::EawStatistics bestStatistics;
+    for (int i = 0; i < options.repeat; ++i)
+    {
+        const double ms = TimeMs(1, [&]() { CpuBackend::EawDenoise(pool, scene.color, scene.Guides(), dst, settings, &statistics); });
+        if (ms < best)
+        {
+            best = ms;
+            bestStatistics = statistics;
+        }
+    }
+    std::cout << "  iteration  step   filter ms   exchange ms" << std::endl;
+    for (size_t i = 0; i < bestStatistics.filterMs.size(); ++i)
+    {
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::setw(9) << i << std::setw(6) << (1 << i)
+            << std::setw(12) << bestStatistics.filterMs[i] << std::setw(14)
+            << (i < bestStatistics.exchangeMs.size() ? bestStatistics.exchangeMs[i] : 0.0) << std::endl;
+    }
+    std::cout << "  total " << best << " ms, " << std::setprecision(1)
+        << options.width * double(options.height) * 1e-6 / (best * 1e-3) << " MP/s" << std::defaultfloat << std::endl;
+}
+
+//
+// LWR
+//
+
+struct LwrScene
+{
+    EawScene base;
+    CpuBackend::FloatImage normalsVariance;
+    CpuBackend::FloatImage depthVariance;
+    CpuBackend::FloatImage transVariance;
+
+    CpuBackend::LwrGuides Guides() const
+    {
+        CpuBackend::LwrGuides guides;
+        guides.colorVariance = &base.variance;
+        guides.normals = &base.normals;
+        guides.normalsVariance = &normalsVariance;
+        guides.depth = &base.depth;
+        guides.depthVariance = &depthVariance;
+        guides.trans = &base.trans;
+        guides.transVariance = &transVariance;
+        return guides;
+    }
+};
+
+LwrScene MakeLwrScene(size_t width, size_t height)
+{
+    LwrScene scene;
+    scene.base = MakeEawScene(width, height);
+    const float variances[] = { 0.01f, 0.001f, 0.0001f };
+    CpuBackend::FloatImage* images[] = { &scene.normalsVariance, &scene.depthVariance, &scene.transVariance };
+    for (int i = 0; i < 3; ++i)
+    {
+        images[i]->Resize(width, height);
+        for (size_t y = 0; y < height; ++y)
+        {
+            // noisier towards the bottom so the ridge varies over the image
+            std::fill(images[i]->Row(y), images[i]->Row(y) + 4 * width, variances[i] * (1.0f + 4.0f * y / height));
+        }
+    }
+    return scene;
+}
+
+// every window summed from scratch and solved in double precision
+CpuBackend::FloatImage ReferenceLwr(const LwrScene& scene, const CpuBackend::LwrSettings& settings)
+{
+    const long width = long(scene.base.color.Width());
+    const long height = long(scene.base.color.Height());
+    const int n = CpuBackend::LwrFeatures;
+    const CpuBackend::LwrFeatureMap map(scene.Guides(), width, height);
+    CpuBackend::FloatImage dst(width, height);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            double a[CpuBackend::LwrFeatures][CpuBackend::LwrFeatures] = {};
+            double b[3][CpuBackend::LwrFeatures] = {};
+            double noise[3] = {};
+            for (long qy = std::max(0L, y - settings.radius); qy <= std::min(height - 1, y + settings.radius); ++qy)
+            {
+                for (long qx = std::max(0L, x - settings.radius); qx <= std::min(width - 1, x + settings.radius); ++qx)
+                {
+                    CpuBackend::LwrSample sample;
+                    map.Sample(qx, qy, sample);
+                    const float* rgb = scene.base.color.Row(qy) + 4 * qx;
+                    for (int r = 0; r < n; ++r)
+                    {
+                        for (int c = 0; c < n; ++c)
+                        {
+                            a[r][c] += double(sample.weight) * sample.x[r] * sample.x[c];
+                        }
+                        for (int channel = 0; channel < 3; ++channel)
+                        {
+                            b[channel][r] += double(sample.weight) * sample.x[r] * rgb[channel];
+                        }
+                    }
+                    for (int g = 0; g < 3; ++g)
+                    {
+                        noise[g] += double(sample.weight) * sample.noise[g];
+                    }
+                }
+            }
+            const double total = a[0][0];
+            for (int k = 1; k < n; ++k)
+            {
+                a[k][k] += noise[CpuBackend::LwrFeatureGroup(k)] + settings.ridge * total;
+            }
+
+            // Gaussian elimination with the three right-hand sides
+            for (int c = 0; c < n; ++c)
+            {
+                for (int r = c + 1; r < n; ++r)
+                {
+                    const double f = a[r][c] / a[c][c];
+                    for (int k = c; k < n; ++k)
+                    {
+                        a[r][k] -= f * a[c][k];
+                    }
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        b[channel][r] -= f * b[channel][c];
+                    }
+                }
+            }
+            CpuBackend::LwrSample centre;
+            map.Sample(x, y, centre);
+            float* out = dst.Row(y) + 4 * x;
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                double beta[CpuBackend::LwrFeatures];
+                double result = 0.0;
+                for (int r = n - 1; r >= 0; --r)
+                {
+                    double s = b[channel][r];
+                    for (int k = r + 1; k < n; ++k)
+                    {
+                        s -= a[r][k] * beta[k];
+                    }
+                    beta[r] = s / a[r][r];
+                    result += beta[r] * centre.x[r];
+                }
+                out[channel] = float(std::max(0.0, result));
+            }
+            out[3] = scene.base.color.Row(y)[4 * x + 3];
+        }
+    }
+    return dst;
+}
+
+bool TestLwr(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "LWR sliding sums and batched Cholesky vs direct solve (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    const LwrScene scene = MakeLwrScene(157, 83);
+
+    bool pass = true;
+    for (long tileSize : { 32L, 128L })
+    {
+        for (int radius : { 2, 6 })
+        {
+            CpuBackend::LwrSettings settings;
+            settings.radius = radius;
+            settings.tileSize = tileSize;
+            CpuBackend::FloatImage dst;
+            CpuBackend::LwrDenoise(pool, scene.base.color, scene.Guides(), dst, settings);
+            pass &= Report("tile " + std::to_string(tileSize) + " radius " + std::to_string(radius),
+                MaxAbsDifference(dst, ReferenceLwr(scene, settings)), 2e-3f);
+        }
+    }
+    return pass;
+}
+
+void BenchmarkLwr(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const LwrScene scene = MakeLwrScene(options.width, options.height);
+    const double pixels = options.width * double(options.height);
+    std::cout << "LWR " << options.width << "x" << options.height << ", " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  radius   ms        ns/px" << std::endl;
+    for (int radius : { 2, 6, 12, 24 })
+    {
+        CpuBackend::LwrSettings settings;
+        settings.radius = radius;
+        CpuBackend::FloatImage dst;
+        const double ms = TimeMs(options.repeat, [&]() { CpuBackend::LwrDenoise(pool, scene.base.color, scene.Guides(), dst, settings); });
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(6) << radius << std::setw(9) << ms
+            << std::setw(11) << ms * 1e6 / pixels << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// MLAA
+//
+
+// Hard-edged shapes point sampled at the pixel centres, or averaged over 'samples' x
+// 'samples' points per pixel for the antialiased ground truth.
+CpuBackend::FloatImage MakeAliasedScene(size_t width, size_t height, int samples)
+{
+    CpuBackend::FloatImage image(width, height);
+    const double scale = double(std::min(width, height));
+    auto shade = [&](double u, double v, float* rgb)
+    {
+        rgb[0] = 0.1f; rgb[1] = 0.15f; rgb[2] = 0.2f;
+        // a disk, a rotated square and a thin slanted bar
+        const double du = u - 0.35 * width / scale;
+        const double dv = v - 0.5;
+        if (du * du + dv * dv < 0.3 * 0.3)
+        {
+            rgb[0] = 0.9f; rgb[1] = 0.6f; rgb[2] = 0.2f;
+        }
+        const double su = u - 0.75 * width / scale;
+        const double sv = v - 0.45;
+        if (std::fabs(0.94 * su + 0.34 * sv) < 0.15 && std::fabs(-0.34 * su + 0.94 * sv) < 0.15)
+        {
+            rgb[0] = 0.2f; rgb[1] = 0.8f; rgb[2] = 0.4f;
+        }
+        if (std::fabs(v - 0.85 - 0.07 * u) < 0.02)
+        {
+            rgb[0] = 1.0f; rgb[1] = 1.0f; rgb[2] = 1.0f;
+        }
+    };
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        float* row = image.Row(y);
+        for (size_t x = 0; x < width; ++x)
+        {
+            double sum[3] = {};
+            for (int sy = 0; sy < samples; ++sy)
+            {
+                for (int sx = 0; sx < samples; ++sx)
+                {
+                    float rgb[3];
+                    shade((x + (sx + 0.5) / samples) / scale, (y + (sy + 0.5) / samples) / scale, rgb);
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        sum[c] += rgb[c];
+                    }
+                }
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                row[4 * x + c] = float(sum[c] / (samples * samples));
+            }
+            row[4 * x + 3] = 1.0f;
+        }
+    }
+    return image;
+}
+
+// per pixel searches over plain edge arrays and areas computed without the table
+CpuBackend::FloatImage ReferenceMlaa(const CpuBackend::FloatImage& src, const CpuBackend::FloatImage* depth,
+    const CpuBackend::MlaaSettings& settings)
+{
+    const long width = long(src.Width());
+    const long height = long(src.Height());
+    const int maxDistance = CpuBackend::MlaaMaxDistance;
+    auto luma = [&](long x, long y)
+    {
+        const float* p = src.Row(y) + 4 * x;
+        return 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2];
+    };
+    auto differs = [&](long x0, long y0, long x1, long y1)
+    {
+        if (std::fabs(luma(x0, y0) - luma(x1, y1)) > settings.lumaThreshold)
+        {
+            return true;
+        }
+        return depth && std::fabs(depth->Row(y0)[4 * x0] - depth->Row(y1)[4 * x1]) > settings.depthThreshold;
+    };
+
+    std::vector<char> left(width * height, 0);
+    std::vector<char> top(width * height, 0);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            left[y * width + x] = x > 0 && differs(x, y, x - 1, y);
+            top[y * width + x] = y > 0 && differs(x, y, x, y - 1);
+        }
+    }
+    auto isLeft = [&](long x, long y) { return x >= 0 && x < width && y >= 0 && y < height && left[y * width + x]; };
+    auto isTop = [&](long x, long y) { return x >= 0 && x < width && y >= 0 && y < height && top[y * width + x]; };
+
+    // steps along the edge while it continues, up to the search limit
+    auto search = [&](std::function<bool(int)> continues)
+    {
+        int d = 0;
+        while (d < maxDistance && continues(d + 1))
+        {
+            ++d;
+        }
+        return d;
+    };
+    auto area = [&](int crossingA, int crossingB, int a, int b)
+    {
+        return CpuBackend::MlaaArea(CpuBackend::MlaaEndHeight(a < maxDistance ? crossingA : 0),
+            CpuBackend::MlaaEndHeight(b < maxDistance ? crossingB : 0), std::min(a, maxDistance - 1), std::min(b, maxDistance - 1));
+    };
+
+    std::vector<float> horizontal(width * height, 0.0f);
+    std::vector<float> vertical(width * height, 0.0f);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            if (isTop(x, y))
+            {
+                const int a = search([&](int d) { return isTop(x - d, y); });
+                const int b = search([&](int d) { return isTop(x + d, y); });
+                horizontal[y * width + x] = area(isLeft(x - a, y - 1) | isLeft(x - a, y) << 1,
+                    isLeft(x + b + 1, y - 1) | isLeft(x + b + 1, y) << 1, a, b);
+            }
+            if (isLeft(x, y))
+            {
+                const int a = search([&](int d) { return isLeft(x, y - d); });
+                const int b = search([&](int d) { return isLeft(x, y + d); });
+                vertical[y * width + x] = area(isTop(x - 1, y - a) | isTop(x, y - a) << 1,
+                    isTop(x - 1, y + b + 1) | isTop(x, y + b + 1) << 1, a, b);
+            }
+        }
+    }
+
+    CpuBackend::FloatImage dst(width, height);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            const float up = -std::min(0.0f, horizontal[y * width + x]);
+            const float down = y + 1 < height ? std::max(0.0f, horizontal[(y + 1) * width + x]) : 0.0f;
+            const float leftArea = -std::min(0.0f, vertical[y * width + x]);
+            const float right = x + 1 < width ? std::max(0.0f, vertical[y * width + x + 1]) : 0.0f;
+            const float total = up + down + leftArea + right;
+            const float scale = total > 1.0f ? 1.0f / total : 1.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                double value = src.Row(y)[4 * x + c] * (1.0 - total * scale);
+                value += up > 0.0f ? up * scale * src.Row(y - 1)[4 * x + c] : 0.0;
+                value += down > 0.0f ? down * scale * src.Row(y + 1)[4 * x + c] : 0.0;
+                value += leftArea > 0.0f ? leftArea * scale * src.Row(y)[4 * (x - 1) + c] : 0.0;
+                value += right > 0.0f ? right * scale * src.Row(y)[4 * (x + 1) + c] : 0.0;
+                dst.Row(y)[4 * x + c] = float(value);
+            }
+        }
+    }
+    return dst;
+}
+
+bool TestMlaa(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    std::cout << "MLAA bit masks and area table vs per pixel search (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+
+    // the input of the MLAA sample, with its depth when present
+    std::unique_ptr<CpuBackend::Image> input = LoadTestImage(options, "input.png");
+    CpuBackend::FloatImage src;
+    src.Load(pool, *input);
+    CpuBackend::Context context(1);
+    CpuBackend::Image* depthImage = nullptr;
+    CpuBackend::FloatImage depth;
+    if (CpuBackend::LoadImage(&context, options.images + "/depth.exr", &depthImage) == RIF_SUCCESS)
+    {
+        depth.Load(pool, *depthImage);
+        delete depthImage;
+    }
+    const CpuBackend::FloatImage* depthPointer = depth.Width() == src.Width() && depth.Height() == src.Height() ? &depth : nullptr;
+
+    bool pass = true;
+    CpuBackend::MlaaSettings settings;
+    CpuBackend::FloatImage dst;
+    CpuBackend::Mlaa(pool, src, depthPointer, dst, settings);
+    pass &= Report("sample input", MaxAbsDifference(dst, ReferenceMlaa(src, depthPointer, settings)), 1e-5f);
+
+    // odd sizes so the masks end inside a word, and long runs past the search limit
+    const CpuBackend::FloatImage aliased = MakeAliasedScene(317, 131, 1);
+    CpuBackend::Mlaa(pool, aliased, nullptr, dst, settings);
+    pass &= Report("aliased shapes", MaxAbsDifference(dst, ReferenceMlaa(aliased, nullptr, settings)), 1e-5f);
+
+    // antialiasing must bring the shapes closer to their supersampled version
+    const CpuBackend::FloatImage truth = MakeAliasedScene(317, 131, 8);
+    const float before = MeanAbsDifference(aliased, truth);
+    const float after = MeanAbsDifference(dst, truth);
+    std::cout << "  mean error vs 8x8 supersampling: " << before << " point sampled, " << after << " antialiased" << std::endl;
+    pass &= Report("error ratio vs supersampling", after / before, 0.75f);
+    return pass;
+}
+
+void BenchmarkMlaa(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const CpuBackend::FloatImage src = MakeAliasedScene(options.width, options.height, 1);
+    const CpuBackend::MlaaSettings settings;
+    CpuBackend::MlaaStatistics statistics;
+    CpuBackend::MlaaStatistics bestStatistics;
+    CpuBackend::FloatImage dst;
+
+    std::cout << "MLAA " << options.width << "x" << options.height << ", " << pool.ThreadCount() << " threads" << std::endl;
+    double best = 1e30;
+    for (int i = 0; i < options.repeat; ++i)
+    {
+        const double ms = TimeMs(1, [&]() { CpuBackend::Mlaa(pool, src, nullptr, dst, settings, &statistics); });
+        if (ms < best)
+        {
+            best = ms;
+            bestStatistics = statistics;
+        }
+    }
+    std::cout << std::fixed << std::setprecision(2) << "  edges " << bestStatistics.edgeMs << " ms, areas "
+        << bestStatistics.weightMs << " ms, blend " << bestStatistics.blendMs << " ms" << std::endl;
+    std::cout << "  total " << best << " ms, " << std::setprecision(1)
+        << options.width * double(options.height) * 1e-6 / (best * 1e-3) << " MP/s" << std::defaultfloat << std::endl;
+}
+
+//
+// Image statistics
+//
+
+// the test image spread over roughly [0.005, 20]
+CpuBackend::FloatImage MakeHdrImage(size_t width, size_t height)
+{
+    CpuBackend::FloatImage image = MakeTestImage(width, height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        float* row = image.Row(y);
+        for (size_t i = 0; i < width * 4; ++i)
+        {
+            if (i % 4 != 3)
+            {
+                row[i] = 0.005f * std::exp(8.3f * row[i]);
+            }
+        }
+    }
+    return image;
+}
+
+// the same quantities accumulated in double, one pixel at a time
+CpuBackend::ImageStatistics ReferenceStatistics(const CpuBackend::FloatImage& src, const CpuBackend::StatisticsSettings& settings)
+{
+    double minimum[5], maximum[5], sum[6] = {};
+    std::fill(minimum, minimum + 5, 1e300);
+    std::fill(maximum, maximum + 5, -1e300);
+    CpuBackend::ImageStatistics result;
+    result.histogram.assign(settings.bins, 0);
+    const double scale = settings.bins / double(settings.histogramMax - settings.histogramMin);
+    for (size_t y = 0; y < src.Height(); ++y)
+    {
+        for (size_t x = 0; x < src.Width(); ++x)
+        {
+            const float* p = src.Row(y) + 4 * x;
+            const double v[5] = { p[0], p[1], p[2], p[3], 0.2126 * p[0] + 0.7152 * p[1] + 0.0722 * p[2] };
+            for (int k = 0; k < 5; ++k)
+            {
+                minimum[k] = std::min(minimum[k], v[k]);
+                maximum[k] = std::max(maximum[k], v[k]);
+                sum[k] += v[k];
+            }
+            const double logLuminance = std::log(std::max(v[4], 0.0) + settings.logDelta);
+            sum[5] += logLuminance;
+            const double t = settings.logHistogram ? logLuminance / std::log(2.0) : v[4];
+            const double bin = std::min(std::max((t - settings.histogramMin) * scale, 0.0), settings.bins - 1.0);
+            ++result.histogram[static_cast<int>(bin)];
+        }
+    }
+    const double count = double(src.Width()) * src.Height();
+    for (int k = 0; k < 4; ++k)
+    {
+        result.min[k] = static_cast<float>(minimum[k]);
+        result.max[k] = static_cast<float>(maximum[k]);
+        result.mean[k] = static_cast<float>(sum[k] / count);
+    }
+    result.minLuminance = static_cast<float>(minimum[4]);
+    result.maxLuminance = static_cast<float>(maximum[4]);
+    result.meanLuminance = static_cast<float>(sum[4] / count);
+    result.logAverageLuminance = static_cast<float>(std::exp(sum[5] / count));
+    return result;
+}
+
+// largest relative error over the scalar statistics
+float StatisticsError(const CpuBackend::ImageStatistics& a, const CpuBackend::ImageStatistics& b)
+{
+    const float values[][2] =
+    {
+        { a.min[0], b.min[0] }, { a.min[1], b.min[1] }, { a.min[2], b.min[2] }, { a.min[3], b.min[3] },
+        { a.max[0], b.max[0] }, { a.max[1], b.max[1] }, { a.max[2], b.max[2] }, { a.max[3], b.max[3] },
+        { a.mean[0], b.mean[0] }, { a.mean[1], b.mean[1] }, { a.mean[2], b.mean[2] }, { a.mean[3], b.mean[3] },
+        { a.minLuminance, b.minLuminance }, { a.maxLuminance, b.maxLuminance },
+        { a.meanLuminance, b.meanLuminance }, { a.logAverageLuminance, b.logAverageLuminance },
+    };
+    float error = 0.0f;
+    for (const auto& v : values)
+    {
+        error = std::max(error, std::fabs(v[0] - v[1]) / std::max(std::fabs(v[1]), 1e-6f));
+    }
+    return error;
+}
+
+// fraction of the pixels counted in another bin
+float HistogramError(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, double pixels)
+{
+    double moved = 0.0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        moved += std::fabs(double(a[i]) - double(b[i]));
+    }
+    return static_cast<float>(moved / (2.0 * pixels));
+}
+
+bool TestStatistics(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Image statistics vs double reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+
+    bool pass = true;
+    // an odd width leaves pixels past the last vector and chunk, an odd height a short band
+    const CpuBackend::FloatImage hdr = MakeHdrImage(333, 171);
+    const double pixels = double(hdr.Width()) * hdr.Height();
+    CpuBackend::StatisticsSettings settings;
+    for (bool logHistogram : { true, false })
+    {
+        settings.logHistogram = logHistogram;
+        settings.histogramMin = logHistogram ? -10.0f : 0.0f;
+        settings.histogramMax = logHistogram ? 6.0f : 16.0f;
+        const std::string name = logHistogram ? "log2 histogram" : "linear histogram";
+        for (rif_component_type type : { RIF_COMPONENT_TYPE_FLOAT32, RIF_COMPONENT_TYPE_FLOAT16 })
+        {
+            const std::unique_ptr<CpuBackend::Image> input = ToImage(hdr, 4, type);
+            CpuBackend::FloatImage loaded;
+            loaded.Load(pool, *input);
+            const CpuBackend::ImageStatistics reference = ReferenceStatistics(loaded, settings);
+            const CpuBackend::ImageStatistics result = CpuBackend::ComputeImageStatistics(pool, *input, settings);
+            const std::string suffix = type == RIF_COMPONENT_TYPE_FLOAT32 ? ", float32" : ", float16";
+            pass &= Report("statistics, " + name + suffix, StatisticsError(result, reference), 1e-5f);
+            // bins of pixels right on an edge may differ by the rounding of the log
+            pass &= Report(name + suffix + " (moved pixels)", HistogramError(result.histogram, reference.histogram, pixels), 1e-3f);
+        }
+    }
+
+    // the band split and merge order do not depend on the thread count
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(hdr, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    CpuBackend::ThreadPool single(1);
+    CpuBackend::ThreadPool several(7);
+    const CpuBackend::ImageStatistics one = CpuBackend::ComputeImageStatistics(single, *input, settings);
+    const CpuBackend::ImageStatistics all = CpuBackend::ComputeImageStatistics(several, *input, settings);
+    pass &= Report("1 thread vs 7 threads",
+        StatisticsError(one, all) + HistogramError(one.histogram, all.histogram, pixels), 0.0f);
+
+    // the layout of the filter output
+    CpuBackend::ImageStatisticsFilter filter;
+    std::unique_ptr<CpuBackend::Image> output = MakeImage(32, 2, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    filter.Execute(pool, *input, *output);
+    settings = CpuBackend::StatisticsSettings();
+    settings.bins = 32;
+    const CpuBackend::ImageStatistics expected = CpuBackend::ComputeImageStatistics(pool, *input, settings);
+    const float* summary = output->RowAs<float>(0);
+    const float* bins = output->RowAs<float>(1);
+    float layout = 0.0f;
+    for (int c = 0; c < 4; ++c)
+    {
+        layout = std::max(layout, std::fabs(summary[c] - expected.min[c]));
+        layout = std::max(layout, std::fabs(summary[4 + c] - expected.max[c]));
+        layout = std::max(layout, std::fabs(summary[8 + c] - expected.mean[c]));
+    }
+    layout = std::max(layout, std::fabs(summary[15] - expected.logAverageLuminance));
+    layout = std::max(layout, std::fabs(bins[4 * 31 + 2] - 1.0f));
+    for (int b = 0; b < 32; ++b)
+    {
+        layout = std::max(layout, std::fabs(bins[4 * b] - float(expected.histogram[b])));
+    }
+    pass &= Report("filter output layout", layout, 1e-6f);
+    return pass;
+}
+
+void BenchmarkStatistics(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::simd::Level;
+    struct Size
+    {
+        size_t width;
+        size_t height;
+    } sizes[] = { { options.width, options.height }, { 3840, 2160 } };
+
+    std::cout << "Image statistics, float32 RGBA, " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  size         level         ms      GB/s" << std::endl;
+    for (const Size& size : sizes)
+    {
+        const std::unique_ptr<CpuBackend::Image> input = ToImage(MakeHdrImage(size.width, size.height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+        const double bytes = size.width * double(size.height) * 16;
+        for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+        {
+            const double ms = TimeMs(options.repeat, [&]() { CpuBackend::ComputeImageStatistics(pool, *input, CpuBackend::StatisticsSettings(), level); });
+            std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(13)
+                << (std::to_string(size.width) + "x" + std::to_string(size.height)) << std::setw(10)
+                << CpuBackend::simd::LevelName(level) << std::right << std::setw(8) << ms << std::setw(10)
+                << bytes / (ms * 1e6) << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+//
+// Tone mapping
+//
+
+const struct
+{
+    const char* name;
+    CpuBackend::ToneMapOperator op;
+} ToneMapOperators[] =
+{
+    { "linear", CpuBackend::ToneMapOperator::Linear },
+    { "exponential", CpuBackend::ToneMapOperator::Exponential },
+    { "reinhard02", CpuBackend::ToneMapOperator::Reinhard02 },
+    { "drago", CpuBackend::ToneMapOperator::Drago },
+    { "filmic", CpuBackend::ToneMapOperator::Filmic },
+    { "aces", CpuBackend::ToneMapOperator::Aces },
+    { "maxwhite", CpuBackend::ToneMapOperator::MaxWhite },
+    { "photolinear", CpuBackend::ToneMapOperator::PhotoLinear },
+    { "photo", CpuBackend::ToneMapOperator::Photo },
+    { "uncharted", CpuBackend::ToneMapOperator::FilmicUncharted },
+    { "autolinear", CpuBackend::ToneMapOperator::AutoLinear },
+};
+
+double ReferenceEncode(double x, const CpuBackend::ToneMapSettings& settings)
+{
+    switch (settings.encode)
+    {
+    case CpuBackend::ToneMapEncode::Gamma:
+        return std::pow(std::max(x, 0.0), 1.0 / settings.gamma);
+    case CpuBackend::ToneMapEncode::Srgb:
+        x = std::max(x, 0.0);
+        return x > 0.0031308 ? 1.055 * std::pow(x, 1.0 / 2.4) - 0.055 : 12.92 * x;
+    default:
+        return x;
+    }
+}
+
+// the operators in double precision with the library functions
+CpuBackend::FloatImage ReferenceToneMap(const CpuBackend::FloatImage& src, const CpuBackend::ToneMapSettings& settings,
+    const CpuBackend::ToneMapConstants& c)
+{
+    using CpuBackend::ToneMapOperator;
+    CpuBackend::FloatImage dst(src.Width(), src.Height());
+    auto luminance = [](const double* v) { return 0.2126 * v[0] + 0.7152 * v[1] + 0.0722 * v[2]; };
+    auto hable = [](double x) { return (x * (0.15 * x + 0.05) + 0.004) / (x * (0.15 * x + 0.5) + 0.06) - 0.02 / 0.3; };
+    for (size_t y = 0; y < src.Height(); ++y)
+    {
+        for (size_t x = 0; x < src.Width(); ++x)
+        {
+            const float* in = src.Row(y) + 4 * x;
+            double v[3] = { in[0] * double(c.exposure), in[1] * double(c.exposure), in[2] * double(c.exposure) };
+            switch (settings.op)
+            {
+            case ToneMapOperator::Linear:
+            case ToneMapOperator::AutoLinear:
+            case ToneMapOperator::MaxWhite:
+            case ToneMapOperator::PhotoLinear:
+                for (double& e : v) e *= c.k[0];
+                break;
+            case ToneMapOperator::Exponential:
+                for (double& e : v) e = 1.0 - std::exp(-c.k[0] * e);
+                break;
+            case ToneMapOperator::Reinhard02:
+                for (double& e : v)
+                {
+                    const double s = e * c.k[0];
+                    e = c.k[1] * s * (1.0 + s * c.k[2]) / (1.0 + s);
+                }
+                break;
+            case ToneMapOperator::Drago:
+            {
+                for (double& e : v) e *= c.k[0];
+                const double l = std::max(luminance(v), 1e-8);
+                const double ld = std::log(l + 1.0) * c.k[3] / std::log(2.0 + 8.0 * std::pow(l * c.k[1], double(c.k[2])));
+                for (double& e : v) e *= ld / l;
+                break;
+            }
+            case ToneMapOperator::Filmic:
+                for (double& e : v)
+                {
+                    e *= c.k[0];
+                    if (c.k[2] != 0.0f)
+                    {
+                        const double s = std::pow(std::max(e, 0.0), double(c.k[1]));
+                        e = s / (s + 1.0);
+                    }
+                }
+                break;
+            case ToneMapOperator::Aces:
+                for (double& e : v)
+                {
+                    const double a = 0.6 * e;
+                    e = std::min(std::max(a * (2.51 * a + 0.03) / (a * (2.43 * a + 0.59) + 0.14), 0.0), 1.0);
+                }
+                break;
+            case ToneMapOperator::Photo:
+            {
+                for (double& e : v)
+                {
+                    const double s = e * c.k[0];
+                    e = s * (1.0 + s * c.k[1]) / (1.0 + s);
+                }
+                const double l = luminance(v);
+                for (double& e : v) e = l + (e - l) * c.k[2];
+                break;
+            }
+            case ToneMapOperator::FilmicUncharted:
+                for (double& e : v) e = hable(e * c.k[0]) * c.k[1];
+                break;
+            }
+            float* out = dst.Row(y) + 4 * x;
+            for (int i = 0; i < 3; ++i)
+            {
+                out[i] = float(ReferenceEncode(v[i], settings));
+            }
+            out[3] = in[3];
+        }
+    }
+    return dst;
+}
+
+// worst errors of the vector Exp, Log and Pow against the library over their ranges
+bool TestToneMapMath()
+{
+    const CpuBackend::detail::ToneMapMathFunction math = CpuBackend::detail::SelectToneMapMath(CpuBackend::simd::CurrentLevel());
+    const size_t count = 1 << 16;
+    std::vector<float> x(count);
+    std::vector<float> y(count);
+    std::vector<float> out(count);
+
+    bool pass = true;
+    auto relative = [](double value, double reference) { return std::fabs(value - reference) / std::max(std::fabs(reference), 1e-37); };
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = -87.0f + 175.0f * i / (count - 1);
+    }
+    math(0, x.data(), nullptr, count, out.data());
+    double worst = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        worst = std::max(worst, relative(out[i], std::exp(double(x[i]))));
+    }
+    pass &= Report("exp relative, [-87, 88]", float(worst), 3e-7f);
+
+    double absolute = 0.0;
+    worst = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // even samples in [0.5, 2], odd ones log-spaced over [1e-37, 1e37]
+        x[i] = i % 2 ? float(std::pow(10.0, -37.0 + 74.0 * i / (count - 1))) : 0.5f + 1.5f * i / (count - 1);
+    }
+    math(1, x.data(), nullptr, count, out.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double reference = std::log(double(x[i]));
+        if (x[i] >= 0.5f && x[i] <= 2.0f)
+        {
+            absolute = std::max(absolute, std::fabs(out[i] - reference));
+        }
+        else
+        {
+            worst = std::max(worst, relative(out[i], reference));
+        }
+    }
+    pass &= Report("log absolute, [0.5, 2]", float(absolute), 2e-7f);
+    pass &= Report("log relative, elsewhere", float(worst), 2e-7f);
+
+    // the encoding exponents and their inverse, measured against the bound of simd.h
+    const float exponents[] = { 1.0f / 2.2f, 1.0f / 2.4f, 2.2f };
+    worst = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        x[i] = float(std::pow(10.0, -6.0 + 7.3 * i / (count - 1)));
+        y[i] = exponents[i % 3];
+    }
+    math(2, x.data(), y.data(), count, out.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double bound = 3e-7 + 1.2e-7 * std::fabs(y[i] * std::log(double(x[i])));
+        worst = std::max(worst, relative(out[i], std::pow(double(x[i]), double(y[i]))) / bound);
+    }
+    pass &= Report("pow relative / bound, [1e-6, 20]", float(worst), 1.0f);
+    return pass;
+}
+
+bool TestToneMap(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Tone mapping vs double precision reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    bool pass = TestToneMapMath();
+
+    const CpuBackend::FloatImage hdr = MakeHdrImage(203, 37);
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(hdr, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> floats = MakeImage(hdr.Width(), hdr.Height(), 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> bytes = MakeImage(hdr.Width(), hdr.Height(), 4, RIF_COMPONENT_TYPE_UINT8);
+
+    for (const auto& entry : ToneMapOperators)
+    {
+        float worstFloat = 0.0f;
+        float worstByte = 0.0f;
+        for (CpuBackend::ToneMapEncode encode : { CpuBackend::ToneMapEncode::None, CpuBackend::ToneMapEncode::Gamma, CpuBackend::ToneMapEncode::Srgb })
+        {
+            CpuBackend::ToneMapSettings settings;
+            settings.op = entry.op;
+            settings.encode = encode;
+            settings.exposure = 0.8f;
+            settings.parameters.contrast = 1.5f;
+            settings.parameters.saturation = 1.2f;
+
+            const CpuBackend::ImageStatistics statistics = ReferenceStatistics(hdr, CpuBackend::StatisticsSettings());
+            const CpuBackend::FloatImage reference = ReferenceToneMap(hdr, settings, CpuBackend::ComputeToneMapConstants(settings, &statistics));
+
+            CpuBackend::ToneMap(pool, *input, *floats, settings);
+            CpuBackend::FloatImage result;
+            result.Load(pool, *floats);
+            worstFloat = std::max(worstFloat, MaxAbsDifference(result, reference));
+
+            // quantized by the kernel vs rounding the reference, in units of 1/255
+            CpuBackend::ToneMap(pool, *input, *bytes, settings);
+            result.Load(pool, *bytes);
+            for (size_t y = 0; y < hdr.Height(); ++y)
+            {
+                for (size_t i = 0; i < hdr.Width() * 4; ++i)
+                {
+                    const float expected = std::floor(std::min(std::max(reference.Row(y)[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+                    worstByte = std::max(worstByte, std::fabs(result.Row(y)[i] * 255.0f - expected));
+                }
+            }
+        }
+        pass &= Report(std::string(entry.name) + ", float output", worstFloat, 2e-5f);
+        pass &= Report(std::string(entry.name) + ", uint8 output (levels)", worstByte, 1.0f);
+    }
+    return pass;
+}
+
+void BenchmarkToneMap(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(MakeHdrImage(options.width, options.height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> bytes = MakeImage(options.width, options.height, 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> floats = MakeImage(options.width, options.height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    // float32 RGBA read, uint8 RGBA written
+    const double traffic = options.width * double(options.height) * (16 + 4);
+
+    std::cout << "Tone mapping " << options.width << "x" << options.height << " float32 to uint8 sRGB, "
+        << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ", " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  operator          ms      GB/s" << std::endl;
+    for (const auto& entry : ToneMapOperators)
+    {
+        CpuBackend::ToneMapSettings settings;
+        settings.op = entry.op;
+        settings.encode = CpuBackend::ToneMapEncode::Srgb;
+        const double ms = TimeMs(options.repeat, [&]() { CpuBackend::ToneMap(pool, *input, *bytes, settings); });
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(12) << entry.name << std::right
+            << std::setw(8) << ms << std::setw(10) << traffic / (ms * 1e6) << std::defaultfloat << std::endl;
+    }
+
+    // the same result in separate passes: tone map to float, then the gamma filter
+    CpuBackend::ToneMapSettings settings;
+    CpuBackend::GammaCorrectionFilter gamma;
+    const double separate = TimeMs(options.repeat, [&]()
+    {
+        CpuBackend::ToneMap(pool, *input, *floats, settings);
+        gamma.Execute(pool, *floats, *bytes);
+    });
+    settings.encode = CpuBackend::ToneMapEncode::Gamma;
+    const double fused = TimeMs(options.repeat, [&]() { CpuBackend::ToneMap(pool, *input, *bytes, settings); });
+    std::cout << std::fixed << std::setprecision(2) << "  reinhard02 + gamma 2.2: " << separate << " ms in two passes, "
+        << fused << " ms fused" << std::defaultfloat << std::endl;
+}
+
+//
+// Resampling
+//
+
+const struct
+{
+    const char* name;
+    rif_uint interpolation;
+} ResampleKernels[] =
+{
+    { "nearest", RIF_IMAGE_INTERPOLATION_NEAREST },
+    { "bilinear", RIF_IMAGE_INTERPOLATION_BILINEAR },
+    { "bicubic", RIF_IMAGE_INTERPOLATION_BICUBIC },
+    { "lanczos", RIF_IMAGE_INTERPOLATION_LANCZOS },
+    { "lanczos3", RIF_IMAGE_INTERPOLATION_LANCZOS3 },
+    { "lanczos4", RIF_IMAGE_INTERPOLATION_LANCZOS4 },
+    { "lanczos6", RIF_IMAGE_INTERPOLATION_LANCZOS6 },
+    { "lanczos12", RIF_IMAGE_INTERPOLATION_LANCZOS12 },
+    { "kaiser", RIF_IMAGE_INTERPOLATION_KAISER },
+    { "blackman", RIF_IMAGE_INTERPOLATION_BLACKMAN },
+    { "gauss", RIF_IMAGE_INTERPOLATION_GAUSS },
+    { "box", RIF_IMAGE_INTERPOLATION_BOX },
+    { "tent", RIF_IMAGE_INTERPOLATION_TENT },
+    { "bell", RIF_IMAGE_INTERPOLATION_BELL },
+    { "bspline", RIF_IMAGE_INTERPOLATION_BSPLINE },
+    { "quadratic interp", RIF_IMAGE_INTERPOLATION_QUADRATIC_INTERP },
+    { "quadratic approx", RIF_IMAGE_INTERPOLATION_QUADRATIC_APPROX },
+    { "quadratic mix", RIF_IMAGE_INTERPOLATION_QUADRATIC_MIX },
+    { "mitchell", RIF_IMAGE_INTERPOLATION_MITCHELL },
+    { "catmull", RIF_IMAGE_INTERPOLATION_CATMULL },
+};
+
+// weights of one output recomputed from the kernel, indices clamped to the image
+std::vector<std::pair<long, double>> ReferenceResampleTaps(rif_uint interpolation, size_t in, size_t out, size_t i)
+{
+    const double ratio = double(in) / double(out);
+    const double center = (i + 0.5) * ratio - 0.5;
+    std::vector<std::pair<long, double>> taps;
+    if (interpolation == RIF_IMAGE_INTERPOLATION_NEAREST)
+    {
+        taps.emplace_back(std::min<long>(long(in) - 1, long(std::floor(center + 0.5))), 1.0);
+        return taps;
+    }
+    const double support = CpuBackend::detail::ResampleSupport(interpolation) * std::max(1.0, ratio);
+    double sum = 0.0;
+    for (long j = long(std::floor(center - support)) - 1; j <= long(std::ceil(center + support)) + 1; ++j)
+    {
+        // the same exact distance as the tables, so taps on the support edge agree
+        const double w = CpuBackend::detail::ResampleKernel(interpolation, CpuBackend::detail::ResampleDistance(in, out, i, j));
+        if (w != 0.0)
+        {
+            taps.emplace_back(std::min(std::max(j, 0L), long(in) - 1), w);
+            sum += w;
+        }
+    }
+    for (auto& tap : taps)
+    {
+        tap.second /= sum;
+    }
+    return taps;
+}
+
+CpuBackend::FloatImage ReferenceResample(const CpuBackend::FloatImage& src, size_t width, size_t height, rif_uint interpolation)
+{
+    CpuBackend::FloatImage dst(width, height);
+    std::vector<std::vector<std::pair<long, double>>> columns(width);
+    for (size_t x = 0; x < width; ++x)
+    {
+        columns[x] = ReferenceResampleTaps(interpolation, src.Width(), width, x);
+    }
+    for (size_t y = 0; y < height; ++y)
+    {
+        const std::vector<std::pair<long, double>> rows = ReferenceResampleTaps(interpolation, src.Height(), height, y);
+        for (size_t x = 0; x < width; ++x)
+        {
+            double sum[4] = {};
+            for (const auto& row : rows)
+            {
+                for (const auto& column : columns[x])
+                {
+                    const float* p = src.Row(row.first) + 4 * column.first;
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        sum[c] += row.second * column.second * p[c];
+                    }
+                }
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                dst.Row(y)[4 * x + c] = static_cast<float>(sum[c]);
+            }
+        }
+    }
+    return dst;
+}
+
+bool TestResample(CpuBackend::ThreadPool& pool, const Options&)
+{
+    std::cout << "Polyphase resampling vs per pixel weights (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+
+    bool pass = true;
+    const CpuBackend::FloatImage src = MakeTestImage(97, 53);
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(src, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    // odd ratios both ways, and an exact halving with a single phase
+    const size_t sizes[][2] = { { 151, 79 }, { 40, 23 }, { 48, 26 } };
+    for (const auto& entry : ResampleKernels)
+    {
+        float worst = 0.0f;
+        CpuBackend::ResamplePlan plan;
+        for (const auto& size : sizes)
+        {
+            std::unique_ptr<CpuBackend::Image> output = MakeImage(size[0], size[1], 4, RIF_COMPONENT_TYPE_FLOAT32);
+            CpuBackend::Resample(pool, *input, *output, entry.interpolation, &plan);
+            CpuBackend::FloatImage result;
+            result.Load(pool, *output);
+            worst = std::max(worst, MaxAbsDifference(result, ReferenceResample(src, size[0], size[1], entry.interpolation)));
+        }
+        pass &= Report(entry.name, worst, 2e-5f);
+    }
+
+    // converted a row at a time: float16 in, uint8 out, and uint8 in, float16 out
+    const rif_uint interpolation = RIF_IMAGE_INTERPOLATION_LANCZOS3;
+    for (int i = 0; i < 2; ++i)
+    {
+        const rif_component_type from = i == 0 ? RIF_COMPONENT_TYPE_FLOAT16 : RIF_COMPONENT_TYPE_UINT8;
+        const rif_component_type to = i == 0 ? RIF_COMPONENT_TYPE_UINT8 : RIF_COMPONENT_TYPE_FLOAT16;
+        const std::unique_ptr<CpuBackend::Image> narrow = ToImage(src, 4, from);
+        CpuBackend::FloatImage loaded;
+        loaded.Load(pool, *narrow);
+        std::unique_ptr<CpuBackend::Image> output = MakeImage(151, 79, 4, to);
+        CpuBackend::Resample(pool, *narrow, *output, interpolation);
+        CpuBackend::FloatImage expected = ReferenceResample(loaded, 151, 79, interpolation);
+        CpuBackend::FloatImage result;
+        result.Load(pool, *output);
+        float worst = 0.0f;
+        for (size_t y = 0; y < expected.Height(); ++y)
+        {
+            for (size_t k = 0; k < expected.Width() * 4; ++k)
+            {
+                float e = expected.Row(y)[k];
+                if (to == RIF_COMPONENT_TYPE_UINT8)
+                {
+                    // in units of 1/255 against the rounded reference
+                    e = std::floor(std::min(std::max(e, 0.0f), 1.0f) * 255.0f + 0.5f) / 255.0f;
+                    worst = std::max(worst, std::fabs(result.Row(y)[k] - e) * 255.0f);
+                }
+                else
+                {
+                    worst = std::max(worst, std::fabs(result.Row(y)[k] - e));
+                }
+            }
+        }
+        pass &= Report(i == 0 ? "lanczos3 float16 to uint8 (levels)" : "lanczos3 uint8 to float16", worst, i == 0 ? 1.0f : 1e-3f);
+    }
+    return pass;
+}
+
+void BenchmarkResample(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const std::unique_ptr<CpuBackend::Image> uhd = ToImage(MakeTestImage(3840, 2160), 4, RIF_COMPONENT_TYPE_UINT8);
+    const std::unique_ptr<CpuBackend::Image> hd = ToImage(MakeTestImage(1920, 1080), 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> toHd = MakeImage(1920, 1080, 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> toUhd = MakeImage(3840, 2160, 4, RIF_COMPONENT_TYPE_UINT8);
+
+    std::cout << "Resampling uint8 RGBA, " << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ", "
+        << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  kernel              taps  4K to 1080p ms   taps  1080p to 4K ms" << std::endl;
+    for (const auto& entry : ResampleKernels)
+    {
+        // tables built once, as a filter reused on the same sizes would
+        CpuBackend::ResamplePlan down;
+        CpuBackend::ResamplePlan up;
+        const double downMs = TimeMs(options.repeat, [&]() { CpuBackend::Resample(pool, *uhd, *toHd, entry.interpolation, &down); });
+        const double upMs = TimeMs(options.repeat, [&]() { CpuBackend::Resample(pool, *hd, *toUhd, entry.interpolation, &up); });
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(18) << entry.name << std::right
+            << std::setw(6) << down.horizontal.taps << std::setw(16) << downMs << std::setw(7) << up.horizontal.taps
+            << std::setw(16) << upMs << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// Orientation
+//
+
+const struct
+{
+    const char* name;
+    CpuBackend::Orientation orientation;
+} Orientations[] =
+{
+    { "identity", CpuBackend::Orientation::Identity },
+    { "flip horizontal", CpuBackend::Orientation::FlipHorizontal },
+    { "flip vertical", CpuBackend::Orientation::FlipVertical },
+    { "rotate 180", CpuBackend::Orientation::Rotate180 },
+    { "transpose", CpuBackend::Orientation::Transpose },
+    { "rotate 90", CpuBackend::Orientation::Rotate90 },
+    { "rotate 270", CpuBackend::Orientation::Rotate270 },
+    { "transverse", CpuBackend::Orientation::Transverse },
+};
+
+// the source of destination pixel (x, y) in a width x height source
+void ReferenceSourcePixel(CpuBackend::Orientation orientation, size_t x, size_t y, size_t width, size_t height, size_t* sx, size_t* sy)
+{
+    using CpuBackend::Orientation;
+    switch (orientation)
+    {
+    case Orientation::FlipHorizontal: *sx = width - 1 - x; *sy = y; break;
+    case Orientation::FlipVertical: *sx = x; *sy = height - 1 - y; break;
+    case Orientation::Rotate180: *sx = width - 1 - x; *sy = height - 1 - y; break;
+    case Orientation::Transpose: *sx = y; *sy = x; break;
+    case Orientation::Rotate90: *sx = y; *sy = height - 1 - x; break;
+    case Orientation::Rotate270: *sx = width - 1 - y; *sy = x; break;
+    case Orientation::Transverse: *sx = width - 1 - y; *sy = height - 1 - x; break;
+    default: *sx = x; *sy = y; break;
+    }
+}
+
+std::unique_ptr<CpuBackend::Image> MakeRandomImage(size_t width, size_t height, rif_uint components, rif_component_type type, unsigned seed)
+{
+    std::unique_ptr<CpuBackend::Image> image = MakeImage(width, height, components, type);
+    std::mt19937 random(seed);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t i = 0; i < width * image->PixelSize(); ++i)
+        {
+            image->Row(y)[i] = static_cast<rif_uchar>(random());
+        }
+    }
+    return image;
+}
+
+// pixels whose bytes differ from the reference
+float OrientationMismatches(const CpuBackend::Image& source, const CpuBackend::Image& result, CpuBackend::Orientation orientation)
+{
+    const size_t pixelSize = source.PixelSize();
+    size_t mismatches = 0;
+    for (size_t y = 0; y < result.Height(); ++y)
+    {
+        for (size_t x = 0; x < result.Width(); ++x)
+        {
+            size_t sx, sy;
+            ReferenceSourcePixel(orientation, x, y, source.Width(), source.Height(), &sx, &sy);
+            mismatches += memcmp(result.Row(y) + x * pixelSize, source.Row(sy) + sx * pixelSize, pixelSize) != 0;
+        }
+    }
+    return static_cast<float>(mismatches);
+}
+
+bool TestOrientation(CpuBackend::ThreadPool& pool, const Options&)
+{
+    using CpuBackend::simd::Level;
+    std::cout << "Orientation vs per pixel reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+
+    bool pass = true;
+    for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+    {
+        for (const auto& entry : Orientations)
+        {
+            const bool swaps = CpuBackend::OrientationSwapsAxes(entry.orientation);
+            float mismatches = 0.0f;
+            // every pixel size, odd sizes that end inside tiles and 4 x 4 blocks
+            for (rif_component_type type : { RIF_COMPONENT_TYPE_UINT8, RIF_COMPONENT_TYPE_FLOAT16, RIF_COMPONENT_TYPE_FLOAT32 })
+            {
+                for (rif_uint components = 1; components <= 4; ++components)
+                {
+                    const std::unique_ptr<CpuBackend::Image> source = MakeRandomImage(77, 45, components, type, components);
+                    std::unique_ptr<CpuBackend::Image> result = MakeImage(swaps ? 45 : 77, swaps ? 77 : 45, components, type);
+                    CpuBackend::Orient(pool, *source, *result, entry.orientation, level);
+                    mismatches += OrientationMismatches(*source, *result, entry.orientation);
+
+                    // in place; only square images can swap their axes
+                    for (size_t size : { size_t(67), size_t(128) })
+                    {
+                        const std::unique_ptr<CpuBackend::Image> square = MakeRandomImage(size, swaps ? size : size + 3, components, type, 7);
+                        std::unique_ptr<CpuBackend::Image> copy = MakeImage(square->Width(), square->Height(), components, type);
+                        for (size_t y = 0; y < square->Height(); ++y)
+                        {
+                            memcpy(copy->Row(y), square->Row(y), square->Width() * square->PixelSize());
+                        }
+                        CpuBackend::Orient(pool, *copy, *copy, entry.orientation, level);
+                        mismatches += OrientationMismatches(*square, *copy, entry.orientation);
+                    }
+                }
+            }
+            pass &= Report(std::string(entry.name) + (level == Level::Scalar ? ", scalar" : ""), mismatches, 0.0f);
+        }
+    }
+
+    // the filters, with a format conversion on the way for the flips
+    const CpuBackend::FloatImage src = MakeTestImage(77, 45);
+    const std::unique_ptr<CpuBackend::Image> bytes = ToImage(src, 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> floats = MakeImage(77, 45, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    CpuBackend::FlipFilter flip(RIF_IMAGE_FILTER_FLIP_HOR);
+    flip.Execute(pool, *bytes, *floats);
+    CpuBackend::FloatImage expected;
+    expected.Load(pool, *bytes);
+    CpuBackend::FloatImage flipped;
+    flipped.Load(pool, *floats);
+    float error = 0.0f;
+    for (size_t y = 0; y < 45; ++y)
+    {
+        for (size_t x = 0; x < 77; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                error = std::max(error, std::fabs(flipped.Row(y)[4 * x + c] - expected.Row(y)[4 * (76 - x) + c]));
+            }
+        }
+    }
+    pass &= Report("flip horizontal, uint8 to float32", error, 0.0f);
+
+    CpuBackend::RotateFilter rotate;
+    rotate.SetParameter1f("angle", -90.0f);
+    std::unique_ptr<CpuBackend::Image> rotated = MakeImage(45, 77, 4, RIF_COMPONENT_TYPE_UINT8);
+    const bool status = rotate.Execute(pool, *bytes, *rotated) == RIF_SUCCESS;
+    pass &= Report("rotate filter, -90 degrees", status ? OrientationMismatches(*bytes, *rotated, CpuBackend::Orientation::Rotate270) : 1.0f, 0.0f);
+    return pass;
+}
+
+void BenchmarkOrientation(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::Orientation;
+    const size_t width = 3840;
+    const size_t height = 2160;
+    std::cout << "Orientation " << width << "x" << height << ", " << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel())
+        << ", " << pool.ThreadCount() << " threads; GB/s counts bytes read and written" << std::endl;
+    std::cout << "  format    operation                ms      GB/s   of memcpy" << std::endl;
+    for (int f = 0; f < 2; ++f)
+    {
+        const rif_component_type type = f == 0 ? RIF_COMPONENT_TYPE_UINT8 : RIF_COMPONENT_TYPE_FLOAT32;
+        const char* format = f == 0 ? "rgba8" : "rgba32f";
+        const std::unique_ptr<CpuBackend::Image> source = MakeRandomImage(width, height, 4, type, 1);
+        std::unique_ptr<CpuBackend::Image> same = MakeImage(width, height, 4, type);
+        std::unique_ptr<CpuBackend::Image> swapped = MakeImage(height, width, 4, type);
+        std::unique_ptr<CpuBackend::Image> square = MakeRandomImage(height, height, 4, type, 2);
+        const double bytes = 2.0 * width * height * source->PixelSize();
+
+        const double copyMs = TimeMs(options.repeat, [&]() { memcpy(same->Row(0), source->Row(0), source->SizeInBytes()); });
+        auto print = [&](const std::string& name, double ms, double traffic)
+        {
+            std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(10) << format << std::setw(20)
+                << name << std::right << std::setw(8) << ms << std::setw(10) << traffic / (ms * 1e6) << std::setw(11)
+                << std::setprecision(0) << 100.0 * (traffic / ms) / (bytes / copyMs) << "%" << std::defaultfloat << std::endl;
+        };
+        print("memcpy", copyMs, bytes);
+
+        for (const auto& entry : Orientations)
+        {
+            CpuBackend::Image& output = CpuBackend::OrientationSwapsAxes(entry.orientation) ? *swapped : *same;
+            print(entry.name, TimeMs(options.repeat, [&]() { CpuBackend::Orient(pool, *source, output, entry.orientation); }), bytes);
+        }
+        print("rotate 90, scalar", TimeMs(options.repeat, [&]()
+        {
+            CpuBackend::Orient(pool, *source, *swapped, Orientation::Rotate90, CpuBackend::simd::Level::Scalar);
+        }), bytes);
+
+        // in place on a square image; the rotation is a transpose plus a flip
+        const double squareBytes = 2.0 * height * height * square->PixelSize();
+        print("flip vertical, in place", TimeMs(options.repeat, [&]() { CpuBackend::Orient(pool, *square, *square, Orientation::FlipVertical); }), squareBytes);
+        print("rotate 90, in place", TimeMs(options.repeat, [&]() { CpuBackend::Orient(pool, *square, *square, Orientation::Rotate90); }), squareBytes);
+    }
+}
+
+//
+// Morphology
+//
+
+// the offsets of the element the passes of 'settings' add up to
+std::vector<std::pair<long, long>> ReferenceElement(const CpuBackend::MorphologySettings& settings)
+{
+    std::vector<std::pair<long, long>> element(1, std::make_pair(0L, 0L));
+    for (const CpuBackend::MorphologyPass& pass : CpuBackend::MorphologyPasses(settings))
+    {
+        std::vector<std::pair<long, long>> sum;
+        for (const auto& offset : element)
+        {
+            for (long k = -pass.radius; k <= pass.radius; ++k)
+            {
+                sum.push_back(std::make_pair(offset.first + k * pass.dx, offset.second + k * pass.dy));
+            }
+        }
+        std::sort(sum.begin(), sum.end());
+        sum.erase(std::unique(sum.begin(), sum.end()), sum.end());
+        element.swap(sum);
+    }
+    return element;
+}
+
+// maximum or minimum over the element, pixels outside the image left out
+CpuBackend::FloatImage ReferenceMorphology(const CpuBackend::FloatImage& src, const CpuBackend::MorphologySettings& settings)
+{
+    const long width = static_cast<long>(src.Width());
+    const long height = static_cast<long>(src.Height());
+    const bool dilate = settings.operation == CpuBackend::MorphologyOperation::Dilate;
+    const std::vector<std::pair<long, long>> element = ReferenceElement(settings);
+    CpuBackend::FloatImage dst(width, height);
+    for (long y = 0; y < height; ++y)
+    {
+        for (long x = 0; x < width; ++x)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                float value = src.Row(y)[4 * x + c];
+                for (const auto& offset : element)
+                {
+                    const long sx = x + offset.first;
+                    const long sy = y + offset.second;
+                    if (sx >= 0 && sx < width && sy >= 0 && sy < height)
+                    {
+                        const float v = src.Row(sy)[4 * sx + c];
+                        value = dilate ? std::max(value, v) : std::min(value, v);
+                    }
+                }
+                dst.Row(y)[4 * x + c] = value;
+            }
+        }
+    }
+    return dst;
+}
+
+// pixels in only one of the element and the Euclidean disk, over the disk's area
+float DiskMismatch(long radius)
+{
+    CpuBackend::MorphologySettings settings;
+    settings.shape = CpuBackend::MorphologyShape::Disk;
+    settings.radiusX = radius;
+    const std::vector<std::pair<long, long>> element = ReferenceElement(settings);
+    long area = 0;
+    long inside = 0;
+    for (long y = -radius; y <= radius; ++y)
+    {
+        for (long x = -radius; x <= radius; ++x)
+        {
+            area += x * x + y * y <= radius * radius + radius;
+        }
+    }
+    for (const auto& offset : element)
+    {
+        inside += offset.first * offset.first + offset.second * offset.second <= radius * radius + radius;
+    }
+    return float(area - inside + long(element.size()) - inside) / float(area);
+}
+
+bool TestMorphology(CpuBackend::ThreadPool& pool, const Options&)
+{
+    using CpuBackend::MorphologyShape;
+    using CpuBackend::simd::Level;
+    std::cout << "van Herk / Gil-Werman morphology vs brute force (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    const CpuBackend::FloatImage source = MakeTestImage(61, 37);
+
+    const struct
+    {
+        MorphologyShape shape;
+        long radiusX;
+        long radiusY;
+    } cases[] =
+    {
+        { MorphologyShape::Rectangle, 1, 1 },
+        { MorphologyShape::Rectangle, 3, 2 },
+        { MorphologyShape::Rectangle, 0, 5 },
+        { MorphologyShape::Rectangle, 70, 1 },
+        { MorphologyShape::Disk, 1, 0 },
+        { MorphologyShape::Disk, 2, 0 },
+        { MorphologyShape::Disk, 3, 0 },
+        { MorphologyShape::Disk, 6, 0 },
+        { MorphologyShape::Disk, 11, 0 },
+        { MorphologyShape::Disk, 40, 0 },
+    };
+
+    bool pass = true;
+    for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+    {
+        for (CpuBackend::MorphologyOperation operation : { CpuBackend::MorphologyOperation::Dilate, CpuBackend::MorphologyOperation::Erode })
+        {
+            for (const auto& entry : cases)
+            {
+                CpuBackend::MorphologySettings settings;
+                settings.operation = operation;
+                settings.shape = entry.shape;
+                settings.radiusX = entry.radiusX;
+                settings.radiusY = entry.radiusY;
+                CpuBackend::FloatImage image = source;
+                CpuBackend::Morphology(pool, image, settings, level);
+                const bool disk = entry.shape == MorphologyShape::Disk;
+                const std::string name = std::string(operation == CpuBackend::MorphologyOperation::Dilate ? "dilate " : "erode ") +
+                    (disk ? "disk " + std::to_string(entry.radiusX) : std::to_string(entry.radiusX) + "x" + std::to_string(entry.radiusY)) +
+                    (level == Level::Scalar ? ", scalar" : "");
+                pass &= Report(name, MaxAbsDifference(image, ReferenceMorphology(source, settings)), 0.0f);
+            }
+        }
+    }
+
+    // the octagon against the disk it stands for
+    for (long radius : { 4L, 8L, 16L, 64L })
+    {
+        pass &= Report("disk " + std::to_string(radius) + " area mismatch", DiskMismatch(radius), 0.12f);
+    }
+
+    // the filter on 8-bit pixels, which come back unchanged in value
+    const std::unique_ptr<CpuBackend::Image> bytes = ToImage(source, 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> eroded = MakeImage(61, 37, 4, RIF_COMPONENT_TYPE_UINT8);
+    CpuBackend::DilateErodeFilter filter;
+    filter.SetParameter1u("mode", RIF_ERODE);
+    filter.SetParameter1u("radius", 5);
+    filter.SetParameter1u("shape", 1);
+    filter.Execute(pool, *bytes, *eroded);
+    CpuBackend::FloatImage expected;
+    expected.Load(pool, *bytes);
+    CpuBackend::MorphologySettings settings;
+    settings.operation = CpuBackend::MorphologyOperation::Erode;
+    settings.shape = MorphologyShape::Disk;
+    settings.radiusX = 5;
+    expected = ReferenceMorphology(expected, settings);
+    CpuBackend::FloatImage result;
+    result.Load(pool, *eroded);
+    pass &= Report("filter, uint8 erode disk 5", MaxAbsDifference(result, expected), 0.0f);
+    return pass;
+}
+
+// direct maximum over 2 * radius + 1 taps per pass, the cost the running maximum removes
+void DirectDilate(CpuBackend::ThreadPool& pool, const CpuBackend::FloatImage& src, CpuBackend::FloatImage& dst, long radius)
+{
+    const long width = static_cast<long>(src.Width());
+    const long height = static_cast<long>(src.Height());
+    CpuBackend::FloatImage horizontal(width, height);
+    dst.Resize(width, height);
+    pool.ParallelForRows(height, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; ++y)
+        {
+            for (long i = 0; i < 4 * width; ++i)
+            {
+                float value = src.Row(y)[i];
+                for (long k = std::max(-radius, -(i / 4)); k <= radius && i / 4 + k < width; ++k)
+                {
+                    value = std::max(value, src.Row(y)[i + 4 * k]);
+                }
+                horizontal.Row(y)[i] = value;
+            }
+        }
+    });
+    pool.ParallelForRows(height, [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; ++y)
+        {
+            for (long i = 0; i < 4 * width; ++i)
+            {
+                float value = horizontal.Row(y)[i];
+                for (long k = std::max(-radius, -long(y)); k <= radius && long(y) + k < height; ++k)
+                {
+                    value = std::max(value, horizontal.Row(y + k)[i]);
+                }
+                dst.Row(y)[i] = value;
+            }
+        }
+    });
+}
+
+void BenchmarkMorphology(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::MorphologyShape;
+    const CpuBackend::FloatImage source = MakeTestImage(options.width, options.height);
+    std::cout << "Morphology " << options.width << "x" << options.height << " rgba32f, " << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel())
+        << ", " << pool.ThreadCount() << " threads" << std::endl;
+    std::cout << "  radius   square ns/px   scalar ns/px   disk ns/px   direct ns/px" << std::endl;
+    const double pixels = double(options.width) * options.height;
+    CpuBackend::FloatImage image;
+    CpuBackend::FloatImage direct;
+    for (long radius : { 1L, 2L, 4L, 8L, 16L, 32L, 64L })
+    {
+        CpuBackend::MorphologySettings settings;
+        settings.radiusX = radius;
+        settings.radiusY = radius;
+        auto time = [&](MorphologyShape shape, CpuBackend::simd::Level level)
+        {
+            settings.shape = shape;
+            // the copy is part of every run; it is one pass of plain streaming
+            return TimeMs(options.repeat, [&]() { image = source; CpuBackend::Morphology(pool, image, settings, level); });
+        };
+        const double squareMs = time(MorphologyShape::Rectangle, CpuBackend::simd::CurrentLevel());
+        const double scalarMs = time(MorphologyShape::Rectangle, CpuBackend::simd::Level::Scalar);
+        const double diskMs = time(MorphologyShape::Disk, CpuBackend::simd::CurrentLevel());
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(6) << radius << std::setw(15) << squareMs * 1e6 / pixels
+            << std::setw(15) << scalarMs * 1e6 / pixels << std::setw(13) << diskMs * 1e6 / pixels;
+        // linear in the radius, only run while it stays reasonable
+        if (radius <= 8)
+        {
+            const double directMs = TimeMs(1, [&]() { DirectDilate(pool, source, direct, radius); });
+            std::cout << std::setw(15) << directMs * 1e6 / pixels;
+        }
+        else
+        {
+            std::cout << std::setw(15) << "-";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+//
+// Expression
+//
+
+const struct
+{
+    const char* text;
+    std::function<float(const float* v, const float* k)> reference;
+} ExpressionCases[] =
+{
+    { "a", [](const float* v, const float*) { return v[0]; } },
+    { "a + b", [](const float* v, const float*) { return v[0] + v[1]; } },
+    { "a*k0 + max(b, c)/d", [](const float* v, const float* k)
+        { return v[0] * k[0] + (v[3] != 0.0f ? std::max(v[1], v[2]) / v[3] : 0.0f); } },
+    { "-(a - b) * 2.5", [](const float* v, const float*) { return (0.0f - (v[0] - v[1])) * 2.5f; } },
+    { "clamp(a * 3 - 1, 0, 1)", [](const float* v, const float*) { return std::min(std::max(v[0] * 3.0f - 1.0f, 0.0f), 1.0f); } },
+    { "sqrt(abs(b - c)) + min(a, k1)", [](const float* v, const float* k) { return std::sqrt(std::fabs(v[1] - v[2])) + std::min(v[0], k[1]); } },
+    { "(1 + 2) * a / -4", [](const float* v, const float*) { return 3.0f * v[0] / -4.0f; } },
+    { "a / (b - b)", [](const float*, const float*) { return 0.0f; } },
+    { "min(max(a * b + c, d) / e - f, g) * h", [](const float* v, const float*)
+        { return std::min((v[4] != 0.0f ? std::max(v[0] * v[1] + v[2], v[3]) / v[4] : 0.0f) - v[5], v[6]) * v[7]; } },
+};
+
+std::vector<std::unique_ptr<CpuBackend::Image>> MakeExpressionImages(size_t width, size_t height, rif_component_type type)
+{
+    std::vector<std::unique_ptr<CpuBackend::Image>> images;
+    for (unsigned i = 0; i < CpuBackend::ExpressionMaxImages; ++i)
+    {
+        images.push_back(ToImage(MakeTestImage(width, height, i + 1), 4, type));
+    }
+    return images;
+}
+
+// the same expression as one filter per operation, each one a full pass over memory
+void ChainedExpression(CpuBackend::ThreadPool& pool, const std::vector<std::unique_ptr<CpuBackend::Image>>& images,
+    const std::vector<std::pair<rif_image_filter_type, size_t>>& chain, CpuBackend::Image& scratch, CpuBackend::Image& output)
+{
+    // ping-pong so the last filter writes 'output'
+    CpuBackend::Image* targets[2] = { chain.size() % 2 ? &output : &scratch, chain.size() % 2 ? &scratch : &output };
+    const CpuBackend::Image* current = images[0].get();
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+        CpuBackend::ArithmeticFilter filter(chain[i].first);
+        filter.SetParameterImage("srcImg", images[chain[i].second].get());
+        filter.Execute(pool, *current, *targets[i % 2]);
+        current = targets[i % 2];
+    }
+}
+
+bool TestExpression(CpuBackend::ThreadPool& pool, const Options&)
+{
+    using CpuBackend::simd::Level;
+    std::cout << "Fused expressions vs per pixel reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    // wider than one block with a partial one at the end
+    const size_t width = 157;
+    const size_t height = 23;
+    const std::vector<std::unique_ptr<CpuBackend::Image>> images = MakeExpressionImages(width, height, RIF_COMPONENT_TYPE_FLOAT32);
+    std::vector<const CpuBackend::Image*> inputs;
+    for (const auto& image : images)
+    {
+        inputs.push_back(image.get());
+    }
+    const std::vector<float> scalars = { 0.75f, 0.25f };
+    std::unique_ptr<CpuBackend::Image> output = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+
+    bool pass = true;
+    for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+    {
+        for (const auto& entry : ExpressionCases)
+        {
+            CpuBackend::ExpressionProgram program;
+            float error = CpuBackend::CompileExpression(entry.text, program) ? 0.0f : 1.0f;
+            error += CpuBackend::EvaluateExpression(pool, program, inputs.data(), inputs.size(), scalars, *output, level) == RIF_SUCCESS ? 0.0f : 1.0f;
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t i = 0; i < width * 4; ++i)
+                {
+                    float v[CpuBackend::ExpressionMaxImages];
+                    for (size_t n = 0; n < images.size(); ++n)
+                    {
+                        v[n] = images[n]->RowAs<float>(y)[i];
+                    }
+                    error = std::max(error, std::fabs(output->RowAs<float>(y)[i] - entry.reference(v, scalars.data())));
+                }
+            }
+            pass &= Report(std::string(entry.text) + (level == Level::Scalar ? ", scalar" : ""), error, 0.0f);
+        }
+    }
+
+    // the filter against the chain it replaces
+    std::unique_ptr<CpuBackend::Image> scratch = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> chained = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    ChainedExpression(pool, images, { { RIF_IMAGE_FILTER_MUL, 1 }, { RIF_IMAGE_FILTER_ADD, 2 }, { RIF_IMAGE_FILTER_MAX, 3 },
+        { RIF_IMAGE_FILTER_DIV, 4 } }, *scratch, *chained);
+    CpuBackend::ExpressionFilter filter;
+    std::vector<CpuBackend::Image*> others;
+    for (size_t i = 1; i < images.size(); ++i)
+    {
+        others.push_back(images[i].get());
+    }
+    filter.SetParameterString("expression", "max(a * b + c, d) / e");
+    filter.SetParameterImageArray("inputs", others.data(), rif_uint(others.size()));
+    const bool status = filter.Execute(pool, *images[0], *output) == RIF_SUCCESS;
+    pass &= Report("filter vs MUL, ADD, MAX, DIV chain", status ? MaxAbsDifference(*output, *chained) : 1.0f, 0.0f);
+
+    // malformed text and operands that are not there
+    float accepted = 0.0f;
+    for (const char* text : { "a +", "max(a)", "max(a, b", "a b", "z", "k", "sqrt", "k2", "" })
+    {
+        CpuBackend::ExpressionProgram program;
+        accepted += CpuBackend::CompileExpression(text, program) &&
+            CpuBackend::EvaluateExpression(pool, program, inputs.data(), 2, scalars, *output) == RIF_SUCCESS;
+    }
+    CpuBackend::ExpressionProgram program;
+    CpuBackend::CompileExpression("c", program);
+    accepted += CpuBackend::EvaluateExpression(pool, program, inputs.data(), 2, scalars, *output) == RIF_SUCCESS;
+    pass &= Report("invalid expressions accepted", accepted, 0.0f);
+    return pass;
+}
+
+void BenchmarkExpression(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const struct
+    {
+        const char* text;
+        std::vector<std::pair<rif_image_filter_type, size_t>> chain;
+    } cases[] =
+    {
+        { "max(a * b + c, d) / e", { { RIF_IMAGE_FILTER_MUL, 1 }, { RIF_IMAGE_FILTER_ADD, 2 }, { RIF_IMAGE_FILTER_MAX, 3 },
+            { RIF_IMAGE_FILTER_DIV, 4 } } },
+        { "min(max(a * b + c, d) / e - f, g) * h", { { RIF_IMAGE_FILTER_MUL, 1 }, { RIF_IMAGE_FILTER_ADD, 2 }, { RIF_IMAGE_FILTER_MAX, 3 },
+            { RIF_IMAGE_FILTER_DIV, 4 }, { RIF_IMAGE_FILTER_SUB, 5 }, { RIF_IMAGE_FILTER_MIN, 6 }, { RIF_IMAGE_FILTER_MUL, 7 } } },
+    };
+
+    std::cout << "Expression " << options.width << "x" << options.height << ", " << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel())
+        << ", " << pool.ThreadCount() << " threads; MB counts image reads and writes" << std::endl;
+    std::cout << "  format   filters   chained ms   chained MB   fused ms   fused MB   traffic   speedup" << std::endl;
+    for (rif_component_type type : { RIF_COMPONENT_TYPE_UINT8, RIF_COMPONENT_TYPE_FLOAT32 })
+    {
+        const std::vector<std::unique_ptr<CpuBackend::Image>> images = MakeExpressionImages(options.width, options.height, type);
+        std::vector<CpuBackend::Image*> others;
+        for (size_t i = 1; i < images.size(); ++i)
+        {
+            others.push_back(images[i].get());
+        }
+        std::unique_ptr<CpuBackend::Image> scratch = MakeImage(options.width, options.height, 4, type);
+        std::unique_ptr<CpuBackend::Image> output = MakeImage(options.width, options.height, 4, type);
+        const double imageMb = double(options.width) * options.height * images[0]->PixelSize() / 1e6;
+
+        for (const auto& entry : cases)
+        {
+            CpuBackend::ExpressionFilter filter;
+            filter.SetParameterString("expression", entry.text);
+            filter.SetParameterImageArray("inputs", others.data(), rif_uint(others.size()));
+            const double chainedMs = TimeMs(options.repeat, [&]() { ChainedExpression(pool, images, entry.chain, *scratch, *output); });
+            const double fusedMs = TimeMs(options.repeat, [&]() { filter.Execute(pool, *images[0], *output); });
+            // every chained filter reads two images and writes one; the fused pass reads
+            // each image once and writes the output
+            const double chainedMb = 3.0 * entry.chain.size() * imageMb;
+            const double fusedMb = (entry.chain.size() + 2.0) * imageMb;
+            std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(9)
+                << (type == RIF_COMPONENT_TYPE_UINT8 ? "rgba8" : "rgba32f") << std::right << std::setw(7) << entry.chain.size()
+                << std::setw(13) << chainedMs << std::setw(13) << chainedMb << std::setw(11) << fusedMs << std::setw(11) << fusedMb
+                << std::setw(9) << chainedMb / fusedMb << "x" << std::setw(9) << chainedMs / fusedMs << "x" << std::defaultfloat << std::endl;
+        }
+    }
+}
+
+//
+// User defined kernels
+//
+
+// what every kernel below starts with: the pixel, the size and the input value
+const std::string UserPrologue =
+    "int2 coord;\n"
+    "int2 size = GET_BUFFER_SIZE(outputImage);\n"
+    "GET_COORD_OR_RETURN(coord, size);\n"
+    "vec4 p = ReadPixelTyped(inputImage, coord.x, coord.y);\n";
+
+const std::string UserVignette = UserPrologue +
+    "vec2 dxy = convert_vec2(coord) / convert_vec2(size) - (vec2)0.5f;\n"
+    "p = mix(1.0f, p, exp(-dot(dxy, dxy) * 5));\n"
+    "WritePixelTyped(outputImage, coord.x, coord.y, p);\n";
+
+void ReferenceVignette(const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+{
+    const float dx = float(x) / float(in.Width()) - 0.5f;
+    const float dy = float(y) / float(in.Height()) - 0.5f;
+    const float t = std::exp(-(dx * dx + dy * dy) * 5.0f);
+    for (int c = 0; c < 4; ++c)
+    {
+        out.Row(y)[x * 4 + c] = 1.0f + (in.Row(y)[x * 4 + c] - 1.0f) * t;
+    }
+}
+
+void SetReferencePixel(CpuBackend::FloatImage& out, long x, long y, float r, float g, float b, float a)
+{
+    float* pixel = out.Row(y) + x * 4;
+    pixel[0] = r;
+    pixel[1] = g;
+    pixel[2] = b;
+    pixel[3] = a;
+}
+
+const struct
+{
+    const char* name;
+    std::string code;
+    std::function<void(const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)> reference;
+    float tolerance;
+} UserCases[] =
+{
+    // exp is the polynomial approximation
+    { "UserDefined sample vignette", UserVignette, ReferenceVignette, 1e-5f },
+    { "divergent if / else if / else", UserPrologue +
+        "vec4 r;\n"
+        "if (p.x > 0.5f) { r = p * 2.0f; }\n"
+        "else if (p.y < 0.25f) { r.xy = p.yx; r.zw = (vec2)(1.0f, 0.0f); }\n"
+        "else r = (vec4)(0.0f);\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, r);\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            if (p[0] > 0.5f)
+            {
+                SetReferencePixel(out, x, y, p[0] * 2.0f, p[1] * 2.0f, p[2] * 2.0f, p[3] * 2.0f);
+            }
+            else if (p[1] < 0.25f)
+            {
+                SetReferencePixel(out, x, y, p[1], p[0], 1.0f, 0.0f);
+            }
+            else
+            {
+                SetReferencePixel(out, x, y, 0.0f, 0.0f, 0.0f, 0.0f);
+            }
+        }, 0.0f },
+    { "loops with per pixel trip counts", UserPrologue +
+        "float s = 0.0f;\n"
+        "int n = (coord.x + coord.y) % 7;\n"
+        "for (int i = 0; i < n; i++) { s += p.x * i; }\n"
+        "while (s > 1.0f) s -= 0.5f;\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, (vec4)(s, n, p.z, 1));\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            float s = 0.0f;
+            const long n = (x + y) % 7;
+            for (long i = 0; i < n; i++)
+            {
+                s += p[0] * float(i);
+            }
+            while (s > 1.0f)
+            {
+                s -= 0.5f;
+            }
+            SetReferencePixel(out, x, y, s, float(n), p[2], 1.0f);
+        }, 0.0f },
+    { "return inside branches and loops", UserPrologue +
+        "if (p.x < 0.3f) { WritePixelTyped(outputImage, coord.x, coord.y, (vec4)(1.0f, 0.0f, 0.0f, 1.0f)); return; }\n"
+        "for (int i = 0; i < 10; ++i) {\n"
+        "    if (i * 3 > coord.x) { WritePixelTyped(outputImage, coord.x, coord.y, (vec4)(i)); return; }\n"
+        "}\n"
+        "if (coord.y % 2 == 1) return;\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, p.zyxw);\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            if (p[0] < 0.3f)
+            {
+                SetReferencePixel(out, x, y, 1.0f, 0.0f, 0.0f, 1.0f);
+                return;
+            }
+            for (long i = 0; i < 10; ++i)
+            {
+                if (i * 3 > x)
+                {
+                    SetReferencePixel(out, x, y, float(i), float(i), float(i), float(i));
+                    return;
+                }
+            }
+            if (y % 2 == 1)
+            {
+                return;
+            }
+            SetReferencePixel(out, x, y, p[2], p[1], p[0], p[3]);
+        }, 0.0f },
+    { "ints, swizzles, ?:, compound assigns", UserPrologue +
+        "int a = coord.x / 3 - coord.y % 4, b = -coord.x / 4;\n"
+        "const int m = -coord.x % 3;\n"
+        "vec3 c = p.xyz;\n"
+        "c.zx *= 2.0f;\n"
+        "c.y += a > 0 && !(b < -20) ? 1.0f : -1.0f;\n"
+        "b--;\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, (vec4)(c, (float)(a + b * 10 + m * 100)));\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            const long a = x / 3 - y % 4;
+            long b = -x / 4;
+            const long m = -x % 3;
+            const float g = p[1] + (a > 0 && !(b < -20) ? 1.0f : -1.0f);
+            b--;
+            SetReferencePixel(out, x, y, p[0] * 2.0f, g, p[2] * 2.0f, float(a + b * 10 + m * 100));
+        }, 0.0f },
+    { "writes to other pixels", UserPrologue +
+        "WritePixelTyped(outputImage, size.x - 1 - coord.x, coord.y, p);\n"
+        "WritePixelTyped(outputImage, coord.x + size.x, coord.y, (vec4)(5.0f));\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            SetReferencePixel(out, long(in.Width()) - 1 - x, y, p[0], p[1], p[2], p[3]);
+        }, 0.0f },
+    // log and pow are approximations too
+    { "built-in functions", UserPrologue +
+        "float d = length(p.xy - (vec2)(0.5f)) + distance(p.xy, p.yz);\n"
+        "vec2 n = normalize((vec2)(p.x + 0.1f, p.y));\n"
+        "float e = clamp(p.z * 2.0f, 0.25f, 0.75f) + smoothstep(0.2f, 0.8f, p.x) + step(0.5f, p.y);\n"
+        "float f = fract(p.x * 7.0f) + floor(p.y * 5.0f) + ceil(p.z * 3.0f) + fabs(p.x - p.y);\n"
+        "float g = pow(p.x + 0.5f, 1.5f) + log(p.y + 1.0f) + sqrt(p.z) + sin(p.x) * cos(p.y);\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, (vec4)(d + n.x, e, f + min(n.y, 0.5f), max(g, 1.0f)));\n",
+        [](const CpuBackend::FloatImage& in, long x, long y, CpuBackend::FloatImage& out)
+        {
+            const float* p = in.Row(y) + x * 4;
+            const float d = std::sqrt((p[0] - 0.5f) * (p[0] - 0.5f) + (p[1] - 0.5f) * (p[1] - 0.5f)) +
+                std::sqrt((p[0] - p[1]) * (p[0] - p[1]) + (p[1] - p[2]) * (p[1] - p[2]));
+            const float length = std::sqrt((p[0] + 0.1f) * (p[0] + 0.1f) + p[1] * p[1]);
+            const float t = std::min(std::max((p[0] - 0.2f) / 0.6f, 0.0f), 1.0f);
+            const float e = std::min(std::max(p[2] * 2.0f, 0.25f), 0.75f) + t * t * (3.0f - 2.0f * t) + (p[1] < 0.5f ? 0.0f : 1.0f);
+            const float f = p[0] * 7.0f - std::floor(p[0] * 7.0f) + std::floor(p[1] * 5.0f) + std::ceil(p[2] * 3.0f) + std::fabs(p[0] - p[1]);
+            const float g = std::pow(p[0] + 0.5f, 1.5f) + std::log(p[1] + 1.0f) + std::sqrt(p[2]) + std::sin(p[0]) * std::cos(p[1]);
+            SetReferencePixel(out, x, y, d + (p[0] + 0.1f) / length, e, f + std::min(p[1] / length, 0.5f), std::max(g, 1.0f));
+        }, 2e-5f },
+};
+
+// the vignette in C++, through the same float conversions as the interpreter
+void NativeVignette(CpuBackend::ThreadPool& pool, const CpuBackend::Image& input, CpuBackend::Image& output)
+{
+    CpuBackend::FloatImage source;
+    CpuBackend::FloatImage target;
+    source.Load(pool, input);
+    target.Resize(output.Width(), output.Height());
+    pool.ParallelForRows(output.Height(), [&](size_t begin, size_t end)
+    {
+        for (size_t y = begin; y < end; ++y)
+        {
+            for (size_t x = 0; x < output.Width(); ++x)
+            {
+                ReferenceVignette(source, long(x), long(y), target);
+            }
+        }
+    });
+    target.Store(pool, output);
+}
+
+bool TestUserDefined(CpuBackend::ThreadPool& pool, const Options&)
+{
+    using CpuBackend::simd::Level;
+    std::cout << "User defined kernels vs C++ (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    // wider than one block of lanes with a partial one at the end
+    const size_t width = 157;
+    const size_t height = 23;
+    const CpuBackend::FloatImage source = MakeTestImage(width, height);
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(source, 4, RIF_COMPONENT_TYPE_FLOAT32);
+
+    bool pass = true;
+    for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+    {
+        for (const auto& entry : UserCases)
+        {
+            CpuBackend::FloatImage expected(width, height);
+            for (size_t y = 0; y < height; ++y)
+            {
+                std::fill(expected.Row(y), expected.Row(y) + width * 4, 0.0f);
+            }
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    entry.reference(source, long(x), long(y), expected);
+                }
+            }
+
+            // the output starts zero, so pixels the kernel leaves alone compare too
+            std::unique_ptr<CpuBackend::Image> output = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+            const auto kernel = CpuBackend::CompileUserKernel(entry.code);
+            float error = 1.0f;
+            if (CpuBackend::RunUserKernel(pool, *kernel, *input, *output, level) == RIF_SUCCESS)
+            {
+                CpuBackend::FloatImage result;
+                result.Load(pool, *output);
+                error = MaxAbsDifference(result, expected);
+            }
+            else
+            {
+                std::cout << "  " << kernel->error << std::endl;
+            }
+            pass &= Report(std::string(entry.name) + (level == Level::Scalar ? ", scalar" : ""), error, entry.tolerance);
+        }
+    }
+
+    // through the filter interface, and the cache handing back the same compiled kernel
+    std::unique_ptr<CpuBackend::Image> output = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    CpuBackend::UserDefinedFilter filter;
+    filter.SetParameterString("code", UserVignette);
+    float error = filter.Execute(pool, *input, *output) == RIF_SUCCESS ? 0.0f : 1.0f;
+    std::unique_ptr<CpuBackend::Image> direct = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    CpuBackend::RunUserKernel(pool, *CpuBackend::CompileUserKernel(UserVignette), *input, *direct);
+    error += MaxAbsDifference(*output, *direct);
+    error += CpuBackend::CompileUserKernel(UserVignette) == CpuBackend::CompileUserKernel(std::string(UserVignette)) ? 0.0f : 1.0f;
+    // the cache does not keep kernels nobody holds, failed ones included
+    const std::weak_ptr<const CpuBackend::UserKernel> released = CpuBackend::CompileUserKernel("int x = ;");
+    error += released.expired() ? 0.0f : 1.0f;
+    pass &= Report("filter and cached kernel", error, 0.0f);
+
+    // code outside the dialect is refused with a message
+    float accepted = 0.0f;
+    for (const char* code : { "int x = ;", "float y = 1.0f", "vec4 p = ReadPixelTyped(inputImage, 0);", "unknown(1);",
+        "int2 c; c.z = 1;", "for (;;) { break; }", "float a; float a;", "x = 1;", "int i = 1.5f % 2;", "{ int a = 1;", "float a = 1 @ 2;" })
+    {
+        const auto kernel = CpuBackend::CompileUserKernel(code);
+        accepted += kernel->valid || kernel->error.empty();
+    }
+    filter.SetParameterString("code", "WritePixelTyped(outputImage, 0, 0, ;");
+    accepted += filter.Execute(pool, *input, *output) != RIF_ERROR_INVALID_PARAMETER;
+    pass &= Report("invalid kernels accepted", accepted, 0.0f);
+    return pass;
+}
+
+void BenchmarkUserDefined(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::simd::Level;
+    std::cout << "User defined kernel " << options.width << "x" << options.height << ", " << pool.ThreadCount() << " threads" << std::endl;
+    const std::unique_ptr<CpuBackend::Image> input = ToImage(MakeTestImage(options.width, options.height), 4, RIF_COMPONENT_TYPE_UINT8);
+    std::unique_ptr<CpuBackend::Image> output = MakeImage(options.width, options.height, 4, RIF_COMPONENT_TYPE_UINT8);
+    const double pixels = double(options.width) * options.height;
+
+    std::cout << "  kernel        instructions   scalar ns/px   " << std::left << std::setw(8)
+        << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << std::right << " ns/px   C++ ns/px" << std::endl;
+    const auto vignette = CpuBackend::CompileUserKernel(UserVignette);
+    const double scalarMs = TimeMs(options.repeat, [&]() { CpuBackend::RunUserKernel(pool, *vignette, *input, *output, Level::Scalar); });
+    const double simdMs = TimeMs(options.repeat, [&]() { CpuBackend::RunUserKernel(pool, *vignette, *input, *output); });
+    const double nativeMs = TimeMs(options.repeat, [&]() { NativeVignette(pool, *input, *output); });
+    std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(14) << "vignette" << std::right
+        << std::setw(12) << vignette->code.size() << std::setw(15) << scalarMs * 1e6 / pixels << std::setw(15) << simdMs * 1e6 / pixels
+        << std::setw(12) << nativeMs * 1e6 / pixels << std::defaultfloat << std::endl;
+
+    // a source the cache has not seen, then the same source again while it is held
+    const std::string fresh = UserVignette + "// " + std::to_string(std::random_device()()) + "\n";
+    std::shared_ptr<const CpuBackend::UserKernel> held;
+    const double compileMs = TimeMs(1, [&]() { held = CpuBackend::CompileUserKernel(fresh); });
+    const double cachedMs = TimeMs(options.repeat, [&]() { CpuBackend::CompileUserKernel(fresh); });
+    std::cout << std::fixed << std::setprecision(2) << "  compile " << compileMs * 1e3 << " us, cached lookup " << cachedMs * 1e3
+        << " us" << std::defaultfloat << std::endl;
+}
+
+//
+// Neural networks
+//
+
+const struct
+{
+    const char* name;
+    const char* file;
+} NeuralModels[] =
+{
+    { "denoise ldr", "denoise_c3_ldr_float16.onnx" },
+    { "upscale good", "upscale2x_c3_rt_f16.onnx" },
+    { "upscale fast", "upscale2x_fast.pb" },
+    { "upscale best", "esrgan-03x2x32-273866.pb" },
+};
+
+// plain NHWC activations without padding
+struct ReferenceTensor
+{
+    size_t width = 0;
+    size_t height = 0;
+    size_t channels = 0;
+    std::vector<double> data;
+
+    double& At(size_t x, size_t y, size_t c)
+    {
+        return data[(y * width + x) * channels + c];
+    }
+
+    double At(size_t x, size_t y, size_t c) const
+    {
+        return data[(y * width + x) * channels + c];
+    }
+};
+
+double ReferenceActivation(double value, CpuBackend::NeuralActivation activation, float alpha)
+{
+    if (activation == CpuBackend::NeuralActivation::Relu)
+    {
+        return std::max(value, 0.0);
+    }
+    return activation == CpuBackend::NeuralActivation::LeakyRelu && value < 0.0 ? value * alpha : value;
+}
+
+// the operations of 'network' one output value at a time in double precision
+ReferenceTensor ReferenceNetwork(const CpuBackend::NeuralNetwork& network, const ReferenceTensor& input)
+{
+    using CpuBackend::NeuralOpType;
+    std::vector<ReferenceTensor> values(network.tensors);
+    values[network.input] = input;
+    for (const CpuBackend::NeuralOp& op : network.ops)
+    {
+        const ReferenceTensor& in = values[op.inputs[0]];
+        ReferenceTensor out;
+        out.channels = op.channels;
+        out.width = in.width;
+        out.height = in.height;
+        if (op.type == NeuralOpType::MaxPool)
+        {
+            out.width = (in.width + 1) / 2;
+            out.height = (in.height + 1) / 2;
+        }
+        else if (op.type == NeuralOpType::Upsample)
+        {
+            out.width = op.like >= 0 ? values[op.like].width : in.width * op.block;
+            out.height = op.like >= 0 ? values[op.like].height : in.height * op.block;
+        }
+        else if (op.type == NeuralOpType::DepthToSpace)
+        {
+            out.width = in.width * op.block;
+            out.height = in.height * op.block;
+        }
+        out.data.assign(out.width * out.height * out.channels, 0.0);
+
+        const long radius = long(op.kernel / 2);
+        for (size_t y = 0; y < out.height; ++y)
+        {
+            for (size_t x = 0; x < out.width; ++x)
+            {
+                for (size_t c = 0; c < out.channels; ++c)
+                {
+                    double value = 0.0;
+                    switch (op.type)
+                    {
+                    case NeuralOpType::Convolution:
+                        value = op.bias[c];
+                        for (long ky = -radius; ky <= radius; ++ky)
+                        {
+                            for (long kx = -radius; kx <= radius; ++kx)
+                            {
+                                const long sx = long(x) + kx;
+                                const long sy = long(y) + ky;
+                                if (sx < 0 || sy < 0 || sx >= long(in.width) || sy >= long(in.height))
+                                {
+                                    continue;
+                                }
+                                for (size_t i = 0; i < op.inChannels; ++i)
+                                {
+                                    value += in.At(sx, sy, i) * CpuBackend::NeuralNetwork::Weight(op, c, i, kx + radius, ky + radius);
+                                }
+                            }
+                        }
+                        value = ReferenceActivation(value, op.activation, op.alpha);
+                        break;
+                    case NeuralOpType::MaxPool:
+                        value = -1e30;
+                        for (size_t sy = 2 * y; sy < std::min(2 * y + 2, in.height); ++sy)
+                        {
+                            for (size_t sx = 2 * x; sx < std::min(2 * x + 2, in.width); ++sx)
+                            {
+                                value = std::max(value, in.At(sx, sy, c));
+                            }
+                        }
+                        break;
+                    case NeuralOpType::Upsample:
+                        value = in.At(x * in.width / out.width, y * in.height / out.height, c);
+                        break;
+                    case NeuralOpType::Concat:
+                    {
+                        size_t channel = c;
+                        for (int tensor : op.inputs)
+                        {
+                            if (channel < values[tensor].channels)
+                            {
+                                value = values[tensor].At(x, y, channel);
+                                break;
+                            }
+                            channel -= values[tensor].channels;
+                        }
+                        break;
+                    }
+                    case NeuralOpType::DepthToSpace:
+                        value = in.At(x / op.block, y / op.block, ((y % op.block) * op.block + x % op.block) * op.channels + c);
+                        break;
+                    case NeuralOpType::Elementwise:
+                        value = in.At(x, y, c) * op.scale + (op.inputs.size() > 1 ? values[op.inputs[1]].At(x, y, c) : 0.0);
+                        value = ReferenceActivation(value, op.activation, op.alpha);
+                        break;
+                    }
+                    out.At(x, y, c) = value;
+                }
+            }
+        }
+        values[op.output] = std::move(out);
+    }
+    return values[network.output];
+}
+
+// colour of a test image as network input
+void MakeNeuralInput(const CpuBackend::FloatImage& source, CpuBackend::NeuralTensor& tensor, ReferenceTensor& reference)
+{
+    tensor.Resize(source.Width(), source.Height(), 3);
+    reference.width = source.Width();
+    reference.height = source.Height();
+    reference.channels = 3;
+    reference.data.resize(source.Width() * source.Height() * 3);
+    for (size_t y = 0; y < source.Height(); ++y)
+    {
+        for (size_t x = 0; x < source.Width(); ++x)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                tensor.Pixel(long(x), long(y))[c] = source.Row(y)[x * 4 + c];
+                reference.At(x, y, c) = source.Row(y)[x * 4 + c];
+            }
+        }
+    }
+}
+
+float MaxAbsDifference(const CpuBackend::NeuralTensor& a, const ReferenceTensor& b)
+{
+    if (a.Width() != b.width || a.Height() != b.height || a.Channels() != b.channels)
+    {
+        return 1.0f;
+    }
+    double result = 0.0;
+    for (size_t y = 0; y < b.height; ++y)
+    {
+        for (size_t x = 0; x < b.width; ++x)
+        {
+            for (size_t c = 0; c < b.channels; ++c)
+            {
+                result = std::max(result, std::fabs(a.Pixel(long(x), long(y))[c] - b.At(x, y, c)));
+            }
+        }
+    }
+    return float(result);
+}
+
+float MaxAbsDifference(const CpuBackend::NeuralTensor& a, const CpuBackend::NeuralTensor& b)
+{
+    if (!a.SameShape(b.Width(), b.Height(), b.Channels()))
+    {
+        return 1.0f;
+    }
+    float result = 0.0f;
+    for (size_t y = 0; y < b.Height(); ++y)
+    {
+        for (size_t x = 0; x < b.Width(); ++x)
+        {
+            for (size_t c = 0; c < b.Channels(); ++c)
+            {
+                result = std::max(result, std::fabs(a.Pixel(long(x), long(y))[c] - b.Pixel(long(x), long(y))[c]));
+            }
+        }
+    }
+    return result;
+}
+
+// root mean square difference; PSNR = -20 log10 of it for values in [0, 1]
+float RmsDifference(const CpuBackend::NeuralTensor& a, const CpuBackend::NeuralTensor& b)
+{
+    if (!a.SameShape(b.Width(), b.Height(), b.Channels()))
+    {
+        return 1.0f;
+    }
+    double sum = 0.0;
+    for (size_t y = 0; y < b.Height(); ++y)
+    {
+        for (size_t x = 0; x < b.Width(); ++x)
+        {
+            for (size_t c = 0; c < b.Channels(); ++c)
+            {
+                const double d = a.Pixel(long(x), long(y))[c] - b.Pixel(long(x), long(y))[c];
+                sum += d * d;
+            }
+        }
+    }
+    return float(std::sqrt(sum / double(b.Width() * b.Height() * b.Channels())));
+}
+
+// 'network' quantized with the ranges it sees on two other test images
+bool QuantizeForTest(CpuBackend::ThreadPool& pool, const CpuBackend::NeuralNetwork& network, size_t width, size_t height,
+    CpuBackend::NeuralNetwork& quantized)
+{
+    CpuBackend::NeuralCalibration calibration;
+    for (unsigned seed : { 2u, 3u })
+    {
+        CpuBackend::NeuralTensor sample;
+        ReferenceTensor unused;
+        MakeNeuralInput(MakeTestImage(width, height, seed), sample, unused);
+        if (CpuBackend::CalibrateNeuralNetwork(pool, network, sample, calibration) != RIF_SUCCESS)
+        {
+            return false;
+        }
+    }
+    return CpuBackend::QuantizeNeuralNetwork(network, calibration, quantized) == RIF_SUCCESS;
+}
+
+// one network per model bytes and precision, and packed files that run the same as the
+// parsed networks
+bool TestNeuralCache(CpuBackend::ThreadPool& pool, const Options& options, const CpuBackend::NeuralTensor& input)
+{
+    const std::string path = options.models + "/upscale2x_fast.pb";
+    std::shared_ptr<const CpuBackend::NeuralNetwork> parsed[2];
+    std::shared_ptr<const CpuBackend::NeuralNetwork> again;
+    float wrong = 0.0f;
+    wrong += CpuBackend::AcquireNeuralNetwork(path, false, "", parsed[0]) != RIF_SUCCESS;
+    wrong += CpuBackend::AcquireNeuralNetwork(options.models + "/./upscale2x_fast.pb", false, "", again) != RIF_SUCCESS;
+    wrong += again != parsed[0];
+    wrong += CpuBackend::AcquireNeuralNetwork(path, true, "", parsed[1]) != RIF_SUCCESS;
+    wrong += parsed[1] == parsed[0];
+    wrong += CpuBackend::AcquireNeuralNetwork(options.models + "/missing.pb", false, "", again) != RIF_ERROR_IO_ERROR;
+
+    float error = 0.0f;
+    for (int quantized = 0; quantized < 2 && parsed[quantized]; ++quantized)
+    {
+        uint64_t key = 0;
+        CpuBackend::NeuralNetwork packed;
+        CpuBackend::NeuralNetwork unused;
+        wrong += CpuBackend::NeuralNetworkKey(path, quantized != 0, key) != RIF_SUCCESS;
+        const std::string packedPath = CpuBackend::PackedNeuralNetworkPath(options.cache, key);
+        wrong += CpuBackend::SavePackedNeuralNetwork(packedPath, key, *parsed[quantized]) != RIF_SUCCESS;
+        wrong += CpuBackend::LoadPackedNeuralNetwork(packedPath, key, packed) != RIF_SUCCESS;
+        wrong += CpuBackend::LoadPackedNeuralNetwork(packedPath, key + 1, unused) != RIF_ERROR_INVALID_PARAMETER;
+
+        // files with a valid header whose op geometry does not add up
+        for (int damage = 0; damage < 3; ++damage)
+        {
+            CpuBackend::NeuralNetwork damaged = *parsed[quantized];
+            CpuBackend::NeuralOp& op = *std::find_if(damaged.ops.begin(), damaged.ops.end(),
+                [](const CpuBackend::NeuralOp& o) { return o.type == CpuBackend::NeuralOpType::Convolution; });
+            if (damage == 0)
+            {
+                op.bias.pop_back();
+            }
+            else if (damage == 1)
+            {
+                op.like = int(damaged.tensors);
+            }
+            else
+            {
+                op.type = CpuBackend::NeuralOpType(uint8_t(CpuBackend::NeuralOpType::Elementwise) + 1);
+            }
+            wrong += CpuBackend::SavePackedNeuralNetwork(packedPath, key, damaged) != RIF_SUCCESS;
+            wrong += CpuBackend::LoadPackedNeuralNetwork(packedPath, key, unused) != RIF_ERROR_INVALID_PARAMETER;
+        }
+        std::remove(packedPath.c_str());
+
+        CpuBackend::NeuralTensor expected;
+        CpuBackend::NeuralTensor result;
+        const bool ran = CpuBackend::RunNeuralNetwork(pool, *parsed[quantized], input, expected) == RIF_SUCCESS &&
+            CpuBackend::RunNeuralNetwork(pool, packed, input, result) == RIF_SUCCESS;
+        error = std::max(error, ran ? MaxAbsDifference(result, expected) : 1.0f);
+    }
+    // a model whose file is replaced is loaded again on the next run, and the network it
+    // replaced goes with the last holder: the cache does not keep it alive
+    const std::string editedPath = options.cache + "/edited.pb";
+    std::weak_ptr<const CpuBackend::NeuralNetwork> replaced;
+    {
+        std::shared_ptr<const CpuBackend::NeuralNetwork> replacement;
+        CpuBackend::NeuralModel model;
+        std::ofstream(editedPath, std::ios::binary) << std::ifstream(path, std::ios::binary).rdbuf();
+        wrong += model.Load(editedPath, false, "") != RIF_SUCCESS || &model.Network() != parsed[0].get();
+        std::ofstream(editedPath, std::ios::binary) << std::ifstream(options.models + "/esrgan-03x2x32-273866.pb", std::ios::binary).rdbuf();
+        wrong += model.Load(editedPath, false, "") != RIF_SUCCESS ||
+            CpuBackend::AcquireNeuralNetwork(options.models + "/esrgan-03x2x32-273866.pb", false, "", replacement) != RIF_SUCCESS ||
+            &model.Network() != replacement.get();
+        replaced = replacement;
+    }
+    std::remove(editedPath.c_str());
+    wrong += !replaced.expired();
+
+    bool pass = Report("model cache sharing and errors", wrong, 0.0f);
+    pass &= Report("packed networks vs parsed, float and int8", error, 0.0f);
+    return pass;
+}
+
+// workspaces kept per input size: runs that reuse one, at its size or smaller, give
+// the results of runs that do not
+bool TestNeuralBuckets(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    struct Size
+    {
+        size_t width;
+        size_t height;
+    };
+    CpuBackend::AiUpscaleFilter exact;
+    CpuBackend::AiUpscaleFilter bucketed;
+    for (CpuBackend::AiUpscaleFilter* filter : { &exact, &bucketed })
+    {
+        filter->SetParameterString("modelPath", options.models);
+        filter->SetParameter1u("mode", RIF_AI_UPSCALE_MODE_FAST_2X);
+    }
+    bucketed.SetParameter1u("shapeBucket", 16);
+
+    // buckets 48x32, 48x32, 48x32, 64x32, 48x32, 32x32 evicting 64x32, 64x32
+    const Size sizes[] = { { 37, 26 }, { 40, 30 }, { 37, 26 }, { 50, 26 }, { 33, 20 }, { 20, 20 }, { 50, 26 } };
+    float error = 0.0f;
+    float wrong = 0.0f;
+    for (rif_compute_type type : { RIF_COMPUTE_TYPE_FLOAT, RIF_COMPUTE_TYPE_INT8 })
+    {
+        exact.SetComputeType(type);
+        bucketed.SetComputeType(type);
+        for (const Size& size : sizes)
+        {
+            const std::unique_ptr<CpuBackend::Image> image = ToImage(MakeTestImage(size.width, size.height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+            std::unique_ptr<CpuBackend::Image> expected = MakeImage(2 * size.width, 2 * size.height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+            std::unique_ptr<CpuBackend::Image> result = MakeImage(2 * size.width, 2 * size.height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+            const bool ran = exact.Execute(pool, *image, *expected) == RIF_SUCCESS && bucketed.Execute(pool, *image, *result) == RIF_SUCCESS;
+            error = std::max(error, ran ? MaxAbsDifference(*result, *expected) : 1.0f);
+        }
+    }
+
+    // a new compute type loads another network and drops the workspaces
+    const CpuBackend::NeuralBucketStatistics statistics = bucketed.BucketStatistics();
+    wrong += statistics.hits != 6 || statistics.misses != 8 || statistics.buckets != CpuBackend::NeuralModel::MaxBuckets;
+    wrong += exact.BucketStatistics().hits != 2;
+    bool pass = Report("model buckets, hits and misses", wrong, 0.0f);
+    pass &= Report("model buckets vs exact sizes, float and int8", error, 0.0f);
+    return pass;
+}
+
+// images of the "inputs" array denoised in batches, as each would be alone; the
+// batches run on enough threads for the images to share each operation
+bool TestNeuralBatch(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    CpuBackend::ThreadPool wide(16);
+    const size_t width = 23;
+    const size_t height = 17;
+    const size_t count = 5;
+    std::vector<std::unique_ptr<CpuBackend::Image>> inputs;
+    std::vector<std::unique_ptr<CpuBackend::Image>> outputs;
+    std::vector<CpuBackend::Image*> moreInputs;
+    std::vector<CpuBackend::Image*> moreOutputs;
+    for (size_t i = 0; i < count; ++i)
+    {
+        inputs.push_back(ToImage(MakeTestImage(width, height, unsigned(i + 1)), 4, RIF_COMPONENT_TYPE_FLOAT32));
+        outputs.push_back(MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32));
+        if (i > 0)
+        {
+            moreInputs.push_back(inputs[i].get());
+            moreOutputs.push_back(outputs[i].get());
+        }
+    }
+
+    CpuBackend::AiDenoiseFilter single;
+    CpuBackend::AiDenoiseFilter batched;
+    single.SetParameterString("modelPath", options.models);
+    batched.SetParameterString("modelPath", options.models);
+    batched.SetParameterImageArray("inputs", moreInputs.data(), rif_uint(moreInputs.size()));
+    batched.SetParameterImageArray("outputs", moreOutputs.data(), rif_uint(moreOutputs.size()));
+    std::unique_ptr<CpuBackend::Image> expected = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    float error = 0.0f;
+    for (rif_compute_type type : { RIF_COMPUTE_TYPE_FLOAT, RIF_COMPUTE_TYPE_INT8 })
+    {
+        single.SetComputeType(type);
+        batched.SetComputeType(type);
+        // all at once, then batches of 2, 2 and 1
+        for (rif_uint batchSize : { 0u, 2u })
+        {
+            batched.SetParameter1u("batchSize", batchSize);
+            if (batched.Execute(wide, *inputs[0], *outputs[0]) != RIF_SUCCESS)
+            {
+                error = 1.0f;
+                continue;
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                const bool ran = single.Execute(pool, *inputs[i], *expected) == RIF_SUCCESS;
+                error = std::max(error, ran ? MaxAbsDifference(*outputs[i], *expected) : 1.0f);
+            }
+        }
+    }
+
+    float wrong = 0.0f;
+    std::unique_ptr<CpuBackend::Image> other = MakeImage(width + 1, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    moreOutputs.back() = other.get();
+    batched.SetParameterImageArray("outputs", moreOutputs.data(), rif_uint(moreOutputs.size()));
+    wrong += batched.Execute(wide, *inputs[0], *outputs[0]) != RIF_ERROR_INVALID_IMAGE;
+    batched.SetParameterImageArray("outputs", moreOutputs.data(), rif_uint(moreOutputs.size() - 1));
+    wrong += batched.Execute(wide, *inputs[0], *outputs[0]) != RIF_ERROR_INVALID_PARAMETER;
+    bool pass = Report("batched denoise vs single, float and int8", error, 0.0f);
+    pass &= Report("batched denoise errors", wrong, 0.0f);
+    return pass;
+}
+
+// 'frames' crops of 'base' panning by (dx, dy) pixels a frame, so the content moves by
+// (-dx, -dy), each with its own multiplicative noise of 'noise' standard deviation as a
+// new render would have; the motion image has that motion everywhere
+void MakePanSequence(const CpuBackend::FloatImage& base, size_t frames, size_t dx, size_t dy, float noise,
+    std::vector<std::unique_ptr<CpuBackend::Image>>& sequence, std::unique_ptr<CpuBackend::Image>& motion)
+{
+    const size_t width = base.Width() - dx * (frames - 1);
+    const size_t height = base.Height() - dy * (frames - 1);
+    sequence.clear();
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        std::mt19937 random(unsigned(frame + 1));
+        std::normal_distribution<float> normal(0.0f, noise);
+        CpuBackend::FloatImage image(width, height);
+        for (size_t y = 0; y < height; ++y)
+        {
+            const float* source = base.Row(y + dy * frame) + dx * frame * 4;
+            for (size_t x = 0; x < width; ++x)
+            {
+                const float scale = std::max(0.0f, 1.0f + normal(random));
+                for (size_t c = 0; c < 4; ++c)
+                {
+                    image.Row(y)[x * 4 + c] = c == 3 ? source[x * 4 + c] : source[x * 4 + c] * scale;
+                }
+            }
+        }
+        sequence.push_back(ToImage(image, 4, RIF_COMPONENT_TYPE_FLOAT32));
+    }
+    CpuBackend::FloatImage vectors(width, height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            vectors.Row(y)[x * 4 + 0] = -float(dx);
+            vectors.Row(y)[x * 4 + 1] = -float(dy);
+        }
+    }
+    motion = ToImage(vectors, 4, RIF_COMPONENT_TYPE_FLOAT32);
+}
+
+// RMS change of the colour between frames of a sequence panning by (dx, dy), where
+// frame t at (x, y) shows what frame t - 1 showed at (x + dx, y + dy)
+float PanFlicker(const CpuBackend::Image& previous, const CpuBackend::Image& current, size_t dx, size_t dy)
+{
+    const size_t width = current.Width() - dx;
+    std::vector<float> rowA(current.Width() * 4);
+    std::vector<float> rowB(current.Width() * 4);
+    double sum = 0.0;
+    for (size_t y = 0; y + dy < current.Height(); ++y)
+    {
+        previous.LoadRow(y + dy, 0, current.Width(), rowA.data(), 4);
+        current.LoadRow(y, 0, current.Width(), rowB.data(), 4);
+        for (size_t x = 0; x < width; ++x)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const double d = rowA[(x + dx) * 4 + c] - rowB[x * 4 + c];
+                sum += d * d;
+            }
+        }
+    }
+    return float(std::sqrt(sum / double(width * (current.Height() - dy) * 3)));
+}
+
+float RmsDifference(const CpuBackend::Image& a, const CpuBackend::Image& b)
+{
+    std::vector<float> rowA(a.Width() * 4);
+    std::vector<float> rowB(a.Width() * 4);
+    double sum = 0.0;
+    for (size_t y = 0; y < a.Height(); ++y)
+    {
+        a.LoadRow(y, 0, a.Width(), rowA.data(), 4);
+        b.LoadRow(y, 0, a.Width(), rowB.data(), 4);
+        for (size_t x = 0; x < a.Width(); ++x)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                const double d = rowA[x * 4 + c] - rowB[x * 4 + c];
+                sum += d * d;
+            }
+        }
+    }
+    return float(std::sqrt(sum / double(a.Width() * a.Height() * 3)));
+}
+
+// the temporal denoise: runs given the feedback tensor skip work and match full runs,
+// frames that are all key frames or do not move match the stateless filter, and a pan
+// flickers less
+bool TestNeuralTemporal(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    CpuBackend::NeuralNetwork network;
+    if (CpuBackend::LoadNeuralNetwork(options.models + "/denoise_c3_ldr_float16.onnx", network) != RIF_SUCCESS)
+    {
+        return Report("temporal denoise model", 1.0f, 0.0f);
+    }
+    const size_t width = 37;
+    const size_t height = 26;
+    CpuBackend::NeuralTensor input;
+    ReferenceTensor unused;
+    MakeNeuralInput(MakeTestImage(width, height), input, unused);
+
+    // the feedback tensor of a full run given back to the same input
+    float wrong = 0.0f;
+    float error = 0.0f;
+    CpuBackend::NeuralWorkspace workspace;
+    CpuBackend::NeuralFeedback feedback = { CpuBackend::NeuralFeedbackTensor(network, 1), nullptr };
+    CpuBackend::NeuralTensor full;
+    CpuBackend::NeuralTensor features;
+    if (feedback.tensor >= 0 && CpuBackend::RunNeuralNetwork(pool, network, input, feedback, workspace) == RIF_SUCCESS)
+    {
+        full = workspace.Output();
+        features = workspace.Tensor(feedback.tensor);
+        feedback.value = &features;
+        const bool ran = CpuBackend::RunNeuralNetwork(pool, network, input, feedback, workspace) == RIF_SUCCESS;
+        error = ran ? MaxAbsDifference(workspace.Output(), full) : 1.0f;
+        wrong += std::count(workspace.skipped.begin(), workspace.skipped.end(), 1) < 10;
+        CpuBackend::NeuralTensor other;
+        other.Resize(width, height, features.Channels());
+        feedback.value = &other;
+        wrong += CpuBackend::RunNeuralNetwork(pool, network, input, feedback, workspace) != RIF_ERROR_INVALID_PARAMETER;
+    }
+    else
+    {
+        ++wrong;
+    }
+    bool pass = Report("temporal feedback run vs full run", error, 0.0f);
+
+    CpuBackend::AiDenoiseFilter stateless;
+    CpuBackend::AiDenoiseFilter temporal;
+    stateless.SetParameterString("modelPath", options.models);
+    temporal.SetParameterString("modelPath", options.models);
+    temporal.SetParameter1u("useTemporal", 1);
+    std::unique_ptr<CpuBackend::Image> expected = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> result = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+
+    // key frames only, unblended: the stateless filter frame by frame
+    float keyError = 0.0f;
+    temporal.SetParameter1u("temporalKeyInterval", 1);
+    temporal.SetParameter1f("temporalBlend", 0.0f);
+    for (unsigned seed : { 1u, 2u, 3u })
+    {
+        const std::unique_ptr<CpuBackend::Image> frame = ToImage(MakeTestImage(width, height, seed), 4, RIF_COMPONENT_TYPE_FLOAT32);
+        const bool ran = stateless.Execute(pool, *frame, *expected) == RIF_SUCCESS && temporal.Execute(pool, *frame, *result) == RIF_SUCCESS;
+        keyError = std::max(keyError, ran ? MaxAbsDifference(*result, *expected) : 1.0f);
+    }
+    pass &= Report("temporal key frames vs stateless", keyError, 0.0f);
+
+    // a still frame, blended, in float and int8: warped features and history are the frame's own
+    float stillError = 0.0f;
+    const std::unique_ptr<CpuBackend::Image> still = ToImage(MakeTestImage(width, height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+    temporal.SetParameter1u("temporalKeyInterval", 8);
+    temporal.SetParameter1f("temporalBlend", 0.8f);
+    for (rif_compute_type type : { RIF_COMPUTE_TYPE_FLOAT, RIF_COMPUTE_TYPE_INT8 })
+    {
+        stateless.SetComputeType(type);
+        temporal.SetComputeType(type);
+        temporal.ResetHistory();
+        const bool ran = stateless.Execute(pool, *still, *expected) == RIF_SUCCESS;
+        for (int frame = 0; frame < 4; ++frame)
+        {
+            stillError = std::max(stillError, ran && temporal.Execute(pool, *still, *result) == RIF_SUCCESS ?
+                MaxAbsDifference(*result, *expected) : 1.0f);
+        }
+    }
+    stateless.SetComputeType(RIF_COMPUTE_TYPE_FLOAT);
+    temporal.SetComputeType(RIF_COMPUTE_TYPE_FLOAT);
+    pass &= Report("temporal still frames, float and int8", stillError, 0.0f);
+
+    // a pan: close to the stateless filter and steadier
+    const size_t frames = 6;
+    std::vector<std::unique_ptr<CpuBackend::Image>> sequence;
+    std::unique_ptr<CpuBackend::Image> motion;
+    MakePanSequence(MakeTestImage(96, 64), frames, 2, 1, 0.2f, sequence, motion);
+    temporal.ResetHistory();
+    temporal.SetParameterImage("motionImg", motion.get());
+    std::unique_ptr<CpuBackend::Image> previous[2];
+    float drift = 0.0f;
+    double flicker[2] = { 0.0, 0.0 };
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        std::unique_ptr<CpuBackend::Image> outputs[2] = { MakeImage(sequence[frame]->Width(), sequence[frame]->Height(), 4, RIF_COMPONENT_TYPE_FLOAT32),
+            MakeImage(sequence[frame]->Width(), sequence[frame]->Height(), 4, RIF_COMPONENT_TYPE_FLOAT32) };
+        wrong += stateless.Execute(pool, *sequence[frame], *outputs[0]) != RIF_SUCCESS;
+        wrong += temporal.Execute(pool, *sequence[frame], *outputs[1]) != RIF_SUCCESS;
+        drift = std::max(drift, RmsDifference(*outputs[1], *outputs[0]));
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            flicker[mode] += previous[mode] ? PanFlicker(*previous[mode], *outputs[mode], 2, 1) : 0.0f;
+            previous[mode] = std::move(outputs[mode]);
+        }
+    }
+    pass &= Report("temporal pan rms vs stateless", drift, 0.05f);
+    pass &= Report("temporal pan flicker / stateless flicker", float(flicker[1] / std::max(flicker[0], 1e-9)), 0.75f);
+
+    std::unique_ptr<CpuBackend::Image> small = MakeImage(width - 1, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    temporal.SetParameterImage("motionImg", small.get());
+    wrong += temporal.Execute(pool, *still, *result) != RIF_ERROR_INVALID_IMAGE;
+    temporal.SetParameterImage("motionImg", nullptr);
+    CpuBackend::Image* array[] = { still.get() };
+    temporal.SetParameterImageArray("inputs", array, 1);
+    wrong += temporal.Execute(pool, *still, *result) != RIF_ERROR_UNSUPPORTED;
+    pass &= Report("temporal errors and skipped work", wrong, 0.0f);
+    return pass;
+}
+
+bool TestNeural(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::simd::Level;
+    std::cout << "Neural networks vs reference (" << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << ")" << std::endl;
+    // odd sizes: pooling rounds up, and the rows end in partial pixel tiles
+    const size_t width = 37;
+    const size_t height = 26;
+    CpuBackend::NeuralTensor input;
+    ReferenceTensor referenceInput;
+    MakeNeuralInput(MakeTestImage(width, height), input, referenceInput);
+
+    bool pass = true;
+    std::vector<CpuBackend::NeuralTensor> upscaled;
+    for (const auto& model : NeuralModels)
+    {
+        CpuBackend::NeuralNetwork network;
+        const std::string path = options.models + "/" + model.file;
+        if (CpuBackend::LoadNeuralNetwork(path, network) != RIF_SUCCESS)
+        {
+            std::cout << "  " << network.error << ", skipped" << std::endl;
+            continue;
+        }
+        const ReferenceTensor expected = ReferenceNetwork(network, referenceInput);
+        CpuBackend::NeuralTensor output;
+        for (Level level : { Level::Scalar, CpuBackend::simd::CurrentLevel() })
+        {
+            const float error = CpuBackend::RunNeuralNetwork(pool, network, input, output, level) == RIF_SUCCESS ?
+                MaxAbsDifference(output, expected) : 1.0f;
+            pass &= Report(std::string(model.name) + (level == Level::Scalar ? ", scalar" : ""), error, 1e-4f);
+        }
+
+        // int8 against float: an RMS difference of 0.02 is 34 dB PSNR. The integer sums
+        // are exact, so the instruction sets only differ where a float rounds to another
+        // int8 step.
+        CpuBackend::NeuralNetwork quantized;
+        CpuBackend::NeuralTensor scalarInt8;
+        CpuBackend::NeuralTensor simdInt8;
+        const bool ran = QuantizeForTest(pool, network, width, height, quantized) &&
+            CpuBackend::RunNeuralNetwork(pool, quantized, input, scalarInt8, Level::Scalar) == RIF_SUCCESS &&
+            CpuBackend::RunNeuralNetwork(pool, quantized, input, simdInt8) == RIF_SUCCESS;
+        pass &= Report(std::string(model.name) + ", int8 rms vs float", ran ? RmsDifference(simdInt8, output) : 1.0f, 0.02f);
+        pass &= Report(std::string(model.name) + ", int8 scalar vs simd", ran ? RmsDifference(scalarInt8, simdInt8) : 1.0f, 2e-3f);
+        if (std::string(model.name).compare(0, 7, "upscale") == 0)
+        {
+            upscaled.push_back(std::move(output));
+        }
+    }
+
+    // the good and fast upscalers are the same network, stored as float16 ONNX and float32 TensorFlow
+    if (upscaled.size() >= 2)
+    {
+        pass &= Report("upscale onnx float16 vs tensorflow float32", MaxAbsDifference(upscaled[0], upscaled[1]), 2e-3f);
+    }
+
+    // through the filters, which also check their parameters
+    const std::unique_ptr<CpuBackend::Image> image = ToImage(MakeTestImage(width, height), 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> same = MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    std::unique_ptr<CpuBackend::Image> twice = MakeImage(2 * width, 2 * height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    CpuBackend::AiDenoiseFilter denoise;
+    CpuBackend::AiUpscaleFilter upscale;
+    denoise.SetParameterString("modelPath", options.models);
+    upscale.SetParameterString("modelPath", options.models);
+    upscale.SetParameter1u("mode", RIF_AI_UPSCALE_MODE_FAST_2X);
+    float wrong = 0.0f;
+    if (upscale.Execute(pool, *image, *twice) == RIF_SUCCESS && upscaled.size() >= 2)
+    {
+        std::vector<float> row(2 * width * 4);
+        for (size_t y = 0; y < 2 * height; ++y)
+        {
+            twice->LoadRow(y, 0, 2 * width, row.data(), 4);
+            for (size_t x = 0; x < 2 * width; ++x)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const float expected = upscaled[1].Pixel(long(x), long(y))[c];
+                    wrong = std::max(wrong, std::fabs(row[x * 4 + c] - expected));
+                }
+                wrong = std::max(wrong, std::fabs(row[x * 4 + 3] - 1.0f));
+            }
+        }
+    }
+
+    // int8 with the calibration file next to the model, which was made on photographs
+    // rather than this test pattern: single pixels stray, so the bound is on the rms
+    std::unique_ptr<CpuBackend::Image> twiceInt8 = MakeImage(2 * width, 2 * height, 4, RIF_COMPONENT_TYPE_FLOAT32);
+    wrong += upscale.SetComputeType(RIF_COMPUTE_TYPE_INT8) != RIF_SUCCESS;
+    const float int8Error = upscale.Execute(pool, *image, *twiceInt8) == RIF_SUCCESS ? RmsDifference(*twiceInt8, *twice) : 1.0f;
+    wrong += upscale.SetComputeType(RIF_COMPUTE_TYPE_FLOAT) != RIF_SUCCESS;
+    wrong += upscale.SetComputeType(0x7777u) != RIF_ERROR_INVALID_PARAMETER;
+    wrong += upscale.ComputeType() != RIF_COMPUTE_TYPE_FLOAT;
+    wrong += upscale.Execute(pool, *image, *same) != RIF_ERROR_INVALID_IMAGE;
+    upscale.SetParameter1u("mode", 0);
+    wrong += upscale.Execute(pool, *image, *twice) != RIF_ERROR_INVALID_PARAMETER;
+    denoise.SetParameter1u("useHDR", 1);
+    wrong += denoise.Execute(pool, *image, *same) != RIF_ERROR_UNSUPPORTED;
+    denoise.SetParameter1u("useHDR", 0);
+    denoise.SetParameterString("modelPath", options.models + "/missing");
+    wrong += denoise.Execute(pool, *image, *same) != RIF_ERROR_IO_ERROR;
+    if (!upscaled.empty())
+    {
+        pass &= Report("filters and parameter errors", wrong, 0.0f);
+        pass &= Report("upscale fast filter, int8 rms vs float", int8Error, 0.02f);
+        pass &= TestNeuralCache(pool, options, input);
+        pass &= TestNeuralBuckets(pool, options);
+        pass &= TestNeuralBatch(pool, options);
+        pass &= TestNeuralTemporal(pool, options);
+    }
+    return pass;
+}
+
+// thumbnails through the denoiser in batches of each size
+void BenchmarkNeuralBatch(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const size_t width = 64;
+    const size_t height = 64;
+    const size_t count = 16;
+    std::vector<std::unique_ptr<CpuBackend::Image>> inputs;
+    std::vector<std::unique_ptr<CpuBackend::Image>> outputs;
+    std::vector<CpuBackend::Image*> moreInputs;
+    std::vector<CpuBackend::Image*> moreOutputs;
+    for (size_t i = 0; i < count; ++i)
+    {
+        inputs.push_back(ToImage(MakeTestImage(width, height, unsigned(i + 1)), 4, RIF_COMPONENT_TYPE_FLOAT32));
+        outputs.push_back(MakeImage(width, height, 4, RIF_COMPONENT_TYPE_FLOAT32));
+        if (i > 0)
+        {
+            moreInputs.push_back(inputs[i].get());
+            moreOutputs.push_back(outputs[i].get());
+        }
+    }
+
+    std::cout << "AI denoise of " << count << " images " << width << "x" << height << "   batchSize   images/s   int8 images/s" << std::endl;
+    for (rif_uint batchSize : { 1u, 2u, 4u, 8u, 16u })
+    {
+        std::cout << std::fixed << std::setprecision(1) << std::setw(43) << batchSize;
+        for (rif_compute_type type : { RIF_COMPUTE_TYPE_FLOAT, RIF_COMPUTE_TYPE_INT8 })
+        {
+            CpuBackend::AiDenoiseFilter denoise;
+            denoise.SetParameterString("modelPath", options.models);
+            denoise.SetParameterImageArray("inputs", moreInputs.data(), rif_uint(moreInputs.size()));
+            denoise.SetParameterImageArray("outputs", moreOutputs.data(), rif_uint(moreOutputs.size()));
+            denoise.SetParameter1u("batchSize", batchSize);
+            denoise.SetComputeType(type);
+            denoise.Execute(pool, *inputs[0], *outputs[0]);
+            const double ms = TimeMs(options.repeat, [&]() { denoise.Execute(pool, *inputs[0], *outputs[0]); });
+            std::cout << std::setw(type == RIF_COMPUTE_TYPE_FLOAT ? 11 : 16) << 1000.0 * double(count) / ms;
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+}
+
+// a single channel float image of the samples, as grey
+bool LoadBinImage(const std::string& path, size_t width, size_t height, CpuBackend::FloatImage& image)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<float> values(width * height);
+    if (!file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float)))
+    {
+        return false;
+    }
+    image.Resize(width, height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            std::fill(image.Row(y) + x * 4, image.Row(y) + x * 4 + 3, values[y * width + x]);
+            image.Row(y)[x * 4 + 3] = 1.0f;
+        }
+    }
+    return true;
+}
+
+// the sample renders panned with fresh noise each frame, denoised frame by frame and
+// as a sequence
+void BenchmarkNeuralTemporal(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    const size_t frames = 8;
+    const size_t dx = 2;
+    const size_t dy = 1;
+    std::cout << "AI denoise of " << frames << " frames panning " << dx << "x" << dy
+        << " px     ms/frame: stateless   temporal    flicker: stateless   temporal    rms difference" << std::endl;
+    for (const char* name : { "cam_1", "cam_5", "cam_12" })
+    {
+        CpuBackend::FloatImage base;
+        const std::string path = options.images + "/" + name + "_gloss_spp_8.bin";
+        if (!LoadBinImage(path, 800, 600, base))
+        {
+            std::cout << "  " << path << " not found, skipped" << std::endl;
+            continue;
+        }
+        std::vector<std::unique_ptr<CpuBackend::Image>> sequence;
+        std::unique_ptr<CpuBackend::Image> motion;
+        MakePanSequence(base, frames, dx, dy, 0.2f, sequence, motion);
+
+        CpuBackend::AiDenoiseFilter filters[2];
+        for (CpuBackend::AiDenoiseFilter& filter : filters)
+        {
+            filter.SetParameterString("modelPath", options.models);
+        }
+        filters[1].SetParameter1u("useTemporal", 1);
+        filters[1].SetParameterImage("motionImg", motion.get());
+
+        double ms[2] = { 0.0, 0.0 };
+        double flicker[2] = { 0.0, 0.0 };
+        double difference = 0.0;
+        std::unique_ptr<CpuBackend::Image> previous[2];
+        for (size_t frame = 0; frame < frames; ++frame)
+        {
+            std::unique_ptr<CpuBackend::Image> outputs[2];
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                outputs[mode] = MakeImage(sequence[frame]->Width(), sequence[frame]->Height(), 4, RIF_COMPONENT_TYPE_FLOAT32);
+                ms[mode] += TimeMs(1, [&]() { filters[mode].Execute(pool, *sequence[frame], *outputs[mode]); });
+            }
+            difference += RmsDifference(*outputs[1], *outputs[0]);
+            for (int mode = 0; mode < 2; ++mode)
+            {
+                flicker[mode] += previous[mode] ? PanFlicker(*previous[mode], *outputs[mode], dx, dy) : 0.0f;
+                previous[mode] = std::move(outputs[mode]);
+            }
+        }
+        std::cout << std::fixed << std::setprecision(1) << "  " << std::left << std::setw(47) << name << std::right
+            << std::setw(9) << ms[0] / double(frames) << std::setw(11) << ms[1] / double(frames) << std::setprecision(4)
+            << std::setw(20) << flicker[0] / double(frames - 1) << std::setw(11) << flicker[1] / double(frames - 1)
+            << std::setw(18) << difference / double(frames) << std::defaultfloat << std::endl;
+    }
+}
+
+void BenchmarkNeural(CpuBackend::ThreadPool& pool, const Options& options)
+{
+    using CpuBackend::simd::Level;
+    // a tenth of the benchmark size in each direction keeps the scalar runs short
+    const size_t width = std::max<size_t>(16, options.width / 10);
+    const size_t height = std::max<size_t>(16, options.height / 10);
+    std::cout << "Neural networks " << width << "x" << height << ", " << pool.ThreadCount() << " threads" << std::endl;
+    CpuBackend::NeuralTensor input;
+    ReferenceTensor unused;
+    MakeNeuralInput(MakeTestImage(width, height), input, unused);
+
+    std::cout << "  model           GMAC   scalar ms   scalar GFLOP/s   " << std::left << std::setw(8)
+        << CpuBackend::simd::LevelName(CpuBackend::simd::CurrentLevel()) << std::right << " ms   GFLOP/s   int8 ms   GOP/s"
+        << (CpuBackend::simd::CurrentAvx512Vnni() ? " (VNNI)" : "") << std::endl;
+    for (const auto& model : NeuralModels)
+    {
+        CpuBackend::NeuralNetwork network;
+        if (CpuBackend::LoadNeuralNetwork(options.models + "/" + model.file, network) != RIF_SUCCESS)
+        {
+            std::cout << "  " << network.error << ", skipped" << std::endl;
+            continue;
+        }
+        CpuBackend::NeuralTensor output;
+        const double macs = network.MultiplyAdds(width, height);
+        const double scalarMs = TimeMs(1, [&]() { CpuBackend::RunNeuralNetwork(pool, network, input, output, Level::Scalar); });
+        const double simdMs = TimeMs(options.repeat, [&]() { CpuBackend::RunNeuralNetwork(pool, network, input, output); });
+        CpuBackend::NeuralNetwork quantized;
+        QuantizeForTest(pool, network, width, height, quantized);
+        const double int8Ms = TimeMs(options.repeat, [&]() { CpuBackend::RunNeuralNetwork(pool, quantized, input, output); });
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(14) << model.name << std::right
+            << std::setw(6) << macs * 1e-9 << std::setw(12) << scalarMs << std::setw(17) << 2.0 * macs / (scalarMs * 1e6)
+            << std::setw(12) << simdMs << std::setw(10) << 2.0 * macs / (simdMs * 1e6) << std::setw(10) << int8Ms
+            << std::setw(8) << 2.0 * macs / (int8Ms * 1e6) << std::defaultfloat << std::endl;
+    }
+
+    // what an AI filter pays on its first run: parsing the model (nothing cached),
+    // reading the packed file of an earlier process, or sharing the network another
+    // filter already loaded
+    std::cout << "AI filter model setup, ms        float: parse   packed   shared    int8: parse   packed   shared" << std::endl;
+    for (const auto& model : NeuralModels)
+    {
+        const std::string path = options.models + "/" + model.file;
+        std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(30) << model.name << std::right;
+        for (bool quantized : { false, true })
+        {
+            uint64_t key = 0;
+            std::shared_ptr<const CpuBackend::NeuralNetwork> network;
+            if (CpuBackend::NeuralNetworkKey(path, quantized, key) != RIF_SUCCESS)
+            {
+                std::cout << std::setw(27) << "-";
+                continue;
+            }
+            const std::string packedPath = CpuBackend::PackedNeuralNetworkPath(options.cache, key);
+            std::remove(packedPath.c_str());
+            CpuBackend::TrimNeuralNetworkCache();
+            const double parseMs = TimeMs(1, [&]() { CpuBackend::AcquireNeuralNetwork(path, quantized, options.cache, network); });
+            network.reset();
+            CpuBackend::TrimNeuralNetworkCache();
+            const double packedMs = TimeMs(1, [&]() { CpuBackend::AcquireNeuralNetwork(path, quantized, options.cache, network); });
+            const double sharedMs = TimeMs(options.repeat, [&]()
+            {
+                std::shared_ptr<const CpuBackend::NeuralNetwork> other;
+                CpuBackend::AcquireNeuralNetwork(path, quantized, options.cache, other);
+            });
+            std::remove(packedPath.c_str());
+            std::cout << std::setw(13) << parseMs << std::setw(9) << packedMs << std::setw(9) << sharedMs;
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+    CpuBackend::TrimNeuralNetworkCache();
+
+    // a window dragged larger, 6x4 pixels a frame, through the fast upscaler: every
+    // frame plans and allocates at its exact size, buckets only when one is crossed
+    const size_t frames = 16;
+    std::vector<std::unique_ptr<CpuBackend::Image>> inputs;
+    std::vector<std::unique_ptr<CpuBackend::Image>> outputs;
+    for (size_t frame = 0; frame < frames; ++frame)
+    {
+        const size_t frameWidth = width + 6 * frame;
+        const size_t frameHeight = height + 4 * frame;
+        inputs.push_back(ToImage(MakeTestImage(frameWidth, frameHeight), 4, RIF_COMPONENT_TYPE_FLOAT32));
+        outputs.push_back(MakeImage(2 * frameWidth, 2 * frameHeight, 4, RIF_COMPONENT_TYPE_FLOAT32));
+    }
+    BenchmarkNeuralBatch(pool, options);
+    BenchmarkNeuralTemporal(pool, options);
+
+    std::cout << "AI upscale while resizing, " << frames << " frames    shapeBucket   ms/frame   misses" << std::endl;
+    for (rif_uint bucket : { 0u, 64u, 128u })
+    {
+        CpuBackend::AiUpscaleFilter upscale;
+        upscale.SetParameterString("modelPath", options.models);
+        upscale.SetParameter1u("mode", RIF_AI_UPSCALE_MODE_FAST_2X);
+        upscale.SetParameter1u("shapeBucket", bucket);
+        upscale.Execute(pool, *inputs[0], *outputs[0]);
+        const double ms = TimeMs(1, [&]()
+        {
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                upscale.Execute(pool, *inputs[frame], *outputs[frame]);
+            }
+        });
+        std::cout << std::fixed << std::setprecision(2) << std::setw(49) << bucket << std::setw(11) << ms / double(frames)
+            << std::setw(9) << upscale.BucketStatistics().misses - 1 << std::defaultfloat << std::endl;
+    }
+}
+
+struct Section
+{
+    const char* name;
+    bool (*test)(CpuBackend::ThreadPool&, const Options&);
+    void (*benchmark)(CpuBackend::ThreadPool&, const Options&);
+};
+
+const Section Sections[] =
+{
+    { "blur", TestBlur, BenchmarkBlur },
+    { "median", TestMedian, BenchmarkMedian },
+    { "morphology", TestMorphology, BenchmarkMorphology },
+    { "bilateral", TestBilateral, BenchmarkBilateral },
+    { "eaw", TestEaw, BenchmarkEaw },
+    { "lwr", TestLwr, BenchmarkLwr },
+    { "mlaa", TestMlaa, BenchmarkMlaa },
+    { "statistics", TestStatistics, BenchmarkStatistics },
+    { "tonemap", TestToneMap, BenchmarkToneMap },
+    { "resample", TestResample, BenchmarkResample },
+    { "orientation", TestOrientation, BenchmarkOrientation },
+    { "expression", TestExpression, BenchmarkExpression },
+    { "userdefined", TestUserDefined, BenchmarkUserDefined },
+    { "neural", TestNeural, BenchmarkNeural },
+};
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-h"))
+    {
+        std::cout << "Usage: CpuBenchmarks [-test] [-only <section>] [-threads <n>] [-width <w>] [-height <h>] [-repeat <n>] [-images <dir>] [-models <dir>] [-cache <dir>]" << std::endl;
+        std::cout << "Sections:";
+        for (const auto& section : Sections)
+        {
+            std::cout << " " << section.name;
+        }
+        std::cout << std::endl;
+        return 0;
+    }
+
+    Options options;
+    options.width = cmd.GetOption<size_t>("-width", options.width);
+    options.height = cmd.GetOption<size_t>("-height", options.height);
+    options.repeat = std::max(1, cmd.GetOption("-repeat", options.repeat));
+    options.images = cmd.GetOption<std::string>("-images", options.images);
+    options.models = cmd.GetOption<std::string>("-models", options.models);
+    options.cache = cmd.GetOption<std::string>("-cache", options.cache);
+    const bool testOnly = cmd.OptionExists("-test");
+    const std::string only = cmd.GetOption<std::string>("-only", "");
+
+    CpuBackend::ThreadPool pool(cmd.GetOption("-threads", 0u));
+
+    bool pass = true;
+    for (const auto& section : Sections)
+    {
+        if (!only.empty() && only != section.name)
+        {
+            continue;
+        }
+        pass &= section.test(pool, options);
+        if (!testOnly)
+        {
+            section.benchmark(pool, options);
+        }
+    }
+
+    std::cout << (pass ? "All checks passed" : "Some checks FAILED") << std::endl;
+    return pass ? 0 : ERRCODE;
+}
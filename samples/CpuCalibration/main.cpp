@@ -0,0 +1,250 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../CpuBackend/image_io.h"
+#include "../CpuBackend/image_quality.h"
+#include "../Utils/cmd_parser.h"
+
+// Writes the int8 calibration files of the AI models for RIF_COMPUTE_TYPE_INT8 on the
+// host and reports what quantization costs. Every model runs in float over crops of
+// the calibration images to record the ranges its convolutions read; the file goes
+// next to the model. The quantized network is then compared with the float one on
+// crops of the evaluation images, which the calibration never saw.
+//
+// .bin inputs are the raw single channel float AOVs of the AIDenoiser sample
+// (-binsize), used as grey colour; other files are read as images.
+
+const char* const Models[] =
+{
+    "denoise_c3_ldr_float16.onnx",
+    "upscale2x_c3_rt_f16.onnx",
+    "upscale2x_fast.pb",
+    "esrgan-03x2x32-273866.pb",
+};
+
+std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool LoadInput(const std::string& path, size_t binWidth, size_t binHeight, CpuBackend::ThreadPool& pool, CpuBackend::FloatImage& image)
+{
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<float> values(binWidth * binHeight);
+        if (!file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float)))
+        {
+            return false;
+        }
+        image.Resize(binWidth, binHeight);
+        for (size_t y = 0; y < binHeight; ++y)
+        {
+            for (size_t x = 0; x < binWidth; ++x)
+            {
+                const float value = values[y * binWidth + x];
+                std::fill(image.Row(y) + x * 4, image.Row(y) + x * 4 + 3, value);
+                image.Row(y)[x * 4 + 3] = 1.0f;
+            }
+        }
+        return true;
+    }
+
+    CpuBackend::Context context(1);
+    CpuBackend::Image* loaded = nullptr;
+    if (CpuBackend::LoadImage(&context, path, &loaded) != RIF_SUCCESS)
+    {
+        return false;
+    }
+    image.Load(pool, *loaded);
+    CpuBackend::ObjectDelete(loaded);
+    return true;
+}
+
+// 'tiles' x 'tiles' crops of 'size' spread evenly over 'image', colour clamped to [0, 1]
+// as the filters do
+void AppendCrops(const CpuBackend::FloatImage& image, size_t size, size_t tiles, std::vector<CpuBackend::NeuralTensor>& crops)
+{
+    const size_t width = std::min(size, image.Width());
+    const size_t height = std::min(size, image.Height());
+    for (size_t ty = 0; ty < tiles; ++ty)
+    {
+        for (size_t tx = 0; tx < tiles; ++tx)
+        {
+            const size_t left = tiles > 1 ? (image.Width() - width) * tx / (tiles - 1) : (image.Width() - width) / 2;
+            const size_t top = tiles > 1 ? (image.Height() - height) * ty / (tiles - 1) : (image.Height() - height) / 2;
+            CpuBackend::NeuralTensor crop;
+            crop.Resize(width, height, 3);
+            for (size_t y = 0; y < height; ++y)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    for (size_t c = 0; c < 3; ++c)
+                    {
+                        crop.Pixel(long(x), long(y))[c] = std::min(std::max(image.Row(top + y)[(left + x) * 4 + c], 0.0f), 1.0f);
+                    }
+                }
+            }
+            crops.push_back(std::move(crop));
+        }
+    }
+}
+
+CpuBackend::FloatImage ToFloatImage(const CpuBackend::NeuralTensor& tensor)
+{
+    CpuBackend::FloatImage image(tensor.Width(), tensor.Height());
+    for (size_t y = 0; y < tensor.Height(); ++y)
+    {
+        for (size_t x = 0; x < tensor.Width(); ++x)
+        {
+            const float* pixel = tensor.Pixel(long(x), long(y));
+            for (size_t c = 0; c < 3; ++c)
+            {
+                image.Row(y)[x * 4 + c] = std::min(std::max(pixel[c], 0.0f), 1.0f);
+            }
+            image.Row(y)[x * 4 + 3] = 1.0f;
+        }
+    }
+    return image;
+}
+
+template <typename Function>
+double TimeMs(Function function)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    function();
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-h"))
+    {
+        std::cout << "Usage: CpuCalibration [-models <dir>] [-images <dir>] [-calibrate <files>] [-evaluate <files>]" << std::endl;
+        std::cout << "       [-crop <size>] [-tiles <n per side>] [-binsize <width>x<height>] [-threads <n>]" << std::endl;
+        std::cout << "       file lists are comma separated names in the images directory" << std::endl;
+        return 0;
+    }
+
+    const std::string models = cmd.GetOption<std::string>("-models", "models");
+    const std::string images = cmd.GetOption<std::string>("-images", "images");
+    const std::vector<std::string> calibrationFiles = SplitList(cmd.GetOption<std::string>("-calibrate",
+        "cam_1_gloss_spp_8.bin,cam_5_gloss_spp_8.bin,albedo.jpg"));
+    const std::vector<std::string> evaluationFiles = SplitList(cmd.GetOption<std::string>("-evaluate", "cam_12_gloss_spp_8.bin,color.jpg"));
+    const size_t crop = std::max<size_t>(16, cmd.GetOption<size_t>("-crop", 128));
+    const size_t tiles = std::max<size_t>(1, cmd.GetOption<size_t>("-tiles", 2));
+    const std::string binSize = cmd.GetOption<std::string>("-binsize", "800x600");
+    const size_t binWidth = std::strtoul(binSize.c_str(), nullptr, 10);
+    const size_t binHeight = binSize.find('x') == std::string::npos ? 0 : std::strtoul(binSize.c_str() + binSize.find('x') + 1, nullptr, 10);
+    CpuBackend::ThreadPool pool(cmd.GetOption("-threads", 0u));
+
+    std::vector<CpuBackend::NeuralTensor> calibrationCrops;
+    std::vector<CpuBackend::NeuralTensor> evaluationCrops;
+    for (int set = 0; set < 2; ++set)
+    {
+        for (const std::string& name : set == 0 ? calibrationFiles : evaluationFiles)
+        {
+            CpuBackend::FloatImage image;
+            if (!LoadInput(images + "/" + name, binWidth, binHeight, pool, image))
+            {
+                std::cerr << "Couldn't read " << images << "/" << name << std::endl;
+                return ERRCODE;
+            }
+            AppendCrops(image, crop, tiles, set == 0 ? calibrationCrops : evaluationCrops);
+        }
+    }
+    std::cout << calibrationCrops.size() << " calibration and " << evaluationCrops.size() << " evaluation crops of " << crop << "x" << crop
+        << ", " << pool.ThreadCount() << " threads" << std::endl;
+
+    std::cout << "  model                          PSNR dB      SSIM   float ms   int8 ms   speedup" << std::endl;
+    for (const char* file : Models)
+    {
+        const std::string path = models + "/" + file;
+        CpuBackend::NeuralNetwork network;
+        if (CpuBackend::LoadNeuralNetwork(path, network) != RIF_SUCCESS)
+        {
+            std::cerr << "  " << network.error << std::endl;
+            return ERRCODE;
+        }
+
+        CpuBackend::NeuralCalibration calibration;
+        for (const CpuBackend::NeuralTensor& input : calibrationCrops)
+        {
+            CpuBackend::CalibrateNeuralNetwork(pool, network, input, calibration);
+        }
+        CpuBackend::NeuralNetwork quantized;
+        if (CpuBackend::SaveNeuralCalibration(CpuBackend::NeuralCalibrationPath(path), calibration) != RIF_SUCCESS ||
+            CpuBackend::QuantizeNeuralNetwork(network, calibration, quantized) != RIF_SUCCESS)
+        {
+            std::cerr << "  Couldn't write " << CpuBackend::NeuralCalibrationPath(path) << std::endl;
+            return ERRCODE;
+        }
+
+        // averages over the evaluation crops; the PSNR of identical crops counts as 100 dB
+        double psnr = 0.0;
+        double ssim = 0.0;
+        double floatMs = 0.0;
+        double int8Ms = 0.0;
+        for (const CpuBackend::NeuralTensor& input : evaluationCrops)
+        {
+            CpuBackend::NeuralTensor reference;
+            CpuBackend::NeuralTensor result;
+            floatMs += TimeMs([&]() { CpuBackend::RunNeuralNetwork(pool, network, input, reference); });
+            int8Ms += TimeMs([&]() { CpuBackend::RunNeuralNetwork(pool, quantized, input, result); });
+            const CpuBackend::FloatImage a = ToFloatImage(result);
+            const CpuBackend::FloatImage b = ToFloatImage(reference);
+            psnr += std::min(100.0, CpuBackend::ImagePsnr(a, b));
+            ssim += CpuBackend::ImageSsim(a, b);
+        }
+        const double count = double(evaluationCrops.size());
+        std::cout << std::fixed << "  " << std::left << std::setw(28) << file << std::right << std::setprecision(2) << std::setw(10)
+            << psnr / count << std::setprecision(5) << std::setw(10) << ssim / count << std::setprecision(1) << std::setw(11)
+            << floatMs / count << std::setw(10) << int8Ms / count << std::setprecision(2) << std::setw(9) << floatMs / int8Ms
+            << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,450 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../CpuBackend/image_io.h"
+#include "../Utils/cmd_parser.h"
+
+// filters selectable with -filter; 'setup' reads the filter options from the command line
+struct FilterEntry
+{
+    const char* name;
+    rif_image_filter_type type;
+    rif_int (*setup)(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image* input);
+};
+
+rif_int NoSetup(CpuBackend::Filter*, const utils::CmdParser&, CpuBackend::Image*)
+{
+    return RIF_SUCCESS;
+}
+
+rif_int SetupGamma(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1f("cGamma", cmd.GetOption("-gamma", 2.2f));
+}
+
+rif_int SetupBlur(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    rif_int status = filter->SetParameter1u("radius", cmd.GetOption("-radius", 8u));
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1f("sigma", cmd.GetOption("-sigma", 0.0f));
+    }
+    return status;
+}
+
+rif_int SetupMedian(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1u("radius", cmd.GetOption("-radius", 2u));
+}
+
+// the input guides itself, which is how the Denoisers sample starts too
+rif_int SetupBilateral(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image* input)
+{
+    const float sigma = cmd.GetOption("-sigma", 0.1f);
+    rif_int status = filter->SetParameterImageArray("inputs", &input, 1);
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameterFloatArray("sigmas", &sigma, 1);
+    }
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1u("radius", cmd.GetOption("-radius", 10u));
+    }
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1u("bilateralMode", cmd.GetOption("-mode", 0u));
+    }
+    return status;
+}
+
+// without guides only the colour distance stops the wavelet
+rif_int SetupEaw(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    rif_int status = filter->SetParameter1u("iterations", cmd.GetOption("-iterations", 4u));
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1f("colorSigma", cmd.GetOption("-sigma", 0.5f));
+    }
+    return status;
+}
+
+// without guides the regression falls back to a variance weighted box mean
+rif_int SetupLwr(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1u("radius", cmd.GetOption("-radius", 6u));
+}
+
+rif_int SetupMlaa(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1f("colorTreshold", cmd.GetOption("-threshold", 0.1f));
+}
+
+rif_int SetupResample(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1u("interpOperator", cmd.GetOption("-interp", static_cast<rif_uint>(RIF_IMAGE_INTERPOLATION_LANCZOS3)));
+}
+
+rif_int SetupMorphology(CpuBackend::Filter* filter, const utils::CmdParser& cmd, rif_uint mode)
+{
+    rif_int status = filter->SetParameter1u("mode", mode);
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1u("radius", cmd.GetOption("-radius", 4u));
+    }
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1u("shape", cmd.GetOption("-shape", 0u));
+    }
+    return status;
+}
+
+rif_int SetupDilate(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return SetupMorphology(filter, cmd, RIF_DILATE);
+}
+
+rif_int SetupErode(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return SetupMorphology(filter, cmd, RIF_ERODE);
+}
+
+rif_int SetupRotate(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    return filter->SetParameter1f("angle", cmd.GetOption("-angle", 90.0f));
+}
+
+// the second operand is the input itself, which is enough to exercise the arithmetic
+rif_int SetupArithmetic(CpuBackend::Filter* filter, const utils::CmdParser&, CpuBackend::Image* input)
+{
+    return filter->SetParameterImage("srcImg", input);
+}
+
+// 'b' is the input again and k0, k1 are fixed, enough to exercise a fused expression
+rif_int SetupExpression(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image* input)
+{
+    const float scalars[] = { 0.5f, 2.0f };
+    rif_int status = filter->SetParameterString("expression", cmd.GetOption("-expr", std::string("a * k0 + max(a, b) / k1")));
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameterImageArray("inputs", &input, 1);
+    }
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameterFloatArray("scalars", scalars, 2);
+    }
+    return status;
+}
+
+// the vignette of the UserDefined sample unless -code names a file with another kernel
+rif_int SetupUser(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    std::string code =
+        "int2 coord;\n"
+        "int2 size = GET_BUFFER_SIZE(outputImage);\n"
+        "GET_COORD_OR_RETURN(coord, size);\n"
+        "vec4 pixel = ReadPixelTyped(inputImage, coord.x, coord.y);\n"
+        "vec2 dxy = convert_vec2(coord) / convert_vec2(size) - (vec2)0.5f;\n"
+        "pixel = mix(1.0f, pixel, exp(-dot(dxy, dxy) * 5));\n"
+        "WritePixelTyped(outputImage, coord.x, coord.y, pixel);\n";
+    if (cmd.OptionExists("-code"))
+    {
+        std::ifstream file(cmd.GetOption<std::string>("-code", ""));
+        if (!file)
+        {
+            std::cerr << "Couldn't read " << cmd.GetOption<std::string>("-code", "") << std::endl;
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+        code.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    const auto kernel = CpuBackend::CompileUserKernel(code);
+    if (!kernel->valid)
+    {
+        std::cerr << "Kernel error: " << kernel->error << std::endl;
+        return RIF_ERROR_INVALID_PARAMETER;
+    }
+    return filter->SetParameterString("code", code);
+}
+
+rif_int SetupAiDenoise(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image*)
+{
+    rif_int status = filter->SetParameterString("modelPath", cmd.GetOption<std::string>("-models", "models"));
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameterString("cachePath", cmd.GetOption<std::string>("-cache", ""));
+    }
+    if (status == RIF_SUCCESS && cmd.OptionExists("-int8"))
+    {
+        status = filter->SetComputeType(RIF_COMPUTE_TYPE_INT8);
+    }
+    return status;
+}
+
+rif_int SetupAiUpscale(CpuBackend::Filter* filter, const utils::CmdParser& cmd, CpuBackend::Image* input)
+{
+    rif_int status = SetupAiDenoise(filter, cmd, input);
+    if (status == RIF_SUCCESS)
+    {
+        status = filter->SetParameter1u("mode", cmd.GetOption("-mode", static_cast<rif_uint>(RIF_AI_UPSCALE_MODE_GOOD_2X)));
+    }
+    return status;
+}
+
+const FilterEntry Filters[] =
+{
+    { "gamma", RIF_IMAGE_FILTER_GAMMA_CORRECTION, SetupGamma },
+    { "flipv", RIF_IMAGE_FILTER_FLIP_VERT, NoSetup },
+    { "fliph", RIF_IMAGE_FILTER_FLIP_HOR, NoSetup },
+    { "rotate", RIF_IMAGE_FILTER_ROTATE, SetupRotate },
+    { "add", RIF_IMAGE_FILTER_ADD, SetupArithmetic },
+    { "mul", RIF_IMAGE_FILTER_MUL, SetupArithmetic },
+    { "expression", RIF_IMAGE_FILTER_EXPRESSION, SetupExpression },
+    { "user", RIF_IMAGE_FILTER_USER_DEFINED, SetupUser },
+    { "bgra", RIF_IMAGE_FILTER_BGRA_TO_RGBA, NoSetup },
+    { "convert", RIF_IMAGE_FILTER_CONVERT, NoSetup },
+    { "resample", RIF_IMAGE_FILTER_RESAMPLE, SetupResample },
+    { "blur", RIF_IMAGE_FILTER_GAUSSIAN_BLUR, SetupBlur },
+    { "median", RIF_IMAGE_FILTER_MEDIAN_DENOISE, SetupMedian },
+    { "dilate", RIF_IMAGE_FILTER_DILATE_ERODE, SetupDilate },
+    { "erode", RIF_IMAGE_FILTER_DILATE_ERODE, SetupErode },
+    { "bilateral", RIF_IMAGE_FILTER_BILATERAL_DENOISE, SetupBilateral },
+    { "eaw", RIF_IMAGE_FILTER_EAW_DENOISE, SetupEaw },
+    { "lwr", RIF_IMAGE_FILTER_LWR_DENOISE, SetupLwr },
+    { "mlaa", RIF_IMAGE_FILTER_MLAA, SetupMlaa },
+    { "aidenoise", RIF_IMAGE_FILTER_AI_DENOISE, SetupAiDenoise },
+    { "aiupscale", RIF_IMAGE_FILTER_AI_UPSCALE, SetupAiUpscale },
+    { "linear", RIF_IMAGE_FILTER_LINEAR_TONEMAP, NoSetup },
+    { "exponential", RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP, NoSetup },
+    { "reinhard02", RIF_IMAGE_FILTER_REINHARD02_TONEMAP, NoSetup },
+    { "drago", RIF_IMAGE_FILTER_DRAGO_TONEMAP, NoSetup },
+    { "filmic", RIF_IMAGE_FILTER_FILMIC_TONEMAP, NoSetup },
+    { "aces", RIF_IMAGE_FILTER_ACES_TONEMAP, NoSetup },
+    { "maxwhite", RIF_IMAGE_FILTER_MAXWHITE_TONEMAP, NoSetup },
+    { "photolinear", RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP, NoSetup },
+    { "photo", RIF_IMAGE_FILTER_PHOTO_TONEMAP, NoSetup },
+    { "uncharted", RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP, NoSetup },
+    { "autolinear", RIF_IMAGE_FILTER_AUTOLINEAR_TONEMAP, NoSetup },
+    { "normalize", RIF_IMAGE_FILTER_NORMALIZATION, NoSetup },
+};
+
+void PrintUsage()
+{
+    std::cout << "Usage: CpuFilters [-i <image>] [-o <image>] [-filter <name>] [-threads <n>] [-repeat <n>]" << std::endl;
+    std::cout << "       -gamma <value> for gamma, -radius <n> -sigma <value> for blur, -radius <n> for median," << std::endl;
+    std::cout << "       -radius <n> -sigma <range sigma> -mode <0 auto, 1 exact, 2 grid> for bilateral," << std::endl;
+    std::cout << "       -iterations <n> -sigma <colour sigma> for eaw, -radius <n> for lwr," << std::endl;
+    std::cout << "       -threshold <luma difference> for mlaa," << std::endl;
+    std::cout << "       -interp <RIF_IMAGE_INTERPOLATION_*> -scale <output / input size> for resample," << std::endl;
+    std::cout << "       -angle <clockwise degrees> for rotate," << std::endl;
+    std::cout << "       -radius <n> -shape <0 rectangle, 1 disk> for dilate and erode," << std::endl;
+    std::cout << "       -expr <expression over a, b = a, k0 = 0.5, k1 = 2, without spaces> for expression," << std::endl;
+    std::cout << "       -code <file with a UserDefined kernel> for user," << std::endl;
+    std::cout << "       -models <directory> [-int8] [-cache <directory>] for aidenoise and aiupscale, -mode <RIF_AI_UPSCALE_MODE_*> for aiupscale" << std::endl;
+    std::cout << "Filters:";
+    for (const auto& entry : Filters)
+    {
+        std::cout << " " << entry.name;
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-h"))
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    const std::string inputPath = cmd.GetOption<std::string>("-i", "images/color.jpg");
+    const std::string outputPath = cmd.GetOption<std::string>("-o", "out.png");
+    const std::string filterName = cmd.GetOption<std::string>("-filter", "gamma");
+    const unsigned threads = cmd.GetOption("-threads", 0u);
+    const int repeat = std::max(1, cmd.GetOption("-repeat", 1));
+
+    const FilterEntry* entry = nullptr;
+    for (const auto& candidate : Filters)
+    {
+        if (filterName == candidate.name)
+        {
+            entry = &candidate;
+        }
+    }
+    if (!entry)
+    {
+        PrintUsage();
+        return ERRCODE;
+    }
+
+    // the GPU backend is preferred when there is one; this sample always runs on the host
+    int gpuCount = 0;
+    if (CpuBackend::GetDeviceCount(BACKEND_TYPE, &gpuCount) != RIF_SUCCESS)
+    {
+        gpuCount = 0;
+    }
+
+    rif_int status = RIF_SUCCESS;
+    int deviceCount = 0;
+    status = CpuBackend::GetDeviceCount(RIF_BACKEND_API_CPU, &deviceCount);
+    if (status != RIF_SUCCESS || deviceCount == 0)
+    {
+        return ERRCODE;
+    }
+
+    char name[256] = {};
+    char vendor[256] = {};
+    rif_uint64 memory = 0;
+    rif_uint threadCount = 0;
+    size_t retSize = 0;
+    CpuBackend::GetDeviceInfo(RIF_BACKEND_API_CPU, DEVICE, RIF_DEVICE_NAME, sizeof(name), name, &retSize);
+    CpuBackend::GetDeviceInfo(RIF_BACKEND_API_CPU, DEVICE, RIF_DEVICE_VENDOR, sizeof(vendor), vendor, &retSize);
+    CpuBackend::GetDeviceInfo(RIF_BACKEND_API_CPU, DEVICE, RIF_DEVICE_MEMORY_SIZE, sizeof(memory), &memory, &retSize);
+    CpuBackend::GetDeviceInfo(RIF_BACKEND_API_CPU, DEVICE, RIF_DEVICE_THREAD_COUNT, sizeof(threadCount), &threadCount, &retSize, threads);
+
+    std::cout << "GPU devices: " << gpuCount << std::endl;
+    std::cout << "CPU device : " << name << " (" << vendor << "), " << (memory >> 20) << " MiB, "
+        << threadCount << " threads" << std::endl;
+
+    CpuBackend::Context* context = nullptr;
+    status = CpuBackend::CreateContext(RIF_BACKEND_API_CPU, DEVICE, threads, &context);
+    if (status != RIF_SUCCESS || !context)
+    {
+        return ERRCODE;
+    }
+
+    CpuBackend::CommandQueue* queue = nullptr;
+    status = context->CreateCommandQueue(&queue);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    CpuBackend::Image* inputImage = nullptr;
+    status = CpuBackend::LoadImage(context, inputPath, &inputImage);
+    if (status != RIF_SUCCESS)
+    {
+        std::cerr << "Couldn't load " << inputPath << std::endl;
+        return ERRCODE;
+    }
+
+    // only the resampler, the upscaler and quarter rotations change the size
+    rif_image_desc outputDesc = inputImage->Desc();
+    if (entry->type == RIF_IMAGE_FILTER_ROTATE && std::lround(cmd.GetOption("-angle", 90.0f) / 90.0f) % 2 != 0)
+    {
+        std::swap(outputDesc.image_width, outputDesc.image_height);
+        outputDesc.image_row_pitch = 0;
+        outputDesc.image_slice_pitch = 0;
+    }
+    if (entry->type == RIF_IMAGE_FILTER_RESAMPLE)
+    {
+        const float scale = cmd.GetOption("-scale", 0.5f);
+        outputDesc.image_width = std::max(1u, static_cast<rif_uint>(outputDesc.image_width * scale + 0.5f));
+        outputDesc.image_height = std::max(1u, static_cast<rif_uint>(outputDesc.image_height * scale + 0.5f));
+        outputDesc.image_row_pitch = 0;
+        outputDesc.image_slice_pitch = 0;
+    }
+    if (entry->type == RIF_IMAGE_FILTER_AI_UPSCALE)
+    {
+        outputDesc.image_width *= 2;
+        outputDesc.image_height *= 2;
+        outputDesc.image_row_pitch = 0;
+        outputDesc.image_slice_pitch = 0;
+    }
+
+    CpuBackend::Image* outputImage = nullptr;
+    status = context->CreateImage(&outputDesc, nullptr, &outputImage);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    CpuBackend::Filter* filter = nullptr;
+    status = context->CreateImageFilter(entry->type, &filter);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    status = entry->setup(filter, cmd, inputImage);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    status = queue->AttachImageFilter(filter, inputImage, outputImage);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    rif_performance_statistic statistics = {};
+    statistics.measure_execution_time = RIF_TRUE;
+    rif_uint64 best = ~0ull;
+    for (int i = 0; i < repeat; ++i)
+    {
+        status = context->ExecuteCommandQueue(queue, nullptr, nullptr, &statistics);
+        if (status != RIF_SUCCESS)
+        {
+            std::cerr << "Execution failed: " << rifGetErrorCodeString(status) << std::endl;
+            return ERRCODE;
+        }
+        best = std::min(best, statistics.execution_time);
+    }
+
+    const double megapixels = inputImage->Width() * double(inputImage->Height()) * 1e-6;
+    std::cout << entry->name << ": " << best * 1e-6 << " ms, " << megapixels / (best * 1e-9) << " MP/s" << std::endl;
+
+    status = CpuBackend::SaveImage(*outputImage, outputPath);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    //Free resources
+    queue->DetachImageFilter(filter);
+    CpuBackend::ObjectDelete(filter);
+    CpuBackend::ObjectDelete(inputImage);
+    CpuBackend::ObjectDelete(outputImage);
+    CpuBackend::ObjectDelete(queue);
+    CpuBackend::ObjectDelete(context);
+    return 0;
+}
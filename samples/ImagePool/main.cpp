@@ -0,0 +1,166 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../Utils/cmd_parser.h"
+#include "../Utils/image_pool.h"
+
+// Simulates an interactive viewer: every frame the viewport may change size and the
+// resample + blur chain is rebuilt with output and temporary images of the new size.
+// Run with -reuse to recycle the images through utils::ImagePool.
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    const bool reuse = cmd.OptionExists("-reuse");
+    const int frames = cmd.GetOption("-frames", 200);
+    const uint64_t byteCap = cmd.GetOption<uint64_t>("-cap", 64ull << 20);
+
+    rif_int status = RIF_SUCCESS;
+    rif_context context = nullptr;
+    rif_command_queue queue = nullptr;
+    rif_image_filter resampleFilter = nullptr;
+    rif_image_filter blurFilter = nullptr;
+
+    int deviceCount = 0;
+    status = rifGetDeviceCount(BACKEND_TYPE, &deviceCount);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    if (deviceCount > 0 || status)
+    {
+        status = rifCreateContext(RIF_API_VERSION, BACKEND_TYPE, DEVICE, nullptr, &context);
+        if (status != RIF_SUCCESS || !context)
+        {
+            return ERRCODE;
+        }
+    }
+    status = rifContextCreateCommandQueue(context, &queue);
+    if (status != RIF_SUCCESS || !queue)
+    {
+        return ERRCODE;
+    }
+
+    rif_image inputImage = ImageTools::LoadImage("images/color.jpg", context);
+    if (!inputImage)
+    {
+        return ERRCODE;
+    }
+
+    status = rifContextCreateImageFilter(context, RIF_IMAGE_FILTER_RESAMPLE, &resampleFilter);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    status = rifContextCreateImageFilter(context, RIF_IMAGE_FILTER_GAUSSIAN_BLUR, &blurFilter);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    rifImageFilterSetParameter1u(resampleFilter, "interpOperator", RIF_IMAGE_INTERPOLATION_BILINEAR);
+    rifImageFilterSetParameter1u(blurFilter, "radius", 3);
+    rifImageFilterSetParameter1f(blurFilter, "sigma", 2.0f);
+
+    utils::ImagePool pool(context, byteCap);
+    pool.SetReuseEnabled(reuse);
+
+    // a user dragging the window border back and forth
+    const rif_uint viewports[][2] = { { 640, 360 }, { 800, 450 }, { 1024, 576 }, { 800, 450 } };
+    const int framesPerViewport = 10;
+
+    rif_image_desc desc;
+    size_t retSize;
+    rifImageGetInfo(inputImage, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        const rif_uint* viewport = viewports[(frame / framesPerViewport) % 4];
+        desc.image_width = viewport[0];
+        desc.image_height = viewport[1];
+        desc.image_row_pitch = 0;
+        desc.image_slice_pitch = 0;
+
+        rif_image tempImage = nullptr;
+        rif_image outputImage = nullptr;
+        if (pool.Acquire(desc, &tempImage) != RIF_SUCCESS || pool.Acquire(desc, &outputImage) != RIF_SUCCESS)
+        {
+            return ERRCODE;
+        }
+
+        rifImageFilterSetParameter2u(resampleFilter, "outSize", viewport[0], viewport[1]);
+        status = rifCommandQueueAttachImageFilter(queue, resampleFilter, inputImage, tempImage);
+        if (status == RIF_SUCCESS)
+            status = rifCommandQueueAttachImageFilter(queue, blurFilter, tempImage, outputImage);
+        if (status == RIF_SUCCESS)
+            status = rifContextExecuteCommandQueue(context, queue, nullptr, nullptr, nullptr);
+        if (status == RIF_SUCCESS)
+            status = rifSyncronizeQueue(queue);
+        if (status != RIF_SUCCESS)
+        {
+            return ERRCODE;
+        }
+
+        if (frame + 1 == frames)
+        {
+            ImageTools::SaveImage(outputImage, "out.png");
+        }
+
+        rifCommandQueueDetachImageFilter(queue, resampleFilter);
+        rifCommandQueueDetachImageFilter(queue, blurFilter);
+        pool.Release(tempImage);
+        pool.Release(outputImage);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    auto stats = pool.GetStatistics();
+    std::cout << (reuse ? "Pooled" : "Unpooled") << " images, " << frames << " frames: "
+        << std::chrono::duration<double, std::milli>(end - start).count() / frames << " ms/frame" << std::endl;
+    std::cout << "hits " << stats.hits << ", misses " << stats.misses << ", trims " << stats.trims
+        << ", pooled " << stats.pooledImages << " images / " << (stats.pooledBytes >> 10) << " KiB" << std::endl;
+
+    //Free resources
+    pool.Clear();
+    rifObjectDelete(inputImage);
+    rifObjectDelete(resampleFilter);
+    rifObjectDelete(blurFilter);
+    rifObjectDelete(queue);
+    rifObjectDelete(context);
+    return 0;
+}
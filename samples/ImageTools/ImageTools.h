@@ -5,10 +5,24 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <vector>
 
 namespace ImageTools
 {
-
+    // swaps the rows of an image in place so the last row comes first
+    void FlipRows(void* data, size_t rowBytes, size_t rows)
+    {
+        unsigned char* bytes = static_cast<unsigned char*>(data);
+        std::vector<unsigned char> saved(rowBytes);
+        for (size_t y = 0; y < rows / 2; ++y)
+        {
+            unsigned char* top = bytes + y * rowBytes;
+            unsigned char* bottom = bytes + (rows - 1 - y) * rowBytes;
+            memcpy(saved.data(), top, rowBytes);
+            memcpy(top, bottom, rowBytes);
+            memcpy(bottom, saved.data(), rowBytes);
+        }
+    }
 
     int LoadEXRLikeTiny(float **out_rgba, int *width, int *height, const char *filename,
         const char **err)
@@ -214,6 +228,13 @@ namespace ImageTools
             }
         }
 
+        // tinyexr places the scanlines of DECREASING_Y files bottom-up although their
+        // y coordinates are absolute; swap them back so the top row always comes first
+        if (!exr_header.tiled && exr_header.line_order == 1)
+        {
+            FlipRows(*out_rgba, 4 * sizeof(float) * static_cast<size_t>(exr_image.width), static_cast<size_t>(exr_image.height));
+        }
+
         (*width) = exr_image.width;
         (*height) = exr_image.height;
 
@@ -0,0 +1,436 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// rif-warm: compiles the kernels of every standard filter ahead of time into the
+// content-addressed kernel cache, so the first rifContextExecuteCommandQueue of a
+// render node does not pay the compilation.
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../Utils/cmd_parser.h"
+#include "../Utils/kernel_cache.h"
+
+struct FilterInfo
+{
+    rif_image_filter_type type;
+    const char* name;
+    // image parameters the filter cannot run without, separated by commas; the warmer
+    // binds its input image to each of them
+    const char* images;
+};
+
+// the auxiliary images of the denoisers, as the Denoisers sample binds them
+const char* LwrImages = "vColorImg,transImg,vTransImg,normalsImg,vNormalsImg,depthImg,vDepthImg";
+const char* EawImages = "normalsImg,depthImg,transImg,colorVar";
+
+// AI filters are excluded: they compile model kernels and need models on disk
+const FilterInfo Filters[] =
+{
+    { RIF_IMAGE_FILTER_NORMALIZATION, "NORMALIZATION", "" },
+    { RIF_IMAGE_FILTER_GAMMA_CORRECTION, "GAMMA_CORRECTION", "" },
+    { RIF_IMAGE_FILTER_RESAMPLE, "RESAMPLE", "" },
+    { RIF_IMAGE_FILTER_RESAMPLE_DYNAMIC, "RESAMPLE_DYNAMIC", "" },
+    { RIF_IMAGE_FILTER_REMAP_RANGE, "REMAP_RANGE", "" },
+    { RIF_IMAGE_FILTER_GAUSSIAN_BLUR, "GAUSSIAN_BLUR", "" },
+    { RIF_IMAGE_FILTER_MOTION_BLUR, "MOTION_BLUR", "" },
+    { RIF_IMAGE_FILTER_COLOR_SPACE, "COLOR_SPACE", "" },
+    { RIF_IMAGE_FILTER_HUE_SATURATION, "HUE_SATURATION", "" },
+    { RIF_IMAGE_FILTER_FILMIC_TONEMAP, "FILMIC_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_ACES_TONEMAP, "ACES_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_REINHARD02_TONEMAP, "REINHARD02_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_EXPONENTIAL_TONEMAP, "EXPONENTIAL_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_LINEAR_TONEMAP, "LINEAR_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_DRAGO_TONEMAP, "DRAGO_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_AUTOLINEAR_TONEMAP, "AUTOLINEAR_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_MAXWHITE_TONEMAP, "MAXWHITE_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_PHOTO_LINEAR_TONEMAP, "PHOTO_LINEAR_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_PHOTO_TONEMAP, "PHOTO_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_FILMIC_UNCHARTED_TONEMAP, "FILMIC_UNCHARTED_TONEMAP", "" },
+    { RIF_IMAGE_FILTER_BILATERAL_DENOISE, "BILATERAL_DENOISE", "" },
+    { RIF_IMAGE_FILTER_LWR_DENOISE, "LWR_DENOISE", LwrImages },
+    { RIF_IMAGE_FILTER_EAW_DENOISE, "EAW_DENOISE", EawImages },
+    { RIF_IMAGE_FILTER_MEDIAN_DENOISE, "MEDIAN_DENOISE", "" },
+    { RIF_IMAGE_FILTER_MLAA, "MLAA", "depthImg" },
+    { RIF_IMAGE_FILTER_SOBEL, "SOBEL", "" },
+    { RIF_IMAGE_FILTER_LAPLACE, "LAPLACE", "" },
+    { RIF_IMAGE_FILTER_EMBOSS, "EMBOSS", "" },
+    { RIF_IMAGE_FILTER_WEIGHTED_SUM, "WEIGHTED_SUM", "" },
+    { RIF_IMAGE_FILTER_MULT, "MULT", "" },
+    { RIF_IMAGE_FILTER_SCALAR_MULT, "SCALAR_MULT", "" },
+    { RIF_IMAGE_FILTER_SHARPEN, "SHARPEN", "" },
+    { RIF_IMAGE_FILTER_MOTION_BUFFER, "MOTION_BUFFER", "" },
+    { RIF_IMAGE_FILTER_TEMPORAL_ACCUMULATOR, "TEMPORAL_ACCUMULATOR", "" },
+    { RIF_IMAGE_FILTER_SHADOW_CATCHER, "SHADOW_CATCHER", "" },
+    { RIF_IMAGE_FILTER_DILATE_ERODE, "DILATE_ERODE", "" },
+    { RIF_IMAGE_FILTER_POSTERIZE, "POSTERIZE", "" },
+    { RIF_IMAGE_FILTER_BLOOM, "BLOOM", "" },
+    { RIF_IMAGE_FILTER_BLOOM_REALTIME, "BLOOM_REALTIME", "" },
+    { RIF_IMAGE_FILTER_DEPTH_OF_FIELD, "DEPTH_OF_FIELD", "" },
+    { RIF_IMAGE_FILTER_NDC_DEPTH, "NDC_DEPTH", "" },
+    { RIF_IMAGE_FILTER_CONVERT, "CONVERT", "" },
+    { RIF_IMAGE_FILTER_BGRA_TO_RGBA, "BGRA_TO_RGBA", "" },
+    { RIF_IMAGE_FILTER_SPREAD, "SPREAD", "" },
+    { RIF_IMAGE_FILTER_RGB_NOISE, "RGB_NOISE", "" },
+    { RIF_IMAGE_FILTER_FLIP_VERT, "FLIP_VERT", "" },
+    { RIF_IMAGE_FILTER_FLIP_HOR, "FLIP_HOR", "" },
+    { RIF_IMAGE_FILTER_ROTATE, "ROTATE", "" },
+    { RIF_IMAGE_FILTER_ADD, "ADD", "srcImg" },
+    { RIF_IMAGE_FILTER_MUL, "MUL", "srcImg" },
+    { RIF_IMAGE_FILTER_SUB, "SUB", "srcImg" },
+    { RIF_IMAGE_FILTER_DIV, "DIV", "srcImg" },
+    { RIF_IMAGE_FILTER_MAX, "MAX", "srcImg" },
+    { RIF_IMAGE_FILTER_MIN, "MIN", "srcImg" },
+};
+
+struct WarmJob
+{
+    const FilterInfo* filter;
+    rif_component_type type;
+    rif_uint components;
+
+    rif_int status = RIF_SUCCESS;
+    float compileTime = 0.f;        // ms, as rif_performance_statistic::compile_time
+    double wallTimeMs = 0.0;
+};
+
+struct WarmSettings
+{
+    std::string cacheRoot = "./kernel_cache";
+    std::string sourceDir;
+    std::vector<rif_component_type> types = { RIF_COMPONENT_TYPE_UINT8, RIF_COMPONENT_TYPE_FLOAT16, RIF_COMPONENT_TYPE_FLOAT32 };
+    std::vector<rif_uint> channels = { 1, 3, 4 };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    rif_uint size = 64;
+};
+
+const char* ComponentTypeName(rif_component_type type)
+{
+    switch (type)
+    {
+    case RIF_COMPONENT_TYPE_UINT8:
+        return "uint8";
+    case RIF_COMPONENT_TYPE_FLOAT16:
+        return "float16";
+    case RIF_COMPONENT_TYPE_FLOAT32:
+        return "float32";
+    default:
+        return "unknown";
+    }
+}
+
+std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+void ShowHelp()
+{
+    std::cout << "rif-warm: precompiles filter kernels into the kernel cache\n"
+        << "  -cache <dir>       cache root (default ./kernel_cache)\n"
+        << "  -src <dir>         kernel source directory (RIF_CONTEXT_KERNELS_SOURCE_DIR)\n"
+        << "  -types <list>      component types, e.g. uint8,float16,float32\n"
+        << "  -channels <list>   channel counts, e.g. 1,3,4\n"
+        << "  -j <n>             number of parallel compilations\n"
+        << "  -h                 show this help" << std::endl;
+}
+
+bool ParseSettings(int argc, char* argv[], WarmSettings& s)
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-h"))
+    {
+        ShowHelp();
+        return false;
+    }
+
+    s.cacheRoot = cmd.GetOption("-cache", s.cacheRoot);
+    s.sourceDir = cmd.GetOption("-src", s.sourceDir);
+    s.threads = std::max(1u, cmd.GetOption("-j", s.threads));
+
+    if (cmd.OptionExists("-types"))
+    {
+        s.types.clear();
+        for (const auto& name : SplitList(cmd.GetOption("-types")))
+        {
+            if (name == "uint8")
+                s.types.push_back(RIF_COMPONENT_TYPE_UINT8);
+            else if (name == "float16")
+                s.types.push_back(RIF_COMPONENT_TYPE_FLOAT16);
+            else if (name == "float32")
+                s.types.push_back(RIF_COMPONENT_TYPE_FLOAT32);
+            else
+            {
+                std::cerr << "Unknown component type " << name << std::endl;
+                return false;
+            }
+        }
+    }
+
+    if (cmd.OptionExists("-channels"))
+    {
+        s.channels.clear();
+        for (const auto& count : SplitList(cmd.GetOption("-channels")))
+        {
+            rif_uint n = static_cast<rif_uint>(std::stoul(count));
+            if (n < 1 || n > 4)
+            {
+                std::cerr << "Channel count must be in [1, 4]" << std::endl;
+                return false;
+            }
+            s.channels.push_back(n);
+        }
+    }
+
+    return true;
+}
+
+// binds 'image' to every image parameter 'filter' needs to run, so that the warm run
+// compiles the kernels a real run would instead of failing
+rif_int BindRequiredParameters(rif_image_filter filter, const FilterInfo& info, rif_image image)
+{
+    rif_int status = RIF_SUCCESS;
+    if (info.type == RIF_IMAGE_FILTER_BILATERAL_DENOISE)
+    {
+        float sigma = 0.1f;
+        status = rifImageFilterSetParameterImageArray(filter, "inputs", &image, 1);
+        if (status == RIF_SUCCESS)
+            status = rifImageFilterSetParameterFloatArray(filter, "sigmas", &sigma, 1);
+        if (status == RIF_SUCCESS)
+            status = rifImageFilterSetParameter1u(filter, "inputsNum", 1);
+    }
+    for (const auto& name : SplitList(info.images))
+    {
+        if (status == RIF_SUCCESS)
+            status = rifImageFilterSetParameterImage(filter, name.c_str(), image);
+    }
+    return status;
+}
+
+// Runs the filter once on a small image; the first execution compiles the kernels
+// and stores the binaries in the context's cache directory
+void WarmFilter(rif_context context, rif_command_queue queue, rif_uint size, WarmJob& job)
+{
+    rif_image_filter filter = nullptr;
+    rif_image inputImage = nullptr;
+    rif_image outputImage = nullptr;
+
+    rif_image_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.image_width = size;
+    desc.image_height = size;
+    desc.num_components = job.components;
+    desc.type = job.type;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    job.status = rifContextCreateImageFilter(context, job.filter->type, &filter);
+    if (job.status == RIF_SUCCESS)
+        job.status = rifContextCreateImage(context, &desc, nullptr, &inputImage);
+    if (job.status == RIF_SUCCESS)
+        job.status = rifContextCreateImage(context, &desc, nullptr, &outputImage);
+    if (job.status == RIF_SUCCESS)
+        job.status = BindRequiredParameters(filter, *job.filter, inputImage);
+    if (job.status == RIF_SUCCESS)
+        job.status = rifCommandQueueAttachImageFilter(queue, filter, inputImage, outputImage);
+
+    if (job.status == RIF_SUCCESS)
+    {
+        rif_performance_statistic stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.measure_compile_time = RIF_TRUE;
+
+        job.status = rifContextExecuteCommandQueue(context, queue, nullptr, nullptr, &stats);
+        if (job.status == RIF_SUCCESS)
+        {
+            job.status = rifSyncronizeQueue(queue);
+        }
+        job.compileTime = stats.compile_time;
+
+        rifCommandQueueDetachImageFilter(queue, filter);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    job.wallTimeMs = std::chrono::duration<double, std::milli>(end - start).count();
+
+    rifObjectDelete(inputImage);
+    rifObjectDelete(outputImage);
+    rifObjectDelete(filter);
+}
+
+// Each worker owns its context and queue, contexts are not shared between threads
+rif_int RunWorker(const WarmSettings& settings, std::vector<WarmJob>& jobs, std::atomic<size_t>& next)
+{
+    rif_context context = nullptr;
+    rif_command_queue queue = nullptr;
+
+    rif_int status = rifCreateContext(RIF_API_VERSION, BACKEND_TYPE, DEVICE, nullptr, &context);
+    if (status != RIF_SUCCESS || !context)
+    {
+        return status;
+    }
+
+    status = utils::SetKernelCacheDir(context, settings.cacheRoot, settings.sourceDir);
+    if (status == RIF_SUCCESS)
+    {
+        status = rifContextCreateCommandQueue(context, &queue);
+    }
+
+    if (status == RIF_SUCCESS)
+    {
+        for (size_t i = next++; i < jobs.size(); i = next++)
+        {
+            WarmFilter(context, queue, settings.size, jobs[i]);
+        }
+    }
+
+    rifObjectDelete(queue);
+    rifObjectDelete(context);
+    return status;
+}
+
+int main(int argc, char* argv[])
+{
+    WarmSettings settings;
+    try
+    {
+        if (!ParseSettings(argc, argv, settings))
+        {
+            return ERRCODE;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return ERRCODE;
+    }
+
+    int deviceCount = 0;
+    rif_int status = rifGetDeviceCount(BACKEND_TYPE, &deviceCount);
+    if (status != RIF_SUCCESS || deviceCount == 0)
+    {
+        std::cerr << "No devices available for the backend" << std::endl;
+        return ERRCODE;
+    }
+
+    std::string cacheDir = utils::KernelCacheDir(settings.cacheRoot, settings.sourceDir);
+    if (cacheDir.empty())
+    {
+        std::cerr << "Couldn't create cache directory under " << settings.cacheRoot << std::endl;
+        return ERRCODE;
+    }
+    std::cout << "Library: " << utils::LoadedLibraryPath() << std::endl;
+    std::cout << "Kernel cache: " << cacheDir << std::endl;
+
+    std::vector<WarmJob> jobs;
+    for (const auto& filter : Filters)
+    {
+        for (auto type : settings.types)
+        {
+            for (auto components : settings.channels)
+            {
+                WarmJob job;
+                job.filter = &filter;
+                job.type = type;
+                job.components = components;
+                jobs.push_back(job);
+            }
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<rif_int> workerStatus(std::min<size_t>(settings.threads, jobs.size()), RIF_SUCCESS);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < workerStatus.size(); ++i)
+    {
+        workers.emplace_back([&, i]()
+        {
+            workerStatus[i] = RunWorker(settings, jobs, next);
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    for (auto workerResult : workerStatus)
+    {
+        if (workerResult != RIF_SUCCESS)
+        {
+            std::cerr << "Worker failed: " << rifGetErrorCodeString(workerResult) << std::endl;
+            return ERRCODE;
+        }
+    }
+
+    size_t failed = 0;
+    std::cout << std::left << std::setw(28) << "filter" << std::setw(10) << "type" << std::setw(4) << "ch"
+        << std::right << std::setw(14) << "compile (ms)" << std::setw(14) << "wall (ms)" << std::endl;
+    for (const auto& job : jobs)
+    {
+        std::cout << std::left << std::setw(28) << job.filter->name << std::setw(10) << ComponentTypeName(job.type)
+            << std::setw(4) << job.components << std::right << std::fixed << std::setprecision(2);
+        if (job.status == RIF_SUCCESS)
+        {
+            std::cout << std::setw(14) << job.compileTime << std::setw(14) << job.wallTimeMs << std::endl;
+        }
+        else
+        {
+            std::cout << "  failed: " << rifGetErrorCodeString(job.status) << std::endl;
+            ++failed;
+        }
+    }
+
+    std::cout << jobs.size() - failed << " of " << jobs.size() << " kernels warmed with "
+        << workers.size() << " threads in "
+        << std::chrono::duration<double>(end - start).count() << " s" << std::endl;
+
+    // a kernel that did not run is not in the cache, and the first frame would pay for it
+    return failed == 0 ? 0 : ERRCODE;
+}
@@ -0,0 +1,65 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#define ERRCODE -1
+
+#include "../Utils/cmd_parser.h"
+#include "../Utils/ring_logger.h"
+
+// rif-logdecode: prints a binary log written by utils::RingLogSink as text
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    if (cmd.OptionExists("-h") || !cmd.OptionExists("-i"))
+    {
+        std::cout << "Usage: rif-logdecode -i <log.bin> [-o <log.txt>]" << std::endl;
+        return cmd.OptionExists("-h") ? 0 : ERRCODE;
+    }
+
+    const std::string inputPath = cmd.GetOption<std::string>("-i", "");
+    std::ifstream input(inputPath, std::ios::binary);
+    if (!input)
+    {
+        std::cerr << "Couldn't open " << inputPath << std::endl;
+        return ERRCODE;
+    }
+
+    std::ofstream file;
+    if (cmd.OptionExists("-o"))
+    {
+        file.open(cmd.GetOption<std::string>("-o", ""));
+        if (!file)
+        {
+            std::cerr << "Couldn't open " << cmd.GetOption<std::string>("-o", "") << std::endl;
+            return ERRCODE;
+        }
+    }
+
+    if (!utils::DecodeRingLog(input, file.is_open() ? file : std::cout))
+    {
+        std::cerr << inputPath << " is not a ring log" << std::endl;
+        return ERRCODE;
+    }
+    return 0;
+}
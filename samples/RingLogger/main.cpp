@@ -0,0 +1,166 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../Utils/cmd_parser.h"
+#include "../Utils/ring_logger.h"
+
+// Runs 'threads' writers logging 'messages' lines each, roughly the shape of an
+// INFO trace line. 'makeStream' returns the stream a writer thread logs into and
+// 'lock' is taken around every line when not nullptr.
+// returns the average cost of one line in nanoseconds, as seen by the writer
+template <typename MakeStream>
+double MeasureLogging(int threads, int messages, MakeStream makeStream, std::mutex* lock)
+{
+    std::vector<std::thread> workers;
+    std::vector<double> elapsed(threads);
+
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            std::ostream& stream = makeStream(t);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < messages; ++i)
+            {
+                if (lock)
+                {
+                    std::lock_guard<std::mutex> guard(*lock);
+                    stream << "[INFO] queue " << t << ": filter GAUSSIAN_BLUR executed, frame " << i << '\n';
+                }
+                else
+                {
+                    stream << "[INFO] queue " << t << ": filter GAUSSIAN_BLUR executed, frame " << i << '\n';
+                }
+            }
+            stream.flush();
+            elapsed[t] = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        });
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    double total = 0.0;
+    for (double e : elapsed)
+    {
+        total += e;
+    }
+    return total / (double(threads) * messages);
+}
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    const int threads = cmd.GetOption("-threads", 4);
+    const int messages = cmd.GetOption("-messages", 100000);
+    const std::string logPath = cmd.GetOption<std::string>("-o", "rif_log.bin");
+
+    // the baseline is what the stderr logger does: one shared stream, one lock per line.
+    // Redirect stderr (2>/dev/null) to keep terminal rendering out of the numbers.
+    std::ostream stderrStream(std::cerr.rdbuf());
+    std::mutex stderrLock;
+    double stderrCost = MeasureLogging(threads, messages,
+        [&](int) -> std::ostream& { return stderrStream; }, &stderrLock);
+
+    double ringCost = 0.0;
+    uint64_t dropped = 0;
+    {
+        utils::RingLogSink sink("bench_" + logPath, 1 << 16);
+        if (!sink.IsOpen())
+        {
+            std::cerr << "Couldn't open bench_" << logPath << std::endl;
+            return ERRCODE;
+        }
+
+        std::vector<std::unique_ptr<std::ostream>> streams;
+        for (int t = 0; t < threads; ++t)
+        {
+            streams.emplace_back(new std::ostream(sink.MessageBuffer()));
+        }
+        ringCost = MeasureLogging(threads, messages,
+            [&](int t) -> std::ostream& { return *streams[t]; }, nullptr);
+
+        sink.Flush();
+        dropped = sink.Dropped();
+    }
+
+    std::cout << "Logging " << threads << " threads x " << messages << " lines" << std::endl;
+    std::cout << "  stderr logger : " << stderrCost << " ns/line" << std::endl;
+    std::cout << "  ring sink     : " << ringCost << " ns/line (" << dropped << " lines dropped)" << std::endl;
+
+    // route the library log at INFO level into the sink while creating a context
+    utils::RingLogSink sink(logPath);
+    rif_int status = sink.Attach(RIF_LOG_LEVEL_INFO);
+    if (status != RIF_SUCCESS)
+    {
+        std::cerr << "rifLoggerAttach failed: " << rifGetErrorCodeString(status) << std::endl;
+        return ERRCODE;
+    }
+
+    rif_context context = nullptr;
+    int deviceCount = 0;
+    status = rifGetDeviceCount(BACKEND_TYPE, &deviceCount);
+    if (status == RIF_SUCCESS && deviceCount > 0)
+    {
+        status = rifCreateContext(RIF_API_VERSION, BACKEND_TYPE, DEVICE, nullptr, &context);
+    }
+
+    sink.Flush();
+    std::cout << "Library log written to " << logPath << ", decode it with rif-logdecode" << std::endl;
+
+    //Free resources
+    if (context)
+    {
+        rifObjectDelete(context);
+    }
+
+    // hand the library back to the default logger before the sink goes away
+    rif_logger_desc desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.level = RIF_LOG_LEVEL_DEFAULT;
+    desc.error.handle = stderr;
+    desc.message.handle = stdout;
+    rifLoggerAttach(&desc);
+    return 0;
+}
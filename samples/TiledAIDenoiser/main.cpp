@@ -0,0 +1,197 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "RadeonImageFilters.h"
+#include <algorithm>
+#include <iostream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define DEVICE 0
+
+#ifdef RIF_USE_METAL
+#define BACKEND_TYPE RIF_BACKEND_API_METAL
+#else
+#define BACKEND_TYPE RIF_BACKEND_API_OPENCL
+#endif // RIF_USE_METAL
+
+#define ERRCODE -1
+
+#include "../ImageTools/ImageTools.h"
+#include "../Utils/cmd_parser.h"
+#include "../Utils/tiled_filter.h"
+
+// Stand-in for rifGetModelMemorySize: fixed weights plus activations proportional to the
+// pixel count, roughly what the U-Net denoiser needs in float.
+rif_int MockModelMemorySize(const rif_image_desc& desc, rif_uint64* size)
+{
+    const rif_uint64 weights = 10ull << 20;
+    const rif_uint64 bytesPerPixel = 32 * 4 * 6;
+    *size = weights + rif_uint64(desc.image_width) * desc.image_height * bytesPerPixel;
+    return RIF_SUCCESS;
+}
+
+// Runs the planner against the mocked size function, no device needed. Checks that
+// every plan fits the budget, covers the image and that the next larger tile would not fit.
+int RunMockPlanner(rif_uint overlap)
+{
+    const rif_uint sizes[][2] = { { 800, 600 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 } };
+    const rif_uint64 budgets[] = { 256ull << 20, 1ull << 30, 4ull << 30 };
+    const rif_uint alignment = 16;
+
+    int failures = 0;
+    for (const auto& size : sizes)
+    {
+        for (auto budget : budgets)
+        {
+            rif_image_desc desc = {};
+            desc.image_width = size[0];
+            desc.image_height = size[1];
+            desc.num_components = 3;
+            desc.type = RIF_COMPONENT_TYPE_FLOAT32;
+
+            utils::TilePlan plan;
+            rif_int status = utils::PlanTiles(desc, budget, overlap, MockModelMemorySize, plan, &std::cout, alignment);
+            if (status != RIF_SUCCESS)
+            {
+                std::cout << "  no plan: " << rifGetErrorCodeString(status) << std::endl;
+                continue;
+            }
+
+            bool fits = plan.tileMemory <= budget;
+            bool covers = plan.tilesX * plan.tileWidth >= size[0] && plan.tilesY * plan.tileHeight >= size[1];
+            bool maximal = plan.TileCount() == 1;
+            if (!maximal)
+            {
+                rif_image_desc larger = desc;
+                larger.image_width = std::min(plan.tileWidth + alignment + 2 * overlap, size[0]);
+                larger.image_height = std::min(plan.tileHeight + alignment + 2 * overlap, size[1]);
+                rif_uint64 largerSize = 0;
+                MockModelMemorySize(larger, &largerSize);
+                maximal = largerSize > budget || plan.tileWidth + alignment > std::max(size[0], size[1]);
+            }
+
+            if (!(fits && covers && maximal))
+            {
+                std::cout << "  FAILED:" << (fits ? "" : " over budget") << (covers ? "" : " incomplete coverage")
+                    << (maximal ? "" : " tile not maximal") << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    std::cout << (failures ? "Planner checks failed" : "Planner checks passed") << std::endl;
+    return failures ? ERRCODE : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    utils::CmdParser cmd(argc, argv);
+    const rif_uint overlap = cmd.GetOption("-overlap", 32u);
+    if (cmd.OptionExists("-mock"))
+    {
+        return RunMockPlanner(overlap);
+    }
+
+    const rif_uint64 budget = cmd.GetOption<rif_uint64>("-budget", 512) << 20;
+    const std::string inputPath = cmd.GetOption<std::string>("-i", "images/color.jpg");
+
+    rif_int status = RIF_SUCCESS;
+    rif_context context = nullptr;
+    rif_command_queue queue = nullptr;
+    rif_image_filter denoiseFilter = nullptr;
+    rif_image outputImage = nullptr;
+
+    int deviceCount = 0;
+    status = rifGetDeviceCount(BACKEND_TYPE, &deviceCount);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    if (deviceCount > 0 || status)
+    {
+        status = rifCreateContext(RIF_API_VERSION, BACKEND_TYPE, DEVICE, nullptr, &context);
+        if (status != RIF_SUCCESS || !context)
+        {
+            return ERRCODE;
+        }
+    }
+    status = rifContextCreateCommandQueue(context, &queue);
+    if (status != RIF_SUCCESS || !queue)
+    {
+        return ERRCODE;
+    }
+
+    rif_image colorImg = ImageTools::LoadImage(inputPath, context);
+    if (!colorImg)
+    {
+        std::cerr << "Couldn't load " << inputPath << std::endl;
+        return ERRCODE;
+    }
+
+    rif_image_desc desc;
+    size_t retSize;
+    rifImageGetInfo(colorImg, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+    desc.type = RIF_COMPONENT_TYPE_FLOAT32;
+    status = rifContextCreateImage(context, &desc, nullptr, &outputImage);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    status = rifContextCreateImageFilter(context, RIF_IMAGE_FILTER_AI_DENOISE, &denoiseFilter);
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+    status = rifImageFilterSetParameterString(denoiseFilter, "modelPath", "./models");
+    if (status != RIF_SUCCESS)
+    {
+        return ERRCODE;
+    }
+
+    utils::TilePlan plan;
+    status = utils::PlanTiles(desc, budget, overlap,
+        utils::MakeModelMemoryFunction(RIF_IMAGE_FILTER_AI_DENOISE), plan, &std::cout);
+    if (status != RIF_SUCCESS)
+    {
+        std::cerr << "Tile planning failed: " << rifGetErrorCodeString(status) << std::endl;
+        return ERRCODE;
+    }
+
+    status = utils::RunTiled(context, queue, denoiseFilter, colorImg, outputImage, "colorImg", {}, plan, &std::cout);
+    if (status != RIF_SUCCESS)
+    {
+        std::cerr << "Tiled denoise failed: " << rifGetErrorCodeString(status) << std::endl;
+        return ERRCODE;
+    }
+
+    ImageTools::ImageSaveToFile(outputImage, "out.hdr");
+
+    //Free resources
+    rifObjectDelete(colorImg);
+    rifObjectDelete(outputImage);
+    rifObjectDelete(denoiseFilter);
+    rifObjectDelete(queue);
+    rifObjectDelete(context);
+    return 0;
+}
@@ -0,0 +1,435 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+
+namespace utils
+{
+    // Future-based execution of command queues on top of the
+    // rifContextExecuteCommandQueue completion callback. Execute() returns a
+    // Future that becomes ready when the library invokes the callback; Then()
+    // chains continuations (readback, encode, ...) that run on an Executor, and
+    // with C++20 the Future can be co_await-ed, giving an AwaitResult with the
+    // status. Several queues can be in flight while the submitting thread sleeps
+    // in Executor::RunUntil().
+
+    // Runs continuations. Callbacks from the library may arrive on an internal
+    // thread, they only post work here and never run user code directly.
+    class Executor
+    {
+    public:
+        virtual ~Executor() = default;
+        virtual void Post(std::function<void()> task) = 0;
+    };
+
+    // Executor drained by the thread that calls Run*(). Nothing runs until the
+    // owner pumps it, which makes the order of continuations deterministic.
+    class ManualExecutor : public Executor
+    {
+    public:
+        void Post(std::function<void()> task) override
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+            }
+            m_cv.notify_one();
+        }
+
+        // runs one pending task, returns false if there was none
+        bool RunOne()
+        {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_tasks.empty())
+                {
+                    return false;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+            return true;
+        }
+
+        // runs tasks until none are pending, returns the number of tasks run
+        size_t RunAll()
+        {
+            size_t count = 0;
+            while (RunOne())
+            {
+                ++count;
+            }
+            return count;
+        }
+
+        // sleeps until tasks are posted and runs them until 'done' returns true
+        void RunUntil(const std::function<bool()>& done)
+        {
+            while (!done())
+            {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_cv.wait(lock, [this]() { return !m_tasks.empty(); });
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        size_t Pending() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_tasks.size();
+        }
+
+    private:
+        std::deque<std::function<void()>> m_tasks;
+        mutable std::mutex m_mutex;
+        std::condition_variable m_cv;
+    };
+
+    template <typename T>
+    class Future;
+
+    // what co_await on a Future<T> gives: its status and its value, which is T() when
+    // the status is an error. The value is moved out of the future, which is usually a
+    // temporary gone by the end of the co_await statement.
+    template <typename T>
+    struct AwaitResult
+    {
+        rif_int status;
+        T value;
+    };
+
+    namespace detail
+    {
+        template <typename T>
+        struct SharedState
+        {
+            explicit SharedState(Executor& executor)
+                : executor(executor)
+            {   }
+
+            void Complete(rif_int result, T&& result_value)
+            {
+                std::vector<std::function<void()>> ready;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (done)
+                    {
+                        return;
+                    }
+                    status = result;
+                    value = std::move(result_value);
+                    done = true;
+                    ready.swap(continuations);
+                }
+                cv.notify_all();
+
+                for (auto& continuation : ready)
+                {
+                    executor.Post(std::move(continuation));
+                }
+            }
+
+            void AddContinuation(std::function<void()> continuation)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!done)
+                    {
+                        continuations.push_back(std::move(continuation));
+                        return;
+                    }
+                }
+                executor.Post(std::move(continuation));
+            }
+
+            Executor& executor;
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+            rif_int status = RIF_SUCCESS;
+            T value = T();
+            std::vector<std::function<void()>> continuations;
+        };
+
+        // maps 'void' continuation results onto rif_int statuses
+        template <typename R>
+        struct ContinuationResult
+        {
+            using type = R;
+
+            template <typename F, typename T>
+            static rif_int Invoke(F& f, T& value, R& result)
+            {
+                result = f(value);
+                return RIF_SUCCESS;
+            }
+        };
+
+        template <>
+        struct ContinuationResult<void>
+        {
+            using type = rif_int;
+
+            template <typename F, typename T>
+            static rif_int Invoke(F& f, T& value, rif_int& result)
+            {
+                f(value);
+                result = RIF_SUCCESS;
+                return RIF_SUCCESS;
+            }
+        };
+    }
+
+    // Completes the future it was created with
+    template <typename T>
+    class Promise
+    {
+    public:
+        explicit Promise(Executor& executor)
+            : m_state(std::make_shared<detail::SharedState<T>>(executor))
+        {   }
+
+        Future<T> GetFuture() const
+        {
+            return Future<T>(m_state);
+        }
+
+        void SetValue(T value)
+        {
+            m_state->Complete(RIF_SUCCESS, std::move(value));
+        }
+
+        void SetError(rif_int status)
+        {
+            m_state->Complete(status, T());
+        }
+
+    private:
+        std::shared_ptr<detail::SharedState<T>> m_state;
+    };
+
+    template <typename T>
+    class Future
+    {
+    public:
+        Future() = default;
+
+        explicit Future(std::shared_ptr<detail::SharedState<T>> state)
+            : m_state(std::move(state))
+        {   }
+
+        bool IsValid() const
+        {
+            return m_state != nullptr;
+        }
+
+        bool IsReady() const
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            return m_state->done;
+        }
+
+        // blocks the calling thread, prefer Then() or co_await
+        void Wait() const
+        {
+            std::unique_lock<std::mutex> lock(m_state->mutex);
+            m_state->cv.wait(lock, [this]() { return m_state->done; });
+        }
+
+        rif_int Status() const
+        {
+            Wait();
+            return m_state->status;
+        }
+
+        T& Get() const
+        {
+            Wait();
+            return m_state->value;
+        }
+
+        // 'f' - continuation taking T&, it runs on the executor once this future is ready.
+        // If this future completes with an error 'f' is skipped and the error is forwarded
+        // to the returned future. A continuation returning void yields a Future<rif_int>.
+        template <typename F>
+        auto Then(F f) const -> Future<typename detail::ContinuationResult<decltype(f(std::declval<T&>()))>::type>
+        {
+            using R = decltype(f(std::declval<T&>()));
+            using Result = typename detail::ContinuationResult<R>::type;
+
+            Promise<Result> promise(m_state->executor);
+            auto state = m_state;
+            m_state->AddContinuation([state, promise, f]() mutable
+            {
+                if (state->status != RIF_SUCCESS)
+                {
+                    promise.SetError(state->status);
+                    return;
+                }
+
+                Result result = Result();
+                detail::ContinuationResult<R>::Invoke(f, state->value, result);
+                promise.SetValue(std::move(result));
+            });
+            return promise.GetFuture();
+        }
+
+#if defined(__cpp_impl_coroutine)
+        struct Awaiter
+        {
+            std::shared_ptr<detail::SharedState<T>> state;
+
+            bool await_ready() const
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                return state->done;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                state->AddContinuation([handle]() { handle.resume(); });
+            }
+
+            AwaitResult<T> await_resume()
+            {
+                return AwaitResult<T>{ state->status, std::move(state->value) };
+            }
+        };
+
+        Awaiter operator co_await() const
+        {
+            return Awaiter{ m_state };
+        }
+#endif
+
+    private:
+        std::shared_ptr<detail::SharedState<T>> m_state;
+    };
+
+    template <typename T>
+    Future<T> MakeReadyFuture(Executor& executor, T value)
+    {
+        Promise<T> promise(executor);
+        promise.SetValue(std::move(value));
+        return promise.GetFuture();
+    }
+
+    // Submits command queues with a completion callback and returns a Future per
+    // execution. The value of the future is the executed queue.
+    class AsyncQueue
+    {
+    public:
+        // Starts an execution whose completion is signalled by calling 'callback(data)'.
+        // The default launcher is rifContextExecuteCommandQueue; tests and CPU
+        // pipelines can provide their own to drive completion deterministically.
+        using Launcher = std::function<rif_int(rif_command_queue queue, rif_exec_command_queue_callback* callback, void* data)>;
+
+        AsyncQueue(rif_context context, Executor& executor)
+            : m_executor(executor)
+            , m_launcher([context](rif_command_queue queue, rif_exec_command_queue_callback* callback, void* data)
+            {
+                return rifContextExecuteCommandQueue(context, queue, callback, data, nullptr);
+            })
+        {   }
+
+        AsyncQueue(Launcher launcher, Executor& executor)
+            : m_executor(executor)
+            , m_launcher(std::move(launcher))
+        {   }
+
+        Future<rif_command_queue> Execute(rif_command_queue queue)
+        {
+            auto pending = new Pending{ Promise<rif_command_queue>(m_executor), queue };
+            auto future = pending->promise.GetFuture();
+
+            rif_int status = m_launcher(queue, &AsyncQueue::OnFinished, pending);
+            if (status != RIF_SUCCESS)
+            {
+                // the callback is not going to be called
+                pending->promise.SetError(status);
+                delete pending;
+            }
+            return future;
+        }
+
+        Executor& GetExecutor() const
+        {
+            return m_executor;
+        }
+
+    private:
+        struct Pending
+        {
+            Promise<rif_command_queue> promise;
+            rif_command_queue queue;
+        };
+
+        static void* OnFinished(void* data)
+        {
+            auto pending = static_cast<Pending*>(data);
+            pending->promise.SetValue(pending->queue);
+            delete pending;
+            return nullptr;
+        }
+
+        Executor& m_executor;
+        Launcher m_launcher;
+    };
+
+#if defined(__cpp_impl_coroutine)
+    // Fire-and-forget coroutine type for pipelines written with co_await.
+    // The coroutine starts eagerly and resumes on the executor of the awaited futures.
+    struct AsyncTask
+    {
+        struct promise_type
+        {
+            AsyncTask get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+#endif
+}
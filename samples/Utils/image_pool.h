@@ -0,0 +1,244 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace utils
+{
+    // Recycles rif_image objects of one rif_context. Images are keyed by width, height,
+    // depth, row and slice pitch, number of components and component type; a released
+    // image is parked in the pool and handed out again for the next request with the
+    // same key instead of going through rifObjectDelete/rifContextCreateImage. Reuse is
+    // opt-in: with reuse disabled Release() deletes the image right away, so the pool is
+    // a drop-in replacement.
+    class ImagePool
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t hits = 0;          // Acquire() served from the pool
+            uint64_t misses = 0;        // Acquire() created a new image
+            uint64_t trims = 0;         // pooled images deleted to honour the byte cap
+            uint64_t pooledImages = 0;
+            uint64_t pooledBytes = 0;
+        };
+
+        // 'context' - a valid rif_context object, must outlive the pool
+        // 'byteCap' - maximum size of the released images kept alive by the pool
+        explicit ImagePool(rif_context context, uint64_t byteCap = 256ull << 20)
+            : m_context(context)
+            , m_byteCap(byteCap)
+        {   }
+
+        ~ImagePool()
+        {
+            Clear();
+        }
+
+        ImagePool(const ImagePool&) = delete;
+        ImagePool& operator=(const ImagePool&) = delete;
+
+        void SetReuseEnabled(bool enabled)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_reuse = enabled;
+            if (!m_reuse)
+            {
+                TrimLocked(0);
+            }
+        }
+
+        void SetByteCap(uint64_t byteCap)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_byteCap = byteCap;
+            TrimLocked(m_byteCap);
+        }
+
+        // 'desc' - the description of the requested image, a pitch of 0 is the packed one
+        // 'out_image' - receives a pooled or newly created image, contents are undefined
+        rif_int Acquire(const rif_image_desc& desc, rif_image* out_image)
+        {
+            if (!out_image)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_free.find(MakeKey(desc));
+                if (it != m_free.end() && !it->second.empty())
+                {
+                    // most recently released image first, it is the most likely to be resident
+                    auto entry = it->second.back();
+                    it->second.pop_back();
+
+                    *out_image = entry->image;
+                    m_stats.pooledBytes -= entry->bytes;
+                    --m_stats.pooledImages;
+                    ++m_stats.hits;
+                    m_lru.erase(entry);
+                    return RIF_SUCCESS;
+                }
+                ++m_stats.misses;
+            }
+
+            return rifContextCreateImage(m_context, &desc, nullptr, out_image);
+        }
+
+        // 'image' - an image created by Acquire() or by rifContextCreateImage on the pool's context
+        rif_int Release(rif_image image)
+        {
+            if (!image)
+            {
+                return RIF_ERROR_INVALID_PARAMETER;
+            }
+
+            rif_image_desc desc;
+            size_t retSize = 0;
+            rif_int status = rifImageGetInfo(image, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t bytes = ImageSize(desc);
+            if (!m_reuse || bytes > m_byteCap)
+            {
+                return rifObjectDelete(image);
+            }
+
+            Key key = MakeKey(desc);
+            m_lru.push_front(Entry{ key, image, bytes });
+            m_free[key].push_back(m_lru.begin());
+            m_stats.pooledBytes += bytes;
+            ++m_stats.pooledImages;
+
+            TrimLocked(m_byteCap);
+            return RIF_SUCCESS;
+        }
+
+        // deletes least recently released images until at most 'targetBytes' are pooled
+        void Trim(uint64_t targetBytes)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            TrimLocked(targetBytes);
+        }
+
+        void Clear()
+        {
+            Trim(0);
+        }
+
+        Statistics GetStatistics() const
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_stats;
+        }
+
+        static uint64_t ComponentSize(rif_component_type type)
+        {
+            switch (type)
+            {
+            case RIF_COMPONENT_TYPE_UINT8:
+                return 1;
+            case RIF_COMPONENT_TYPE_FLOAT16:
+                return 2;
+            default:
+                return 4;
+            }
+        }
+
+        static uint64_t ImageSize(const rif_image_desc& desc)
+        {
+            return uint64_t(desc.image_width) * desc.image_height * std::max(1u, desc.image_depth) *
+                desc.num_components * ComponentSize(desc.type);
+        }
+
+    private:
+        // width, height, depth, row pitch, slice pitch, components, type
+        using Key = std::tuple<rif_uint, rif_uint, rif_uint, rif_uint, rif_uint, rif_uint, rif_component_type>;
+
+        struct Entry
+        {
+            Key key;
+            rif_image image;
+            uint64_t bytes;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        static Key MakeKey(const rif_image_desc& desc)
+        {
+            // a depth of 0 is a 2D image as one of 1 is, as in ImageSize. A pitch of 0 asks
+            // for the packed one, which is what the description of the created image reports,
+            // so requests and released images are keyed on the pitch actually used
+            const rif_uint row = desc.image_row_pitch ? desc.image_row_pitch :
+                rif_uint(desc.image_width * desc.num_components * ComponentSize(desc.type));
+            const rif_uint slice = desc.image_slice_pitch ? desc.image_slice_pitch : row * desc.image_height;
+            return Key(desc.image_width, desc.image_height, std::max(1u, desc.image_depth), row, slice,
+                desc.num_components, desc.type);
+        }
+
+        void TrimLocked(uint64_t targetBytes)
+        {
+            while (m_stats.pooledBytes > targetBytes && !m_lru.empty())
+            {
+                auto entry = std::prev(m_lru.end());
+
+                auto& bucket = m_free[entry->key];
+                bucket.erase(std::find(bucket.begin(), bucket.end(), entry));
+                if (bucket.empty())
+                {
+                    m_free.erase(entry->key);
+                }
+
+                rifObjectDelete(entry->image);
+                m_stats.pooledBytes -= entry->bytes;
+                --m_stats.pooledImages;
+                ++m_stats.trims;
+                m_lru.erase(entry);
+            }
+        }
+
+        rif_context m_context;
+        uint64_t m_byteCap;
+        bool m_reuse = false;
+
+        // front is the most recently released image
+        EntryList m_lru;
+        std::map<Key, std::vector<EntryList::iterator>> m_free;
+        Statistics m_stats;
+        mutable std::mutex m_mutex;
+    };
+}
@@ -0,0 +1,273 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+namespace utils
+{
+    // Kernel binaries written to RIF_CONTEXT_KERNELS_CACHE_DIR are only valid for
+    // the library build and the kernel sources that produced them. Instead of
+    // pointing every context at one shared directory, applications point it at
+    // a content-addressed subdirectory, so a library update or an edited kernel
+    // source tree lands in a fresh directory and stale binaries are never loaded.
+    // The library is identified by the bytes of the binary loaded at run time, not
+    // by the header the application was built with.
+
+    class Fnv1a64
+    {
+    public:
+        void Update(const void* data, size_t size)
+        {
+            auto bytes = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                m_hash ^= bytes[i];
+                m_hash *= 0x100000001b3ull;
+            }
+        }
+
+        void Update(const std::string& str)
+        {
+            // hash the terminator too, so "ab"+"c" and "a"+"bc" differ
+            Update(str.c_str(), str.size() + 1);
+        }
+
+        uint64_t Get() const
+        {
+            return m_hash;
+        }
+
+    private:
+        uint64_t m_hash = 0xcbf29ce484222325ull;
+    };
+
+    // 'dir' - directory to list
+    // returns the sorted paths, relative to 'dir' and separated by '/', of the regular files
+    // in 'dir' and all of its subdirectories
+    inline std::vector<std::string> ListFiles(const std::string& dir)
+    {
+        std::vector<std::string> files;
+        std::vector<std::string> pending(1, std::string());
+        while (!pending.empty())
+        {
+            const std::string relative = pending.back();
+            pending.pop_back();
+            const std::string path = relative.empty() ? dir : dir + "/" + relative;
+            const std::string prefix = relative.empty() ? std::string() : relative + "/";
+
+#if defined(WIN32) || defined(_WIN32)
+            WIN32_FIND_DATAA data;
+            HANDLE handle = FindFirstFileA((path + "\\*").c_str(), &data);
+            if (handle != INVALID_HANDLE_VALUE)
+            {
+                do
+                {
+                    const std::string name = data.cFileName;
+                    if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                    {
+                        files.push_back(prefix + name);
+                    }
+                    else if (name != "." && name != "..")
+                    {
+                        pending.push_back(prefix + name);
+                    }
+                } while (FindNextFileA(handle, &data));
+                FindClose(handle);
+            }
+#else
+            if (DIR* handle = opendir(path.c_str()))
+            {
+                while (dirent* entry = readdir(handle))
+                {
+                    const std::string name = entry->d_name;
+                    struct stat info;
+                    if (name == "." || name == ".." || stat((path + "/" + name).c_str(), &info) != 0)
+                    {
+                        continue;
+                    }
+                    if (S_ISREG(info.st_mode))
+                    {
+                        files.push_back(prefix + name);
+                    }
+                    else if (S_ISDIR(info.st_mode) && lstat((path + "/" + name).c_str(), &info) == 0 &&
+                        !S_ISLNK(info.st_mode))
+                    {
+                        // linked directories are skipped, they may lead back up the tree
+                        pending.push_back(prefix + name);
+                    }
+                }
+                closedir(handle);
+            }
+#endif
+        }
+
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // creates 'dir' if it does not exist, returns false on failure
+    inline bool MakeDirectory(const std::string& dir)
+    {
+#if defined(WIN32) || defined(_WIN32)
+        return _mkdir(dir.c_str()) == 0 || errno == EEXIST;
+#else
+        return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+    }
+
+    // returns the file of the module rifCreateContext was loaded from: the shared
+    // library, or the executable when linked statically; empty if it cannot be found
+    inline std::string LoadedLibraryPath()
+    {
+#if defined(WIN32) || defined(_WIN32)
+        HMODULE module = nullptr;
+        char path[MAX_PATH];
+        if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                reinterpret_cast<LPCSTR>(&rifCreateContext), &module) &&
+            GetModuleFileNameA(module, path, MAX_PATH) > 0)
+        {
+            return path;
+        }
+#else
+        // looked up rather than taking &rifCreateContext, which may be the executable's PLT stub
+        Dl_info info;
+        void* symbol = dlsym(RTLD_DEFAULT, "rifCreateContext");
+        if (symbol && dladdr(symbol, &info) && info.dli_fname)
+        {
+            return info.dli_fname;
+        }
+#endif
+        return std::string();
+    }
+
+    // returns false if the loaded library cannot be read; it is hashed once per process
+    inline bool HashLoadedLibrary(Fnv1a64& hash)
+    {
+        struct Identity
+        {
+            bool found = false;
+            Fnv1a64 hash;
+        };
+        static const Identity identity = []()
+        {
+            Identity result;
+            std::ifstream file(LoadedLibraryPath(), std::ios::binary);
+            std::vector<char> content(std::istreambuf_iterator<char>(file), {});
+            result.found = !content.empty();
+            result.hash.Update(content.data(), content.size());
+            return result;
+        }();
+
+        if (identity.found)
+        {
+            const uint64_t value = identity.hash.Get();
+            hash.Update(&value, sizeof(value));
+        }
+        return identity.found;
+    }
+
+    // 'sourceDir' - kernel source directory set by RIF_CONTEXT_KERNELS_SOURCE_DIR, empty if the
+    // kernels embedded in the library are used
+    // returns the hex key identifying the library build and the kernel sources; the build is
+    // the loaded library's bytes, or only the header's version when the library cannot be read
+    inline std::string KernelCacheKey(const std::string& sourceDir = "")
+    {
+        Fnv1a64 hash;
+        hash.Update(RIF_API_VERSION_STRING);
+        HashLoadedLibrary(hash);
+
+        if (!sourceDir.empty())
+        {
+            for (const auto& name : ListFiles(sourceDir))
+            {
+                std::ifstream file(sourceDir + "/" + name, std::ios::binary);
+                std::vector<char> content(std::istreambuf_iterator<char>(file), {});
+
+                hash.Update(name);
+                hash.Update(content.data(), content.size());
+            }
+        }
+
+        char key[17];
+        snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash.Get()));
+        return key;
+    }
+
+    // 'root' - the cache root shared by all builds
+    // 'sourceDir' - see KernelCacheKey
+    // returns the content-addressed cache directory (created on demand), empty string on failure.
+    // The result is meant to be passed to rifContextSetInfo(RIF_CONTEXT_KERNELS_CACHE_DIR).
+    inline std::string KernelCacheDir(const std::string& root, const std::string& sourceDir = "")
+    {
+        if (!MakeDirectory(root))
+        {
+            return std::string();
+        }
+
+        std::string dir = root + "/" + RIF_STRINGIFY(RIF_VERSION_MAJOR) "." RIF_STRINGIFY(RIF_VERSION_MINOR) "."
+            RIF_STRINGIFY(RIF_VERSION_REVISION) "-" + KernelCacheKey(sourceDir);
+
+        return MakeDirectory(dir) ? dir : std::string();
+    }
+
+    // 'context' - a valid rif_context object
+    // points 'context' at the content-addressed cache directory under 'root'
+    inline rif_int SetKernelCacheDir(rif_context context, const std::string& root, const std::string& sourceDir = "")
+    {
+        if (!sourceDir.empty())
+        {
+            rif_int status = rifContextSetInfo(context, RIF_CONTEXT_KERNELS_SOURCE_DIR, sourceDir.c_str());
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+        }
+
+        std::string dir = KernelCacheDir(root, sourceDir);
+        if (dir.empty())
+        {
+            return RIF_ERROR_IO_ERROR;
+        }
+
+        return rifContextSetInfo(context, RIF_CONTEXT_KERNELS_CACHE_DIR, dir.c_str());
+    }
+}
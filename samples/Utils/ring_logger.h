@@ -0,0 +1,485 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils
+{
+    // Logger sink for rifLoggerAttach that keeps file I/O off the logging threads.
+    // The sink hands the library two std::streambuf objects (error and message).
+    // Characters written by a thread are staged per thread and every completed line
+    // becomes one or more fixed-size binary records in that thread's single-producer
+    // ring. A background thread drains all rings into a binary file which
+    // DecodeRingLog (and the rif-logdecode tool) turns back into text. It sleeps until
+    // a ring is half full, Flush is called or the sink is destroyed. When a ring is
+    // full the whole line is dropped and counted instead of blocking the producer.
+
+    const char RingLogMagic[8] = { 'R', 'I', 'F', 'R', 'L', 'O', 'G', '1' };
+
+    enum RingLogStream : uint16_t
+    {
+        RING_LOG_ERROR = 0,
+        RING_LOG_MESSAGE = 1,
+        RING_LOG_CONTINUED = 0x8000,    // the line goes on in the next record of the thread
+    };
+
+    struct RingLogRecord
+    {
+        uint64_t timestamp;     // nanoseconds since the sink was created
+        uint32_t thread;        // index of the producing thread, in registration order
+        uint16_t stream;        // RingLogStream flags
+        uint16_t length;        // used bytes of 'text'
+        char text[112];
+    };
+
+    static_assert(sizeof(RingLogRecord) == 128, "log records must stay two cache lines");
+
+    struct RingLogFileHeader
+    {
+        char magic[8];
+        uint32_t recordSize;
+        uint32_t reserved;
+    };
+
+    class RingLogSink
+    {
+    public:
+        // 'path' - binary log file
+        // 'recordsPerThread' - ring capacity, rounded up to a power of two
+        explicit RingLogSink(const std::string& path, size_t recordsPerThread = 4096)
+            : m_capacity(RoundUpPow2(recordsPerThread))
+            , m_start(std::chrono::steady_clock::now())
+            , m_error(*this, RING_LOG_ERROR)
+            , m_message(*this, RING_LOG_MESSAGE)
+        {
+            m_file = fopen(path.c_str(), "wb");
+            if (m_file)
+            {
+                RingLogFileHeader header;
+                memcpy(header.magic, RingLogMagic, sizeof(header.magic));
+                header.recordSize = sizeof(RingLogRecord);
+                header.reserved = 0;
+                fwrite(&header, sizeof(header), 1, m_file);
+                m_drainer = std::thread([this]() { DrainLoop(); });
+            }
+        }
+
+        ~RingLogSink()
+        {
+            if (m_drainer.joinable())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_drainMutex);
+                    m_stop = true;
+                }
+                m_drainCv.notify_all();
+                m_drainer.join();
+            }
+            if (m_file)
+            {
+                fclose(m_file);
+            }
+        }
+
+        RingLogSink(const RingLogSink&) = delete;
+        RingLogSink& operator=(const RingLogSink&) = delete;
+
+        bool IsOpen() const
+        {
+            return m_file != nullptr;
+        }
+
+        std::streambuf* ErrorBuffer()
+        {
+            return &m_error;
+        }
+
+        std::streambuf* MessageBuffer()
+        {
+            return &m_message;
+        }
+
+        // routes the library log of 'level' (RIF_LOG_LEVEL_*) into this sink
+        rif_int Attach(int level)
+        {
+            if (!IsOpen())
+            {
+                return RIF_ERROR_IO_ERROR;
+            }
+
+            rif_logger_desc desc;
+            memset(&desc, 0, sizeof(desc));
+            desc.level = level;
+            desc.error.rdbuf = ErrorBuffer();
+            desc.message.rdbuf = MessageBuffer();
+            return rifLoggerAttach(&desc);
+        }
+
+        // blocks until everything logged before the call is written to the file
+        void Flush()
+        {
+            std::unique_lock<std::mutex> lock(m_drainMutex);
+            uint64_t target = ++m_flushRequested;
+            m_drainCv.notify_all();
+            m_flushCv.wait(lock, [&]() { return m_flushDone >= target || !m_drainer.joinable(); });
+        }
+
+        uint64_t Dropped() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+    private:
+        // single producer (the owning thread), single consumer (the drainer)
+        struct Ring
+        {
+            Ring(size_t capacity, uint32_t index)
+                : records(capacity)
+                , thread(index)
+            {   }
+
+            std::vector<RingLogRecord> records;
+            uint32_t thread;
+
+            // explicit padding rather than alignas: operator new only guarantees 16-byte
+            // alignment before C++17, but 64 bytes between the indices keeps them on
+            // separate cache lines wherever the ring lands
+            char padHead[64];
+            std::atomic<uint64_t> head{ 0 };   // next record to write
+            char padTail[64];
+            std::atomic<uint64_t> tail{ 0 };   // next record to read
+            char padStaging[64];
+
+            // partial lines, touched by the producer only
+            std::string staging[2];
+        };
+
+        class Buffer : public std::streambuf
+        {
+        public:
+            Buffer(RingLogSink& sink, uint16_t stream)
+                : m_sink(sink)
+                , m_stream(stream)
+            {   }
+
+        protected:
+            std::streamsize xsputn(const char* s, std::streamsize n) override
+            {
+                Ring& ring = m_sink.LocalRing();
+                std::string& line = ring.staging[m_stream];
+                const char* end = s + n;
+                while (s != end)
+                {
+                    const char* newline = static_cast<const char*>(memchr(s, '\n', end - s));
+                    if (!newline)
+                    {
+                        line.append(s, end);
+                        break;
+                    }
+                    line.append(s, newline);
+                    m_sink.Emit(ring, m_stream, line);
+                    line.clear();
+                    s = newline + 1;
+                }
+                return n;
+            }
+
+            int_type overflow(int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                {
+                    char ch = traits_type::to_char_type(c);
+                    xsputn(&ch, 1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            int sync() override
+            {
+                Ring& ring = m_sink.LocalRing();
+                std::string& line = ring.staging[m_stream];
+                if (!line.empty())
+                {
+                    m_sink.Emit(ring, m_stream, line);
+                    line.clear();
+                }
+                return 0;
+            }
+
+        private:
+            RingLogSink& m_sink;
+            uint16_t m_stream;
+        };
+
+        static size_t RoundUpPow2(size_t value)
+        {
+            size_t result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        Ring& LocalRing()
+        {
+            // one cached ring per thread; the registry lock is only taken the first time
+            // a thread logs into this sink
+            struct Cache
+            {
+                const RingLogSink* sink = nullptr;
+                uint64_t generation = 0;
+                Ring* ring = nullptr;
+            };
+            thread_local Cache cache;
+
+            if (cache.sink == this && cache.generation == m_generation)
+            {
+                return *cache.ring;
+            }
+
+            std::lock_guard<std::mutex> lock(m_ringsMutex);
+            auto id = std::this_thread::get_id();
+            Ring* ring = nullptr;
+            for (auto& entry : m_rings)
+            {
+                if (entry.first == id)
+                {
+                    ring = entry.second.get();
+                }
+            }
+            if (!ring)
+            {
+                m_rings.emplace_back(id, std::unique_ptr<Ring>(new Ring(m_capacity, static_cast<uint32_t>(m_rings.size()))));
+                ring = m_rings.back().second.get();
+            }
+
+            cache.sink = this;
+            cache.generation = m_generation;
+            cache.ring = ring;
+            return *ring;
+        }
+
+        void Emit(Ring& ring, uint16_t stream, const std::string& line)
+        {
+            const uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+            const size_t chunk = sizeof(RingLogRecord::text);
+
+            // a line is published whole or not at all, so the decoder never sees a
+            // continued record without its end
+            const size_t count = std::max<size_t>(1, (line.size() + chunk - 1) / chunk);
+            uint64_t head = ring.head.load(std::memory_order_relaxed);
+            if (head - ring.tail.load(std::memory_order_acquire) + count > ring.records.size())
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                WakeDrainer();
+                return;
+            }
+
+            size_t offset = 0;
+            do
+            {
+                size_t length = std::min(chunk, line.size() - offset);
+                RingLogRecord& record = ring.records[head & (ring.records.size() - 1)];
+                record.timestamp = timestamp;
+                record.thread = ring.thread;
+                record.length = static_cast<uint16_t>(length);
+                record.stream = stream | (offset + length < line.size() ? RING_LOG_CONTINUED : 0);
+                memcpy(record.text, line.data() + offset, length);
+
+                offset += length;
+                ++head;
+            } while (offset < line.size());
+            ring.head.store(head, std::memory_order_release);
+
+            if (head - ring.tail.load(std::memory_order_acquire) >= ring.records.size() / 2)
+            {
+                WakeDrainer();
+            }
+        }
+
+        // the mutex is only taken once per wake-up, not per line
+        void WakeDrainer()
+        {
+            // pairs with the fence in DrainLoop: either the drain that clears the flag
+            // sees the records published before this call, or this call sees the flag clear
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_drainRequested.load(std::memory_order_relaxed) || m_drainRequested.exchange(true))
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(m_drainMutex);
+            m_drainCv.notify_all();
+        }
+
+        // returns the number of records written
+        size_t DrainOnce()
+        {
+            std::vector<Ring*> rings;
+            {
+                std::lock_guard<std::mutex> lock(m_ringsMutex);
+                for (auto& entry : m_rings)
+                {
+                    rings.push_back(entry.second.get());
+                }
+            }
+
+            size_t written = 0;
+            for (Ring* ring : rings)
+            {
+                uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+                const uint64_t head = ring->head.load(std::memory_order_acquire);
+                for (; tail != head; ++tail, ++written)
+                {
+                    fwrite(&ring->records[tail & (ring->records.size() - 1)], sizeof(RingLogRecord), 1, m_file);
+                }
+                ring->tail.store(tail, std::memory_order_release);
+            }
+            return written;
+        }
+
+        void DrainLoop()
+        {
+            std::unique_lock<std::mutex> lock(m_drainMutex);
+            for (;;)
+            {
+                uint64_t flushTarget = m_flushRequested;
+                bool stop = m_stop;
+                m_drainRequested.store(false, std::memory_order_relaxed);
+                lock.unlock();
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                while (DrainOnce() > 0)
+                {
+                }
+                if (stop || flushTarget != m_flushDone)
+                {
+                    fflush(m_file);
+                }
+
+                lock.lock();
+                m_flushDone = flushTarget;
+                m_flushCv.notify_all();
+                if (stop)
+                {
+                    return;
+                }
+                m_drainCv.wait(lock, [&]()
+                {
+                    return m_stop || m_flushRequested != flushTarget || m_drainRequested.load(std::memory_order_relaxed);
+                });
+            }
+        }
+
+        const size_t m_capacity;
+        const std::chrono::steady_clock::time_point m_start;
+        Buffer m_error;
+        Buffer m_message;
+
+        // distinguishes this sink from an earlier one allocated at the same address
+        const uint64_t m_generation = NextGeneration();
+
+        static uint64_t NextGeneration()
+        {
+            static std::atomic<uint64_t> generation(0);
+            return ++generation;
+        }
+
+        std::mutex m_ringsMutex;
+        std::vector<std::pair<std::thread::id, std::unique_ptr<Ring>>> m_rings;
+
+        FILE* m_file = nullptr;
+        std::thread m_drainer;
+        std::mutex m_drainMutex;
+        std::condition_variable m_drainCv;
+        std::condition_variable m_flushCv;
+        bool m_stop = false;
+        uint64_t m_flushRequested = 0;
+        uint64_t m_flushDone = 0;
+        std::atomic<bool> m_drainRequested{ false };
+        std::atomic<uint64_t> m_dropped{ 0 };
+    };
+
+    // 'in' - binary log written by RingLogSink
+    // 'out' - receives one text line per logged line: time, thread, stream, message
+    // returns false if 'in' is not a ring log
+    inline bool DecodeRingLog(std::istream& in, std::ostream& out)
+    {
+        RingLogFileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            memcmp(header.magic, RingLogMagic, sizeof(header.magic)) != 0 ||
+            header.recordSize != sizeof(RingLogRecord))
+        {
+            return false;
+        }
+
+        // a long line is split into consecutive records of the same thread, but records of
+        // different threads may interleave in the file
+        std::vector<std::string> pending;
+        std::vector<uint64_t> pendingTime;
+
+        RingLogRecord record;
+        while (in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+        {
+            if (record.thread >= pending.size())
+            {
+                pending.resize(record.thread + 1);
+                pendingTime.resize(record.thread + 1);
+            }
+
+            std::string& line = pending[record.thread];
+            if (line.empty())
+            {
+                pendingTime[record.thread] = record.timestamp;
+            }
+            line.append(record.text, std::min<size_t>(record.length, sizeof(record.text)));
+
+            if (!(record.stream & RING_LOG_CONTINUED))
+            {
+                out << std::fixed << std::setprecision(6) << pendingTime[record.thread] * 1e-9 << " [T"
+                    << record.thread << "] " << ((record.stream & 1) == RING_LOG_ERROR ? "ERROR " : "") << line << '\n';
+                line.clear();
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,204 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+
+#include <algorithm>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#if !defined(WIN32) && !defined(_WIN32)
+#include <dlfcn.h>
+#endif
+
+namespace utils
+{
+    // Splits an image into tiles small enough for an AI filter to run within a memory
+    // budget. Each tile is processed with 'overlap' extra pixels on every side so the
+    // network sees the same context as in a full-frame run; the overlap regions are
+    // feather-blended when the tiles are merged (see tiled_filter.h).
+
+    // 'desc' - the description of the image the model runs on
+    // 'size' - receives the memory the model needs for 'desc', in bytes
+    using ModelMemoryFunction = std::function<rif_int(const rif_image_desc& desc, rif_uint64* size)>;
+
+    struct TilePlan
+    {
+        rif_uint tileWidth = 0;     // tile size without overlap
+        rif_uint tileHeight = 0;
+        rif_uint overlap = 0;
+        rif_uint tilesX = 0;
+        rif_uint tilesY = 0;
+        rif_uint64 tileMemory = 0;  // model memory of one tile including overlap
+        rif_uint64 imageMemory = 0; // model memory of the whole image
+
+        rif_uint TileCount() const
+        {
+            return tilesX * tilesY;
+        }
+    };
+
+    // The prebuilt Linux and macOS libraries of this release do not export
+    // rifGetModelMemorySize, so it is looked up at run time there.
+    inline rif_int GetModelMemorySize(rif_image_desc const* imageDesc, rif_ai_models_desc const* modelDesc,
+        rif_uint64* memorySize, const rif_char* modelPath)
+    {
+#if defined(WIN32) || defined(_WIN32)
+        return rifGetModelMemorySize(imageDesc, modelDesc, memorySize, modelPath);
+#else
+        using GetModelMemorySizeFunction = rif_int (*)(rif_image_desc const*, rif_ai_models_desc const*, rif_uint64*, const rif_char*);
+        static auto function = reinterpret_cast<GetModelMemorySizeFunction>(dlsym(RTLD_DEFAULT, "rifGetModelMemorySize"));
+        return function ? function(imageDesc, modelDesc, memorySize, modelPath) : RIF_ERROR_UNSUPPORTED;
+#endif
+    }
+
+    // returns a ModelMemoryFunction querying rifGetModelMemorySize for the given model
+    inline ModelMemoryFunction MakeModelMemoryFunction(rif_image_filter_type filterType,
+        rif_compute_type computeType = RIF_COMPUTE_TYPE_FLOAT, const std::string& modelPath = "./models")
+    {
+        return [=](const rif_image_desc& desc, rif_uint64* size)
+        {
+            rif_ai_models_desc modelDesc;
+            modelDesc.filter_type = filterType;
+            modelDesc.param = nullptr;
+            modelDesc.compute_type = computeType;
+            return GetModelMemorySize(&desc, &modelDesc, size, modelPath.c_str());
+        };
+    }
+
+    // 'image' - the description of the full image
+    // 'budget' - memory available to the model, in bytes
+    // 'overlap' - context pixels added on each side of a tile
+    // 'alignment' - tile sizes are multiples of it; 16 keeps them divisible through the
+    //  U-Net pooling levels and satisfies the multiple-of-8 rule of rifCommandQueueAttachImageFilterRect
+    // 'plan' - receives the largest square-ish tiling that fits into 'budget'
+    // 'log' - if not nullptr, receives the planner decisions
+    // returns RIF_ERROR_OUT_OF_VIDEO_MEMORY if even the smallest tile does not fit
+    inline rif_int PlanTiles(const rif_image_desc& image, rif_uint64 budget, rif_uint overlap,
+        const ModelMemoryFunction& memorySize, TilePlan& plan, std::ostream* log = nullptr, rif_uint alignment = 16)
+    {
+        if (!memorySize || image.image_width == 0 || image.image_height == 0 || alignment == 0)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        auto query = [&](rif_uint width, rif_uint height, rif_uint64& size)
+        {
+            rif_image_desc desc = image;
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.image_row_pitch = 0;
+            desc.image_slice_pitch = 0;
+            return memorySize(desc, &size);
+        };
+
+        plan = TilePlan();
+        plan.overlap = overlap;
+
+        rif_int status = query(image.image_width, image.image_height, plan.imageMemory);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        if (plan.imageMemory <= budget)
+        {
+            plan.tileWidth = image.image_width;
+            plan.tileHeight = image.image_height;
+            plan.overlap = 0;
+            plan.tilesX = plan.tilesY = 1;
+            plan.tileMemory = plan.imageMemory;
+
+            if (log)
+            {
+                *log << "[TilePlanner] " << image.image_width << "x" << image.image_height << " needs "
+                    << (plan.imageMemory >> 20) << " MiB, fits the " << (budget >> 20) << " MiB budget untiled" << std::endl;
+            }
+            return RIF_SUCCESS;
+        }
+
+        // model memory grows monotonically with the tile area, so binary search the tile edge
+        const rif_uint maxEdge = std::max(image.image_width, image.image_height);
+        rif_uint lo = 1;
+        rif_uint hi = (maxEdge + alignment - 1) / alignment;
+        rif_uint best = 0;
+        rif_uint64 bestMemory = 0;
+        int probes = 0;
+
+        while (lo <= hi)
+        {
+            rif_uint mid = lo + (hi - lo) / 2;
+            rif_uint edge = mid * alignment;
+            rif_uint paddedWidth = std::min(edge, image.image_width) + 2 * overlap;
+            rif_uint paddedHeight = std::min(edge, image.image_height) + 2 * overlap;
+
+            rif_uint64 size = 0;
+            status = query(std::min(paddedWidth, image.image_width), std::min(paddedHeight, image.image_height), size);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            ++probes;
+
+            if (size <= budget)
+            {
+                best = mid;
+                bestMemory = size;
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid - 1;
+            }
+        }
+
+        if (best == 0)
+        {
+            if (log)
+            {
+                *log << "[TilePlanner] no tile of " << alignment << "px plus " << overlap
+                    << "px overlap fits the " << (budget >> 20) << " MiB budget" << std::endl;
+            }
+            return RIF_ERROR_OUT_OF_VIDEO_MEMORY;
+        }
+
+        rif_uint edge = best * alignment;
+        plan.tileWidth = std::min(edge, image.image_width);
+        plan.tileHeight = std::min(edge, image.image_height);
+        plan.tilesX = (image.image_width + plan.tileWidth - 1) / plan.tileWidth;
+        plan.tilesY = (image.image_height + plan.tileHeight - 1) / plan.tileHeight;
+        plan.tileMemory = bestMemory;
+
+        if (log)
+        {
+            *log << "[TilePlanner] " << image.image_width << "x" << image.image_height << " needs "
+                << (plan.imageMemory >> 20) << " MiB, budget " << (budget >> 20) << " MiB: "
+                << plan.tilesX << "x" << plan.tilesY << " tiles of " << plan.tileWidth << "x" << plan.tileHeight
+                << " + " << overlap << "px overlap, " << (plan.tileMemory >> 20) << " MiB per tile ("
+                << probes << " size queries)" << std::endl;
+        }
+        return RIF_SUCCESS;
+    }
+}
@@ -0,0 +1,384 @@
+/**********************************************************************
+Copyright (c) 2022 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#pragma once
+
+#include "RadeonImageFilters.h"
+#include "Half/half.hpp"
+#include "image_pool.h"
+#include "tile_planner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace utils
+{
+    inline size_t ComponentSize(rif_component_type type)
+    {
+        switch (type)
+        {
+        case RIF_COMPONENT_TYPE_UINT8:
+            return 1;
+        case RIF_COMPONENT_TYPE_FLOAT16:
+            return 2;
+        default:
+            return 4;
+        }
+    }
+
+    inline size_t RowPitch(const rif_image_desc& desc)
+    {
+        return desc.image_row_pitch ? desc.image_row_pitch :
+            size_t(desc.image_width) * desc.num_components * ComponentSize(desc.type);
+    }
+
+    // copies 'image' into 'pixels' as tightly packed floats, UINT8 is normalized to [0, 1]
+    inline rif_int ReadImageFloat(rif_image image, rif_image_desc& desc, std::vector<float>& pixels)
+    {
+        size_t retSize = 0;
+        rif_int status = rifImageGetInfo(image, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        void* data = nullptr;
+        status = rifImageMap(image, RIF_IMAGE_MAP_READ, &data);
+        if (status != RIF_SUCCESS || !data)
+        {
+            return status != RIF_SUCCESS ? status : RIF_ERROR_INTERNAL_ERROR;
+        }
+
+        const size_t rowSize = size_t(desc.image_width) * desc.num_components;
+        pixels.resize(rowSize * desc.image_height);
+        for (rif_uint y = 0; y < desc.image_height; ++y)
+        {
+            const rif_uchar* row = static_cast<const rif_uchar*>(data) + y * RowPitch(desc);
+            float* dst = &pixels[y * rowSize];
+            for (size_t i = 0; i < rowSize; ++i)
+            {
+                switch (desc.type)
+                {
+                case RIF_COMPONENT_TYPE_UINT8:
+                    dst[i] = row[i] / 255.f;
+                    break;
+                case RIF_COMPONENT_TYPE_FLOAT16:
+                    dst[i] = reinterpret_cast<const half_float::half*>(row)[i];
+                    break;
+                default:
+                    dst[i] = reinterpret_cast<const float*>(row)[i];
+                    break;
+                }
+            }
+        }
+
+        return rifImageUnmap(image, data);
+    }
+
+    // copies tightly packed floats into 'image', converting to its component type
+    inline rif_int WriteImageFloat(rif_image image, const float* pixels)
+    {
+        rif_image_desc desc;
+        size_t retSize = 0;
+        rif_int status = rifImageGetInfo(image, RIF_IMAGE_DESC, sizeof(desc), &desc, &retSize);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        void* data = nullptr;
+        status = rifImageMap(image, RIF_IMAGE_MAP_WRITE, &data);
+        if (status != RIF_SUCCESS || !data)
+        {
+            return status != RIF_SUCCESS ? status : RIF_ERROR_INTERNAL_ERROR;
+        }
+
+        const size_t rowSize = size_t(desc.image_width) * desc.num_components;
+        for (rif_uint y = 0; y < desc.image_height; ++y)
+        {
+            rif_uchar* row = static_cast<rif_uchar*>(data) + y * RowPitch(desc);
+            const float* src = pixels + y * rowSize;
+            for (size_t i = 0; i < rowSize; ++i)
+            {
+                switch (desc.type)
+                {
+                case RIF_COMPONENT_TYPE_UINT8:
+                    row[i] = static_cast<rif_uchar>(std::min(std::max(src[i], 0.f), 1.f) * 255.f + 0.5f);
+                    break;
+                case RIF_COMPONENT_TYPE_FLOAT16:
+                    reinterpret_cast<half_float::half*>(row)[i] = half_float::half(src[i]);
+                    break;
+                default:
+                    reinterpret_cast<float*>(row)[i] = src[i];
+                    break;
+                }
+            }
+        }
+
+        return rifImageUnmap(image, data);
+    }
+
+    // An image parameter of the filter that has to be cropped together with the input,
+    // e.g. "normalsImg" for RIF_IMAGE_FILTER_AI_DENOISE
+    struct TiledParameter
+    {
+        std::string name;
+        rif_image image;
+    };
+
+    namespace detail
+    {
+        struct HostImage
+        {
+            rif_image_desc desc;
+            std::vector<float> pixels;
+        };
+
+        // 1 inside the tile core, ramping down to 0 across the overlap
+        inline float FeatherWeight(int x, int paddedBegin, int coreBegin, int coreEnd, int paddedEnd)
+        {
+            if (x < coreBegin)
+            {
+                return float(x - paddedBegin + 1) / float(coreBegin - paddedBegin + 1);
+            }
+            if (x >= coreEnd)
+            {
+                return float(paddedEnd - x) / float(paddedEnd - coreEnd + 1);
+            }
+            return 1.f;
+        }
+
+        inline rif_int UploadCrop(ImagePool& pool, const HostImage& src, rif_uint x0, rif_uint y0,
+            rif_uint width, rif_uint height, rif_image& out, rif_uint64& bytes)
+        {
+            rif_image_desc desc = src.desc;
+            desc.image_width = width;
+            desc.image_height = height;
+            desc.image_row_pitch = 0;
+            desc.image_slice_pitch = 0;
+
+            rif_int status = pool.Acquire(desc, &out);
+            if (status != RIF_SUCCESS)
+            {
+                return status;
+            }
+            bytes += ImagePool::ImageSize(desc);
+
+            const size_t channels = desc.num_components;
+            std::vector<float> crop(size_t(width) * height * channels);
+            for (rif_uint y = 0; y < height; ++y)
+            {
+                const float* row = &src.pixels[((y0 + y) * size_t(src.desc.image_width) + x0) * channels];
+                std::copy(row, row + width * channels, &crop[y * width * channels]);
+            }
+            return WriteImageFloat(out, crop.data());
+        }
+    }
+
+    // 'filter' - filter to run tile by tile, typically RIF_IMAGE_FILTER_AI_DENOISE or AI_UPSCALE
+    // 'input', 'output' - full-size images; the output may be an integer multiple of the input size
+    // 'inputParameter' - name of the filter parameter that must point at the input tile ("colorImg"), may be empty
+    // 'parameters' - additional per-pixel inputs cropped alongside the input
+    // 'plan' - tiling computed by PlanTiles
+    // 'log' - if not nullptr, receives per-tile progress and the peak memory estimate
+    inline rif_int RunTiled(rif_context context, rif_command_queue queue, rif_image_filter filter,
+        rif_image input, rif_image output, const std::string& inputParameter,
+        const std::vector<TiledParameter>& parameters, const TilePlan& plan, std::ostream* log = nullptr)
+    {
+        if (plan.TileCount() == 0)
+        {
+            return RIF_ERROR_INVALID_PARAMETER;
+        }
+
+        detail::HostImage source;
+        rif_int status = ReadImageFloat(input, source.desc, source.pixels);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        std::vector<detail::HostImage> guides(parameters.size());
+        for (size_t i = 0; i < parameters.size() && status == RIF_SUCCESS; ++i)
+        {
+            status = ReadImageFloat(parameters[i].image, guides[i].desc, guides[i].pixels);
+        }
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        rif_image_desc outDesc;
+        size_t retSize = 0;
+        status = rifImageGetInfo(output, RIF_IMAGE_DESC, sizeof(outDesc), &outDesc, &retSize);
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        const rif_uint scale = std::max(1u, outDesc.image_width / source.desc.image_width);
+        const size_t channels = outDesc.num_components;
+        std::vector<float> accum(size_t(outDesc.image_width) * outDesc.image_height * channels, 0.f);
+        std::vector<float> weights(size_t(outDesc.image_width) * outDesc.image_height, 0.f);
+
+        rif_uint64 hostBytes = (accum.size() + weights.size() + source.pixels.size()) * sizeof(float);
+        for (const auto& guide : guides)
+        {
+            hostBytes += guide.pixels.size() * sizeof(float);
+        }
+        rif_uint64 peakDeviceBytes = 0;
+
+        // edge tiles have other sizes than interior ones, the pool keeps one set per size
+        ImagePool pool(context);
+        pool.SetReuseEnabled(true);
+
+        const int width = static_cast<int>(source.desc.image_width);
+        const int height = static_cast<int>(source.desc.image_height);
+        const int overlap = static_cast<int>(plan.overlap);
+
+        for (rif_uint ty = 0; ty < plan.tilesY && status == RIF_SUCCESS; ++ty)
+        {
+            for (rif_uint tx = 0; tx < plan.tilesX && status == RIF_SUCCESS; ++tx)
+            {
+                const int coreX0 = tx * plan.tileWidth;
+                const int coreY0 = ty * plan.tileHeight;
+                const int coreX1 = std::min<int>(coreX0 + plan.tileWidth, width);
+                const int coreY1 = std::min<int>(coreY0 + plan.tileHeight, height);
+                const int padX0 = std::max(coreX0 - overlap, 0);
+                const int padY0 = std::max(coreY0 - overlap, 0);
+                const int padX1 = std::min(coreX1 + overlap, width);
+                const int padY1 = std::min(coreY1 + overlap, height);
+                const rif_uint tileWidth = padX1 - padX0;
+                const rif_uint tileHeight = padY1 - padY0;
+
+                rif_uint64 deviceBytes = plan.tileMemory;
+                rif_image tileInput = nullptr;
+                rif_image tileOutput = nullptr;
+                std::vector<rif_image> tileGuides(guides.size(), nullptr);
+
+                status = detail::UploadCrop(pool, source, padX0, padY0, tileWidth, tileHeight, tileInput, deviceBytes);
+                for (size_t i = 0; i < guides.size() && status == RIF_SUCCESS; ++i)
+                {
+                    status = detail::UploadCrop(pool, guides[i], padX0, padY0, tileWidth, tileHeight, tileGuides[i], deviceBytes);
+                    if (status == RIF_SUCCESS)
+                        status = rifImageFilterSetParameterImage(filter, parameters[i].name.c_str(), tileGuides[i]);
+                }
+                if (status == RIF_SUCCESS && !inputParameter.empty())
+                {
+                    status = rifImageFilterSetParameterImage(filter, inputParameter.c_str(), tileInput);
+                }
+                if (status == RIF_SUCCESS)
+                {
+                    rif_image_desc tileDesc = outDesc;
+                    tileDesc.image_width = tileWidth * scale;
+                    tileDesc.image_height = tileHeight * scale;
+                    tileDesc.image_row_pitch = 0;
+                    tileDesc.image_slice_pitch = 0;
+                    status = pool.Acquire(tileDesc, &tileOutput);
+                    deviceBytes += ImagePool::ImageSize(tileDesc);
+                }
+                if (status == RIF_SUCCESS)
+                    status = rifCommandQueueAttachImageFilter(queue, filter, tileInput, tileOutput);
+                if (status == RIF_SUCCESS)
+                {
+                    status = rifContextExecuteCommandQueue(context, queue, nullptr, nullptr, nullptr);
+                    if (status == RIF_SUCCESS)
+                        status = rifSyncronizeQueue(queue);
+                    rifCommandQueueDetachImageFilter(queue, filter);
+                }
+
+                detail::HostImage result;
+                if (status == RIF_SUCCESS)
+                    status = ReadImageFloat(tileOutput, result.desc, result.pixels);
+
+                if (status == RIF_SUCCESS)
+                {
+                    // feather only towards neighbouring tiles, image borders keep full weight
+                    for (int y = padY0 * int(scale); y < padY1 * int(scale); ++y)
+                    {
+                        float wy = detail::FeatherWeight(y, padY0 * scale, coreY0 * scale, coreY1 * scale, padY1 * scale);
+                        for (int x = padX0 * int(scale); x < padX1 * int(scale); ++x)
+                        {
+                            float w = wy * detail::FeatherWeight(x, padX0 * scale, coreX0 * scale, coreX1 * scale, padX1 * scale);
+                            size_t dst = size_t(y) * outDesc.image_width + x;
+                            size_t src = (size_t(y - padY0 * scale) * result.desc.image_width + (x - padX0 * scale)) * result.desc.num_components;
+                            for (size_t c = 0; c < channels; ++c)
+                            {
+                                accum[dst * channels + c] += w * result.pixels[src + std::min<size_t>(c, result.desc.num_components - 1)];
+                            }
+                            weights[dst] += w;
+                        }
+                    }
+                }
+
+                peakDeviceBytes = std::max(peakDeviceBytes, deviceBytes);
+                if (log)
+                {
+                    *log << "[TiledFilter] tile " << ty * plan.tilesX + tx + 1 << "/" << plan.TileCount()
+                        << " at (" << padX0 << ", " << padY0 << ") " << tileWidth << "x" << tileHeight
+                        << (status == RIF_SUCCESS ? "" : " failed") << std::endl;
+                }
+
+                pool.Release(tileInput);
+                pool.Release(tileOutput);
+                for (auto tileGuide : tileGuides)
+                {
+                    pool.Release(tileGuide);
+                }
+            }
+        }
+
+        // restore the full-size images on the filter
+        for (size_t i = 0; i < parameters.size(); ++i)
+        {
+            rifImageFilterSetParameterImage(filter, parameters[i].name.c_str(), parameters[i].image);
+        }
+        if (!inputParameter.empty())
+        {
+            rifImageFilterSetParameterImage(filter, inputParameter.c_str(), input);
+        }
+
+        if (status != RIF_SUCCESS)
+        {
+            return status;
+        }
+
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            float inv = weights[i] > 0.f ? 1.f / weights[i] : 0.f;
+            for (size_t c = 0; c < channels; ++c)
+            {
+                accum[i * channels + c] *= inv;
+            }
+        }
+
+        if (log)
+        {
+            *log << "[TiledFilter] peak device memory estimate " << (peakDeviceBytes >> 20) << " MiB (model "
+                << (plan.tileMemory >> 20) << " MiB), host buffers " << (hostBytes >> 20) << " MiB" << std::endl;
+        }
+
+        return WriteImageFloat(output, accum.data());
+    }
+}